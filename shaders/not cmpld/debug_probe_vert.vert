@@ -14,6 +14,8 @@ layout(push_constant) uniform PushConsts
 	float zDist;
 	uint debugType;
 	vec2 invIrradianceTextureResolution;
+	float invProbeMaxActiveDistance;
+	ivec3 probeScroll;
 } pushConstants;
 
 layout(location = 0) in vec3 positionLocal;
@@ -33,11 +35,13 @@ void main()
 		 gl_InstanceIndex % pushConstants.probeCountX, 
 		(gl_InstanceIndex % (pushConstants.probeCountX * pushConstants.probeCountY)) / pushConstants.probeCountX, 
 		 gl_InstanceIndex / (pushConstants.probeCountX * pushConstants.probeCountY));
+	ivec3 probeCount = ivec3(pushConstants.probeCountX, pushConstants.probeCountY, pushConstants.probeCountZ);
+	ivec3 logicalProbeID = (outProbeID - pushConstants.probeScroll + probeCount) % probeCount;
 	vec3 probeOffset = imageLoad(ProbeOffsetImage, outProbeID).xyz;
 	vec3 positionWorld = pushConstants.firstProbePosition + 
-		vec3(pushConstants.xDist * (outProbeID.x + probeOffset.x), 
-			 pushConstants.yDist * (outProbeID.y + probeOffset.y), 
-			 pushConstants.zDist * (outProbeID.z + probeOffset.z));
+		vec3(pushConstants.xDist * (logicalProbeID.x + probeOffset.x), 
+			 pushConstants.yDist * (logicalProbeID.y + probeOffset.y), 
+			 pushConstants.zDist * (logicalProbeID.z + probeOffset.z));
 	float probeSizeModif = 4.0 / float(max(max(pushConstants.probeCountX, pushConstants.probeCountY), pushConstants.probeCountZ));
     vec4 vertPos = coordTransformData.ndcFromWorld * vec4(positionLocal * probeSizeModif + positionWorld, 1.0);
     gl_Position = vertPos;
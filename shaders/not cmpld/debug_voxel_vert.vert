@@ -12,6 +12,8 @@ layout(push_constant) uniform PushConsts
 	uint resolution;
 	float voxelSize;
 	uint indexROMA;
+	vec3 center;
+	ivec3 voxelScroll;
 } pushConstants;
 
 layout(set = 1, binding = 0, r32ui) uniform readonly uimage3D BOM;
@@ -39,16 +41,17 @@ layout(location = 1) out flat uint renderVoxel;
 void main() 
 {
 	ivec3 voxelCoord = ivec3(gl_VertexIndex % pushConstants.resolution, gl_VertexIndex / (pushConstants.resolution * pushConstants.resolution), (gl_VertexIndex % (pushConstants.resolution * pushConstants.resolution)) / pushConstants.resolution);
+	ivec3 physicalVoxelCoord = getPhysicalVoxelCoord(voxelCoord, pushConstants.voxelScroll, int(pushConstants.resolution));
 	
 	if (pushConstants.debugType == DEBUG_TYPE_BOM)
 	{
 		const uint packingX = 4;
 		const uint packingY = 2;
 		const uint packingZ = 4;
-		renderVoxel = imageLoad(BOM, ivec3(voxelCoord.x / packingX, voxelCoord.y / packingY, voxelCoord.z / packingZ)).x;
-		renderVoxel &= 1 << ((voxelCoord.x % packingX) * 4) << ((voxelCoord.y % packingY) * 16) << ((voxelCoord.z % packingZ));
+		renderVoxel = imageLoad(BOM, ivec3(physicalVoxelCoord.x / packingX, physicalVoxelCoord.y / packingY, physicalVoxelCoord.z / packingZ)).x;
+		renderVoxel &= 1 << ((physicalVoxelCoord.x % packingX) * 4) << ((physicalVoxelCoord.y % packingY) * 16) << ((physicalVoxelCoord.z % packingZ));
 		outColor = vec3(voxelCoord.x % 2, voxelCoord.y % 2, voxelCoord.z % 2);
-		vec3 origin = vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
+		vec3 origin = pushConstants.center + vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
 		gl_Position = vec4(origin + pushConstants.voxelSize * voxelCoord, 1.0);
 	}
 	else if (pushConstants.debugType == DEBUG_TYPE_ROM)
@@ -63,17 +66,17 @@ void main()
 			(0.5 * (1.0 - pushConstants.resolution) + voxelCoord.x) * viewmatsROMA.viewmats[pushConstants.indexROMA][0].xyz * pushConstants.voxelSize + 
 			(0.5 * (1.0 - pushConstants.resolution) + voxelCoord.y) * viewmatsROMA.viewmats[pushConstants.indexROMA][1].xyz * pushConstants.voxelSize + 
 			(0.5 * (1.0 - pushConstants.resolution) + voxelCoord.z) * viewmatsROMA.viewmats[pushConstants.indexROMA][2].xyz * pushConstants.voxelSize;
-		gl_Position = vec4(pos, 1.0);
+		gl_Position = vec4(pushConstants.center + pos, 1.0);
 	}
 	else if (pushConstants.debugType == DEBUG_TYPE_ALBEDO)
 	{
 		vec3 albedo;
 		vec3 normal;
-		unpackMaterialVM(albedo, normal, imageLoad(AlbedoNormalVoxelMap, ivec3(voxelCoord.x, voxelCoord.y, voxelCoord.z)));
+		unpackMaterialVM(albedo, normal, imageLoad(AlbedoNormalVoxelMap, physicalVoxelCoord));
 
 		renderVoxel = uint(any(greaterThan(albedo, vec3(0.0001))));
 		outColor = albedo;
-		vec3 origin = vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
+		vec3 origin = pushConstants.center + vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
 		gl_Position = vec4(origin + pushConstants.voxelSize * voxelCoord, 1.0);
 	}
 	else if (pushConstants.debugType == DEBUG_TYPE_METALNESS)
@@ -81,11 +84,11 @@ void main()
 		vec3 emission;
 		float roughness;
 		float metalness;
-		unpackEmissionVM(emission, metalness, roughness, imageLoad(EmissionMetRoughVoxelMap, ivec3(voxelCoord.x, voxelCoord.y, voxelCoord.z)));
+		unpackEmissionVM(emission, metalness, roughness, imageLoad(EmissionMetRoughVoxelMap, physicalVoxelCoord));
 
 		renderVoxel = uint(metalness > 0.0001);
 		outColor = vec3(metalness);
-		vec3 origin = vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
+		vec3 origin = pushConstants.center + vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
 		gl_Position = vec4(origin + pushConstants.voxelSize * voxelCoord, 1.0);
 	}
 	else if (pushConstants.debugType == DEBUG_TYPE_ROUGHNESS)
@@ -93,11 +96,11 @@ void main()
 		vec3 emission;
 		float roughness;
 		float metalness;
-		unpackEmissionVM(emission, metalness, roughness, imageLoad(EmissionMetRoughVoxelMap, ivec3(voxelCoord.x, voxelCoord.y, voxelCoord.z)));
+		unpackEmissionVM(emission, metalness, roughness, imageLoad(EmissionMetRoughVoxelMap, physicalVoxelCoord));
 
 		renderVoxel = uint(roughness > 0.0001);
 		outColor = vec3(roughness);
-		vec3 origin = vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
+		vec3 origin = pushConstants.center + vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
 		gl_Position = vec4(origin + pushConstants.voxelSize * voxelCoord, 1.0);
 	}
 	else if (pushConstants.debugType == DEBUG_TYPE_EMISSION)
@@ -105,11 +108,11 @@ void main()
 		vec3 emission;
 		float roughness;
 		float metalness;
-		unpackEmissionVM(emission, metalness, roughness, imageLoad(EmissionMetRoughVoxelMap, ivec3(voxelCoord.x, voxelCoord.y, voxelCoord.z)));
+		unpackEmissionVM(emission, metalness, roughness, imageLoad(EmissionMetRoughVoxelMap, physicalVoxelCoord));
 
 		renderVoxel = uint(any(greaterThan(emission, vec3(0.0001))));
 		outColor = emission;
-		vec3 origin = vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
+		vec3 origin = pushConstants.center + vec3(0.5) * pushConstants.voxelSize * (1.0 - pushConstants.resolution);
 		gl_Position = vec4(origin + pushConstants.voxelSize * voxelCoord, 1.0);
 	}
 	else
@@ -1,10 +1,11 @@
 #version 460
 
 #extension GL_GOOGLE_include_directive						: enable
+#extension GL_EXT_nonuniform_qualifier						: enable
 
 #include "gi_data.h"
 
-layout(set = 2, binding = 0) uniform sampler2DArray imageListArray[64];
+layout(set = 2, binding = 0) uniform sampler2DArray imageListArray[];
 
 layout(set = 3, binding = 0, r32ui) uniform uimage3D BOM;
 layout(set = 4, binding = 0, rgba16ui) uniform writeonly uimage3D EmissionMetRoughVoxelMap;
@@ -18,14 +19,24 @@ layout(location = 4) in flat uint in_mrList_mrLayer;
 
 layout(push_constant) uniform PushConsts 
 {
+	vec3 center;
 	float halfSide;
+	ivec3 slabMin;
 	uint resolutionBOM;
+	ivec3 slabMax;
 	uint resolutionVM;
+	ivec3 voxelScroll;
+	uint drawOffset;
 } pushConstants;
 
 void main() 
 {
-	vec3 coordsBOM = inVoxTexCoords * pushConstants.resolutionBOM;
+	//Only the slab being revoxelized is written
+	ivec3 logicalCoordsVM = ivec3(inVoxTexCoords * pushConstants.resolutionVM);
+	if (any(lessThan(logicalCoordsVM, pushConstants.slabMin)) || any(greaterThanEqual(logicalCoordsVM, pushConstants.slabMax)))
+		return;
+
+	ivec3 coordsBOM = getPhysicalVoxelCoord(ivec3(inVoxTexCoords * pushConstants.resolutionBOM), pushConstants.voxelScroll, int(pushConstants.resolutionBOM));
 
 	const uint packingX = 4;
 	const uint packingY = 2;
@@ -55,6 +66,7 @@ void main()
 
 	uvec4 anData = uvec4(anR, anG, anB, anA);
 
-	imageStore(EmissionMetRoughVoxelMap, ivec3(inVoxTexCoords * (pushConstants.resolutionVM)), emrData);
-	imageStore(AlbedoNormalVoxelMap, ivec3(inVoxTexCoords * (pushConstants.resolutionVM)), anData);
+	ivec3 coordsVM = getPhysicalVoxelCoord(logicalCoordsVM, pushConstants.voxelScroll, int(pushConstants.resolutionVM));
+	imageStore(EmissionMetRoughVoxelMap, coordsVM, emrData);
+	imageStore(AlbedoNormalVoxelMap, coordsVM, anData);
 }
\ No newline at end of file
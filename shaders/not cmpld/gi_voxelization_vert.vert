@@ -13,9 +13,14 @@ layout(location = 3) in uint packedTexCoords2x16;
 
 layout(push_constant) uniform PushConsts 
 {
+	vec3 center;
 	float halfSide;
+	ivec3 slabMin;
 	uint resolutionBOM;
+	ivec3 slabMax;
 	uint resolutionVM;
+	ivec3 voxelScroll;
+	uint drawOffset;
 } pushConstants;
 
 layout(set = 0, binding = 0) buffer ModelMatrices 
@@ -41,13 +46,13 @@ layout(location = 3) out flat uint out_mrList_mrLayer;
 
 void main() 
 {
-    DrawData drawdata = drawData.data[gl_DrawID];
+    DrawData drawdata = drawData.data[gl_DrawID + pushConstants.drawOffset];
 
     out_bcList_bcLayer_emList_emLayer = (uint(drawdata.bcIndexList) << (8 * 3)) | (uint(drawdata.bcIndexLayer) << (8 * 2)) | (uint(drawdata.emIndexList) << (8 * 1)) | (uint(drawdata.emIndexLayer));
     out_mrList_mrLayer = (uint(drawdata.mrIndexList) << (8 * 1)) | (uint(drawdata.mrIndexLayer));
 
     mat4 modelmat = modelMatrices.modelMatrices[drawdata.modelIndex];
-    gl_Position = vec4(transformOrthographicallyAxisAlignedCube(vec3(modelmat * vec4(position, 1.0)), vec3(0.0), pushConstants.halfSide), 1.0);
+    gl_Position = vec4(transformOrthographicallyAxisAlignedCube(vec3(modelmat * vec4(position, 1.0)), pushConstants.center, pushConstants.halfSide), 1.0);
     outTexCoords = unpackHalf2x16(packedTexCoords2x16);
     outNormal = normalize(mat3(modelmat) * vec3(unpackSnorm4x8(packedNormals4x8)));
 }
\ No newline at end of file
@@ -2,11 +2,11 @@
 #define BINDLESS_HEADER
 
 #extension GL_EXT_shader_explicit_arithmetic_types_int8 : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int16 : enable
 
 struct DrawData
 {
-    uint8_t modelIndex;
-    uint8_t index1;
+    uint16_t modelIndex;
     uint8_t index2;
     uint8_t index3;
     uint8_t bcIndexList;
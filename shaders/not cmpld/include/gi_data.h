@@ -19,7 +19,14 @@
 #define DDGI_IRRADIANCE_INVERSE_SCALE (1.0 / DDGI_IRRADIANCE_SCALE)
 #define DDGI_VISIBILIYY_SHARPNESS 32
 
+//Nested volumes around the camera, every cascade covers twice the extent of the previous one
+#define GI_CASCADE_COUNT 3
+//Width of the band at the edge of a cascade in which it is blended with the next one, in probe distances
+#define GI_CASCADE_BLEND_PROBES 2.0
+
 #define PROBE_STATE_IMPOTENT 0x01
+#define PROBE_STATE_RESET 0x02
+#define PROBE_STATE_DIRTY 0x04
 
 struct ProbeGridData
 {
@@ -39,7 +46,9 @@ struct ProbeGridData
 	float probeInvDistY;
 	float probeInvDistZ;
 	float shadowBias;
-	//pad3
+	int probeScrollX;
+	int probeScrollY;
+	int probeScrollZ;
 };
 
 struct SpecularData
@@ -57,23 +66,70 @@ struct VoxelizationData
 	float occupationHalfMeterSize;
 	float invOccupationHalfMeterSize;
 	float offsetNormalScaleROM;
-	//pad1
+	int voxelScrollX;
+	int voxelScrollY;
+	int voxelScrollZ;
+	//pad2
 };
 
 struct Cascade
 {
 	ProbeGridData gridData;
 	VoxelizationData voxelData;
+	vec3 center;
+	//pad
 };
 
 struct GIMetaData
 {
-	Cascade cascades[1];
+	Cascade cascades[GI_CASCADE_COUNT];
 	SpecularData specData;
 };
 
 
 
+//The volume follows the camera, data is stored toroidally with the physical coordinate being the logical one shifted by the scroll
+ivec3 getPhysicalVoxelCoord(ivec3 logicalCoord, ivec3 voxelScroll, int resolution)
+{
+	return (logicalCoord + voxelScroll) % resolution;
+}
+ivec3 getPhysicalVoxelCoord(ivec3 logicalCoord, VoxelizationData voxelData)
+{
+	return getPhysicalVoxelCoord(logicalCoord, ivec3(voxelData.voxelScrollX, voxelData.voxelScrollY, voxelData.voxelScrollZ), int(voxelData.resolutionVM));
+}
+ivec3 getPhysicalProbeID(ivec3 logicalID, ProbeGridData gridData)
+{
+	ivec3 probeCount = ivec3(gridData.probeCountX, gridData.probeCountY, gridData.probeCountZ);
+	return (logicalID + ivec3(gridData.probeScrollX, gridData.probeScrollY, gridData.probeScrollZ)) % probeCount;
+}
+ivec3 getLogicalProbeID(ivec3 physicalID, ProbeGridData gridData)
+{
+	ivec3 probeCount = ivec3(gridData.probeCountX, gridData.probeCountY, gridData.probeCountZ);
+	return (physicalID - ivec3(gridData.probeScrollX, gridData.probeScrollY, gridData.probeScrollZ) + probeCount) % probeCount;
+}
+//Scheduled probes are packed as their tile in the probe images
+ivec2 unpackProbeTile(uint packedTile)
+{
+	return ivec2(packedTile & 0xFFFF, packedTile >> 16);
+}
+uint getProbeTileLinearIndex(ivec2 probeTile, ProbeGridData gridData)
+{
+	return uint(probeTile.y) * uint(gridData.probeCountX * gridData.probeCountZ) + uint(probeTile.x);
+}
+//Probes in the slab exposed by a scroll of "scrollDelta" probes hold data from the opposite side of the volume
+bool isProbeEntering(ivec3 logicalID, ivec3 scrollDelta, ProbeGridData gridData)
+{
+	ivec3 probeCount = ivec3(gridData.probeCountX, gridData.probeCountY, gridData.probeCountZ);
+	if (any(lessThan(logicalID, ivec3(0))) || any(greaterThanEqual(logicalID, probeCount)))
+		return false;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (scrollDelta[axis] > 0 ? logicalID[axis] >= probeCount[axis] - scrollDelta[axis] : logicalID[axis] < -scrollDelta[axis])
+			return true;
+	}
+	return false;
+}
+
 vec2 getInnerProbeCoordSampling(vec3 dir)
 {
 	return encodeOctohedralZeroToOne(dir) * DDGI_PROBE_LIGHT_SIDE_SIZE;
@@ -114,9 +170,12 @@ vec3 sampleProbeVolume(ProbeGridData gridData, vec3 sampleDir, vec3 gridPos, vec
 		weight *= wrappedDP * wrappedDP + 0.2;
 		//
 
+		ivec3 probeCount = ivec3(gridData.probeCountX, gridData.probeCountY, gridData.probeCountZ);
+		vec3 physicalProbeCoord = vec3(getPhysicalProbeID(clamp(ivec3(curProbeCoord), ivec3(0), probeCount - 1), gridData));
+
 		vec3 irradiance;
 		vec2 visibility;
-		getProbeData(irradiance, visibility, sampleDir, gridData.probeCountX, curProbeCoord, gridData.invProbeTextureResolution, IrradianceProbes, VisibilityProbes);
+		getProbeData(irradiance, visibility, sampleDir, gridData.probeCountX, physicalProbeCoord, gridData.invProbeTextureResolution, IrradianceProbes, VisibilityProbes);
 
 		//Visibility weighing
 		float distToProbe = distance(gridPos, curProbeCoord * vec3(gridData.probeDistX, gridData.probeDistY, gridData.probeDistZ));
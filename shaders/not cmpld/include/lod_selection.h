@@ -0,0 +1,22 @@
+#ifndef LOD_SELECTION_HEADER
+#define LOD_SELECTION_HEADER
+
+#define LOD_MAX_COUNT 4
+//Draws projected larger than this part of the view use full detail, every halving of the projected size moves one LOD further
+#define LOD_FULL_DETAIL_PROJECTED_SIZE 0.25
+
+//Index ranges of the LODs of a draw, LOD 0 is the range of the draw command
+struct DrawLODData
+{
+	uint lodCount;
+	uint firstIndex[LOD_MAX_COUNT];
+	uint indexCount[LOD_MAX_COUNT];
+};
+
+uint selectLOD(float projectedSize, uint lodCount)
+{
+	float lod = floor(log2(LOD_FULL_DETAIL_PROJECTED_SIZE / max(projectedSize, 1e-6)));
+	return uint(clamp(lod, 0.0, float(lodCount) - 1.0));
+}
+
+#endif
\ No newline at end of file
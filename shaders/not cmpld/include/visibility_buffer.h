@@ -0,0 +1,68 @@
+#ifndef VISIBILITY_BUFFER_HEADER
+#define VISIBILITY_BUFFER_HEADER
+
+//Draw index in the high bits, triangle index of the draw in the low bits
+#define VISIBILITY_TRIANGLE_ID_BITS 20
+#define VISIBILITY_TRIANGLE_ID_MASK ((1u << VISIBILITY_TRIANGLE_ID_BITS) - 1u)
+
+//StaticVertex is position, packed normal, packed tangent and packed texture coordinates
+#define STATIC_VERTEX_WORD_COUNT 6
+
+uint packVisibility(uint drawID, uint triangleID)
+{
+	return (drawID << VISIBILITY_TRIANGLE_ID_BITS) | (triangleID & VISIBILITY_TRIANGLE_ID_MASK);
+}
+uint getVisibilityDrawID(uint visibility)
+{
+	return visibility >> VISIBILITY_TRIANGLE_ID_BITS;
+}
+uint getVisibilityTriangleID(uint visibility)
+{
+	return visibility & VISIBILITY_TRIANGLE_ID_MASK;
+}
+
+struct BarycentricDerivatives
+{
+	vec3 lambda;
+	vec3 ddx;
+	vec3 ddy;
+};
+//Perspective correct barycentrics of the pixel and their change towards the neighbouring pixels, computed from the clip space vertices of the triangle
+BarycentricDerivatives computeBarycentricDerivatives(vec4 pt0, vec4 pt1, vec4 pt2, vec2 pixelNdc, vec2 ndcPixelSize)
+{
+	BarycentricDerivatives result;
+
+	vec3 invW = 1.0 / vec3(pt0.w, pt1.w, pt2.w);
+	vec2 ndc0 = pt0.xy * invW.x;
+	vec2 ndc1 = pt1.xy * invW.y;
+	vec2 ndc2 = pt2.xy * invW.z;
+
+	float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+	result.ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+	result.ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+	float ddxSum = dot(result.ddx, vec3(1.0));
+	float ddySum = dot(result.ddy, vec3(1.0));
+
+	vec2 deltaVec = pixelNdc - ndc0;
+	float interpInvW = invW.x + deltaVec.x * ddxSum + deltaVec.y * ddySum;
+	float interpW = 1.0 / interpInvW;
+
+	result.lambda.x = interpW * (invW.x + deltaVec.x * result.ddx.x + deltaVec.y * result.ddy.x);
+	result.lambda.y = interpW * (deltaVec.x * result.ddx.y + deltaVec.y * result.ddy.y);
+	result.lambda.z = interpW * (deltaVec.x * result.ddx.z + deltaVec.y * result.ddy.z);
+
+	//Step of one pixel in NDC
+	result.ddx *= ndcPixelSize.x;
+	result.ddy *= ndcPixelSize.y;
+	ddxSum *= ndcPixelSize.x;
+	ddySum *= ndcPixelSize.y;
+
+	float interpWddx = 1.0 / (interpInvW + ddxSum);
+	float interpWddy = 1.0 / (interpInvW + ddySum);
+	result.ddx = interpWddx * (result.lambda * interpInvW + result.ddx) - result.lambda;
+	result.ddy = interpWddy * (result.lambda * interpInvW + result.ddy) - result.lambda;
+
+	return result;
+}
+
+#endif
\ No newline at end of file
@@ -1,6 +1,44 @@
 #version 460 core
 
+#extension GL_GOOGLE_include_directive						:  enable
+
+#define COORDINATE_TRANSFORMATION_SET_INDEX 0
+#include "coordinate_transformation_set.h"
+
+//Center and half axes scaled by the extents
+struct Bounds
+{
+	vec4 center;
+	vec4 halfAxes[3];
+};
+
+layout(set = 1, binding = 0) buffer readonly WorldBounds
+{
+	Bounds bounds[];
+};
+layout(set = 1, binding = 1) buffer readonly DrawCullingStatus
+{
+	uint drawCullingStatus[];
+};
+
+layout(location = 0) out vec3 outColor;
+
+//Endpoints of the twelve edges as line list vertices, bits of a corner select the sign of the x, y and z half axes
+const uint edgeCorners[24] = uint[24](
+	0, 1,  2, 3,  4, 5,  6, 7,
+	0, 2,  1, 3,  4, 6,  5, 7,
+	0, 4,  1, 5,  2, 6,  3, 7);
+
+//Indexed by the culling status: frustum culled, occluded, visible
+const vec3 statusColors[3] = vec3[3](vec3(0.98, 0.05, 0.05), vec3(0.98, 0.6, 0.03), vec3(0.03, 0.98, 0.1));
+
 void main() 
-{    
-    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
-} 
\ No newline at end of file
+{
+	Bounds box = bounds[gl_InstanceIndex];
+	uint corner = edgeCorners[gl_VertexIndex];
+	vec3 cornerSigns = vec3((corner & 1) == 0 ? 1.0 : -1.0, (corner & 2) == 0 ? 1.0 : -1.0, (corner & 4) == 0 ? 1.0 : -1.0);
+	vec3 position = box.center.xyz + box.halfAxes[0].xyz * cornerSigns.x + box.halfAxes[1].xyz * cornerSigns.y + box.halfAxes[2].xyz * cornerSigns.z;
+
+	gl_Position = coordTransformData.ndcFromWorld * vec4(position, 1.0);
+	outColor = statusColors[min(drawCullingStatus[gl_InstanceIndex], 2)];
+}
\ No newline at end of file
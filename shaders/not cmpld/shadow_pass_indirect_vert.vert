@@ -0,0 +1,86 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive						:  enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int8     :  enable
+#extension GL_ARB_shader_viewport_layer_array               :  enable
+
+#include "bindless.h"
+#include "misc.h"
+
+layout(location = 0) in vec3 position;
+
+layout(push_constant) uniform PushConsts 
+{
+	int layer;
+    uint drawDataIndexOffset;
+    float proj00;
+    float proj11;
+    float proj22;
+    float proj32;
+    uint viewMatrixIndex;
+    uint faceMask;
+} pushConstants;
+
+layout(set = 0, binding = 0) buffer ViewMatrices
+{
+    mat4 mats[];
+} viewmatrices;
+
+layout(set = 0, binding = 1) buffer ModelMatrices 
+{
+    mat4 modelMatrices[];
+} modelMatrices;
+
+layout(set = 0, binding = 2) buffer DrawDataBuffer 
+{
+    DrawData data[];
+} drawData;
+
+layout(set = 0, binding = 3) buffer DrawDataIndexBuffer 
+{
+    uint data[];
+} drawDataIndices;
+
+#define CUBE_FACE_MASK_SHIFT 24
+#define CUBE_DRAW_INDEX_MASK ((1u << CUBE_FACE_MASK_SHIFT) - 1)
+
+//Returns the face of the cube which corresponds to the n-th set bit of the mask
+int getFaceFromMask(uint mask, int n)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        if ((mask & (1u << i)) != 0)
+        {
+            if (n == 0)
+                return i;
+            --n;
+        }
+    }
+    return 0;
+}
+
+void main()
+{
+    //Cube draws carry the mask of overlapped faces and are instanced once per face, spot light draws have an empty mask
+    uint packedIndex = drawDataIndices.data[pushConstants.drawDataIndexOffset + gl_DrawID];
+    uint drawDataIndex = packedIndex & CUBE_DRAW_INDEX_MASK;
+    uint faceMask = packedIndex >> CUBE_FACE_MASK_SHIFT;
+    int layer = pushConstants.layer;
+    uint viewMatrixIndex = pushConstants.viewMatrixIndex;
+    if (faceMask != 0)
+    {
+        int face = getFaceFromMask(faceMask, gl_InstanceIndex);
+        layer = face;
+        viewMatrixIndex += face;
+    }
+
+    mat4 modelmat = modelMatrices.modelMatrices[drawData.data[drawDataIndex].modelIndex];
+    vec4 worldPos = modelmat * vec4(position, 1.0);
+    vec4 pos = viewmatrices.mats[viewMatrixIndex] * worldPos;
+    pos.x = pos.x * pushConstants.proj00;
+    pos.y = pos.y * pushConstants.proj11;
+    pos.w = pos.z;
+	pos.z = pos.z * pushConstants.proj22 + pushConstants.proj32;
+    gl_Position = pos;
+    gl_Layer = layer;
+}
@@ -18,6 +18,7 @@ layout(push_constant) uniform PushConsts
     float proj22;
     float proj32;
     uint viewMatrixIndex;
+    uint faceMask;
 } pushConstants;
 
 layout(set = 0, binding = 0) buffer ViewMatrices
@@ -35,15 +36,39 @@ layout(set = 0, binding = 2) buffer DrawDataBuffer
     DrawData data[];
 } drawData;
 
+//Returns the face of the cube which corresponds to the n-th set bit of the mask
+int getFaceFromMask(uint mask, int n)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        if ((mask & (1u << i)) != 0)
+        {
+            if (n == 0)
+                return i;
+            --n;
+        }
+    }
+    return 0;
+}
+
 void main()
 {
+    int layer = pushConstants.layer;
+    uint viewMatrixIndex = pushConstants.viewMatrixIndex;
+    if (pushConstants.faceMask != 0)
+    {
+        int face = getFaceFromMask(pushConstants.faceMask, gl_InstanceIndex);
+        layer = face;
+        viewMatrixIndex += face;
+    }
+
     mat4 modelmat = modelMatrices.modelMatrices[drawData.data[pushConstants.drawDataIndex].modelIndex];
     vec4 worldPos = modelmat * vec4(position, 1.0);
-    vec4 pos = viewmatrices.mats[pushConstants.viewMatrixIndex] * worldPos;
+    vec4 pos = viewmatrices.mats[viewMatrixIndex] * worldPos;
     pos.x = pos.x * pushConstants.proj00;
     pos.y = pos.y * pushConstants.proj11;
     pos.w = pos.z;
 	pos.z = pos.z * pushConstants.proj22 + pushConstants.proj32;
     gl_Position = pos;
-    gl_Layer = pushConstants.layer;
+    gl_Layer = layer;
 }
\ No newline at end of file
@@ -17,10 +17,13 @@ layout(location = 1) in vec3 inNorm;
 layout(location = 2) in vec3 inTang;
 layout(location = 3) in flat float inTangSign;
 layout(location = 4) in vec2 inTexC;
+layout(location = 5) in vec4 inCurrPos;
+layout(location = 6) in vec4 inPrevPos;
 
 layout(location = 0) out uint outputUV;
 layout(location = 1) out vec4 outputTangentFramePacked;
 layout(location = 2) out uint outputDrawID;
+layout(location = 3) out vec2 outputVelocity;
 
 #define COORDINATE_TRANSFORMATION_SET_INDEX 0
 #include "coordinate_transformation_set.h"
@@ -34,4 +37,6 @@ void main()
     uint drawID_frameHandednessBit = drawID | (inTangSign < 0.0 ? 0x8000 : 0x0000);
 	outputDrawID = drawID_frameHandednessBit;
 	outputUV = packHalf2x16(inTexC + dFdxFine(inTexC) * coordTransformData.ndcFromWorld[2][0] - dFdyFine(inTexC) * coordTransformData.ndcFromWorld[2][1]);
+	//Screen UV offset from the previous frame, includes both camera and object motion
+	outputVelocity = (inCurrPos.xy / inCurrPos.w - inPrevPos.xy / inPrevPos.w) * 0.5;
 }
\ No newline at end of file
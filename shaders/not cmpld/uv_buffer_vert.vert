@@ -16,6 +16,8 @@ layout(location = 1) out vec3 outNorm;
 layout(location = 2) out vec3 outTang;
 layout(location = 3) out flat float outTangSign;
 layout(location = 4) out vec2 outTexC;
+layout(location = 5) out vec4 outCurrPos;
+layout(location = 6) out vec4 outPrevPos;
 
 #define COORDINATE_TRANSFORMATION_SET_INDEX 0
 #include "coordinate_transformation_set.h"
@@ -24,6 +26,11 @@ layout(set = 1, binding = 0) buffer ModelMatrices
 {
     mat4 modelMatrices[];
 } modelMatrices;
+//Transforms the draws had in the previous frame
+layout(set = 1, binding = 1) buffer PrevModelMatrices 
+{
+    mat4 modelMatrices[];
+} prevModelMatrices;
 
 layout(set = 2, binding = 0) buffer DrawDataBuffer 
 {
@@ -38,8 +45,11 @@ void main()
 {
 	drawID = drawDataIndices.data[gl_DrawID];
 	
-    mat4 modelmat = modelMatrices.modelMatrices[drawData.data[drawID].modelIndex];
+    uint modelIndex = drawData.data[drawID].modelIndex;
+    mat4 modelmat = modelMatrices.modelMatrices[modelIndex];
     gl_Position = coordTransformData.ndcFromWorld * modelmat * vec4(position, 1.0);
+    outCurrPos = gl_Position;
+    outPrevPos = coordTransformData.ndcFromWorldPrev * prevModelMatrices.modelMatrices[modelIndex] * vec4(position, 1.0);
 
     vec3 norm = vec3(unpackSnorm4x8(packedNormals4x8));
     vec4 tang = vec4(unpackSnorm4x8(packedTangents4x8));
@@ -0,0 +1,38 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive						:  enable
+
+#include "tang_frame.h"
+#include "visibility_buffer.h"
+
+//Math
+#define PI 3.141592653589
+#define TWO_PI (2.0 * PI)
+#define ONE_OVER_PI (1.0 / PI)
+#define ONE_OVER_TWO_PI (1.0 / TWO_PI)
+#define SQRT_2 1.41421356237309
+#define ONE_OVER_SQRT_2 0.7071067811865475244
+
+layout(location = 0) in flat uint drawID;
+layout(location = 1) in vec3 inNorm;
+layout(location = 2) in vec3 inTang;
+layout(location = 3) in flat float inTangSign;
+layout(location = 4) in vec2 inTexC;
+layout(location = 5) in vec4 inCurrPos;
+layout(location = 6) in vec4 inPrevPos;
+
+layout(location = 0) out uint outputVisibility;
+layout(location = 1) out vec4 outputTangentFramePacked;
+layout(location = 2) out vec2 outputVelocity;
+
+void main()
+{
+	//UVs and the shading frame are reconstructed from the triangle in the lighting pass
+	outputVisibility = packVisibility(drawID, uint(gl_PrimitiveID));
+	//Specular tracing still reads the geometric normal
+	vec3 N = normalize(inNorm);
+	vec3 B = normalize(cross(inTang, N));
+	vec3 T = cross(N, B);
+	outputTangentFramePacked = packTangentFrame(T,N,B);
+	outputVelocity = (inCurrPos.xy / inCurrPos.w - inPrevPos.xy / inPrevPos.w) * 0.5;
+}
\ No newline at end of file
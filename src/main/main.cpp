@@ -8,6 +8,7 @@
 #include <random>
 #include <string>
 #include <bitset>
+#include <limits>
 #include <intrin.h>
 
 #define GLFW_INCLUDE_VULKAN
@@ -25,6 +26,7 @@
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 
 #include <tbb/flow_graph.h>
@@ -32,11 +34,13 @@
 #include "src/rendering/vulkan_object_handling/vulkan_object_handler.h"
 #include "src/rendering/renderer/pipeline_management.h"
 #include "src/rendering/shader_management/shader_operations.h"
+#include "src/rendering/shader_management/shader_reloader.h"
 #include "src/rendering/renderer/command_management.h"
 #include "src/rendering/renderer/descriptor_management.h"
 #include "src/rendering/renderer/deferred_lighting.h"
 #include "src/rendering/data_management/memory_manager.h"
 #include "src/rendering/data_management/buffer_class.h"
+#include "src/rendering/data_management/ring_allocator.h"
 #include "src/rendering/data_management/image_classes.h"
 #include "src/rendering/renderer/sync_operations.h"
 #include "src/rendering/renderer/timeline_semaphore.h"
@@ -53,6 +57,9 @@
 #include "src/rendering/renderer/depth_buffer.h"
 #include "src/rendering/renderer/HBAO.h"
 #include "src/rendering/renderer/TAA.h"
+#include "src/rendering/renderer/dynamic_resolution.h"
+#include "src/rendering/renderer/render_graph.h"
+#include "src/rendering/renderer/transform_storage.h"
 #include "src/rendering/data_abstraction/BB.h"
 #include "src/rendering/renderer/world_transform.h"
 #include "src/rendering/UI/UI.h"
@@ -64,11 +71,9 @@
 
 #define WINDOW_WIDTH_DEFAULT  1600u
 #define WINDOW_HEIGHT_DEFAULT 900u
-#define HBAO_WIDTH_DEFAULT  1280u
-#define HBAO_HEIGHT_DEFAULT 720u
 
-#define MAX_INDIRECT_DRAWS 4096
-#define MAX_TRANSFORM_MATRICES 64
+//Bindless material arrays are sized to the image list count rounded up to this
+#define BINDLESS_ARRAY_GRANULARITY 64
 
 #define NEAR_PLANE 0.1
 #define FAR_PLANE  10000.0
@@ -76,6 +81,7 @@
 #define GENERAL_BUFFER_DEFAULT_SIZE 134217728ll
 #define SHARED_BUFFER_DEFAULT_SIZE 8388608ll
 #define DEVICE_BUFFER_DEFAULT_SIZE 268435456ll
+#define FRAME_ALLOCATOR_DEFAULT_SIZE 16777216ll
 
 namespace fs = std::filesystem;
 
@@ -86,7 +92,8 @@ Pipeline createSpaceLinesPipeline(PipelineAssembler& assembler, const ResourceSe
 
 void createResourceSets(VkDevice device,
 	ResourceSet& transformMatricesRS,
-	const BufferMapped& transformMatrices,
+	const Buffer& transformMatrices,
+	const Buffer& prevTransformMatrices,
 	ResourceSet& materialsTexturesRS,
 	const ImageListContainer& imageLists,
 	ResourceSet& skyboxRS,
@@ -101,7 +108,8 @@ void createShadowMapResourceSet(VkDevice device,
 	ResourceSet& shadowMapsRS,
 	const ImageListContainer& shadowMapLists,
 	const std::vector<ImageList>& shadowCubeMapLists,
-	const BufferBaseHostAccessible& shadowMapViewMatrices,
+	const RingAllocator& frameAllocator,
+	VkDeviceSize viewMatricesMaxSize,
 	VkSampler nearestSampler);
 void createBRDFLUTResourceSet(VkDevice device,
 	VkSampler generalSampler,
@@ -110,20 +118,17 @@ void createBRDFLUTResourceSet(VkDevice device,
 void createDirecLightingResourceSet(VkDevice device,
 	ResourceSet& directLightingRS,
 	const BufferMapped& directionalLight,
-	const BufferMapped& sortedLightsData,
-	const BufferBaseHostAccessible& typeData,
-	const BufferBaseHostInaccessible& tileData,
-	const BufferMapped& zBinData);
+	const RingAllocator& frameAllocator,
+	const BufferBaseHostInaccessible& tileData);
 
 uint32_t uploadLineVertices(fs::path filepath, Buffer& vertexBuffer, BufferBaseHostAccessible& stagingBase, CommandBufferSet& cmdBufferSet, VkQueue queue);
 void uploadSkyboxVertexData(Buffer& skyboxData, BufferBaseHostAccessible& stagingBase, CommandBufferSet& cmdBufferSet, VkQueue queue);
 
 void loadDefaultTextures(ImageListContainer& imageLists, BufferBaseHostAccessible& stagingBase, CommandBufferSet& cmdBufferSet, VkQueue queue);
 void transformOBBs(OBBs& boundingBoxes, std::vector<StaticMesh>& staticMeshes, int drawCount, const std::vector<glm::mat4>& modelMatrices);
-void getBoundingSpheres(BufferMapped& indirectDataBuffer, const OBBs& boundingBoxes);
+void moveModel(uint32_t modelIndex, const glm::mat4& newModelMatrix, TransformStorage& transformStorage, OBBs& boundingBoxes, GI& gi);
 
 void fillFrustumData(CoordinateTransformation& coordinateTransformation, Camera& camera, Clusterer& clusterer, HBAO& hbao, FrustumInfo& frustumInfo, ShadowCaster& caster, DeferredLighting& deferredLighting);
-void fillModelMatrices(const BufferMapped& modelTransformDataSSBO, const std::vector<glm::mat4>& modelMatrices);
 void fillDrawData(const BufferMapped& perDrawDataIndicesSSBO, std::vector<StaticMesh>& staticMeshes, int drawCount);
 
 void processInput(const Window& window, UiData& renderingData, Camera& camera, float deltaTime, bool disableCursor);
@@ -158,6 +163,10 @@ int main()
 	DescriptorManager descManager{ *vulkanObjectHandler };
 	ResourceSet::assignGlobalDescriptorManager(descManager);
 
+	PipelineCache pipelineCache{ vulkanObjectHandler->getLogicalDevice(), vulkanObjectHandler->getPhysicalDevice(), "pipeline_cache.bin" };
+	Pipeline::assignGlobalPipelineCache(pipelineCache);
+	ShaderReloader shaderReloader{ vulkanObjectHandler->getLogicalDevice(), "shaders/not cmpld", "shaders/cmpld" };
+
 	CommandBufferSet cmdBufferSet{ *vulkanObjectHandler };
 
 	UI ui{ window, *vulkanObjectHandler, cmdBufferSet };
@@ -165,7 +174,7 @@ int main()
 	VkDevice device{ vulkanObjectHandler->getLogicalDevice() };
 
 	BufferBaseHostInaccessible baseDeviceBuffer{ device, DEVICE_BUFFER_DEFAULT_SIZE, 
-		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT };
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT };
 	BufferBaseHostAccessible baseHostBuffer{ device, GENERAL_BUFFER_DEFAULT_SIZE, 
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT };
 	BufferBaseHostAccessible baseHostCachedBuffer{ device, GENERAL_BUFFER_DEFAULT_SIZE, 
@@ -183,10 +192,16 @@ int main()
 	uploadSkyboxVertexData(skyboxData, baseHostBuffer, cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE));
 	Buffer spaceLinesVertexData{ baseDeviceBuffer };
 	uint32_t lineVertNum{ uploadLineVertices("internal/spaceLinesMesh/space_lines_vertices.bin", spaceLinesVertexData, baseHostBuffer, cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE)) };
-	BufferMapped indirectDrawCmdData{ baseHostCachedBuffer, sizeof(IndirectData) * MAX_INDIRECT_DRAWS };
-	BufferMapped drawData{ baseHostBuffer, sizeof(uint8_t) * 12 * MAX_INDIRECT_DRAWS };
-	BufferMapped transformMatrices{ baseHostBuffer, sizeof(glm::mat4) * MAX_TRANSFORM_MATRICES };
+	//Draw buffers are sized by loadStaticMeshes() once the draws of the scene are counted
+	BufferMapped indirectDrawCmdData{ baseHostCachedBuffer };
+	BufferMapped drawLODData{ baseHostCachedBuffer };
+	BufferMapped drawData{ baseHostBuffer };
 	BufferMapped directionalLight{ baseHostBuffer, LightTypes::DirectionalLight::getDataByteSize() };
+	//Frame timeline is created before the frame allocator, which stalls on it when the ring is full
+	TimelineSemaphore semaphore{ device };
+	RingAllocator frameAllocator{ device, FRAME_ALLOCATOR_DEFAULT_SIZE, 
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		semaphore };
 	VkSampler linearSampler{ createLinearSampler(device, vulkanObjectHandler->getPhysDevLimits().maxSamplerAnisotropy) };
 	VkSampler nearestSampler{ createNearestSampler(device, vulkanObjectHandler->getPhysDevLimits().maxSamplerAnisotropy) };
 	Image brdfLUT{ TextureLoaders::loadTexture(*vulkanObjectHandler, cmdBufferSet, baseHostBuffer, "internal/brdfLUT/brdfLUT.ktx2", VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT) };
@@ -231,7 +246,7 @@ int main()
 			2, VK_IMAGE_ASPECT_DEPTH_BIT };
 	std::vector<ImageList> shadowCubeMaps{};
 	FrustumInfo frustumInfo{};
-	OBBs rUnitOBBs{ MAX_INDIRECT_DRAWS };
+	OBBs rUnitOBBs{ OBB_INITIAL_CAPACITY };
 	uint32_t drawCount{};
 	UiData renderingData{};
 	renderingData.finalDrawCount.initialize(baseHostBuffer, sizeof(uint32_t));
@@ -239,14 +254,25 @@ int main()
 	coordinateTransformation.updateScreenDimensions(window.getWidth(), window.getHeight());
 
 	std::vector<StaticMesh> staticMeshes{ loadStaticMeshes(vertexData, indexData, 
-		indirectDrawCmdData, drawCount,
+		indirectDrawCmdData, drawLODData, drawCount,
 		rUnitOBBs,
 		materialsTextures, 
 		modelPaths,
 		*vulkanObjectHandler, cmdBufferSet)
 	};
+	EASSERT(drawCount <= VISIBILITY_MAX_DRAW_COUNT, "App", "Draw indices have to fit into the visibility buffer.");
+	drawData.initialize(sizeof(uint8_t) * 12 * drawCount);
+	TransformStorage transformStorage{ device, static_cast<uint32_t>(staticMeshes.size()), drawCount, indirectDrawCmdData, frameAllocator };
+	for (uint32_t i{ 0 }, firstDraw{ 0 }; i < staticMeshes.size(); ++i)
+	{
+		uint32_t meshDrawCount{ static_cast<uint32_t>(staticMeshes[i].getRUnits().size()) };
+		transformStorage.addObject(modelMatrices[i], firstDraw, meshDrawCount);
+		firstDraw += meshDrawCount;
+	}
+	//Bounding spheres are computed on the GPU from the model space boxes
+	transformStorage.setLocalBounds(rUnitOBBs);
+	rUnitOBBs.storeLocalBounds();
 	transformOBBs(rUnitOBBs, staticMeshes, drawCount, modelMatrices);
-	getBoundingSpheres(indirectDrawCmdData, rUnitOBBs);
 
 	ResourceSet transformMatricesRS{};
 	ResourceSet materialsTexturesRS{};
@@ -257,15 +283,15 @@ int main()
 	ResourceSet BRDFLUTRS{};
 	ResourceSet directLightingRS{};
 	createResourceSets(device,
-		transformMatricesRS, transformMatrices, 
+		transformMatricesRS, transformStorage.getTransforms(), transformStorage.getPrevTransforms(), 
 		materialsTexturesRS, materialsTextures, 
 		skyboxRS, cubemapSkybox, 
 		distantProbeRS, cubemapSkyboxRadiance);
 	DepthBuffer depthBuffer{ device, window.getWidth(), window.getHeight() };
-	Clusterer clusterer{ device, cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE), window.getWidth(), window.getHeight(), coordinateTransformation.getResourceSet() };
-	ShadowCaster caster{ device, clusterer, shadowMaps, shadowCubeMaps, indirectDrawCmdData, transformMatrices, drawData, rUnitOBBs };
-	Culling culling{ device, MAX_INDIRECT_DRAWS, NEAR_PLANE, coordinateTransformation.getResourceSet(), indirectDrawCmdData, depthBuffer, vulkanObjectHandler->getComputeFamilyIndex(), vulkanObjectHandler->getGraphicsFamilyIndex()};
-	HBAO hbao{ device, HBAO_WIDTH_DEFAULT, HBAO_HEIGHT_DEFAULT, depthBuffer, cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE) };
+	Clusterer clusterer{ device, cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE), window.getWidth(), window.getHeight(), coordinateTransformation.getResourceSet(), frameAllocator };
+	ShadowCaster caster{ device, clusterer, shadowMaps, shadowCubeMaps, indirectDrawCmdData, drawLODData, transformStorage.getTransforms(), drawData, rUnitOBBs, frameAllocator };
+	Culling culling{ device, drawCount, NEAR_PLANE, coordinateTransformation.getResourceSet(), indirectDrawCmdData, drawLODData, depthBuffer, vulkanObjectHandler->getComputeFamilyIndex(), vulkanObjectHandler->getGraphicsFamilyIndex()};
+	HBAO hbao{ device, window.getWidth(), window.getHeight(), depthBuffer, coordinateTransformation.getResourceSet(), cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE) };
 	GI gi{ device, window.getWidth(), window.getHeight(), baseHostBuffer, baseDeviceBuffer, clusterer};
 	renderingData.countROM = gi.getCountROM();
 	LightTypes::LightBase::assignGlobalGI(gi);
@@ -283,8 +309,15 @@ int main()
 
 	createDrawDataResourceSet(device, drawDataRS, drawData, culling.getDrawDataIndexBuffer());
 	createBRDFLUTResourceSet(device, linearSampler, BRDFLUTRS, brdfLUT);
-	createShadowMapResourceSet(device, shadowMapsRS, shadowMaps, shadowCubeMaps, caster.getShadowViewMatrices(), nearestSampler);
-	createDirecLightingResourceSet(device, directLightingRS, directionalLight, clusterer.getSortedLights(), clusterer.getSortedTypeData(), clusterer.getTileData(), clusterer.getZBin());
+	createShadowMapResourceSet(device, shadowMapsRS, shadowMaps, shadowCubeMaps, frameAllocator, caster.getShadowViewMatricesMaxSize(), nearestSampler);
+	caster.registerViewMatrixSet(shadowMapsRS, 4);
+	createDirecLightingResourceSet(device, directLightingRS, directionalLight, frameAllocator, clusterer.getTileData());
+	directionalLight.setMovable([&directionalLight, &directLightingRS]()
+		{
+			VkDescriptorAddressInfoEXT directionalLightAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = directionalLight.getDeviceAddress(), .range = directionalLight.getSize() };
+			directLightingRS.rewriteDescriptor(0, 0, 0, { .pUniformBuffer = &directionalLightAddressInfo });
+		});
+	clusterer.registerLightDataSet(directLightingRS, 1, 2, 4);
 	gi.initialize(device, drawDataRS, transformMatricesRS, materialsTexturesRS, distantProbeRS, BRDFLUTRS, shadowMapsRS, linearSampler);
 	gi.initializeDebug(device, coordinateTransformation.getResourceSet(), window.getWidth(), window.getHeight(), baseHostBuffer, linearSampler, cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE));
 	DeferredLighting deferredLighting{device, window.getWidth(), window.getHeight(), 
@@ -294,11 +327,18 @@ int main()
 		materialsTexturesRS, shadowMapsRS, 
 		gi.getIndirectDiffuseLightingResourceSet(), gi.getIndirectSpecularLightingResourceSet(), gi.getIndirectLightingMetadataResourceSet(),
 		distantProbeRS,
-		drawDataRS, BRDFLUTRS, directLightingRS, linearSampler };
+		drawDataRS, BRDFLUTRS, directLightingRS, 
+		vertexData, indexData, indirectDrawCmdData, culling.getDrawFirstIndexBuffer(),
+		linearSampler };
 	deferredLighting.updateTileWidth(clusterer.getWidthInTiles());
-	gi.initializeSpecular(device, depthBuffer, deferredLighting.getTangentFrameImage(), distantProbeRS, BRDFLUTRS, linearSampler);
-	TAA taa{ device, depthBuffer, deferredLighting.getFramebuffer(), coordinateTransformation.getResourceSet(), cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE) };
-	rUnitOBBs.initVisualizationResources(device, window.getWidth(), window.getHeight(), coordinateTransformation.getResourceSet());
+	//Everything else in the device buffer is bound by handle at record time
+	baseDeviceBuffer.setMovable([&]() { deferredLighting.updateGeometryData(vertexData, indexData); });
+	gi.initializeSpecular(device, depthBuffer, deferredLighting.getTangentFrameImage(), deferredLighting.getVelocityImage(), coordinateTransformation.getResourceSet(), distantProbeRS, BRDFLUTRS, linearSampler, cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE));
+	TAA taa{ device, depthBuffer, deferredLighting.getFramebuffer(), deferredLighting.getVelocityImage(), coordinateTransformation.getResourceSet(), cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE) };
+	rUnitOBBs.initVisualizationResources(device, window.getWidth(), window.getHeight(), coordinateTransformation.getResourceSet(), transformStorage.getWorldBounds(), culling.getDrawCullingStatusBuffer());
+	DynamicResolution dynamicResolution{ window.getWidth(), window.getHeight() };
+	renderingData.renderWidth = window.getWidth();
+	renderingData.renderHeight = window.getHeight();
 
 	PipelineAssembler assembler{ device };
 	
@@ -311,8 +351,13 @@ int main()
 	assembler.setRasterizationState(PipelineAssembler::RASTERIZATION_STATE_DEFAULT, 1.0f, VK_CULL_MODE_NONE);
 	assembler.setDepthStencilState(PipelineAssembler::DEPTH_STENCIL_STATE_SKYBOX, VK_COMPARE_OP_EQUAL);
 	assembler.setPipelineRenderingState(PipelineAssembler::PIPELINE_RENDERING_STATE_DEFAULT, VK_FORMAT_R16G16B16A16_SFLOAT);
+	//Skybox is drawn at the render resolution
+	assembler.setDynamicState(PipelineAssembler::DYNAMIC_STATE_VIEWPORT);
+	assembler.setViewportState(PipelineAssembler::VIEWPORT_STATE_DYNAMIC);
 	Pipeline skyboxPipeline{ createSkyboxPipeline(assembler, coordinateTransformation.getResourceSet(), skyboxRS) };
 	
+	assembler.setDynamicState(PipelineAssembler::DYNAMIC_STATE_DEFAULT);
+	assembler.setViewportState(PipelineAssembler::VIEWPORT_STATE_DEFAULT, window.getWidth(), window.getHeight());
 	assembler.setInputAssemblyState(PipelineAssembler::INPUT_ASSEMBLY_STATE_LINE_DRAWING);
 	assembler.setRasterizationState(PipelineAssembler::RASTERIZATION_STATE_DEFAULT, 1.5f);
 	assembler.setColorBlendState(PipelineAssembler::COLOR_BLEND_STATE_DEFAULT);
@@ -322,15 +367,10 @@ int main()
 
 
 	fillFrustumData(coordinateTransformation, camera, clusterer, hbao, frustumInfo, caster, deferredLighting);
-	fillModelMatrices(transformMatrices, modelMatrices);
 	fillDrawData(drawData, staticMeshes, drawCount);
 
 	
 
-	VkBuffer vertexBindings[1]{ vertexData.getBufferHandle() };
-	VkDeviceSize vertexBindingOffsets[1]{ vertexData.getOffset() };
-
-	TimelineSemaphore semaphore{ device };
 	TimelineSemaphore semaphoreCompute{ device };
 	VkSemaphore swapchainSemaphore{};
 	VkSemaphore readyToPresentSemaphore{};
@@ -351,11 +391,13 @@ int main()
 
 
 	bool& profile = renderingData.profilingEnabled;
-	constexpr uint32_t queryNum = 12;
+	constexpr uint32_t queryNum = 15;
 	TimestampQueries<queryNum> queries{ *vulkanObjectHandler, baseHostCachedBuffer };
+	//Spans the whole graphics queue frame and is written regardless of profiling since dynamic resolution is driven by it
+	TimestampQueries<1> frameQueries{ *vulkanObjectHandler, baseHostCachedBuffer };
 	renderingData.gpuTasks.resize(queryNum);
 	constexpr uint32_t gqQueryOffset = 0;
-	constexpr uint32_t gqQueryCount = 9;
+	constexpr uint32_t gqQueryCount = 12;
 	constexpr uint32_t queryIndexHiZ = 0;
 	constexpr uint32_t queryIndexShadowMaps = 1;
 	constexpr uint32_t queryIndexTileTest = 2;
@@ -364,15 +406,20 @@ int main()
 	constexpr uint32_t queryIndexHBAO = 5;
 	constexpr uint32_t queryIndexTAA = 6;
 	constexpr uint32_t queryIndexGIInjectLights = 7;
-	constexpr uint32_t queryIndexGIComputeSpecular = 8;
-	constexpr uint32_t cqQueryOffset = 9;
+	constexpr uint32_t queryIndexGITraceSpecular = 8;
+	constexpr uint32_t queryIndexShadowCubeMaps = 9;
+	constexpr uint32_t queryIndexGIReconstructSpecular = 10;
+	constexpr uint32_t queryIndexGIBlurSpecular = 11;
+	constexpr uint32_t cqQueryOffset = 12;
 	constexpr uint32_t cqQueryCount = 3;
-	constexpr uint32_t queryIndexGICreateROMA = 9;
-	constexpr uint32_t queryIndexGITraceProbes = 10;
-	constexpr uint32_t queryIndexGIComputeIrradianceAndVisibility = 11;
+	constexpr uint32_t queryIndexGICreateROMA = 12;
+	constexpr uint32_t queryIndexGITraceProbes = 13;
+	constexpr uint32_t queryIndexGIComputeIrradianceAndVisibility = 14;
 	renderingData.gpuTasks[queryIndexHiZ].name = "HiZ";
 	renderingData.gpuTasks[queryIndexHiZ].color = legit::Colors::asbestos;
-	renderingData.gpuTasks[queryIndexShadowMaps].name = "Shadow maps";
+	renderingData.gpuTasks[queryIndexShadowMaps].name = "Spot shadow maps";
+	renderingData.gpuTasks[queryIndexShadowCubeMaps].name = "Shadow cube maps";
+	renderingData.gpuTasks[queryIndexShadowCubeMaps].color = legit::Colors::wisteria;
 	renderingData.gpuTasks[queryIndexShadowMaps].color = legit::Colors::midnightBlue;
 	renderingData.gpuTasks[queryIndexTileTest].name = "Tile test";
 	renderingData.gpuTasks[queryIndexTileTest].color = legit::Colors::alizarin;
@@ -392,8 +439,12 @@ int main()
 	renderingData.gpuTasks[queryIndexGIComputeIrradianceAndVisibility].color = legit::Colors::belizeHole;
 	renderingData.gpuTasks[queryIndexGIInjectLights].name = "(GI) Inject lights";
 	renderingData.gpuTasks[queryIndexGIInjectLights].color = legit::Colors::nephritis;
-	renderingData.gpuTasks[queryIndexGIComputeSpecular].name = "(GI) Compute specular";
-	renderingData.gpuTasks[queryIndexGIComputeSpecular].color = legit::Colors::carrot;
+	renderingData.gpuTasks[queryIndexGITraceSpecular].name = "(GI) Trace specular";
+	renderingData.gpuTasks[queryIndexGITraceSpecular].color = legit::Colors::carrot;
+	renderingData.gpuTasks[queryIndexGIReconstructSpecular].name = "(GI) Reconstruct specular";
+	renderingData.gpuTasks[queryIndexGIReconstructSpecular].color = legit::Colors::amethyst;
+	renderingData.gpuTasks[queryIndexGIBlurSpecular].name = "(GI) Blur specular";
+	renderingData.gpuTasks[queryIndexGIBlurSpecular].color = legit::Colors::pumpkin;
 	renderingData.cpuTasks.resize(2);
 	renderingData.cpuTasks[0].name = "Frame preparation and recording";
 	renderingData.cpuTasks[0].color = legit::Colors::emerald;
@@ -409,6 +460,395 @@ int main()
 	uint32_t cbSetIndex{ cmdBufferSet.createInterchangeableSet(2, CommandBufferSet::ASYNC_COMPUTE_CB) };
 	uint32_t currentCBindex{ 1 };
 	uint32_t currentProbesIndex{ 0 };
+
+	RenderGraph drawGraph{ device, memManager };
+	{
+		typedef RenderGraph::ResourceState state_t;
+		constexpr VkPipelineStageFlags2 fragmentTests{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT };
+		constexpr VkAccessFlags2 depthAttachmentRW{ VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+
+		//Images are resolved every frame, so recreated or relocated images are picked up by the graph
+		auto importImage{ [&drawGraph](const char* name, const Image& image, const state_t& initialState, const state_t& finalState)
+			{ return drawGraph.importImage(name, [&image]() { return RenderGraph::ImportedImage{ image.getImageHandle(), image.getImageView(), image.getSubresourceRange() }; }, initialState, finalState); } };
+
+		RenderGraph::ResourceHandle depth{ drawGraph.importImage("Depth",
+			[&depthBuffer]() { return RenderGraph::ImportedImage{ depthBuffer.getImageHandle(), depthBuffer.getImageView(), depthBuffer.getDepthBufferSubresourceRange() }; },
+			state_t{}, state_t{ fragmentTests, depthAttachmentRW, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL }) };
+		RenderGraph::ResourceHandle uv{ importImage("UV", deferredLighting.getUVImage(), state_t{}, state_t{}) };
+		RenderGraph::ResourceHandle tangentFrame{ importImage("Tangent frame", deferredLighting.getTangentFrameImage(), state_t{}, state_t{}) };
+		RenderGraph::ResourceHandle drawID{ importImage("Draw ID", deferredLighting.getDrawIDImage(), state_t{}, state_t{}) };
+		RenderGraph::ResourceHandle velocity{ importImage("Velocity", deferredLighting.getVelocityImage(),
+			state_t{}, state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }) };
+		RenderGraph::ResourceHandle specularGlossy{ importImage("Specular glossy", gi.getSpecularReflectionGlossy(), state_t{}, state_t{}) };
+		RenderGraph::ResourceHandle specularRough{ importImage("Specular rough", gi.getSpecularReflectionRough(), state_t{}, state_t{}) };
+		RenderGraph::ResourceHandle specularGuide{ importImage("Specular guide", gi.getSpecularGuide(), state_t{}, state_t{}) };
+		RenderGraph::ResourceHandle specularHistory{ importImage("Specular history", gi.getSpecularHistory(),
+			state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL },
+			state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL }) };
+		RenderGraph::ResourceHandle ao{ importImage("AO", hbao.getAO(),
+			state_t{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL }, state_t{}) };
+		RenderGraph::ResourceHandle framebuffer{ importImage("Framebuffer", deferredLighting.getFramebuffer(),
+			state_t{}, state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }) };
+		RenderGraph::ResourceHandle rawAO{ drawGraph.createTransientImage("Raw AO", RenderGraph::TransientImageInfo{
+			.format = hbao.getRawAOFormat(), .width = hbao.getAOImageWidth(), .height = hbao.getAOImageHeight(),
+			.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, .aspects = VK_IMAGE_ASPECT_COLOR_BIT }) };
+		RenderGraph::ResourceHandle specularTraced{ drawGraph.createTransientImage("Specular traced", RenderGraph::TransientImageInfo{
+			.format = gi.getSpecularTracedFormat(), .width = gi.getSpecularTracedWidth(), .height = gi.getSpecularTracedHeight(),
+			.usage = VK_IMAGE_USAGE_STORAGE_BIT, .aspects = VK_IMAGE_ASPECT_COLOR_BIT }) };
+		RenderGraph::ResourceHandle tiles{ drawGraph.importBuffer("Tiles",
+			[&clusterer]() { return RenderGraph::ImportedBuffer{ clusterer.getTileData().getBufferHandle(), clusterer.getTileData().getOffset(), clusterer.getTileData().getSize() }; }) };
+		drawGraph.markOutput(framebuffer);
+		drawGraph.markOutput(depth);
+		drawGraph.markOutput(velocity);
+
+		//Probe tracing has no attachments in the graph and is left to the graph to place, it ends up on the async compute queue
+		drawGraph.addPass("GI indirect", RenderGraph::ANY_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.setSideEffects();
+			},
+			[&](VkCommandBuffer cb)
+			{
+				gi.cmdComputeIndirect(cb,
+					queries,
+					queryIndexGICreateROMA, queryIndexGITraceProbes, queryIndexGIComputeIrradianceAndVisibility,
+					camera.getPosition(), coordinateTransformation.getViewProjectionMatrix(),
+					renderingData.skyboxEnabled,
+					profile);
+			});
+		drawGraph.addPass("Clear tile buffer", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.writeBuffer(tiles, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				clusterer.cmdTransferClearTileBuffer(cb);
+			});
+		drawGraph.addPass("Tile test", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.writeBuffer(tiles, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				if (profile) queries.cmdWriteStart(cb, queryIndexTileTest);
+				clusterer.cmdPassConductTileTest(cb);
+				if (profile) queries.cmdWriteEnd(cb, queryIndexTileTest);
+			});
+		drawGraph.addPass("UV buffer", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.writeImage(uv, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+				builder.writeImage(tangentFrame, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+				builder.writeImage(drawID, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+				builder.writeImage(velocity, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+				builder.writeImage(depth, fragmentTests, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				if (renderingData.voxelDebug != UiData::NONE_VOXEL_DEBUG)
+					return;
+				if (profile) queries.cmdWriteStart(cb, queryIndexUVbufferDraw);
+				deferredLighting.cmdPassDrawToUVBuffer(cb, culling, vertexData, indexData);
+				if (profile) queries.cmdWriteEnd(cb, queryIndexUVbufferDraw);
+			});
+		drawGraph.addPass("Specular trace", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.readImage(tangentFrame, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.readImage(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+				builder.writeImage(specularTraced, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				if (profile) queries.cmdWriteStart(cb, queryIndexGITraceSpecular);
+				gi.setSpecularTraceMode(static_cast<UiData::SpecularTraceMode>(renderingData.specularTraceMode));
+				gi.cmdTraceSpecular(cb, coordinateTransformation.getInverseViewProjectionMatrix(), camera.getPosition(), coordinateTransformation.getCurrentJitter(), renderingData.skyboxEnabled);
+				if (profile) queries.cmdWriteEnd(cb, queryIndexGITraceSpecular);
+			});
+		drawGraph.addPass("Specular reconstruct", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.readImage(specularTraced, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+				builder.readImage(specularHistory, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+				builder.readImage(tangentFrame, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.readImage(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+				builder.readImage(velocity, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.writeImage(specularGlossy, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+				builder.writeImage(specularGuide, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				if (profile) queries.cmdWriteStart(cb, queryIndexGIReconstructSpecular);
+				gi.cmdReconstructSpecular(cb);
+				if (profile) queries.cmdWriteEnd(cb, queryIndexGIReconstructSpecular);
+			});
+		drawGraph.addPass("Specular blur", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.readImage(specularGlossy, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+				builder.writeImage(specularRough, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+				builder.writeImage(specularHistory, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				if (profile) queries.cmdWriteStart(cb, queryIndexGIBlurSpecular);
+				gi.cmdBlurSpecular(cb);
+				if (profile) queries.cmdWriteEnd(cb, queryIndexGIBlurSpecular);
+			});
+		drawGraph.addPass("HBAO", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.readImage(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+				builder.writeImage(rawAO, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				if (profile) queries.cmdWriteStart(cb, queryIndexHBAO);
+				hbao.cmdDispatchHBAO(cb);
+			});
+		drawGraph.addPass("HBAO accumulate and blur", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.readImage(rawAO, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.readImage(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+				builder.writeImage(ao, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				hbao.cmdDispatchHBAOAccumulate(cb);
+				hbao.cmdDispatchHBAOBlur(cb);
+				if (profile) queries.cmdWriteEnd(cb, queryIndexHBAO);
+			});
+		drawGraph.addPass("Lighting", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.readImage(uv, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.readImage(tangentFrame, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.readImage(drawID, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.readImage(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+				builder.readImage(specularGlossy, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+				builder.readImage(specularRough, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+				builder.readImage(specularGuide, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+				builder.readImage(ao, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+				builder.readBuffer(tiles, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+				builder.writeImage(framebuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				deferredLighting.updateLightBinWidth(clusterer.getCurrentBinWidth());
+				if (renderingData.voxelDebug != UiData::NONE_VOXEL_DEBUG)
+					return;
+				if (profile) queries.cmdWriteStart(cb, queryIndexLightingPass);
+				deferredLighting.cmdDispatchLightingCompute(cb, currentProbesIndex);
+				if (profile) queries.cmdWriteEnd(cb, queryIndexLightingPass);
+			});
+		drawGraph.addPass("Skybox", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.writeImage(framebuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+				builder.writeImage(depth, fragmentTests, depthAttachmentRW, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				if (!renderingData.skyboxEnabled)
+					return;
+				VkRenderingAttachmentInfo colorAttachmentInfoSkybox{};
+				colorAttachmentInfoSkybox.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				colorAttachmentInfoSkybox.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+				colorAttachmentInfoSkybox.clearValue = VkClearValue{ .color{.float32{0.4f, 1.0f, 0.8f}} };
+				colorAttachmentInfoSkybox.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				colorAttachmentInfoSkybox.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+				colorAttachmentInfoSkybox.imageView = deferredLighting.getFramebufferImageView();
+				VkRenderingAttachmentInfo depthAttachmentInfoSkybox{};
+				depthAttachmentInfoSkybox.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				depthAttachmentInfoSkybox.imageView = depthBuffer.getImageView();
+				depthAttachmentInfoSkybox.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+				depthAttachmentInfoSkybox.clearValue = { .depthStencil = {.depth = 0.0f, .stencil = 0} };
+				depthAttachmentInfoSkybox.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				depthAttachmentInfoSkybox.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+				VkRenderingInfo renderInfoSkybox{};
+				renderInfoSkybox.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+				renderInfoSkybox.renderArea = { .offset{0,0}, .extent{.width = dynamicResolution.getRenderWidth(), .height = dynamicResolution.getRenderHeight()} };
+				VkViewport viewportSkybox{ .x = 0.0f, .y = 0.0f, .width = float(dynamicResolution.getRenderWidth()), .height = float(dynamicResolution.getRenderHeight()), .minDepth = 0.0f, .maxDepth = 1.0f };
+				renderInfoSkybox.layerCount = 1;
+				renderInfoSkybox.colorAttachmentCount = 1;
+				renderInfoSkybox.pColorAttachments = &colorAttachmentInfoSkybox;
+				renderInfoSkybox.pDepthAttachment = &depthAttachmentInfoSkybox;
+				vkCmdBeginRendering(cb, &renderInfoSkybox);
+					vkCmdSetViewport(cb, 0, 1, &viewportSkybox);
+					VkBuffer skyboxVertexBinding[1]{ skyboxData.getBufferHandle() };
+					VkDeviceSize skyboxVertexOffsets[1]{ skyboxData.getOffset() };
+					vkCmdBindVertexBuffers(cb, 0, 1, skyboxVertexBinding, skyboxVertexOffsets);
+					skyboxPipeline.cmdBindResourceSets(cb);
+					skyboxPipeline.cmdBind(cb);
+					vkCmdDraw(cb, 36, 1, 0, 0);
+				vkCmdEndRendering(cb);
+			});
+
+		drawGraph.compile();
+		hbao.setRawAOImage(drawGraph.getImageView(rawAO));
+		gi.setSpecularTracedImage(drawGraph.getImageView(specularTraced));
+	}
+
+	//TAA, overlays and UI. Swapchain image and TAA history change every frame and are resolved before recording
+	RenderGraph postGraph{ device, memManager };
+	{
+		typedef RenderGraph::ResourceState state_t;
+		constexpr VkPipelineStageFlags2 fragmentTests{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT };
+		constexpr VkAccessFlags2 depthAttachmentRW{ VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+		constexpr VkAccessFlags2 colorAttachmentRW{ VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+
+		//Images shared with the draw graph are counted there
+		RenderGraph::ResourceHandle swapchainImage{ postGraph.importImage("Swapchain",
+			[&swapchainImageData]() { return RenderGraph::ImportedImage{ std::get<0>(swapchainImageData), std::get<1>(swapchainImageData),
+				VkImageSubresourceRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1 } }; },
+			state_t{}, state_t{ VK_PIPELINE_STAGE_NONE, VK_ACCESS_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR }, false) };
+		RenderGraph::ResourceHandle depth{ postGraph.importImage("Depth",
+			[&depthBuffer]() { return RenderGraph::ImportedImage{ depthBuffer.getImageHandle(), depthBuffer.getImageView(), depthBuffer.getDepthBufferSubresourceRange() }; },
+			state_t{ fragmentTests, depthAttachmentRW, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL }, state_t{ fragmentTests, depthAttachmentRW, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL }, false) };
+		RenderGraph::ResourceHandle framebuffer{ postGraph.importImage("Framebuffer",
+			[&deferredLighting]() { const Image& image{ deferredLighting.getFramebuffer() }; return RenderGraph::ImportedImage{ image.getImageHandle(), image.getImageView(), image.getSubresourceRange() }; },
+			state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }, state_t{}, false) };
+		RenderGraph::ResourceHandle velocity{ postGraph.importImage("Velocity",
+			[&deferredLighting]() { const Image& image{ deferredLighting.getVelocityImage() }; return RenderGraph::ImportedImage{ image.getImageHandle(), image.getImageView(), image.getSubresourceRange() }; },
+			state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }, state_t{}, false) };
+		//History images swap roles after every dispatch, the final states prepare them for the next frame
+		RenderGraph::ResourceHandle historyRead{ postGraph.importImage("TAA history read",
+			[&taa]() { const Image& image{ taa.getHistoryRead() }; return RenderGraph::ImportedImage{ image.getImageHandle(), image.getImageView(), image.getSubresourceRange() }; },
+			state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+			state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL }) };
+		RenderGraph::ResourceHandle historyWrite{ postGraph.importImage("TAA history write",
+			[&taa]() { const Image& image{ taa.getHistoryWrite() }; return RenderGraph::ImportedImage{ image.getImageHandle(), image.getImageView(), image.getSubresourceRange() }; },
+			state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL },
+			state_t{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }) };
+		postGraph.markOutput(swapchainImage);
+
+		postGraph.addPass("TAA", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.readImage(framebuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.readImage(velocity, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.readImage(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+				builder.readImage(historyRead, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				builder.writeImage(historyWrite, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+				builder.writeImage(swapchainImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				if (profile) queries.cmdWriteStart(cb, queryIndexTAA);
+				taa.adjustSmoothingFactor(WorldState::deltaTime, camera.getSpeed(), camera.cameraPositionChanged());
+				taa.updateJitterValue(coordinateTransformation.getCurrentJitter());
+				taa.cmdDispatchTAA(cb, std::get<1>(swapchainImageData));
+				if (profile) queries.cmdWriteEnd(cb, queryIndexTAA);
+			});
+		postGraph.addPass("Overlays", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.writeImage(swapchainImage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, colorAttachmentRW, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+				builder.writeImage(depth, fragmentTests, depthAttachmentRW, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				VkRenderingAttachmentInfo colorAttachmentInfoDirectDraw{};
+				colorAttachmentInfoDirectDraw.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				colorAttachmentInfoDirectDraw.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+				colorAttachmentInfoDirectDraw.clearValue = VkClearValue{ .color{.float32{0.4f, 1.0f, 0.8f}} };
+				colorAttachmentInfoDirectDraw.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				colorAttachmentInfoDirectDraw.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+				colorAttachmentInfoDirectDraw.imageView = std::get<1>(swapchainImageData);
+				VkRenderingAttachmentInfo depthAttachmentInfoDirectDraw{};
+				depthAttachmentInfoDirectDraw.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				depthAttachmentInfoDirectDraw.imageView = depthBuffer.getImageView();
+				depthAttachmentInfoDirectDraw.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+				depthAttachmentInfoDirectDraw.clearValue = { .depthStencil = {.depth = 0.0f, .stencil = 0} };
+				depthAttachmentInfoDirectDraw.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				depthAttachmentInfoDirectDraw.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+				VkRenderingInfo renderInfoDirectDraw{};
+				renderInfoDirectDraw.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+				renderInfoDirectDraw.renderArea = { .offset{0,0}, .extent{.width = window.getWidth(), .height = window.getHeight()} };
+				renderInfoDirectDraw.layerCount = 1;
+				renderInfoDirectDraw.colorAttachmentCount = 1;
+				renderInfoDirectDraw.pColorAttachments = &colorAttachmentInfoDirectDraw;
+				renderInfoDirectDraw.pDepthAttachment = &depthAttachmentInfoDirectDraw;
+				vkCmdBeginRendering(cb, &renderInfoDirectDraw);
+					if (renderingData.drawBVs)
+						clusterer.cmdDrawBVs(cb);
+					if (renderingData.drawLightProxies)
+						clusterer.cmdDrawProxies(cb);
+
+					if (renderingData.showOBBs)
+						rUnitOBBs.cmdVisualizeOBBs(cb);
+
+					if (renderingData.voxelDebug == UiData::BOM_VOXEL_DEBUG)
+						gi.cmdDrawBOM(cb, camera.getPosition());
+					else if (renderingData.voxelDebug == UiData::ROM_VOXEL_DEBUG)
+						gi.cmdDrawROM(cb, camera.getPosition(), renderingData.indexROM);
+					else if (renderingData.voxelDebug == UiData::ALBEDO_VOXEL_DEBUG)
+						gi.cmdDrawAlbedo(cb, camera.getPosition());
+					else if (renderingData.voxelDebug == UiData::METALNESS_VOXEL_DEBUG)
+						gi.cmdDrawMetalness(cb, camera.getPosition());
+					else if (renderingData.voxelDebug == UiData::ROUGHNESS_VOXEL_DEBUG)
+						gi.cmdDrawRoughness(cb, camera.getPosition());
+					else if (renderingData.voxelDebug == UiData::EMISSION_VOXEL_DEBUG)
+						gi.cmdDrawEmission(cb, camera.getPosition());
+
+					if (renderingData.probeDebug == UiData::RADIANCE_PROBE_DEBUG)
+						gi.cmdDrawRadianceProbes(cb);
+					else if (renderingData.probeDebug == UiData::IRRADIANCE_PROBE_DEBUG)
+						gi.cmdDrawIrradianceProbes(cb);
+					else if (renderingData.probeDebug == UiData::VISIBILITY_PROBE_DEBUG)
+						gi.cmdDrawVisibilityProbes(cb);
+
+					if (renderingData.drawSpaceGrid)
+					{
+						VkBuffer lineVertexBindings[1]{ spaceLinesVertexData.getBufferHandle() };
+						VkDeviceSize lineVertexBindingOffsets[1]{ spaceLinesVertexData.getOffset() };
+						vkCmdBindVertexBuffers(cb, 0, 1, lineVertexBindings, lineVertexBindingOffsets);
+						spaceLinesPipeline.cmdBindResourceSets(cb);
+						spaceLinesPipeline.cmdBind(cb);
+						vkCmdPushConstants(cb, spaceLinesPipeline.getPipelineLayoutHandle(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::vec3), &camera.getPosition());
+						vkCmdDraw(cb, lineVertNum, 1, 0, 0);
+					}
+				vkCmdEndRendering(cb);
+			});
+		postGraph.addPass("UI", RenderGraph::GRAPHICS_QUEUE,
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.writeImage(swapchainImage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, colorAttachmentRW, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			},
+			[&](VkCommandBuffer cb)
+			{
+				if (!renderingData.hideUI)
+				{
+					ui.startUIPass(cb, std::get<1>(swapchainImageData));
+					ui.begin("Settings");
+					ui.stats(renderingData, drawCount);
+					ui.lightSettings(renderingData, pointLights, spotLights);
+					ui.misc(renderingData);
+					ui.end();
+					ui.profiler(renderingData);
+					ui.shaderErrors(shaderReloader.getErrors());
+					ui.endUIPass(cb);
+				}
+			});
+
+		postGraph.compile();
+	}
+
+	{
+		const RenderGraph::Statistics& drawStats{ drawGraph.getStatistics() };
+		const RenderGraph::Statistics& postStats{ postGraph.getStatistics() };
+		renderingData.renderGraphPassCount = drawStats.passCount + postStats.passCount;
+		renderingData.renderGraphCulledPassCount = drawStats.culledPassCount + postStats.culledPassCount;
+		renderingData.renderGraphComputeQueuePassCount = drawStats.computeQueuePassCount + postStats.computeQueuePassCount;
+		renderingData.renderGraphBarrierCount = drawStats.barrierCount + postStats.barrierCount;
+		renderingData.renderGraphBarrierBatchCount = drawStats.barrierBatchCount + postStats.barrierBatchCount;
+		renderingData.renderGraphAttachmentMemory = drawStats.importedImageMemory + drawStats.transientMemory + postStats.importedImageMemory + postStats.transientMemory;
+		renderingData.renderGraphTransientMemory = drawStats.transientMemory + postStats.transientMemory;
+		renderingData.renderGraphTransientMemoryUnaliased = drawStats.transientMemoryUnaliased + postStats.transientMemoryUnaliased;
+	}
 	
 	typedef oneapi::tbb::flow::continue_node<oneapi::tbb::flow::continue_msg> node_t;
 	typedef const oneapi::tbb::flow::continue_msg& msg_t;
@@ -423,9 +863,9 @@ int main()
 			swapchainImageData = vulkanObjectHandler->getSwapchainImageData(swapchainIndex);
 
 			deferredLighting.updateCameraPosition(camera.getPosition());
-			deferredLighting.updateGISceneCenter(gi.getScenePosition());
 			deferredLighting.updateSkyboxState(renderingData.skyboxEnabled);
 			deferredLighting.updateDebugOptionsBitfield(renderingData.lightingPassDebugOptionsBitfield);
+			deferredLighting.setVisibilityBufferEnabled(renderingData.visibilityBuffer);
 
 			coordinateTransformation.updateProjectionMatrixJitter();
 			coordinateTransformation.updateViewMatrix(camera.getPosition(), camera.getPosition() + camera.getForwardDirection(), camera.getUpDirection());
@@ -439,12 +879,19 @@ int main()
 		} };
 	node_t nodePrepareDataForShadowMapRender{ flowGraph, [&](msg_t)
 		{
+			caster.setGPUCulling(renderingData.gpuShadowCasterCulling);
 			caster.prepareDataForShadowMapRendering();
 		} };
 	node_t nodePreprocessCB1{ flowGraph, [&](msg_t)
 		{
 			cbPreprocessing = cmdBufferSet.beginPerThreadRecording(0);
 
+			frameQueries.cmdUpdateResults(cbPreprocessing, 0, 1);
+			frameQueries.cmdReset(cbPreprocessing, 0, 1);
+			frameQueries.cmdWriteStart(cbPreprocessing, 0);
+
+			transformStorage.cmdUpload(cbPreprocessing);
+
 			if (profile) 
 			{
 				queries.cmdUpdateResults(cbPreprocessing, gqQueryOffset, gqQueryCount);
@@ -453,6 +900,7 @@ int main()
 
 			culling.cmdTransferSetDrawCountToZero(cbPreprocessing);
 			caster.cmdTransferClearShadowMaps(cbPreprocessing);
+			caster.cmdDispatchShadowCasterCulling(cbPreprocessing);
 			events.cmdSet(cbPreprocessing, 1, caster.getDependency());
 
 			if (profile) queries.cmdWriteStart(cbPreprocessing, queryIndexHiZ);
@@ -460,9 +908,8 @@ int main()
 			if (profile) queries.cmdWriteEnd(cbPreprocessing, queryIndexHiZ);
 
 			SyncOperations::cmdExecuteBarrier(cbPreprocessing, culling.getDependency());
+			culling.updateHiZUVScale(depthBuffer);
 			culling.cmdDispatchCullOccluded(cbPreprocessing);
-			clusterer.cmdTransferClearTileBuffer(cbPreprocessing);
-			events.cmdSet(cbPreprocessing, 0, clusterer.getDependency());
 		} };
 	node_t nodePreprocessCB2{ flowGraph, [&](msg_t)
 		{
@@ -470,18 +917,7 @@ int main()
 
 			uint32_t indicesSM[]{ 1 };
 			events.cmdWait(cbPreprocessing, 1, indicesSM, &caster.getDependency());
-			if (profile) queries.cmdWriteStart(cbPreprocessing, queryIndexShadowMaps);
-			caster.cmdRenderShadowMaps(cbPreprocessing, vertexData, indexData);
-			if (profile) queries.cmdWriteEnd(cbPreprocessing, queryIndexShadowMaps);
-
-			uint32_t indices[]{ 0 };
-			events.cmdWait(cbPreprocessing, 1, indices, &clusterer.getDependency());
-		} };
-	node_t nodePreprocessCB3{ flowGraph, [&](msg_t)
-		{
-			if (profile) queries.cmdWriteStart(cbPreprocessing, queryIndexTileTest);
-			clusterer.cmdPassConductTileTest(cbPreprocessing);
-			if (profile) queries.cmdWriteEnd(cbPreprocessing, queryIndexTileTest);
+			caster.cmdRenderShadowMaps(cbPreprocessing, cmdBufferSet, vertexData, indexData, queries, queryIndexShadowMaps, queryIndexShadowCubeMaps, profile);
 		} };
 	node_t nodePreprocessCB4{ flowGraph, [&](msg_t)
 		{
@@ -498,209 +934,26 @@ int main()
 				{ {SyncOperations::constructMemoryBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
 					VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT)} });
 
+				gi.cmdRevoxelizeDirtyRegions(cbDraw, indirectDrawCmdData, vertexData, indexData, sizeof(IndirectData));
 				gi.cmdInjectLights(cbDraw, queries, queryIndexGIInjectLights, profile);
 
-				if (renderingData.voxelDebug != UiData::NONE_VOXEL_DEBUG)
-				{
-					SyncOperations::cmdExecuteBarrier(cbDraw, { {SyncOperations::constructImageBarrier(
-						VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-						VK_ACCESS_NONE, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-						VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-						depthBuffer.getImageHandle(), depthBuffer.getDepthBufferSubresourceRange())} });
-				}
-				else
-				{
-					if (profile) queries.cmdWriteStart(cbDraw, queryIndexUVbufferDraw);
-					deferredLighting.cmdPassDrawToUVBuffer(cbDraw, culling, vertexData, indexData);
-					if (profile) queries.cmdWriteEnd(cbDraw, queryIndexUVbufferDraw);
-				}
-
-				SyncOperations::cmdExecuteBarrier(cbDraw, deferredLighting.getDependency());
-
-				if (profile) queries.cmdWriteStart(cbDraw, queryIndexGIComputeSpecular);
-				gi.cmdTraceSpecular(cbDraw, coordinateTransformation.getInverseViewProjectionMatrix(), camera.getPosition(), renderingData.skyboxEnabled);
-				SyncOperations::cmdExecuteBarrier(cbDraw, gi.getSpecularTraceAndBlurDependency());
-				gi.cmdBlurSpecular(cbDraw);
-				if (profile) queries.cmdWriteEnd(cbDraw, queryIndexGIComputeSpecular);
-
-				if (profile) queries.cmdWriteStart(cbDraw, queryIndexHBAO);
-				hbao.cmdDispatchHBAO(cbDraw);
-				SyncOperations::cmdExecuteBarrier(cbDraw, hbao.getDependency());
-				hbao.cmdDispatchHBAOBlur(cbDraw);
-				if (profile) queries.cmdWriteEnd(cbDraw, queryIndexHBAO);
-
-				SyncOperations::cmdExecuteBarrier(cbDraw, {{gi.getBlurredSpecularBarrier()}});
-				SyncOperations::cmdExecuteBarrier(cbDraw,
-					{ {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-						VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-						VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-						hbao.getAO().getImageHandle(), hbao.getAO().getSubresourceRange())} });
-
-				deferredLighting.updateLightBinWidth(clusterer.getCurrentBinWidth());
-
-				if (renderingData.voxelDebug == UiData::NONE_VOXEL_DEBUG)
-				{
-					if (profile) queries.cmdWriteStart(cbDraw, queryIndexLightingPass);
-					deferredLighting.cmdDispatchLightingCompute(cbDraw, currentProbesIndex);
-					if (profile) queries.cmdWriteEnd(cbDraw, queryIndexLightingPass);
-				}
-
-				SyncOperations::cmdExecuteBarrier(cbDraw, 
-					{ {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-						VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-						VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-						depthBuffer.getImageHandle(), depthBuffer.getDepthBufferSubresourceRange())} });
-				
-				if (renderingData.skyboxEnabled)
-				{
-					VkRenderingAttachmentInfo colorAttachmentInfoSkybox{};
-					colorAttachmentInfoSkybox.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-					colorAttachmentInfoSkybox.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-					colorAttachmentInfoSkybox.clearValue = VkClearValue{ .color{.float32{0.4f, 1.0f, 0.8f}} };
-					colorAttachmentInfoSkybox.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-					colorAttachmentInfoSkybox.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-					colorAttachmentInfoSkybox.imageView = deferredLighting.getFramebufferImageView();
-					VkRenderingAttachmentInfo depthAttachmentInfoSkybox{};
-					depthAttachmentInfoSkybox.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-					depthAttachmentInfoSkybox.imageView = depthBuffer.getImageView();
-					depthAttachmentInfoSkybox.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
-					depthAttachmentInfoSkybox.clearValue = { .depthStencil = {.depth = 0.0f, .stencil = 0} };
-					depthAttachmentInfoSkybox.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-					depthAttachmentInfoSkybox.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-					VkRenderingInfo renderInfoSkybox{};
-					renderInfoSkybox.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-					renderInfoSkybox.renderArea = { .offset{0,0}, .extent{.width = window.getWidth(), .height = window.getHeight()} };
-					renderInfoSkybox.layerCount = 1;
-					renderInfoSkybox.colorAttachmentCount = 1;
-					renderInfoSkybox.pColorAttachments = &colorAttachmentInfoSkybox;
-					renderInfoSkybox.pDepthAttachment = &depthAttachmentInfoSkybox;
-					vkCmdBeginRendering(cbDraw, &renderInfoSkybox);
-						VkBuffer skyboxVertexBinding[1]{ skyboxData.getBufferHandle() };
-						VkDeviceSize skyboxVertexOffsets[1]{ skyboxData.getOffset() };
-						vkCmdBindVertexBuffers(cbDraw, 0, 1, skyboxVertexBinding, skyboxVertexOffsets);
-						skyboxPipeline.cmdBindResourceSets(cbDraw);
-						skyboxPipeline.cmdBind(cbDraw);
-						vkCmdDraw(cbDraw, 36, 1, 0, 0);
-					vkCmdEndRendering(cbDraw);
-				}
-
+				drawGraph.cmdExecute(cbDraw, RenderGraph::GRAPHICS_QUEUE);
 
 			cmdBufferSet.endRecording(cbDraw);
 		} };
 	node_t nodePostprocessCB{ flowGraph, [&](msg_t)
 		{
+			//Swapchain image is known only after acquisition
+			postGraph.resolve();
 			cbPostprocessing = cmdBufferSet.beginPerThreadRecording(2);
 
 			SyncOperations::cmdExecuteBarrier(cbPostprocessing,
 				{ {SyncOperations::constructMemoryBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
 					VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT)} });
 
-			SyncOperations::cmdExecuteBarrier(cbPostprocessing, 
-				{{SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-					0, VK_ACCESS_SHADER_WRITE_BIT,
-					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-					std::get<0>(swapchainImageData),
-					{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.baseMipLevel = 0,
-					.levelCount = 1,
-					.baseArrayLayer = 0,
-					.layerCount = 1 })} });
-
-			if (profile) queries.cmdWriteStart(cbPostprocessing, queryIndexTAA);
-			taa.adjustSmoothingFactor(WorldState::deltaTime, camera.getSpeed(), camera.cameraPositionChanged());
-			taa.updateJitterValue(coordinateTransformation.getCurrentJitter());
-			taa.cmdDispatchTAA(cbPostprocessing, std::get<1>(swapchainImageData));
-			if (profile) queries.cmdWriteEnd(cbPostprocessing, queryIndexTAA);
-			
-			SyncOperations::cmdExecuteBarrier(cbPostprocessing,
-				{{SyncOperations::constructMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
-					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT)}});
-
-			VkRenderingAttachmentInfo colorAttachmentInfoDirectDraw{};
-			colorAttachmentInfoDirectDraw.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-			colorAttachmentInfoDirectDraw.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			colorAttachmentInfoDirectDraw.clearValue = VkClearValue{ .color{.float32{0.4f, 1.0f, 0.8f}} };
-			colorAttachmentInfoDirectDraw.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-			colorAttachmentInfoDirectDraw.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			colorAttachmentInfoDirectDraw.imageView = std::get<1>(swapchainImageData);
-			VkRenderingAttachmentInfo depthAttachmentInfoDirectDraw{};
-			depthAttachmentInfoDirectDraw.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-			depthAttachmentInfoDirectDraw.imageView = depthBuffer.getImageView();
-			depthAttachmentInfoDirectDraw.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
-			depthAttachmentInfoDirectDraw.clearValue = { .depthStencil = {.depth = 0.0f, .stencil = 0} };
-			depthAttachmentInfoDirectDraw.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-			depthAttachmentInfoDirectDraw.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			VkRenderingInfo renderInfoDirectDraw{};
-			renderInfoDirectDraw.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-			renderInfoDirectDraw.renderArea = { .offset{0,0}, .extent{.width = window.getWidth(), .height = window.getHeight()} };
-			renderInfoDirectDraw.layerCount = 1;
-			renderInfoDirectDraw.colorAttachmentCount = 1;
-			renderInfoDirectDraw.pColorAttachments = &colorAttachmentInfoDirectDraw;
-			renderInfoDirectDraw.pDepthAttachment = &depthAttachmentInfoDirectDraw;
-			vkCmdBeginRendering(cbPostprocessing, &renderInfoDirectDraw);
-				if (renderingData.drawBVs)
-					clusterer.cmdDrawBVs(cbPostprocessing);
-				if (renderingData.drawLightProxies)
-					clusterer.cmdDrawProxies(cbPostprocessing);
-
-				if (renderingData.showOBBs)
-					rUnitOBBs.cmdVisualizeOBBs(cbPostprocessing);
-
-				if (renderingData.voxelDebug == UiData::BOM_VOXEL_DEBUG)
-					gi.cmdDrawBOM(cbPostprocessing, camera.getPosition());
-				else if (renderingData.voxelDebug == UiData::ROM_VOXEL_DEBUG)
-					gi.cmdDrawROM(cbPostprocessing, camera.getPosition(), renderingData.indexROM);
-				else if (renderingData.voxelDebug == UiData::ALBEDO_VOXEL_DEBUG)
-					gi.cmdDrawAlbedo(cbPostprocessing, camera.getPosition());
-				else if (renderingData.voxelDebug == UiData::METALNESS_VOXEL_DEBUG)
-					gi.cmdDrawMetalness(cbPostprocessing, camera.getPosition());
-				else if (renderingData.voxelDebug == UiData::ROUGHNESS_VOXEL_DEBUG)
-					gi.cmdDrawRoughness(cbPostprocessing, camera.getPosition());
-				else if (renderingData.voxelDebug == UiData::EMISSION_VOXEL_DEBUG)
-					gi.cmdDrawEmission(cbPostprocessing, camera.getPosition());
-
-				if (renderingData.probeDebug == UiData::RADIANCE_PROBE_DEBUG)
-					gi.cmdDrawRadianceProbes(cbPostprocessing);
-				else if (renderingData.probeDebug == UiData::IRRADIANCE_PROBE_DEBUG)
-					gi.cmdDrawIrradianceProbes(cbPostprocessing);
-				else if (renderingData.probeDebug == UiData::VISIBILITY_PROBE_DEBUG)
-					gi.cmdDrawVisibilityProbes(cbPostprocessing);
-
-				if (renderingData.drawSpaceGrid)
-				{
-					VkBuffer lineVertexBindings[1]{ spaceLinesVertexData.getBufferHandle() };
-					VkDeviceSize lineVertexBindingOffsets[1]{ spaceLinesVertexData.getOffset() };
-					vkCmdBindVertexBuffers(cbPostprocessing, 0, 1, lineVertexBindings, lineVertexBindingOffsets);
-					spaceLinesPipeline.cmdBindResourceSets(cbPostprocessing);
-					spaceLinesPipeline.cmdBind(cbPostprocessing);
-					vkCmdPushConstants(cbPostprocessing, spaceLinesPipeline.getPipelineLayoutHandle(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::vec3), &camera.getPosition());
-					vkCmdDraw(cbPostprocessing, lineVertNum, 1, 0, 0);
-				}
-			vkCmdEndRendering(cbPostprocessing);
-
-			if (!renderingData.hideUI)
-			{
-				ui.startUIPass(cbPostprocessing, std::get<1>(swapchainImageData));
-				ui.begin("Settings");
-				ui.stats(renderingData, drawCount);
-				ui.lightSettings(renderingData, pointLights, spotLights);
-				ui.misc(renderingData);
-				ui.end();
-				ui.profiler(renderingData);
-				ui.endUIPass(cbPostprocessing);
-			}
-
-			SyncOperations::cmdExecuteBarrier(cbPostprocessing, 
-				{{SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_NONE,
-					VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0,
-					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-					std::get<0>(swapchainImageData),
-					{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.baseMipLevel = 0,
-					.levelCount = 1,
-					.baseArrayLayer = 0,
-					.layerCount = 1 })}});
+			postGraph.cmdExecute(cbPostprocessing);
 
+			frameQueries.cmdWriteEnd(cbPostprocessing, 0);
 			cmdBufferSet.endRecording(cbPostprocessing);
 		} };
 	node_t nodeComputeCB{ flowGraph, [&](msg_t)
@@ -713,11 +966,7 @@ int main()
 				queries.cmdUpdateResults(cbCompute, cqQueryOffset, cqQueryCount);
 				queries.cmdReset(cbCompute, cqQueryOffset, cqQueryCount);
 			}
-			gi.cmdComputeIndirect(cbCompute,
-				queries, 
-				queryIndexGICreateROMA, queryIndexGITraceProbes, queryIndexGIComputeIrradianceAndVisibility,
-				renderingData.skyboxEnabled,
-				profile);
+			drawGraph.cmdExecute(cbCompute, RenderGraph::COMPUTE_QUEUE);
 
 			cmdBufferSet.endRecording(cbCompute);
 		} };
@@ -729,27 +978,116 @@ int main()
 	oneapi::tbb::flow::make_edge(nodeFrustumCulling, nodePreprocessCB1);
 	oneapi::tbb::flow::make_edge(nodePreprocessCB1, nodePreprocessCB2);
 	oneapi::tbb::flow::make_edge(nodePrepareDataForShadowMapRender, nodePreprocessCB1);
-	oneapi::tbb::flow::make_edge(nodePreprocessCB2, nodePreprocessCB3);
-	oneapi::tbb::flow::make_edge(nodePreprocessCB3, nodePreprocessCB4);
-	clusterer.connectToFlowGraph(flowGraph, nodePrepare, nodePrepareDataForShadowMapRender, nodePreprocessCB3);
+	oneapi::tbb::flow::make_edge(nodePreprocessCB2, nodePreprocessCB4);
+	//Tile test is recorded by the draw graph, so drawing waits for the light buffers
+	clusterer.connectToFlowGraph(flowGraph, nodePrepare, nodePrepareDataForShadowMapRender, nodeDrawCB);
 	
+	pipelineCache.waitForCompilation();
+
+	transformStorage.upload(cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE));
 	voxelize(gi, cmdBufferSet, vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE), indirectDrawCmdData, vertexData, indexData, drawCount, 0, sizeof(IndirectData));
 
 	vkDeviceWaitIdle(device);
 	WorldState::initialize();
+	uint32_t frameIndex{ 0 };
+	renderingData.modelCount = staticMeshes.size();
+	uint32_t animatedModel{ UINT32_MAX };
+	uint32_t benchmarkMovedCount{ 0 };
+	double animationAngle{ 0.0 };
+	//Probe budget sweep, every budget is held until the probe ages settle and the GI timestamps are averaged over the following frames
+	constexpr std::array probeBudgetSweepBudgets{ 864, 1728, 3456, 6912, 13824 };
+	constexpr uint32_t probeBudgetSweepSettleFrames{ 120 };
+	constexpr uint32_t probeBudgetSweepMeasuredFrames{ 240 };
+	uint32_t probeBudgetSweepStep{ 0 };
+	uint32_t probeBudgetSweepFrame{ 0 };
+	uint32_t probeBudgetSweepSampleCount{ 0 };
+	double probeBudgetSweepTraceMS{ 0.0 };
+	double probeBudgetSweepIrradianceMS{ 0.0 };
+	int probeBudgetSweepUserBudget{ renderingData.giProbeUpdateBudget };
 	while (!glfwWindowShouldClose(window))
 	{
 		WorldState::refreshFrameTime();
 		glfwPollEvents();
 
+		memManager.updateBudget(frameIndex++);
+		renderingData.memoryHeaps = memManager.getHeapBudgets();
+		renderingData.memoryBudgetFallbackCount = memManager.getBudgetFallbackCount();
+		renderingData.defragmentationActive = memManager.isDefragmenting();
+
 		processInput(window, renderingData, camera, WorldState::deltaTime, ui.cursorOnUI());
 
+		//Scripted mover, the selected model spins around its up axis. A model is put back into place when deselected
+		//The benchmark spins the first N models to measure the transform upload against the number of dirty objects
+		uint32_t selectedModel{ renderingData.animateModel ? static_cast<uint32_t>(renderingData.animatedModelIndex) : UINT32_MAX };
+		uint32_t movedCount{ static_cast<uint32_t>(renderingData.benchmarkMovedModelCount) };
+		if (animatedModel != UINT32_MAX && animatedModel != selectedModel && animatedModel >= movedCount)
+			moveModel(animatedModel, modelMatrices[animatedModel], transformStorage, rUnitOBBs, gi);
+		for (uint32_t i{ movedCount }; i < benchmarkMovedCount; ++i)
+			if (i != selectedModel)
+				moveModel(i, modelMatrices[i], transformStorage, rUnitOBBs, gi);
+		animatedModel = selectedModel;
+		benchmarkMovedCount = movedCount;
+		animationAngle = std::fmod(animationAngle + WorldState::deltaTime * renderingData.animationSpeed, glm::two_pi<double>());
+		glm::mat4 spin{ glm::rotate(static_cast<float>(animationAngle), glm::vec3{ 0.0f, 1.0f, 0.0f }) };
+		for (uint32_t i{ 0 }; i < benchmarkMovedCount; ++i)
+			moveModel(i, modelMatrices[i] * spin, transformStorage, rUnitOBBs, gi);
+		if (animatedModel != UINT32_MAX && animatedModel >= benchmarkMovedCount)
+			moveModel(animatedModel, modelMatrices[animatedModel] * spin, transformStorage, rUnitOBBs, gi);
+
 		double startTime = glfwGetTime();
 
+		gi.updateCameraPosition(camera.getPosition());
+		gi.updateDirtyRegions(rUnitOBBs, drawCount);
+		if (renderingData.probeBudgetSweepRequested && !renderingData.probeBudgetSweepActive)
+		{
+			renderingData.probeBudgetSweepActive = true;
+			renderingData.probeBudgetSweepResults.clear();
+			probeBudgetSweepUserBudget = renderingData.giProbeUpdateBudget;
+			probeBudgetSweepStep = 0;
+			probeBudgetSweepFrame = 0;
+		}
+		renderingData.probeBudgetSweepRequested = false;
+		if (renderingData.probeBudgetSweepActive)
+			renderingData.giProbeUpdateBudget = probeBudgetSweepBudgets[probeBudgetSweepStep];
+		gi.setProbeUpdateBudget(renderingData.giProbeUpdateBudget);
+		renderingData.giScheduledProbeCount = gi.getScheduledProbeCount();
+		renderingData.giMaxProbeAge = gi.getMaxProbeAge();
+		renderingData.giMeanProbeAge = gi.getMeanProbeAge();
+
+		//Overlays are depth tested at the window resolution against the scaled depth, so native resolution is held while they are shown
+		bool depthTestedOverlays{ renderingData.drawBVs || renderingData.drawLightProxies || renderingData.showOBBs || renderingData.drawSpaceGrid ||
+			renderingData.voxelDebug != UiData::NONE_VOXEL_DEBUG || renderingData.probeDebug != UiData::NONE_PROBE_DEBUG };
+		dynamicResolution.setEnabled(renderingData.dynamicResolutionEnabled && !depthTestedOverlays);
+		dynamicResolution.setTargetFrameTime(renderingData.dynamicResolutionTargetMS);
+		dynamicResolution.setScaleBounds(renderingData.dynamicResolutionMinScale, renderingData.dynamicResolutionMaxScale);
+		if (dynamicResolution.getRenderWidth() != renderingData.renderWidth || dynamicResolution.getRenderHeight() != renderingData.renderHeight)
+		{
+			renderingData.renderWidth = dynamicResolution.getRenderWidth();
+			renderingData.renderHeight = dynamicResolution.getRenderHeight();
+			coordinateTransformation.updateScreenDimensions(renderingData.renderWidth, renderingData.renderHeight);
+			deferredLighting.setRenderExtent(renderingData.renderWidth, renderingData.renderHeight);
+			depthBuffer.setRenderExtent(renderingData.renderWidth, renderingData.renderHeight);
+			hbao.setRenderScale(dynamicResolution.getUVScale());
+			gi.setSpecularRenderExtent(renderingData.renderWidth, renderingData.renderHeight);
+			taa.setRenderExtent(renderingData.renderWidth, renderingData.renderHeight);
+		}
+		hbao.setResolutionDivisor(1u << renderingData.aoResolution);
+		hbao.setSampleCounts(renderingData.aoDirectionCount, renderingData.aoStepCount);
+		deferredLighting.updateAOUVScale(hbao.getAOUVScale());
+		//GI metadata is double buffered, async compute of the previous frame keeps reading its own copy
+		gi.uploadMetadata();
+
+		//Post graph is resolved after the swapchain image is acquired
+		drawGraph.resolve();
+
 		renderingData.cpuTasks[0].startTime = glfwGetTime() - startTime;
 		nodePrepare.try_put(oneapi::tbb::flow::continue_msg{});
 		flowGraph.wait_for_all();
 		renderingData.cpuTasks[0].endTime = glfwGetTime() - startTime;
+		renderingData.transformUploadObjectCount = transformStorage.getUploadStats().objectCount;
+		renderingData.transformUploadDrawCount = transformStorage.getUploadStats().drawCount;
+		renderingData.transformUploadBytes = transformStorage.getUploadStats().stagedBytes;
+		renderingData.transformFullUploadBytes = transformStorage.getFullUploadSize();
 
 		renderingData.cpuTasks[1].startTime = glfwGetTime() - startTime;
 		submitAndWait(*vulkanObjectHandler, 
@@ -759,12 +1097,103 @@ int main()
 			std::get<2>(swapchainImageData), swapChains[0]);
 		renderingData.cpuTasks[1].endTime = glfwGetTime() - startTime;
 
+		//Frames are waited on in submitAndWait, so the frame's ranges can be reclaimed right away
+		frameAllocator.endFrame(semaphore.getValue());
+		frameAllocator.reclaim(semaphore.getValue());
+
+#ifdef _DEBUG
+		if (renderingData.gpuShadowCasterCulling)
+			caster.validateGPUCulling();
+#endif
+
 		queries.uploadQueryDataToProfilerTasks(renderingData.gpuTasks.data(), renderingData.gpuTasks.size());
+		double gpuFrameTime{ frameQueries.getQueryTimeMS(0) };
+		if (gpuFrameTime >= 0.0)
+			dynamicResolution.submitFrameTime(gpuFrameTime);
+
+		if (renderingData.probeBudgetSweepActive)
+		{
+			double traceMS{ queries.getQueryTimeMS(queryIndexGITraceProbes) };
+			double irradianceMS{ queries.getQueryTimeMS(queryIndexGIComputeIrradianceAndVisibility) };
+			if (probeBudgetSweepFrame >= probeBudgetSweepSettleFrames && traceMS >= 0.0 && irradianceMS >= 0.0)
+			{
+				probeBudgetSweepTraceMS += traceMS;
+				probeBudgetSweepIrradianceMS += irradianceMS;
+				++probeBudgetSweepSampleCount;
+			}
+			if (++probeBudgetSweepFrame == probeBudgetSweepSettleFrames + probeBudgetSweepMeasuredFrames)
+			{
+				double sampleCount{ static_cast<double>(std::max(probeBudgetSweepSampleCount, 1u)) };
+				UiData::ProbeBudgetSample& sample{ renderingData.probeBudgetSweepResults.emplace_back() };
+				sample.budget = probeBudgetSweepBudgets[probeBudgetSweepStep];
+				sample.traceMS = static_cast<float>(probeBudgetSweepTraceMS / sampleCount);
+				sample.irradianceMS = static_cast<float>(probeBudgetSweepIrradianceMS / sampleCount);
+				sample.maxProbeAge = renderingData.giMaxProbeAge;
+				sample.meanProbeAge = renderingData.giMeanProbeAge;
+				LOG_INFO("Probe budget {}: trace {:.3f} ms, irradiance {:.3f} ms, max probe age {}, mean probe age {:.1f} ({} frames timed).",
+					sample.budget, sample.traceMS, sample.irradianceMS, sample.maxProbeAge, sample.meanProbeAge, probeBudgetSweepSampleCount);
+
+				probeBudgetSweepFrame = 0;
+				probeBudgetSweepSampleCount = 0;
+				probeBudgetSweepTraceMS = 0.0;
+				probeBudgetSweepIrradianceMS = 0.0;
+				if (++probeBudgetSweepStep == probeBudgetSweepBudgets.size())
+				{
+					renderingData.probeBudgetSweepActive = false;
+					renderingData.giProbeUpdateBudget = probeBudgetSweepUserBudget;
+				}
+			}
+		}
+
+		shaderReloader.applyReloadedPipelines();
+
+		if (renderingData.defragmentationRequested)
+		{
+			memManager.beginDefragmentation();
+			renderingData.defragmentationRequested = false;
+		}
+		descManager.advanceFrame();
+		if (descManager.needsCompaction())
+		{
+			EASSERT(vkDeviceWaitIdle(device) == VK_SUCCESS, "Vulkan", "Device wait failed.");
+			descManager.compact();
+		}
+		//Descriptors rewritten by move callbacks land in the frame slot advanced to above
+		for (BufferBaseHostAccessible* hostBuffer : { &baseHostBuffer, &baseHostCachedBuffer })
+		{
+			if (hostBuffer->needsCompaction())
+			{
+				EASSERT(vkDeviceWaitIdle(device) == VK_SUCCESS, "Vulkan", "Device wait failed.");
+				hostBuffer->compact();
+			}
+		}
+
+		//Sources of the previous pass were last used by the frame that has just finished
+		memManager.endDefragmentationPass();
+		if (memManager.isDefragmenting())
+		{
+			cmdBufferSet.resetAllTransient();
+			VkCommandBuffer cbDefrag{ cmdBufferSet.beginTransientRecording() };
+				memManager.cmdDefragmentationPass(cbDefrag);
+			cmdBufferSet.endRecording(cbDefrag);
+
+			//Copies are ordered before the next frame on the graphics queue but async compute of this frame might still read the sources
+			uint64_t waitValues[]{ semaphoreCompute.getValue() };
+			VkSemaphore waitSemaphores[]{ semaphoreCompute.getHandle() };
+			VkPipelineStageFlags waitStages[]{ VK_PIPELINE_STAGE_TRANSFER_BIT };
+			VkTimelineSemaphoreSubmitInfo defragSemaphoreSubmit{ TimelineSemaphore::getSubmitInfo(ARRAYSIZE(waitValues), waitValues, 0, nullptr) };
+			VkSubmitInfo defragSubmitInfo{ .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .pNext = &defragSemaphoreSubmit,
+				.waitSemaphoreCount = ARRAYSIZE(waitSemaphores), .pWaitSemaphores = waitSemaphores, .pWaitDstStageMask = waitStages,
+				.commandBufferCount = 1, .pCommandBuffers = &cbDefrag };
+			vkQueueSubmit(vulkanObjectHandler->getQueue(VulkanObjectHandler::GRAPHICS_QUEUE_TYPE), 1, &defragSubmitInfo, VK_NULL_HANDLE);
+		}
 
 		//vkDeviceWaitIdle(device);
 	}
 	
+	shaderReloader.stop();
 	EASSERT(vkDeviceWaitIdle(device) == VK_SUCCESS, "Vulkan", "Device wait failed.");
+	memManager.endDefragmentationPass();
 	vkDestroySampler(device, linearSampler, nullptr);
 	vkDestroySampler(device, nearestSampler, nullptr);
 	vkDestroySemaphore(device, swapchainSemaphore, nullptr);
@@ -842,7 +1271,8 @@ void loadDefaultTextures(ImageListContainer& imageLists, BufferBaseHostAccessibl
 
 void createResourceSets(VkDevice device,
 	ResourceSet& transformMatricesRS, 
-	const BufferMapped& transformMatrices,
+	const Buffer& transformMatrices,
+	const Buffer& prevTransformMatrices,
 	ResourceSet& materialsTexturesRS, 
 	const ImageListContainer& imageLists,
 	ResourceSet& skyboxRS, 
@@ -852,13 +1282,18 @@ void createResourceSets(VkDevice device,
 {
 	VkDescriptorSetLayoutBinding transformMatricesBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
 	VkDescriptorAddressInfoEXT transformMatricesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = transformMatrices.getDeviceAddress(), .range = transformMatrices.getSize() };
+	VkDescriptorSetLayoutBinding prevTransformMatricesBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
+	VkDescriptorAddressInfoEXT prevTransformMatricesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = prevTransformMatrices.getDeviceAddress(), .range = prevTransformMatrices.getSize() };
 	transformMatricesRS.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
-		std::array{ transformMatricesBinding },
+		std::array{ transformMatricesBinding, prevTransformMatricesBinding },
 		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{ std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &transformMatricesAddressInfo} } },
+		std::vector<std::vector<VkDescriptorDataEXT>>{ 
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &transformMatricesAddressInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &prevTransformMatricesAddressInfo} } },
 		false);
 
-	VkDescriptorSetLayoutBinding imageListsBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 64, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
+	uint32_t imageListsArraySize{ ((imageLists.getImageListCount() + BINDLESS_ARRAY_GRANULARITY - 1) / BINDLESS_ARRAY_GRANULARITY) * BINDLESS_ARRAY_GRANULARITY };
+	VkDescriptorSetLayoutBinding imageListsBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = imageListsArraySize, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
 	std::vector<VkDescriptorImageInfo> storageImageData(imageLists.getImageListCount());
 	std::vector<VkDescriptorDataEXT> imageListsDescData(imageLists.getImageListCount());
 	for (uint32_t i{ 0 }; i < imageListsDescData.size(); ++i)
@@ -924,7 +1359,8 @@ void createShadowMapResourceSet(VkDevice device,
 	ResourceSet& shadowMapsRS,
 	const ImageListContainer& shadowMapLists,
 	const std::vector<ImageList>& shadowCubeMapLists, 
-	const BufferBaseHostAccessible& shadowMapViewMatrices,
+	const RingAllocator& frameAllocator,
+	VkDeviceSize viewMatricesMaxSize,
 	VkSampler nearestSampler)
 {
 	VkDescriptorSetLayoutBinding shadowMapsBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = 64, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
@@ -948,7 +1384,8 @@ void createShadowMapResourceSet(VkDevice device,
 	VkDescriptorSetLayoutBinding nearestSamplerBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
 	VkSampler nearestSamplerData{ nearestSampler };
 	VkDescriptorSetLayoutBinding viewMatricesBinding{ .binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorAddressInfoEXT viewMatricesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = shadowMapViewMatrices.getDeviceAddress(), .range = shadowMapViewMatrices.getSize() };
+	//View matrices live in the frame allocator, the shadow caster points the descriptor at the current frame's range
+	VkDescriptorAddressInfoEXT viewMatricesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = frameAllocator.getDeviceAddress(), .range = viewMatricesMaxSize };
 
 	shadowMapsRS.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
 		std::array{ shadowMapsBinding, shadowCubeMapsBinding, linearSamplerBinding, nearestSamplerBinding, viewMatricesBinding },
@@ -960,7 +1397,7 @@ void createShadowMapResourceSet(VkDevice device,
 			std::vector<VkDescriptorDataEXT>{VkDescriptorDataEXT{ .pSampler = &nearestSamplerData }},
 			std::vector<VkDescriptorDataEXT>{VkDescriptorDataEXT{ .pStorageBuffer = &viewMatricesAddressInfo }},
 		},
-		true);
+		true, true);
 }
 
 void createBRDFLUTResourceSet(VkDevice device,
@@ -981,21 +1418,20 @@ void createBRDFLUTResourceSet(VkDevice device,
 void createDirecLightingResourceSet(VkDevice device,
 	ResourceSet& directLightingRS,
 	const BufferMapped& directionalLight,
-	const BufferMapped& sortedLightsData,
-	const BufferBaseHostAccessible& typeData,
-	const BufferBaseHostInaccessible& tileData,
-	const BufferMapped& zBinData)
+	const RingAllocator& frameAllocator,
+	const BufferBaseHostInaccessible& tileData)
 {
+	//Sorted lights, point light words and z bins live in the frame allocator, the clusterer points these descriptors at the current frame's ranges
 	VkDescriptorSetLayoutBinding directionalLightBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
 	VkDescriptorAddressInfoEXT directionalLightAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = directionalLight.getDeviceAddress(), .range = directionalLight.getSize() };
 	VkDescriptorSetLayoutBinding sortedLightsBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorAddressInfoEXT sortedLightsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = sortedLightsData.getDeviceAddress(), .range = sortedLightsData.getSize() };
+	VkDescriptorAddressInfoEXT sortedLightsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = frameAllocator.getDeviceAddress(), .range = MAX_LIGHTS * sizeof(Clusterer::LightFormat) };
 	VkDescriptorSetLayoutBinding typesBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorAddressInfoEXT typesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = typeData.getDeviceAddress(), .range = typeData.getSize() };
+	VkDescriptorAddressInfoEXT typesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = frameAllocator.getDeviceAddress(), .range = MAX_WORDS * sizeof(uint32_t) };
 	VkDescriptorSetLayoutBinding tileDataBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
 	VkDescriptorAddressInfoEXT tileDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = tileData.getDeviceAddress(), .range = tileData.getSize() };
 	VkDescriptorSetLayoutBinding zBinDataBinding{ .binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorAddressInfoEXT zBinDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = zBinData.getDeviceAddress(), .range = zBinData.getSize() };
+	VkDescriptorAddressInfoEXT zBinDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = frameAllocator.getDeviceAddress(), .range = Z_BIN_COUNT * sizeof(uint16_t) * 2 };
 	directLightingRS.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
 		std::array{ directionalLightBinding, sortedLightsBinding, typesBinding, tileDataBinding, zBinDataBinding },
 		std::array<VkDescriptorBindingFlags, 0>{},
@@ -1005,7 +1441,7 @@ void createDirecLightingResourceSet(VkDevice device,
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &typesAddressInfo} },
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &tileDataAddressInfo} },
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &zBinDataAddressInfo} }},
-		false);
+		false, true);
 }
 
 Pipeline createSkyboxPipeline(PipelineAssembler& assembler, const ResourceSet& viewprojRS, const ResourceSet& skyboxLightingRS)
@@ -1125,25 +1561,50 @@ uint32_t uploadLineVertices(fs::path filepath, Buffer& vertexBuffer, BufferBaseH
 
 void transformOBBs(OBBs& boundingBoxes, std::vector<StaticMesh>& staticMeshes, int drawCount, const std::vector<glm::mat4>& modelMatrices)
 {
-	uint32_t transMatIndex{ 0 };
-	uint32_t drawNum{ static_cast<uint32_t>(staticMeshes[transMatIndex].getRUnits().size()) };
-	for (uint32_t i{ 0 }; i < drawCount; ++i)
-	{
-		if (i == drawNum)
+	std::vector<uint32_t> firstDraws(staticMeshes.size());
+	for (uint32_t i{ 1 }; i < staticMeshes.size(); ++i)
+		firstDraws[i] = firstDraws[i - 1] + staticMeshes[i - 1].getRUnits().size();
+	//Meshes are split between threads, large meshes are split further inside the batch transform
+	oneapi::tbb::parallel_for(size_t{ 0 }, staticMeshes.size(), [&](size_t i)
 		{
-			drawNum += staticMeshes[++transMatIndex].getRUnits().size();
-		}
-		boundingBoxes.transformOBB(i, modelMatrices[transMatIndex]);
-	}
+			uint32_t first{ std::min(firstDraws[i], static_cast<uint32_t>(drawCount)) };
+			uint32_t count{ std::min(static_cast<uint32_t>(staticMeshes[i].getRUnits().size()), drawCount - first) };
+			boundingBoxes.transformOBBs(first, count, modelMatrices[i]);
+		});
 }
-void getBoundingSpheres(BufferMapped& indirectDataBuffer, const OBBs& boundingBoxes)
+void moveModel(uint32_t modelIndex, const glm::mat4& newModelMatrix, TransformStorage& transformStorage, OBBs& boundingBoxes, GI& gi)
 {
-	IndirectData* data{ reinterpret_cast<IndirectData*>(indirectDataBuffer.getData()) };
-
-	for (uint32_t i{ 0 }; i < boundingBoxes.getBBCount(); ++i)
+	//Draw range of the model is stored when it is added to the transform storage, so moving N models stays linear in N
+	uint32_t firstDraw{ transformStorage.getFirstDraw(modelIndex) };
+	uint32_t drawNum{ transformStorage.getDrawCount(modelIndex) };
+
+	glm::vec3 oldMin{ std::numeric_limits<float>::max() };
+	glm::vec3 oldMax{ std::numeric_limits<float>::lowest() };
+	glm::vec3 newMin{ std::numeric_limits<float>::max() };
+	glm::vec3 newMax{ std::numeric_limits<float>::lowest() };
+	for (uint32_t i{ firstDraw }; i < firstDraw + drawNum; ++i)
+	{
+		glm::vec3 min{};
+		glm::vec3 max{};
+		boundingBoxes.getAABB(i, min, max);
+		oldMin = glm::min(oldMin, min);
+		oldMax = glm::max(oldMax, max);
+	}
+	boundingBoxes.transformOBBsFromLocal(firstDraw, drawNum, newModelMatrix);
+	for (uint32_t i{ firstDraw }; i < firstDraw + drawNum; ++i)
 	{
-		boundingBoxes.getBoundingSphere(i, data[i].bsPos, &(data[i].bsRad));
+		glm::vec3 min{};
+		glm::vec3 max{};
+		boundingBoxes.getAABB(i, min, max);
+		newMin = glm::min(newMin, min);
+		newMax = glm::max(newMax, max);
 	}
+	//Bounding spheres of the draws are recomputed on the GPU during the upload
+	transformStorage.setTransform(modelIndex, newModelMatrix);
+
+	//Voxels covered by the model before and after the move are rebuilt
+	gi.markDirtyBounds(oldMin, oldMax);
+	gi.markDirtyBounds(newMin, newMax);
 }
 
 void fillFrustumData(CoordinateTransformation& coordinateTransformation, Camera& camera, Clusterer& clusterer, HBAO& hbao, FrustumInfo& frustumInfo, ShadowCaster& caster, DeferredLighting& deferredLighting)
@@ -1179,14 +1640,6 @@ void fillFrustumData(CoordinateTransformation& coordinateTransformation, Camera&
 	frustumInfo.points[6] = { (farPlane)*fovXScale, (farPlane)*fovYScale, farPlane }; //far top right
 	frustumInfo.points[7] = { (farPlane)*fovXScale, -(farPlane)*fovYScale, farPlane }; //far bot right
 }
-void fillModelMatrices(const BufferMapped& modelTransformData, const std::vector<glm::mat4>& modelMatrices)
-{
-	glm::mat4* transformMatrices{ reinterpret_cast<glm::mat4*>(modelTransformData.getData()) };
-	for (int i{ 0 }; i < modelMatrices.size(); ++i)
-	{
-		transformMatrices[i] = modelMatrices[i];
-	}
-}
 void fillDrawData(const BufferMapped& perDrawDataIndices, std::vector<StaticMesh>& staticMeshes, int drawCount)
 {
 	uint8_t* drawDataIndices{ reinterpret_cast<uint8_t*>(perDrawDataIndices.getData()) };
@@ -1199,8 +1652,8 @@ void fillDrawData(const BufferMapped& perDrawDataIndices, std::vector<StaticMesh
 		{
 			drawNum += staticMeshes[++transMatIndex].getRUnits().size();
 		}
-		*(drawDataIndices + i * 12 + 0) = transMatIndex;
-		*(drawDataIndices + i * 12 + 1) = 0;
+		//Model index is 16 bit
+		*reinterpret_cast<uint16_t*>(drawDataIndices + i * 12 + 0) = transMatIndex;
 		*(drawDataIndices + i * 12 + 2) = 0;
 		*(drawDataIndices + i * 12 + 3) = 0;
 	}
@@ -1369,7 +1822,8 @@ void submitAndWait(VulkanObjectHandler& vulkanObjectHandler,
 	uint64_t signalValues1[]{ ++timelineVal };
 	VkSemaphore waitSemaphores1[]{ semaphoreCompute.getHandle() };
 	VkSemaphore signalSemaphores1[]{ semaphore.getHandle() };
-	VkPipelineStageFlags stageFlags1[]{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
+	//Voxel clears of the scroll and the dynamic emission clear overwrite what async compute of the previous frame reads
+	VkPipelineStageFlags stageFlags1[]{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT };
 	semaphoreSubmit[0] = TimelineSemaphore::getSubmitInfo(ARRAYSIZE(waitValues1), waitValues1, ARRAYSIZE(signalValues1), signalValues1);
 	submitInfos[1] = VkSubmitInfo{ .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .pNext = semaphoreSubmit,
 		.waitSemaphoreCount = ARRAYSIZE(waitSemaphores1), .pWaitSemaphores = waitSemaphores1, .pWaitDstStageMask = stageFlags1,
@@ -146,6 +146,32 @@ public:
         {
             ImGui::Text("Frustum culled meshes - %u", data.frustumCulledCount);
             ImGui::Text("Occlusion culled meshes - %u", drawCount - *reinterpret_cast<uint32_t*>(data.finalDrawCount.getData()) - data.frustumCulledCount);
+            ImGui::Text("Transform upload - %u objects, %u draws, %.2f KB (%.2f KB for the whole scene)", 
+                data.transformUploadObjectCount, data.transformUploadDrawCount, data.transformUploadBytes / 1024.0, data.transformFullUploadBytes / 1024.0);
+            if (ImGui::TreeNode("Render graph"))
+            {
+                ImGui::Text("Passes - %u (%u culled, %u on async compute)", data.renderGraphPassCount, data.renderGraphCulledPassCount, data.renderGraphComputeQueuePassCount);
+                ImGui::Text("Barriers per frame - %u in %u batches", data.renderGraphBarrierCount, data.renderGraphBarrierBatchCount);
+                ImGui::Text("Attachment memory - %.2f MB", data.renderGraphAttachmentMemory / (1024.0 * 1024.0));
+                ImGui::Text("Transient memory - %.2f MB (%.2f MB without aliasing)", data.renderGraphTransientMemory / (1024.0 * 1024.0), data.renderGraphTransientMemoryUnaliased / (1024.0 * 1024.0));
+                ImGui::TreePop();
+            }
+            if (ImGui::TreeNode("Memory"))
+            {
+                for (int i{ 0 }; i < data.memoryHeaps.size(); ++i)
+                {
+                    const MemoryManager::HeapBudget& heap{ data.memoryHeaps[i] };
+                    ImGui::Text("Heap %d (%s) - %.2f / %.2f MB, %.2f MB allocated", i, heap.deviceLocal ? "device" : "host",
+                        heap.usage / (1024.0 * 1024.0), heap.budget / (1024.0 * 1024.0), heap.allocationBytes / (1024.0 * 1024.0));
+                    ImGui::ProgressBar(heap.budget != 0 ? static_cast<float>(static_cast<double>(heap.usage) / heap.budget) : 0.0f);
+                }
+                ImGui::Text("Allocations moved to system memory - %u", data.memoryBudgetFallbackCount);
+                if (data.defragmentationActive)
+                    ImGui::Text("Defragmenting...");
+                else if (ImGui::Button("Defragment"))
+                    data.defragmentationRequested = true;
+                ImGui::TreePop();
+            }
             ImGui::TreePop();
         }
     }
@@ -250,6 +276,16 @@ public:
         m_profilersWindow.Render();
         data.profilingEnabled = !m_profilersWindow.stopProfiling;
     }
+    void shaderErrors(const std::vector<std::string>& errors)
+    {
+        if (errors.empty())
+            return;
+
+        ImGui::Begin("Shader errors");
+        for (auto& error : errors)
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", error.c_str());
+        ImGui::End();
+    }
     void misc(UiData& data)
     {
         if (ImGui::TreeNode("Debug"))
@@ -257,6 +293,7 @@ public:
             ImGui::Checkbox("Space grid", &data.drawSpaceGrid);
             ImGui::Checkbox("Skybox", &data.skyboxEnabled);
             ImGui::Checkbox("OBBs", &data.showOBBs);
+            ImGui::Checkbox("GPU shadow caster culling", &data.gpuShadowCasterCulling);
 #define DISABLE_INDIRECT 0x00000001
 #define DISPLAY_LIGHT_HEAT_MAP 0x00000002
             static bool disableIndirect{ false };
@@ -296,6 +333,68 @@ public:
                 ImGui::RadioButton("Show irradiance", &data.probeDebug, UiData::IRRADIANCE_PROBE_DEBUG);
                 ImGui::RadioButton("Show visibility", &data.probeDebug, UiData::VISIBILITY_PROBE_DEBUG);
 
+                ImGui::SliderInt("Probe update budget", &data.giProbeUpdateBudget, 1, 13824);
+                ImGui::Text("Probes updated: %u", data.giScheduledProbeCount);
+                ImGui::Text("Max probe age: %u frames", data.giMaxProbeAge);
+                ImGui::Text("Mean probe age: %.1f frames", data.giMeanProbeAge);
+
+                if (data.probeBudgetSweepActive)
+                    ImGui::Text("Running budget sweep...");
+                else if (ImGui::Button("Run budget sweep"))
+                    data.probeBudgetSweepRequested = true;
+                ImGui::TextDisabled("Holds every budget for a few seconds and averages the GI timestamps, profiling has to be enabled.");
+                for (auto& sample : data.probeBudgetSweepResults)
+                    ImGui::Text("Budget %5d: trace %.3f ms, irradiance %.3f ms, max age %u, mean age %.1f", 
+                        sample.budget, sample.traceMS, sample.irradianceMS, sample.maxProbeAge, sample.meanProbeAge);
+
+                ImGui::TreePop();
+            }
+            if (ImGui::TreeNode("Specular tracing"))
+            {
+                ImGui::RadioButton("Half resolution", &data.specularTraceMode, UiData::HALF_SPECULAR_TRACE);
+                ImGui::RadioButton("Checkerboard", &data.specularTraceMode, UiData::CHECKERBOARD_SPECULAR_TRACE);
+
+                ImGui::TreePop();
+            }
+            if (ImGui::TreeNode("Ambient occlusion"))
+            {
+                ImGui::RadioButton("Full resolution", &data.aoResolution, UiData::FULL_AO_RESOLUTION);
+                ImGui::RadioButton("Half resolution", &data.aoResolution, UiData::HALF_AO_RESOLUTION);
+                ImGui::RadioButton("Quarter resolution", &data.aoResolution, UiData::QUARTER_AO_RESOLUTION);
+                ImGui::SliderInt("Directions", &data.aoDirectionCount, 2, 8);
+                ImGui::SliderInt("Steps", &data.aoStepCount, 2, 6);
+                ImGui::TextDisabled("Samples are rotated every frame and accumulated over time.");
+
+                ImGui::TreePop();
+            }
+            if (ImGui::TreeNode("G-buffer layout"))
+            {
+                ImGui::Checkbox("Visibility buffer", &data.visibilityBuffer);
+                ImGui::TextDisabled("Stores draw and triangle IDs only. UVs and the tangent frame are reconstructed in the lighting pass.");
+
+                ImGui::TreePop();
+            }
+            if (ImGui::TreeNode("Dynamic resolution"))
+            {
+                ImGui::Checkbox("Enabled", &data.dynamicResolutionEnabled);
+                ImGui::SliderFloat("Target GPU time (ms)", &data.dynamicResolutionTargetMS, 4.0f, 50.0f);
+                ImGui::SliderFloat("Min scale", &data.dynamicResolutionMinScale, 0.25f, 1.0f);
+                ImGui::SliderFloat("Max scale", &data.dynamicResolutionMaxScale, 0.25f, 1.0f);
+                if (data.dynamicResolutionMinScale > data.dynamicResolutionMaxScale)
+                    data.dynamicResolutionMinScale = data.dynamicResolutionMaxScale;
+                ImGui::Text("Render resolution: %ux%u", data.renderWidth, data.renderHeight);
+                ImGui::TextDisabled("Driven by the GPU profiler timings. Native resolution is kept while depth tested debug overlays are shown.");
+
+                ImGui::TreePop();
+            }
+            if (ImGui::TreeNode("Scene animation"))
+            {
+                ImGui::Checkbox("Spin model", &data.animateModel);
+                ImGui::SliderInt("Model", &data.animatedModelIndex, 0, static_cast<int>(data.modelCount) - 1);
+                ImGui::SliderFloat("Speed (rad/s)", &data.animationSpeed, 0.0f, 3.0f);
+                ImGui::SliderInt("Models moved every frame", &data.benchmarkMovedModelCount, 0, static_cast<int>(data.modelCount));
+                ImGui::TextDisabled("Benchmark of the dirty transform path, the first N models spin each frame.");
+
                 ImGui::TreePop();
             }
             ImGui::TreePop();
@@ -25,6 +25,27 @@ struct UiData
         VISIBILITY_PROBE_DEBUG,
         NONE_PROBE_DEBUG
     };
+    enum SpecularTraceMode
+    {
+        HALF_SPECULAR_TRACE,
+        CHECKERBOARD_SPECULAR_TRACE
+    };
+    //Value is the log2 of the divisor applied to the render resolution
+    enum AOResolution
+    {
+        FULL_AO_RESOLUTION,
+        HALF_AO_RESOLUTION,
+        QUARTER_AO_RESOLUTION
+    };
+    //Averaged GPU cost of the probe update and the convergence reached for one budget of the sweep
+    struct ProbeBudgetSample
+    {
+        int budget{ 0 };
+        float traceMS{ 0.0f };
+        float irradianceMS{ 0.0f };
+        uint32_t maxProbeAge{ 0 };
+        float meanProbeAge{ 0.0f };
+    };
 
 
     uint32_t lightingPassDebugOptionsBitfield{ 0 };
@@ -37,10 +58,50 @@ struct UiData
     int voxelDebug{ NONE_VOXEL_DEBUG };
     int probeDebug{ NONE_PROBE_DEBUG };
     bool showOBBs{ false };
+    bool gpuShadowCasterCulling{ true };
     int indexROM{ 0 };
     uint32_t countROM{ 1 };
     uint32_t frustumCulledCount{ 0 };
+    int giProbeUpdateBudget{ 3456 };
+    uint32_t giScheduledProbeCount{ 0 };
+    uint32_t giMaxProbeAge{ 0 };
+    float giMeanProbeAge{ 0.0f };
+    bool probeBudgetSweepRequested{ false };
+    bool probeBudgetSweepActive{ false };
+    std::vector<ProbeBudgetSample> probeBudgetSweepResults{};
+    int specularTraceMode{ CHECKERBOARD_SPECULAR_TRACE };
+    int aoResolution{ HALF_AO_RESOLUTION };
+    int aoDirectionCount{ 4 };
+    int aoStepCount{ 3 };
+    bool visibilityBuffer{ false };
+    bool dynamicResolutionEnabled{ false };
+    float dynamicResolutionTargetMS{ 16.6f };
+    float dynamicResolutionMinScale{ 0.5f };
+    float dynamicResolutionMaxScale{ 1.0f };
+    uint32_t renderWidth{ 0 };
+    uint32_t renderHeight{ 0 };
     BufferMapped finalDrawCount;
+    uint32_t renderGraphPassCount{ 0 };
+    uint32_t renderGraphCulledPassCount{ 0 };
+    uint32_t renderGraphComputeQueuePassCount{ 0 };
+    uint32_t renderGraphBarrierCount{ 0 };
+    uint32_t renderGraphBarrierBatchCount{ 0 };
+    uint64_t renderGraphAttachmentMemory{ 0 };
+    uint64_t renderGraphTransientMemory{ 0 };
+    uint64_t renderGraphTransientMemoryUnaliased{ 0 };
+    std::vector<MemoryManager::HeapBudget> memoryHeaps{};
+    uint32_t memoryBudgetFallbackCount{ 0 };
+    bool defragmentationRequested{ false };
+    bool defragmentationActive{ false };
+    uint32_t modelCount{ 0 };
+    bool animateModel{ false };
+    int animatedModelIndex{ 0 };
+    float animationSpeed{ 0.5f };
+    int benchmarkMovedModelCount{ 0 };
+    uint32_t transformUploadObjectCount{ 0 };
+    uint32_t transformUploadDrawCount{ 0 };
+    uint64_t transformUploadBytes{ 0 };
+    uint64_t transformFullUploadBytes{ 0 };
     std::vector<legit::ProfilerTask> gpuTasks{};
     std::vector<legit::ProfilerTask> cpuTasks{};
 };
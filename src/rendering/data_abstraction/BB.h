@@ -2,14 +2,27 @@
 #define BB_HEADER
 
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <intrin.h>
+
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 
 #include <glm/glm.hpp>
 
 #include "src/rendering/renderer/pipeline_management.h"
+#include "src/rendering/renderer/descriptor_management.h"
+#include "src/rendering/data_management/buffer_class.h"
 
 #include "src/tools/asserter.h"
 #include "src/tools/alignment.h"
 
+//Boxes transformed by one task
+#define OBB_TRANSFORM_GRAIN_SIZE 256
+//Box capacity a scene starts with, addOBB() doubles it when it runs out
+#define OBB_INITIAL_CAPACITY 1024
+
 class OBBs
 {
 private:
@@ -21,9 +34,131 @@ private:
 	float* m_extents{};
 	float* m_centers{};
 
+	//Model space copies, moved boxes are rebuilt from them so transforms don't accumulate error
+	float* m_localData{};
+	float* m_localAxii{};
+	float* m_localExtents{};
+	float* m_localCenters{};
+
 	static constexpr int dimensionsNum{ 3 };
 	static constexpr int boxVertexCount{ 8 };
 
+	//Arrays are stored as rows of m_maxCount boxes, so every row is moved to its place in the larger array
+	static float* relayout(float* src, uint32_t rowCount, uint32_t valuesPerBox, uint32_t oldMaxCount, uint32_t newMaxCount)
+	{
+		float* dst{ new float[rowCount * valuesPerBox * newMaxCount] };
+		for (uint32_t row{ 0 }; row < rowCount; ++row)
+			std::memcpy(dst + row * valuesPerBox * newMaxCount, src + row * valuesPerBox * oldMaxCount, sizeof(float) * valuesPerBox * oldMaxCount);
+		delete[] src;
+		return dst;
+	}
+	void grow()
+	{
+		//Capacity stays a multiple of four for the four-wide transforms
+		uint32_t newMaxCount{ std::max(m_maxCount * 2, 4u) };
+
+		m_data = relayout(m_data, dimensionsNum, boxVertexCount, m_maxCount, newMaxCount);
+		m_axii = relayout(m_axii, dimensionsNum * dimensionsNum, 1, m_maxCount, newMaxCount);
+		m_extents = relayout(m_extents, dimensionsNum, 1, m_maxCount, newMaxCount);
+		m_centers = relayout(m_centers, dimensionsNum, 1, m_maxCount, newMaxCount);
+
+		m_localData = relayout(m_localData, dimensionsNum, boxVertexCount, m_maxCount, newMaxCount);
+		m_localAxii = relayout(m_localAxii, dimensionsNum * dimensionsNum, 1, m_maxCount, newMaxCount);
+		m_localExtents = relayout(m_localExtents, dimensionsNum, 1, m_maxCount, newMaxCount);
+		m_localCenters = relayout(m_localCenters, dimensionsNum, 1, m_maxCount, newMaxCount);
+
+		m_maxCount = newMaxCount;
+	}
+
+	void transformOBBRange(uint32_t begin, uint32_t end, const glm::mat4& transformMatrix)
+	{
+		__m128 m[4][3]{};
+		for (int col{ 0 }; col < 4; ++col)
+			for (int row{ 0 }; row < 3; ++row)
+				m[col][row] = _mm_set1_ps(transformMatrix[col][row]);
+
+		//Corners of a box are stored contiguously, so two vectors hold one coordinate of all eight
+		for (uint32_t i{ begin }; i < end; ++i)
+		{
+			float* xs{ m_data + 0 * boxVertexCount * m_maxCount + boxVertexCount * i };
+			float* ys{ m_data + 1 * boxVertexCount * m_maxCount + boxVertexCount * i };
+			float* zs{ m_data + 2 * boxVertexCount * m_maxCount + boxVertexCount * i };
+			for (int j{ 0 }; j < boxVertexCount; j += 4)
+			{
+				__m128 x{ _mm_load_ps(xs + j) };
+				__m128 y{ _mm_load_ps(ys + j) };
+				__m128 z{ _mm_load_ps(zs + j) };
+				_mm_store_ps(xs + j, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][0], x), _mm_mul_ps(m[1][0], y)), _mm_add_ps(_mm_mul_ps(m[2][0], z), m[3][0])));
+				_mm_store_ps(ys + j, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][1], x), _mm_mul_ps(m[1][1], y)), _mm_add_ps(_mm_mul_ps(m[2][1], z), m[3][1])));
+				_mm_store_ps(zs + j, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][2], x), _mm_mul_ps(m[1][2], y)), _mm_add_ps(_mm_mul_ps(m[2][2], z), m[3][2])));
+			}
+		}
+
+		//Axii, extents and centers are stored per box, so four boxes are transformed at once.
+		//Half axes are transformed, their lengths become the new extents
+		uint32_t i{ begin };
+		for (; i + 4 <= end; i += 4)
+		{
+			for (int axis{ 0 }; axis < dimensionsNum; ++axis)
+			{
+				float* xsOfAxii{ m_axii + (axis * 3 + 0) * m_maxCount + i };
+				float* ysOfAxii{ m_axii + (axis * 3 + 1) * m_maxCount + i };
+				float* zsOfAxii{ m_axii + (axis * 3 + 2) * m_maxCount + i };
+				float* extents{ m_extents + axis * m_maxCount + i };
+
+				__m128 extent{ _mm_loadu_ps(extents) };
+				__m128 x{ _mm_mul_ps(_mm_loadu_ps(xsOfAxii), extent) };
+				__m128 y{ _mm_mul_ps(_mm_loadu_ps(ysOfAxii), extent) };
+				__m128 z{ _mm_mul_ps(_mm_loadu_ps(zsOfAxii), extent) };
+				__m128 xT{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][0], x), _mm_mul_ps(m[1][0], y)), _mm_mul_ps(m[2][0], z)) };
+				__m128 yT{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][1], x), _mm_mul_ps(m[1][1], y)), _mm_mul_ps(m[2][1], z)) };
+				__m128 zT{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][2], x), _mm_mul_ps(m[1][2], y)), _mm_mul_ps(m[2][2], z)) };
+				__m128 length{ _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(xT, xT), _mm_mul_ps(yT, yT)), _mm_mul_ps(zT, zT))) };
+
+				_mm_storeu_ps(xsOfAxii, _mm_div_ps(xT, length));
+				_mm_storeu_ps(ysOfAxii, _mm_div_ps(yT, length));
+				_mm_storeu_ps(zsOfAxii, _mm_div_ps(zT, length));
+				_mm_storeu_ps(extents, length);
+			}
+
+			float* centersX{ m_centers + 0 * m_maxCount + i };
+			float* centersY{ m_centers + 1 * m_maxCount + i };
+			float* centersZ{ m_centers + 2 * m_maxCount + i };
+			__m128 x{ _mm_loadu_ps(centersX) };
+			__m128 y{ _mm_loadu_ps(centersY) };
+			__m128 z{ _mm_loadu_ps(centersZ) };
+			_mm_storeu_ps(centersX, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][0], x), _mm_mul_ps(m[1][0], y)), _mm_add_ps(_mm_mul_ps(m[2][0], z), m[3][0])));
+			_mm_storeu_ps(centersY, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][1], x), _mm_mul_ps(m[1][1], y)), _mm_add_ps(_mm_mul_ps(m[2][1], z), m[3][1])));
+			_mm_storeu_ps(centersZ, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][2], x), _mm_mul_ps(m[1][2], y)), _mm_add_ps(_mm_mul_ps(m[2][2], z), m[3][2])));
+		}
+		for (; i < end; ++i)
+		{
+			glm::mat3 rotationScale{ transformMatrix };
+			for (int axis{ 0 }; axis < dimensionsNum; ++axis)
+			{
+				float* xOfAxis{ m_axii + (axis * 3 + 0) * m_maxCount + i };
+				float* yOfAxis{ m_axii + (axis * 3 + 1) * m_maxCount + i };
+				float* zOfAxis{ m_axii + (axis * 3 + 2) * m_maxCount + i };
+				float* extent{ m_extents + axis * m_maxCount + i };
+
+				glm::vec3 halfAxis{ rotationScale * (glm::vec3{ *xOfAxis, *yOfAxis, *zOfAxis } * *extent) };
+				*extent = glm::length(halfAxis);
+				halfAxis /= *extent;
+				*xOfAxis = halfAxis.x;
+				*yOfAxis = halfAxis.y;
+				*zOfAxis = halfAxis.z;
+			}
+
+			float* centerX{ m_centers + 0 * m_maxCount + i };
+			float* centerY{ m_centers + 1 * m_maxCount + i };
+			float* centerZ{ m_centers + 2 * m_maxCount + i };
+			glm::vec3 center{ transformMatrix * glm::vec4{ *centerX, *centerY, *centerZ, 1.0f } };
+			*centerX = center.x;
+			*centerY = center.y;
+			*centerZ = center.z;
+		}
+	}
+
 public:
 	enum Position
 	{
@@ -45,6 +180,11 @@ public:
 		m_axii = { new float[dimensionsNum * dimensionsNum * m_maxCount] };
 		m_extents = { new float[dimensionsNum * m_maxCount] };
 		m_centers = { new float[dimensionsNum * m_maxCount] };
+
+		m_localData = { new float[dimensionsNum * boxVertexCount * m_maxCount] };
+		m_localAxii = { new float[dimensionsNum * dimensionsNum * m_maxCount] };
+		m_localExtents = { new float[dimensionsNum * m_maxCount] };
+		m_localCenters = { new float[dimensionsNum * m_maxCount] };
 	}
 	~OBBs()
 	{
@@ -52,7 +192,12 @@ public:
 		delete[] m_axii;
 		delete[] m_extents;
 		delete[] m_centers;
+		delete[] m_localData;
+		delete[] m_localAxii;
+		delete[] m_localExtents;
+		delete[] m_localCenters;
 		delete visOBBPipeline;
+		delete visOBBResSet;
 	}
 
 	uint32_t getBBCount() const
@@ -116,69 +261,77 @@ public:
 		float xDif = xMax - xMin;
 		float yDif = yMax - yMin;
 		float zDif = zMax - zMin;
-		*rad = std::sqrt(xDif * xDif + yDif * yDif + zDif * zDif);
+		//Opposite corners span the diagonal, the sphere only needs half of it
+		*rad = std::sqrt(xDif * xDif + yDif * yDif + zDif * zDif) / 2.0;
 	}
 
-	void transformOBB(int index, const glm::mat4& transformMatrix)
+	void getAABB(int index, glm::vec3& min, glm::vec3& max) const
 	{
-		float* xs = m_data + 0 * boxVertexCount * m_maxCount + boxVertexCount * index;
-		float* ys = m_data + 1 * boxVertexCount * m_maxCount + boxVertexCount * index;
-		float* zs = m_data + 2 * boxVertexCount * m_maxCount + boxVertexCount * index;
-		for (int i{ 0 }; i < ALL_POS; ++i)
+		EASSERT(index < m_count, "App", "Undefined data accessed.");
+
+		float* xs{ m_data + 0 * boxVertexCount * m_maxCount + boxVertexCount * index };
+		float* ys{ m_data + 1 * boxVertexCount * m_maxCount + boxVertexCount * index };
+		float* zs{ m_data + 2 * boxVertexCount * m_maxCount + boxVertexCount * index };
+		min = glm::vec3{ xs[0], ys[0], zs[0] };
+		max = min;
+		for (int i{ 1 }; i < ALL_POS; ++i)
 		{
-			glm::vec3 newPos{ transformMatrix * glm::vec4{xs[i], ys[i], zs[i], 1.0} };
-			xs[i] = newPos.x;
-			ys[i] = newPos.y;
-			zs[i] = newPos.z;
+			min = glm::min(min, glm::vec3{ xs[i], ys[i], zs[i] });
+			max = glm::max(max, glm::vec3{ xs[i], ys[i], zs[i] });
 		}
+	}
 
-		float* xsOfXaxii{ m_axii + 0 * m_maxCount + index };
-		float* ysOfXaxii{ m_axii + 1 * m_maxCount + index };
-		float* zsOfXaxii{ m_axii + 2 * m_maxCount + index };
-
-		float* xsOfYaxii{ m_axii + 3 * m_maxCount + index };
-		float* ysOfYaxii{ m_axii + 4 * m_maxCount + index };
-		float* zsOfYaxii{ m_axii + 5 * m_maxCount + index };
-
-		float* xsOfZaxii{ m_axii + 6 * m_maxCount + index };
-		float* ysOfZaxii{ m_axii + 7 * m_maxCount + index };
-		float* zsOfZaxii{ m_axii + 8 * m_maxCount + index };
-
-		glm::vec3 x{ xs[7] - xs[6], ys[7] - ys[6], zs[7] - zs[6] };
-		glm::vec3 y{ xs[2] - xs[6], ys[2] - ys[6], zs[2] - zs[6] };
-		glm::vec3 z{ xs[4] - xs[6], ys[4] - ys[6], zs[4] - zs[6] };
-
-		glm::vec3 xn{ glm::normalize(x) };
-		glm::vec3 yn{ glm::normalize(y) };
-		glm::vec3 zn{ glm::normalize(z) };
-
-		*xsOfXaxii = xn.x;
-		*ysOfXaxii = xn.y;
-		*zsOfXaxii = xn.z;
-
-		*xsOfYaxii = yn.x;
-		*ysOfYaxii = yn.y;
-		*zsOfYaxii = yn.z;
-
-		*xsOfZaxii = zn.x;
-		*ysOfZaxii = zn.y;
-		*zsOfZaxii = zn.z;
-
-		*(m_extents + 0 * m_maxCount + index) = glm::length(x) / 2.0;
-		*(m_extents + 1 * m_maxCount + index) = glm::length(y) / 2.0;
-		*(m_extents + 2 * m_maxCount + index) = glm::length(z) / 2.0;
-
-		glm::vec3 c{ (xs[1] + xs[6]) / 2.0, (ys[1] + ys[6]) / 2.0, (zs[1] + zs[6]) / 2.0 };
+	void transformOBB(int index, const glm::mat4& transformMatrix)
+	{
+		EASSERT(index < m_count, "App", "Undefined data accessed.");
+		transformOBBRange(index, index + 1, transformMatrix);
+	}
+	//Transforms boxes [first, first + count) by one matrix, the range is split between worker threads
+	void transformOBBs(uint32_t first, uint32_t count, const glm::mat4& transformMatrix)
+	{
+		EASSERT(first + count <= m_count, "App", "Undefined data accessed.");
+		oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<uint32_t>(first, first + count, OBB_TRANSFORM_GRAIN_SIZE),
+			[this, &transformMatrix](const oneapi::tbb::blocked_range<uint32_t>& range)
+			{
+				transformOBBRange(range.begin(), range.end(), transformMatrix);
+			});
+	}
 
-		*(m_centers + 0 * m_maxCount + index) = c.x;
-		*(m_centers + 1 * m_maxCount + index) = c.y;
-		*(m_centers + 2 * m_maxCount + index) = c.z;
+	//Current boxes become the model space bounds used by transformOBBsFromLocal()
+	void storeLocalBounds()
+	{
+		std::memcpy(m_localData, m_data, sizeof(float) * dimensionsNum * boxVertexCount * m_maxCount);
+		std::memcpy(m_localAxii, m_axii, sizeof(float) * dimensionsNum * dimensionsNum * m_maxCount);
+		std::memcpy(m_localExtents, m_extents, sizeof(float) * dimensionsNum * m_maxCount);
+		std::memcpy(m_localCenters, m_centers, sizeof(float) * dimensionsNum * m_maxCount);
+	}
+	//Boxes [first, first + count) are set to their model space bounds transformed by the full model matrix
+	void transformOBBsFromLocal(uint32_t first, uint32_t count, const glm::mat4& modelMatrix)
+	{
+		EASSERT(first + count <= m_count, "App", "Undefined data accessed.");
+		oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<uint32_t>(first, first + count, OBB_TRANSFORM_GRAIN_SIZE),
+			[this, &modelMatrix](const oneapi::tbb::blocked_range<uint32_t>& range)
+			{
+				uint32_t begin{ range.begin() };
+				uint32_t size{ static_cast<uint32_t>(range.size()) };
+				for (int i{ 0 }; i < dimensionsNum; ++i)
+				{
+					std::memcpy(m_data + i * boxVertexCount * m_maxCount + boxVertexCount * begin, m_localData + i * boxVertexCount * m_maxCount + boxVertexCount * begin, sizeof(float) * boxVertexCount * size);
+					std::memcpy(m_extents + i * m_maxCount + begin, m_localExtents + i * m_maxCount + begin, sizeof(float) * size);
+					std::memcpy(m_centers + i * m_maxCount + begin, m_localCenters + i * m_maxCount + begin, sizeof(float) * size);
+				}
+				for (int i{ 0 }; i < dimensionsNum * dimensionsNum; ++i)
+					std::memcpy(m_axii + i * m_maxCount + begin, m_localAxii + i * m_maxCount + begin, sizeof(float) * size);
+
+				transformOBBRange(range.begin(), range.end(), modelMatrix);
+			});
 	}
 
-	//Input data should be ordered like in the enum
+	//Input data should be ordered like in the enum. Growing moves the arrays, so boxes must not be added while pointers from getPointsOBB() or getAxiiOBBs() are held
 	void addOBB(float* obbData)
 	{
-		EASSERT(m_count < m_maxCount, "App", "More OBBs added than space allocated.");
+		if (m_count == m_maxCount)
+			grow();
 
 		float* dataToFillX{ m_data + 0 * boxVertexCount * m_maxCount + boxVertexCount * m_count };
 		float* dataToFillY{ m_data + 1 * boxVertexCount * m_maxCount + boxVertexCount * m_count };
@@ -237,20 +390,15 @@ public:
 	}
 
 	Pipeline* visOBBPipeline{ nullptr };
-	BufferBaseHostAccessible* vb{ nullptr };
-	struct {
-		glm::vec4 xAxis_extent;
-		glm::vec4 yAxis_extent;
-		glm::vec4 zAxis_extent;
-		glm::vec3 center;
-	} pcData;
+	ResourceSet* visOBBResSet{ nullptr };
 public:
-	void initVisualizationResources(VkDevice device, uint32_t wWidth, uint32_t wHeight, const ResourceSet& viewprojRS)
+	//Boxes are drawn from the world space bounds kept on the GPU, colored by the culling status of their draws
+	void initVisualizationResources(VkDevice device, uint32_t wWidth, uint32_t wHeight, const ResourceSet& viewprojRS, const Buffer& worldBounds, const Buffer& drawCullingStatus)
 	{
 		PipelineAssembler assembler{ device };
 		assembler.setDynamicState(PipelineAssembler::DYNAMIC_STATE_DEFAULT);
 		assembler.setViewportState(PipelineAssembler::VIEWPORT_STATE_DEFAULT, wWidth, wHeight, 1);
-		assembler.setInputAssemblyState(PipelineAssembler::INPUT_ASSEMBLY_STATE_POINT);
+		assembler.setInputAssemblyState(PipelineAssembler::INPUT_ASSEMBLY_STATE_LINE_DRAWING);
 		assembler.setTesselationState(PipelineAssembler::TESSELATION_STATE_DEFAULT);
 		assembler.setMultisamplingState(PipelineAssembler::MULTISAMPLING_STATE_DISABLED);
 		assembler.setRasterizationState(PipelineAssembler::RASTERIZATION_STATE_DEFAULT, 1.5f, VK_CULL_MODE_NONE);
@@ -258,28 +406,33 @@ public:
 		assembler.setDepthStencilState(PipelineAssembler::DEPTH_STENCIL_STATE_DEFAULT);
 		assembler.setPipelineRenderingState(PipelineAssembler::PIPELINE_RENDERING_STATE_DEFAULT);
 
-		std::array<std::reference_wrapper<const ResourceSet>, 1> resourceSets{ viewprojRS };
+		VkDescriptorSetLayoutBinding boundsBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
+		VkDescriptorAddressInfoEXT boundsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = worldBounds.getDeviceAddress(), .range = worldBounds.getSize() };
+		VkDescriptorSetLayoutBinding cullingStatusBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
+		VkDescriptorAddressInfoEXT cullingStatusAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = drawCullingStatus.getDeviceAddress(), .range = drawCullingStatus.getSize() };
+		visOBBResSet = { new ResourceSet };
+		visOBBResSet->initializeSet(device, 1, VkDescriptorSetLayoutCreateFlags{},
+			std::array{ boundsBinding, cullingStatusBinding },
+			std::array<VkDescriptorBindingFlags, 0>{},
+			std::vector<std::vector<VkDescriptorDataEXT>>{
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &boundsAddressInfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &cullingStatusAddressInfo} } },
+			false);
+
+		std::array<std::reference_wrapper<const ResourceSet>, 2> resourceSets{ viewprojRS, *visOBBResSet };
 		visOBBPipeline = { new Pipeline };
 		visOBBPipeline->initializeGraphics(assembler,
 			{ {ShaderStage{.stage = VK_SHADER_STAGE_VERTEX_BIT, .filepath = "shaders/cmpld/obb_gen_vert.spv"}, 
-			ShaderStage{.stage = VK_SHADER_STAGE_GEOMETRY_BIT, .filepath = "shaders/cmpld/obb_gen_geom.spv"},
 			ShaderStage{.stage = VK_SHADER_STAGE_FRAGMENT_BIT, .filepath = "shaders/cmpld/color_frag.spv"}} },
-			resourceSets, {}, {},
-			{ {VkPushConstantRange{ .stageFlags = VK_SHADER_STAGE_GEOMETRY_BIT, .offset = 0, .size = sizeof(pcData)}}});
+			resourceSets);
 	}
 
+	//One instance per box, 24 line list vertices for the twelve edges
 	void cmdVisualizeOBBs(VkCommandBuffer cb)
 	{
 		visOBBPipeline->cmdBind(cb);
-		for (int i{ 0 }; i < m_count; ++i)
-		{
-			pcData.center = glm::vec3{ *(m_centers + 0 * m_maxCount + i), *(m_centers + 1 * m_maxCount + i), *(m_centers + 2 * m_maxCount + i) };
-			pcData.xAxis_extent = glm::vec4{ *(m_axii + 0 * m_maxCount + i), *(m_axii + 1 * m_maxCount + i), *(m_axii + 2 * m_maxCount + i), *(m_extents + 0 * m_maxCount + i) };
-			pcData.yAxis_extent = glm::vec4{ *(m_axii + 3 * m_maxCount + i), *(m_axii + 4 * m_maxCount + i), *(m_axii + 5 * m_maxCount + i), *(m_extents + 1 * m_maxCount + i) };
-			pcData.zAxis_extent = glm::vec4{ *(m_axii + 6 * m_maxCount + i), *(m_axii + 7 * m_maxCount + i), *(m_axii + 8 * m_maxCount + i), *(m_extents + 2 * m_maxCount + i) };
-			vkCmdPushConstants(cb, visOBBPipeline->getPipelineLayoutHandle(), VK_SHADER_STAGE_GEOMETRY_BIT, 0, sizeof(pcData), &pcData);
-			vkCmdDraw(cb, 1, 1, 0, 0);
-		}
+		visOBBPipeline->cmdBindResourceSets(cb);
+		vkCmdDraw(cb, 24, m_count, 0, 0);
 	}
 };
 
@@ -0,0 +1,414 @@
+#include "src/rendering/data_abstraction/mesh_simplifier.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cfloat>
+
+#include <glm/glm.hpp>
+
+//Border edges get a plane perpendicular to their triangle so that outlines of open meshes are kept
+#define SIMPLIFIER_BORDER_WEIGHT 10.0
+//Triangles around a collapsed vertex must not turn more than roughly 75 degrees
+#define SIMPLIFIER_FLIP_COS 0.25f
+
+namespace
+{
+	enum VertexKind : uint8_t
+	{
+		VERTEX_KIND_MANIFOLD,
+		VERTEX_KIND_BORDER,
+		//Border vertex on an attribute seam, it has a partner with the same position on the other side of the seam
+		VERTEX_KIND_SEAM,
+		VERTEX_KIND_LOCKED
+	};
+
+	//Symmetric 4x4 matrix of the weighted squared distances to a set of planes
+	struct Quadric
+	{
+		double a00{}, a01{}, a02{}, a03{};
+		double a11{}, a12{}, a13{};
+		double a22{}, a23{};
+		double a33{};
+		double weight{};
+
+		void addPlane(const glm::dvec3& n, double d, double w)
+		{
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+			a22 += w * n.z * n.z; a23 += w * n.z * d;
+			a33 += w * d * d;
+			weight += w;
+		}
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+			weight += q.weight;
+		}
+		//Mean squared distance to the planes
+		double evaluate(const glm::dvec3& p) const
+		{
+			double error{ a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+				+ 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z + a03 * p.x + a13 * p.y + a23 * p.z)
+				+ a33 };
+			return weight > 0.0 ? std::abs(error) / weight : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		uint32_t edgeTriangles;
+		double error;
+	};
+
+	//Triangles using every vertex
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets{};
+		std::vector<uint32_t> triangles{};
+
+		void build(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+		{
+			offsets.assign(vertexCount + 1, 0);
+			for (uint32_t index : indices)
+				++offsets[index + 1];
+			for (uint32_t i{ 0 }; i < vertexCount; ++i)
+				offsets[i + 1] += offsets[i];
+			triangles.resize(indices.size());
+			std::vector<uint32_t> fill{ offsets.begin(), offsets.end() - 1 };
+			for (uint32_t i{ 0 }; i < indices.size(); ++i)
+				triangles[fill[indices[i]]++] = i / 3;
+		}
+		uint32_t begin(uint32_t vertex) const { return offsets[vertex]; }
+		uint32_t end(uint32_t vertex) const { return offsets[vertex + 1]; }
+	};
+
+	//Border edges are used by a single triangle
+	uint32_t countEdgeTriangles(const Adjacency& adjacency, const std::vector<uint32_t>& indices, uint32_t a, uint32_t b)
+	{
+		uint32_t count{ 0 };
+		for (uint32_t i{ adjacency.begin(a) }; i < adjacency.end(a); ++i)
+		{
+			const uint32_t* tri{ indices.data() + adjacency.triangles[i] * 3 };
+			count += (tri[0] == b || tri[1] == b || tri[2] == b) ? 1 : 0;
+		}
+		return count;
+	}
+
+	std::vector<uint8_t> classifyVertices(const std::vector<glm::vec3>& positions, const Adjacency& adjacency, const std::vector<uint32_t>& indices, std::vector<uint32_t>& partners)
+	{
+		uint32_t vertexCount{ static_cast<uint32_t>(positions.size()) };
+		std::vector<uint8_t> kinds(vertexCount, VERTEX_KIND_MANIFOLD);
+		std::vector<uint32_t> borderEdgeCounts(vertexCount, 0);
+		std::vector<uint32_t> borderNeighbours(vertexCount, UINT32_MAX);
+		for (uint32_t i{ 0 }; i < indices.size(); ++i)
+		{
+			uint32_t a{ indices[i] };
+			uint32_t b{ indices[i - i % 3 + (i + 1) % 3] };
+			uint32_t edgeTriangles{ countEdgeTriangles(adjacency, indices, a, b) };
+			if (edgeTriangles == 1)
+			{
+				++borderEdgeCounts[a];
+				++borderEdgeCounts[b];
+				borderNeighbours[a] = b;
+			}
+			else if (edgeTriangles > 2)
+			{
+				kinds[a] = VERTEX_KIND_LOCKED;
+				kinds[b] = VERTEX_KIND_LOCKED;
+			}
+		}
+		//Vertices where several border loops meet can't slide along a single border
+		for (uint32_t i{ 0 }; i < vertexCount; ++i)
+			if (kinds[i] != VERTEX_KIND_LOCKED && borderEdgeCounts[i] != 0)
+				kinds[i] = borderEdgeCounts[i] == 2 ? VERTEX_KIND_BORDER : VERTEX_KIND_LOCKED;
+
+		//Vertices sharing a position pairwise are the two sides of an attribute seam, they are only moved together along the seam.
+		//More than two vertices at one position are seam junctions and stay in place
+		partners.assign(vertexCount, UINT32_MAX);
+		std::vector<uint32_t> order(vertexCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&positions](uint32_t a, uint32_t b)
+			{
+				const glm::vec3& pa{ positions[a] };
+				const glm::vec3& pb{ positions[b] };
+				return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+			});
+		for (uint32_t first{ 0 }, last{ 0 }; first < vertexCount; first = last)
+		{
+			last = first + 1;
+			while (last < vertexCount && positions[order[last]] == positions[order[first]])
+				++last;
+			if (last - first == 2)
+			{
+				uint32_t a{ order[first] };
+				uint32_t b{ order[first + 1] };
+				if (kinds[a] == VERTEX_KIND_BORDER && kinds[b] == VERTEX_KIND_BORDER)
+				{
+					partners[a] = b;
+					partners[b] = a;
+					kinds[a] = VERTEX_KIND_SEAM;
+					kinds[b] = VERTEX_KIND_SEAM;
+					continue;
+				}
+			}
+			for (uint32_t i{ first }; i < last && last - first > 1; ++i)
+				kinds[order[i]] = VERTEX_KIND_LOCKED;
+		}
+		//Where a seam ends inside the surface its two sides meet in a single border vertex, moving it would drag one side across the other
+		for (uint32_t i{ 0 }; i < vertexCount; ++i)
+		{
+			if (kinds[i] != VERTEX_KIND_BORDER)
+				continue;
+			for (uint32_t j{ adjacency.begin(i) }; j < adjacency.end(i); ++j)
+			{
+				const uint32_t* tri{ indices.data() + adjacency.triangles[j] * 3 };
+				for (int k{ 0 }; k < 3; ++k)
+					if (tri[k] != i && tri[k] != borderNeighbours[i] && borderNeighbours[i] != UINT32_MAX && positions[tri[k]] == positions[borderNeighbours[i]] && countEdgeTriangles(adjacency, indices, i, tri[k]) == 1)
+						kinds[i] = VERTEX_KIND_LOCKED;
+			}
+		}
+
+		return kinds;
+	}
+
+	std::vector<Quadric> computeQuadrics(const std::vector<glm::vec3>& positions, const Adjacency& adjacency, const std::vector<uint32_t>& indices)
+	{
+		std::vector<Quadric> quadrics(positions.size());
+		for (uint32_t i{ 0 }; i < indices.size(); i += 3)
+		{
+			glm::dvec3 points[3]{ positions[indices[i + 0]], positions[indices[i + 1]], positions[indices[i + 2]] };
+			glm::dvec3 normal{ glm::cross(points[1] - points[0], points[2] - points[0]) };
+			double doubleArea{ glm::length(normal) };
+			if (doubleArea == 0.0)
+				continue;
+			normal /= doubleArea;
+			for (int k{ 0 }; k < 3; ++k)
+				quadrics[indices[i + k]].addPlane(normal, -glm::dot(normal, points[0]), doubleArea * 0.5);
+
+			for (int k{ 0 }; k < 3; ++k)
+			{
+				uint32_t a{ indices[i + k] };
+				uint32_t b{ indices[i + (k + 1) % 3] };
+				if (countEdgeTriangles(adjacency, indices, a, b) != 1)
+					continue;
+				glm::dvec3 edge{ points[(k + 1) % 3] - points[k] };
+				double edgeLength{ glm::length(edge) };
+				if (edgeLength == 0.0)
+					continue;
+				glm::dvec3 borderNormal{ glm::normalize(glm::cross(edge, normal)) };
+				double borderDistance{ -glm::dot(borderNormal, points[k]) };
+				quadrics[a].addPlane(borderNormal, borderDistance, edgeLength * edgeLength * SIMPLIFIER_BORDER_WEIGHT);
+				quadrics[b].addPlane(borderNormal, borderDistance, edgeLength * edgeLength * SIMPLIFIER_BORDER_WEIGHT);
+			}
+		}
+		return quadrics;
+	}
+
+	//Triangles that keep existing after the collapse must not flip
+	bool isCollapseValid(const Adjacency& adjacency, const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, uint32_t from, uint32_t to)
+	{
+		for (uint32_t i{ adjacency.begin(from) }; i < adjacency.end(from); ++i)
+		{
+			const uint32_t* tri{ indices.data() + adjacency.triangles[i] * 3 };
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+				continue;
+
+			glm::vec3 points[3]{ positions[tri[0]], positions[tri[1]], positions[tri[2]] };
+			glm::vec3 oldNormal{ glm::cross(points[1] - points[0], points[2] - points[0]) };
+			for (int k{ 0 }; k < 3; ++k)
+				if (tri[k] == from)
+					points[k] = positions[to];
+			glm::vec3 newNormal{ glm::cross(points[1] - points[0], points[2] - points[0]) };
+
+			if (glm::dot(oldNormal, newNormal) < SIMPLIFIER_FLIP_COS * glm::length(oldNormal) * glm::length(newNormal))
+				return false;
+		}
+		return true;
+	}
+
+	//Vertices connected to both ends have to be the ones opposite to the edge, otherwise the collapse makes the surface non-manifold
+	bool isLinkValid(const Adjacency& adjacency, const std::vector<uint32_t>& indices, uint32_t from, uint32_t to, uint32_t edgeTriangles, std::vector<uint32_t>& neighbours)
+	{
+		neighbours.clear();
+		for (uint32_t i{ adjacency.begin(from) }; i < adjacency.end(from); ++i)
+		{
+			const uint32_t* tri{ indices.data() + adjacency.triangles[i] * 3 };
+			for (int k{ 0 }; k < 3; ++k)
+				if (tri[k] != from && tri[k] != to)
+					neighbours.push_back(tri[k]);
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+		uint32_t sharedCount{ 0 };
+		for (uint32_t neighbour : neighbours)
+			sharedCount += countEdgeTriangles(adjacency, indices, to, neighbour) != 0 ? 1 : 0;
+		return sharedCount <= edgeTriangles;
+	}
+}
+
+namespace MeshSimplifier
+{
+	std::vector<uint32_t> simplify(const uint8_t* positions, uint32_t positionStride, uint32_t vertexCount,
+		const uint32_t* indices, uint32_t indexCount,
+		uint32_t targetIndexCount, float maxError, float* resultError)
+	{
+		if (resultError)
+			*resultError = 0.0f;
+
+		std::vector<uint32_t> result{};
+		result.reserve(indexCount);
+		for (uint32_t i{ 0 }; i + 2 < indexCount; i += 3)
+		{
+			uint32_t a{ indices[i + 0] };
+			uint32_t b{ indices[i + 1] };
+			uint32_t c{ indices[i + 2] };
+			if (a == b || b == c || a == c)
+				continue;
+			result.push_back(a);
+			result.push_back(b);
+			result.push_back(c);
+		}
+		if (result.size() <= targetIndexCount || vertexCount == 0)
+			return result;
+
+		//Positions are normalized so that the error is relative to the size of the mesh
+		std::vector<glm::vec3> vertexPositions(vertexCount);
+		glm::vec3 min{ FLT_MAX };
+		glm::vec3 max{ -FLT_MAX };
+		for (uint32_t i{ 0 }; i < vertexCount; ++i)
+		{
+			const float* position{ reinterpret_cast<const float*>(positions + static_cast<size_t>(i) * positionStride) };
+			vertexPositions[i] = glm::vec3{ position[0], position[1], position[2] };
+			min = glm::min(min, vertexPositions[i]);
+			max = glm::max(max, vertexPositions[i]);
+		}
+		glm::vec3 extent{ max - min };
+		float largestExtent{ std::max(std::max(extent.x, extent.y), extent.z) };
+		float scale{ largestExtent > 0.0f ? 1.0f / largestExtent : 1.0f };
+		for (glm::vec3& position : vertexPositions)
+			position = (position - min) * scale;
+
+		Adjacency adjacency{};
+		adjacency.build(result, vertexCount);
+		std::vector<uint32_t> partners{};
+		std::vector<uint8_t> kinds{ classifyVertices(vertexPositions, adjacency, result, partners) };
+		std::vector<Quadric> quadrics{ computeQuadrics(vertexPositions, adjacency, result) };
+
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint8_t> touched(vertexCount);
+		std::vector<Collapse> collapses{};
+		std::vector<uint32_t> neighbours{};
+		double maxErrorSquared{ static_cast<double>(maxError) * maxError };
+		double reachedError{ 0.0 };
+		uint32_t triangleCount{ static_cast<uint32_t>(result.size() / 3) };
+		uint32_t targetTriangleCount{ targetIndexCount / 3 };
+
+		//Every pass collapses an independent set of the cheapest edges and rebuilds the adjacency
+		while (triangleCount > targetTriangleCount)
+		{
+			adjacency.build(result, vertexCount);
+
+			collapses.clear();
+			for (uint32_t i{ 0 }; i < result.size(); ++i)
+			{
+				uint32_t a{ result[i] };
+				uint32_t b{ result[i - i % 3 + (i + 1) % 3] };
+				uint32_t edgeTriangles{ countEdgeTriangles(adjacency, result, a, b) };
+				//Interior edges are seen from both of their triangles
+				if (edgeTriangles != 1 && a > b)
+					continue;
+				auto addCollapse{ [&](uint32_t from, uint32_t to)
+					{
+						if (kinds[from] == VERTEX_KIND_LOCKED || (kinds[from] != VERTEX_KIND_MANIFOLD && edgeTriangles != 1))
+							return;
+						//Seam vertices only move along the seam, the other side has to have the matching edge
+						if (kinds[from] == VERTEX_KIND_SEAM && (partners[to] == UINT32_MAX || countEdgeTriangles(adjacency, result, partners[from], partners[to]) != 1))
+							return;
+						Quadric quadric{ quadrics[from] };
+						quadric.add(quadrics[to]);
+						if (kinds[from] == VERTEX_KIND_SEAM)
+						{
+							quadric.add(quadrics[partners[from]]);
+							quadric.add(quadrics[partners[to]]);
+						}
+						collapses.push_back({ .from = from, .to = to, .edgeTriangles = edgeTriangles, .error = quadric.evaluate(vertexPositions[to]) });
+					} };
+				addCollapse(a, b);
+				addCollapse(b, a);
+			}
+			if (collapses.empty())
+				break;
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+			std::iota(remap.begin(), remap.end(), 0);
+			std::fill(touched.begin(), touched.end(), 0);
+			uint32_t removedCount{ 0 };
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.error > maxErrorSquared || triangleCount - removedCount <= targetTriangleCount)
+					break;
+				if (touched[collapse.from] || touched[collapse.to])
+					continue;
+				if (!isCollapseValid(adjacency, result, vertexPositions, collapse.from, collapse.to) || !isLinkValid(adjacency, result, collapse.from, collapse.to, collapse.edgeTriangles, neighbours))
+					continue;
+				//Both sides of a seam collapse in the same pass, so the seam stays closed
+				bool seam{ kinds[collapse.from] == VERTEX_KIND_SEAM };
+				uint32_t partnerFrom{ seam ? partners[collapse.from] : UINT32_MAX };
+				uint32_t partnerTo{ seam ? partners[collapse.to] : UINT32_MAX };
+				if (seam && (touched[partnerFrom] || touched[partnerTo] ||
+					!isCollapseValid(adjacency, result, vertexPositions, partnerFrom, partnerTo) || !isLinkValid(adjacency, result, partnerFrom, partnerTo, 1, neighbours)))
+					continue;
+
+				auto applyCollapse{ [&](uint32_t from, uint32_t to)
+					{
+						remap[from] = to;
+						quadrics[to].add(quadrics[from]);
+						//Triangles around the collapsed vertex are stale until the next pass
+						for (uint32_t i{ adjacency.begin(from) }; i < adjacency.end(from); ++i)
+						{
+							const uint32_t* tri{ result.data() + adjacency.triangles[i] * 3 };
+							touched[tri[0]] = 1;
+							touched[tri[1]] = 1;
+							touched[tri[2]] = 1;
+						}
+					} };
+				applyCollapse(collapse.from, collapse.to);
+				removedCount += collapse.edgeTriangles;
+				if (seam)
+				{
+					applyCollapse(partnerFrom, partnerTo);
+					removedCount += 1;
+				}
+				reachedError = std::max(reachedError, collapse.error);
+			}
+			if (removedCount == 0)
+				break;
+
+			uint32_t writeIndex{ 0 };
+			for (uint32_t i{ 0 }; i < result.size(); i += 3)
+			{
+				uint32_t a{ remap[result[i + 0]] };
+				uint32_t b{ remap[result[i + 1]] };
+				uint32_t c{ remap[result[i + 2]] };
+				if (a == b || b == c || a == c)
+					continue;
+				result[writeIndex++] = a;
+				result[writeIndex++] = b;
+				result[writeIndex++] = c;
+			}
+			result.resize(writeIndex);
+			triangleCount = writeIndex / 3;
+		}
+
+		if (resultError)
+			*resultError = static_cast<float>(std::sqrt(reachedError));
+		return result;
+	}
+}
\ No newline at end of file
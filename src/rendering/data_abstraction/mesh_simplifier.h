@@ -0,0 +1,19 @@
+#ifndef MESH_SIMPLIFIER_HEADER
+#define MESH_SIMPLIFIER_HEADER
+
+#include <cstdint>
+#include <vector>
+
+//Quadric error edge collapse simplification.
+//Vertices are only collapsed into other existing vertices, so simplified index lists keep referencing the source vertex data.
+//Border vertices only slide along the border. Pairs of vertices sharing a position (attribute seams) slide along the seam together, vertices where more than two share a position are never moved.
+namespace MeshSimplifier
+{
+	//Collapses edges until the index count drops to targetIndexCount or the next collapse would exceed maxError.
+	//Error is the distance to the planes of the collapsed triangles relative to the largest extent of the mesh, the reached error is written to resultError.
+	std::vector<uint32_t> simplify(const uint8_t* positions, uint32_t positionStride, uint32_t vertexCount,
+		const uint32_t* indices, uint32_t indexCount,
+		uint32_t targetIndexCount, float maxError, float* resultError = nullptr);
+}
+
+#endif
\ No newline at end of file
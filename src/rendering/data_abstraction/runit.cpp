@@ -1,5 +1,7 @@
 #include "RUnit.h"
 
+#include "src/tools/asserter.h"
+
 RUnit::RUnit(uint64_t vertOff, uint64_t indOff, uint16_t vertexSize, uint16_t indexSize, uint64_t vertBufSize, uint64_t indexBufSize, uint16_t imageListIndex, uint16_t imageListLayerIndex)
     : m_offsetVertex{ vertOff }, m_offsetIndex{ indOff }, m_byteSizeVertices{ vertBufSize }, m_byteSizeIndices{ indexBufSize }, m_vertexSize{ vertexSize }, m_indexSize{ indexSize }
 {
@@ -40,6 +42,30 @@ uint64_t RUnit::getDrawCmdBufferOffset() const
     return m_commandBufferOffset;
 }
 
+uint32_t RUnit::getLODCount() const
+{
+    return m_lodCount;
+}
+
+uint32_t RUnit::getLODIndexCount(uint32_t lod) const
+{
+    EASSERT(lod < m_lodCount, "App", "Undefined LOD accessed.");
+    return lod == 0 ? static_cast<uint32_t>(m_byteSizeIndices / m_indexSize) : m_lodIndexCounts[lod - 1];
+}
+
+uint64_t RUnit::getOffsetLODIndices() const
+{
+    return m_offsetLODIndices;
+}
+
+uint64_t RUnit::getLODIndicesByteSize() const
+{
+    uint64_t indexCount{ 0 };
+    for (uint32_t i{ 1 }; i < m_lodCount; ++i)
+        indexCount += m_lodIndexCounts[i - 1];
+    return indexCount * m_indexSize;
+}
+
 std::array<std::pair<uint16_t, uint16_t>, 4>& RUnit::getMaterialIndices()
 {
     return m_materialIndices;
@@ -80,4 +106,15 @@ void RUnit::setIndexSize(uint16_t size)
 void RUnit::setDrawCmdBufferOffset(uint64_t offset)
 {
     m_commandBufferOffset = offset;
+}
+
+void RUnit::setLODIndexBufOffset(uint64_t offset)
+{
+    m_offsetLODIndices = offset;
+}
+
+void RUnit::addLOD(uint32_t indexCount)
+{
+    EASSERT(m_lodCount < LOD_MAX_COUNT, "App", "Too many LODs.");
+    m_lodIndexCounts[m_lodCount++ - 1] = indexCount;
 }
\ No newline at end of file
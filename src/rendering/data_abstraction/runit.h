@@ -6,6 +6,9 @@
 
 #include <glm/glm.hpp>
 
+//Full detail index range counts as the first LOD
+#define LOD_MAX_COUNT 4
+
 class RUnit
 {
 private:
@@ -19,6 +22,11 @@ private:
 
 	uint64_t m_commandBufferOffset{};
 
+	//Simplified index ranges are stored one after another and share the vertex data of the unit
+	uint64_t m_offsetLODIndices{};
+	std::array<uint32_t, LOD_MAX_COUNT - 1> m_lodIndexCounts{};
+	uint32_t m_lodCount{ 1 };
+
 	std::array<std::pair<uint16_t, uint16_t>, 4> m_materialIndices{};
 
 public:
@@ -33,6 +41,10 @@ public:
 	uint16_t getVertexSize() const;
 	uint16_t getIndexSize() const;
 	uint64_t getDrawCmdBufferOffset() const;
+	uint32_t getLODCount() const;
+	uint32_t getLODIndexCount(uint32_t lod) const;
+	uint64_t getOffsetLODIndices() const;
+	uint64_t getLODIndicesByteSize() const;
 
 	std::array<std::pair<uint16_t, uint16_t>, 4>& getMaterialIndices();
 
@@ -43,6 +55,8 @@ public:
 	void setVertexSize(uint16_t size);
 	void setIndexSize(uint16_t size);
 	void setDrawCmdBufferOffset(uint64_t offset);
+	void setLODIndexBufOffset(uint64_t offset);
+	void addLOD(uint32_t indexCount);
 };
 
 #endif
\ No newline at end of file
@@ -1,3 +1,6 @@
+#include <cstring>
+#include <algorithm>
+
 #include "buffer_class.h"
 #include "src/tools/logging.h"
 #include "src/tools/asserter.h"
@@ -49,7 +52,12 @@ BufferBase::BufferBase(VkDevice device, const VkBufferCreateInfo& bufferCI, bool
 	std::list<VmaAllocation>::iterator allocationIter{ m_memoryManager->addAllocation() };
 	m_bufferAllocIter = allocationIter;
 
-	EASSERT(vmaCreateBuffer(m_memoryManager->getAllocator(), &bufferCI, &allocCI, &m_bufferHandle, &(*allocationIter), nullptr) == VK_SUCCESS, "VMA", "Buffer creation failed.")
+	m_memoryManager->createBuffer(bufferCI, allocCI, m_bufferHandle, *allocationIter);
+
+	m_device = device;
+	m_bufferUsage = bufferCI.usage;
+	if (bufferCI.sharingMode == VK_SHARING_MODE_CONCURRENT)
+		m_queueFamilyIndices.assign(bufferCI.pQueueFamilyIndices, bufferCI.pQueueFamilyIndices + bufferCI.queueFamilyIndexCount);
 
 	m_memoryByteSize = bufferCI.size;
 	if (bufferCI.usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
@@ -76,6 +84,9 @@ BufferBase::BufferBase(BufferBase&& bufBase) noexcept
 	this->m_bufferMemoryAddress =	bufBase.m_bufferMemoryAddress;
 	this->m_memoryByteSize		=	bufBase.m_memoryByteSize;
 	this->m_bufferAlignment		=	bufBase.m_bufferAlignment;
+	this->m_device				=	bufBase.m_device;
+	this->m_bufferUsage			=	bufBase.m_bufferUsage;
+	this->m_queueFamilyIndices	=	std::move(bufBase.m_queueFamilyIndices);
 
 	bufBase.m_invalid = true;
 }
@@ -164,6 +175,40 @@ BufferBaseHostInaccessible::BufferBaseHostInaccessible(VkDevice device, VkDevice
 BufferBaseHostInaccessible::~BufferBaseHostInaccessible()
 {
 }
+void BufferBaseHostInaccessible::setMovable(std::function<void()> onMoved)
+{
+	EASSERT((m_bufferUsage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (m_bufferUsage & VK_BUFFER_USAGE_TRANSFER_DST_BIT), "App", "Movable device buffers need transfer source and destination usage.");
+
+	m_memoryManager->setMovable(*m_bufferAllocIter, [this, onMoved](VmaAllocation dstTmpAllocation, VkCommandBuffer cb) -> std::function<void()>
+		{
+			VkBufferCreateInfo bufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			bufferCI.size = m_memoryByteSize;
+			bufferCI.usage = m_bufferUsage;
+			bufferCI.sharingMode = m_queueFamilyIndices.empty() ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT;
+			bufferCI.queueFamilyIndexCount = static_cast<uint32_t>(m_queueFamilyIndices.size());
+			bufferCI.pQueueFamilyIndices = m_queueFamilyIndices.data();
+			VkBuffer newBuffer{};
+			EASSERT(vkCreateBuffer(m_device, &bufferCI, nullptr, &newBuffer) == VK_SUCCESS, "Vulkan", "Buffer creation failed.");
+			EASSERT(vmaBindBufferMemory(m_memoryManager->getAllocator(), dstTmpAllocation, newBuffer) == VK_SUCCESS, "VMA", "Buffer memory binding failed.");
+
+			VkBufferCopy region{ .srcOffset = 0, .dstOffset = 0, .size = m_memoryByteSize };
+			BufferTools::cmdBufferCopy(cb, m_bufferHandle, newBuffer, 1, &region);
+
+			VkBuffer oldBuffer{ m_bufferHandle };
+			m_bufferHandle = newBuffer;
+			if (m_bufferUsage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+			{
+				VkBufferDeviceAddressInfo devicAddrInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = m_bufferHandle };
+				m_bufferMemoryAddress = vkGetBufferDeviceAddress(m_device, &devicAddrInfo);
+			}
+			onMoved();
+
+			return [this, oldBuffer]()
+				{
+					vkDestroyBuffer(m_device, oldBuffer, nullptr);
+				};
+		});
+}
 
 Buffer::Buffer() : m_invalid{ true }
 {
@@ -177,12 +222,10 @@ Buffer::Buffer(BufferBaseHostInaccessible& motherBuffer, VkDeviceSize size) : m_
 }
 Buffer::Buffer(Buffer&& srcBuffer) noexcept
 	: m_motherBuffer{ srcBuffer.m_motherBuffer },
-		m_bufferHandle{ srcBuffer.m_bufferHandle },
-			m_deviceAddress{ srcBuffer.m_deviceAddress },
-				m_bufferOffset{ srcBuffer.m_bufferOffset }, 
-					m_bufferSize{ srcBuffer.m_bufferSize },
-						m_allocation{ srcBuffer.m_allocation },
-							m_invalid{ false }
+		m_bufferOffset{ srcBuffer.m_bufferOffset }, 
+			m_bufferSize{ srcBuffer.m_bufferSize },
+				m_allocation{ srcBuffer.m_allocation },
+					m_invalid{ false }
 {
 	srcBuffer.m_invalid = true;
 }
@@ -195,7 +238,8 @@ Buffer::~Buffer()
 }
 VkBuffer Buffer::getBufferHandle() const
 {
-	return m_bufferHandle;
+	//Queried from the mother buffer as it can be moved by defragmentation
+	return m_motherBuffer != nullptr ? m_motherBuffer->getBufferHandle() : VK_NULL_HANDLE;
 }
 VkDeviceSize Buffer::getSize() const
 {
@@ -207,7 +251,7 @@ VkDeviceSize Buffer::getOffset() const
 }
 VkDeviceAddress Buffer::getDeviceAddress() const
 {
-	return m_deviceAddress;
+	return m_motherBuffer != nullptr ? m_motherBuffer->getDeviceAddress() + m_bufferOffset : 0;
 }
 VkDeviceSize Buffer::getAlignment() const
 {
@@ -230,10 +274,8 @@ void Buffer::initialize(VkDeviceSize size)
 
 	if (m_invalid)
 	{
-		m_bufferHandle = m_motherBuffer->getBufferHandle();
 		m_bufferSize = size;
 		m_motherBuffer->allocateFromBuffer(size, m_allocation, m_bufferOffset);
-		m_deviceAddress = m_motherBuffer->getDeviceAddress() + m_bufferOffset;
 
 		m_invalid = false;
 	}
@@ -295,8 +337,17 @@ BufferBaseHostAccessible::BufferBaseHostAccessible(BufferBaseHostAccessible&& sr
 	this->m_memoryByteSize = srcBuffer.m_memoryByteSize;
 	this->m_bufferAlignment = srcBuffer.m_bufferAlignment;
 	this->m_mappedMemoryPointer = srcBuffer.m_mappedMemoryPointer;
+	this->m_device = srcBuffer.m_device;
+	this->m_bufferUsage = srcBuffer.m_bufferUsage;
+	this->m_queueFamilyIndices = std::move(srcBuffer.m_queueFamilyIndices);
+	this->m_movable = srcBuffer.m_movable;
+	this->m_suballocations = std::move(srcBuffer.m_suballocations);
+	this->m_freedSinceCompaction = srcBuffer.m_freedSinceCompaction;
 
 	srcBuffer.m_invalid = true;
+
+	if (m_movable)
+		registerMove();
 }
 BufferBaseHostAccessible::~BufferBaseHostAccessible()
 {
@@ -330,6 +381,108 @@ void* BufferBaseHostAccessible::getData()
 
 	return m_mappedMemoryPointer;
 }
+void BufferBaseHostAccessible::setMovable()
+{
+	if (!m_movable)
+	{
+		m_movable = true;
+		registerMove();
+	}
+}
+bool BufferBaseHostAccessible::needsCompaction() const
+{
+	if (m_freedSinceCompaction == 0)
+		return false;
+
+	VmaDetailedStatistics stats{};
+	vmaCalculateVirtualBlockStatistics(m_memoryProxy, &stats);
+	VkDeviceSize freeBytes{ stats.statistics.blockBytes - stats.statistics.allocationBytes };
+	return stats.unusedRangeCount > 1 && stats.unusedRangeSizeMax < freeBytes / 2;
+}
+void BufferBaseHostAccessible::compact()
+{
+	//Lowest offsets first, every range is freed and placed at the lowest offset that fits it, which is never above its old one
+	std::vector<BufferMapped*> suballocations{ m_suballocations.begin(), m_suballocations.end() };
+	std::sort(suballocations.begin(), suballocations.end(), [](const BufferMapped* a, const BufferMapped* b) { return a->m_bufferOffset < b->m_bufferOffset; });
+
+	uint8_t* data{ reinterpret_cast<uint8_t*>(getData()) };
+	uint32_t movedCount{ 0 };
+	VkDeviceSize movedBytes{ 0 };
+	for (auto suballocation : suballocations)
+	{
+		if (!suballocation->m_movable)
+			continue;
+
+		freeBufferAllocation(suballocation->m_allocation);
+		VmaVirtualAllocationCreateInfo allocCI{ .size = suballocation->m_bufferSize, .alignment = m_bufferAlignment, .flags = VMA_VIRTUAL_ALLOCATION_CREATE_STRATEGY_MIN_OFFSET_BIT };
+		VkDeviceSize newOffset{};
+		EASSERT(vmaVirtualAllocate(m_memoryProxy, &allocCI, &suballocation->m_allocation, &newOffset) == VK_SUCCESS, "VMA", "Suballocation could not be placed back. || Should never happen.");
+		if (newOffset == suballocation->m_bufferOffset)
+			continue;
+
+		//The new range can overlap the old one
+		std::memmove(data + newOffset, data + suballocation->m_bufferOffset, suballocation->m_bufferSize);
+		suballocation->m_bufferHandle = m_bufferHandle;
+		suballocation->m_bufferOffset = newOffset;
+		suballocation->m_deviceAddress = m_bufferMemoryAddress + newOffset;
+		suballocation->m_dataPtr = data + newOffset;
+		suballocation->m_onMoved();
+
+		++movedCount;
+		movedBytes += suballocation->m_bufferSize;
+	}
+	m_freedSinceCompaction = 0;
+
+	LOG_INFO("Buffer compacted, {} suballocations of {} bytes moved.", movedCount, movedBytes);
+}
+std::list<BufferMapped*>::iterator BufferBaseHostAccessible::addSuballocation(BufferMapped* owner, VkDeviceSize size, VmaVirtualAllocation& allocation, VkDeviceSize& inBufferOffset)
+{
+	allocateFromBuffer(size, allocation, inBufferOffset);
+	return m_suballocations.insert(m_suballocations.end(), owner);
+}
+void BufferBaseHostAccessible::removeSuballocation(std::list<BufferMapped*>::iterator suballocationIter, VmaVirtualAllocation allocation, VkDeviceSize size)
+{
+	freeBufferAllocation(allocation);
+	m_suballocations.erase(suballocationIter);
+	m_freedSinceCompaction += size;
+}
+void BufferBaseHostAccessible::registerMove()
+{
+	m_memoryManager->setMovable(*m_bufferAllocIter, [this](VmaAllocation dstTmpAllocation, VkCommandBuffer) -> std::function<void()>
+		{
+			VkBufferCreateInfo bufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			bufferCI.size = m_memoryByteSize;
+			bufferCI.usage = m_bufferUsage;
+			bufferCI.sharingMode = m_queueFamilyIndices.empty() ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT;
+			bufferCI.queueFamilyIndexCount = static_cast<uint32_t>(m_queueFamilyIndices.size());
+			bufferCI.pQueueFamilyIndices = m_queueFamilyIndices.data();
+			VkBuffer newBuffer{};
+			EASSERT(vkCreateBuffer(m_device, &bufferCI, nullptr, &newBuffer) == VK_SUCCESS, "Vulkan", "Buffer creation failed.");
+			EASSERT(vmaBindBufferMemory(m_memoryManager->getAllocator(), dstTmpAllocation, newBuffer) == VK_SUCCESS, "VMA", "Buffer memory binding failed.");
+
+			//Memory is host visible so the contents are copied on the CPU. Writes made before the pass ends already go to the destination
+			void* dstData{ nullptr };
+			EASSERT(vmaMapMemory(m_memoryManager->getAllocator(), dstTmpAllocation, &dstData) == VK_SUCCESS, "VMA", "Memory mapping failed.");
+			std::memcpy(dstData, getData(), m_memoryByteSize);
+			m_mappedMemoryPointer = dstData;
+
+			VkBuffer oldBuffer{ m_bufferHandle };
+			m_bufferHandle = newBuffer;
+			if (m_bufferUsage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+			{
+				VkBufferDeviceAddressInfo devicAddrInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = m_bufferHandle };
+				m_bufferMemoryAddress = vkGetBufferDeviceAddress(m_device, &devicAddrInfo);
+			}
+
+			return [this, oldBuffer, dstTmpAllocation]()
+				{
+					vkDestroyBuffer(m_device, oldBuffer, nullptr);
+					//Both mappings are dropped before the pass ends, the next getData() maps the allocation at its new place
+					vmaUnmapMemory(m_memoryManager->getAllocator(), dstTmpAllocation);
+					unmapMemory();
+				};
+		});
+}
 
 BufferMapped::BufferMapped() : m_invalid{ true }
 {
@@ -347,15 +500,23 @@ BufferMapped::BufferMapped(BufferMapped&& srcBuffer) noexcept
 			m_deviceAddress{ srcBuffer.m_deviceAddress },
 				m_bufferOffset{ srcBuffer.m_bufferOffset },
 					m_bufferSize{ srcBuffer.m_bufferSize },
-						m_allocation{ srcBuffer.m_allocation }
-{
+						m_dataPtr{ srcBuffer.m_dataPtr },
+							m_allocation{ srcBuffer.m_allocation },
+								m_suballocationIter{ srcBuffer.m_suballocationIter },
+									m_onMoved{ std::move(srcBuffer.m_onMoved) },
+										m_movable{ srcBuffer.m_movable },
+											m_invalid{ srcBuffer.m_invalid }
+{
+	//The mother buffer's list has to point at the new owner
+	if (!m_invalid)
+		*m_suballocationIter = this;
 	srcBuffer.m_invalid = true;
 }
 BufferMapped::~BufferMapped()
 {
 	if (!m_invalid)
 	{
-		m_motherBuffer->freeBufferAllocation(m_allocation);
+		m_motherBuffer->removeSuballocation(m_suballocationIter, m_allocation, m_bufferSize);
 	}
 }
 VkBuffer BufferMapped::getBufferHandle() const
@@ -401,7 +562,7 @@ void BufferMapped::initialize(VkDeviceSize size)
 	{
 		m_bufferHandle = m_motherBuffer->getBufferHandle();
 		m_bufferSize = size;
-		m_motherBuffer->allocateFromBuffer(size, m_allocation, m_bufferOffset);
+		m_suballocationIter = m_motherBuffer->addSuballocation(this, size, m_allocation, m_bufferOffset);
 		m_deviceAddress = m_motherBuffer->getDeviceAddress() + m_bufferOffset;
 
 		m_dataPtr = reinterpret_cast<void*>(reinterpret_cast<uint8_t*>(m_motherBuffer->getData()) + m_bufferOffset);
@@ -413,7 +574,12 @@ void BufferMapped::reset()
 {
 	if (!m_invalid)
 	{
-		m_motherBuffer->freeBufferAllocation(m_allocation);
+		m_motherBuffer->removeSuballocation(m_suballocationIter, m_allocation, m_bufferSize);
 	}
 	m_invalid = true;
+}
+void BufferMapped::setMovable(std::function<void()> onMoved)
+{
+	m_onMoved = std::move(onMoved);
+	m_movable = true;
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <list>
 #include <cassert>
 #include <span>
+#include <vector>
+#include <functional>
 
 #include <vulkan/vulkan.h>
 #include <vma/vk_mem_alloc.h>
@@ -25,6 +27,10 @@ protected:
 	VkDeviceSize m_memoryByteSize{};
 	VkDeviceSize m_bufferAlignment{};
 
+	VkDevice m_device{};
+	VkBufferUsageFlags m_bufferUsage{};
+	std::vector<uint32_t> m_queueFamilyIndices{};
+
 	std::list<VmaAllocation>::const_iterator m_bufferAllocIter{};
 	inline static MemoryManager* m_memoryManager{ nullptr };
 
@@ -72,6 +78,9 @@ public:
 	BufferBaseHostInaccessible(BufferBaseHostInaccessible&& srcBuffer) = default;
 	~BufferBaseHostInaccessible();
 
+	//Lets defragmentation relocate the buffer with a GPU copy. Suballocations follow the new handle and address, onMoved has to update everything that baked them in
+	void setMovable(std::function<void()> onMoved);
+
 protected:
 
 	friend class BufferMapped;
@@ -80,8 +89,6 @@ protected:
 class Buffer
 {
 private:
-	VkBuffer m_bufferHandle{};
-	VkDeviceAddress m_deviceAddress{};
 	VkDeviceSize m_bufferOffset{};
 	VkDeviceSize m_bufferSize{};
 
@@ -112,10 +119,17 @@ public:
 };
 
 
+class BufferMapped;
+
 class BufferBaseHostAccessible : public BufferBase
 {
 private:
 	void* m_mappedMemoryPointer{ nullptr };
+	bool m_movable{ false };
+
+	//Every suballocation is owned by a BufferMapped, compaction moves them and updates their offsets
+	std::list<BufferMapped*> m_suballocations{};
+	VkDeviceSize m_freedSinceCompaction{ 0 };
 
 public:
 	BufferBaseHostAccessible(VkDevice device, const VkBufferCreateInfo& bufferCreateInfo, int allocFlags = NULL_FLAG, bool useSharedMemory = false, bool memoryIsCached = false);
@@ -129,7 +143,21 @@ public:
 
 	void* getData();
 
+	//Lets defragmentation relocate the buffer. Handle, device address and mapped pointer change, so users have to query them every frame instead of caching them
+	void setMovable();
+
+	//Free ranges are fragmented when memory was freed since the last compaction and the largest free range holds less than half of the free memory
+	bool needsCompaction() const;
+	//Moves movable suballocations to the lowest free offsets, suballocations that aren't movable stay in place. The buffer must not be in use by the GPU
+	void compact();
+
 	friend class BufferMapped;
+
+private:
+	void registerMove();
+
+	std::list<BufferMapped*>::iterator addSuballocation(BufferMapped* owner, VkDeviceSize size, VmaVirtualAllocation& allocation, VkDeviceSize& inBufferOffset);
+	void removeSuballocation(std::list<BufferMapped*>::iterator suballocationIter, VmaVirtualAllocation allocation, VkDeviceSize size);
 };
 
 class BufferMapped
@@ -143,6 +171,10 @@ private:
 
 	BufferBaseHostAccessible* m_motherBuffer{ nullptr };
 	VmaVirtualAllocation m_allocation{};
+	std::list<BufferMapped*>::iterator m_suballocationIter{};
+
+	std::function<void()> m_onMoved{};
+	bool m_movable{ false };
 
 	bool m_invalid{ true };
 
@@ -165,7 +197,12 @@ public:
 
 	void reset();
 
+	//Lets compaction of the mother buffer move the range. Offset, device address and data pointer change, onMoved has to update everything that baked them in
+	void setMovable(std::function<void()> onMoved);
+
 	void operator=(BufferMapped&) = delete;
+
+	friend class BufferBaseHostAccessible;
 };
 
 #endif
\ No newline at end of file
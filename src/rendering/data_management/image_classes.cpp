@@ -100,9 +100,14 @@ void Image::initialize(VkDevice device,
 		allocCI.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
 
 		auto allocationIter{ m_memoryManager->addAllocation() };
-		EASSERT(vmaCreateImage(m_memoryManager->getAllocator(), &imageCI, &allocCI, &m_imageHandle, &(*allocationIter), nullptr) == VK_SUCCESS, "VMA", "Image creation failed.");
+		m_memoryManager->createImage(imageCI, allocCI, m_imageHandle, *allocationIter);
 		m_imageAllocIter = allocationIter;
 
+		//Kept to recreate the image when it is moved
+		m_queueFamilyIndices.assign(queueFamilyIndices, queueFamilyIndices + imageCI.queueFamilyIndexCount);
+		m_imageCI = imageCI;
+		m_imageCI.pQueueFamilyIndices = nullptr;
+
 		m_aspects = imageAspects;
 
 		VkImageViewCreateInfo imageViewCI{};
@@ -129,6 +134,8 @@ Image::Image(Image&& src) noexcept
 	m_depth = src.m_depth;
 	m_mipLevelCount = src.m_mipLevelCount;
 	m_aspects = src.m_aspects;
+	m_imageCI = src.m_imageCI;
+	m_queueFamilyIndices = std::move(src.m_queueFamilyIndices);
 
 	m_imageAllocIter = src.m_imageAllocIter;
 
@@ -156,6 +163,78 @@ VkImageAspectFlags Image::getAspects() const
 	return m_aspects;
 }
 
+void Image::setMovable(VkImageLayout restingLayout, std::function<void()> onMoved)
+{
+	EASSERT((m_imageCI.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) && (m_imageCI.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT), "App", "Movable images need transfer source and destination usage.");
+
+	m_memoryManager->setMovable(*m_imageAllocIter, [this, restingLayout, onMoved](VmaAllocation dstTmpAllocation, VkCommandBuffer cb) -> std::function<void()>
+		{
+			VkDevice device{ m_memoryManager->m_device };
+
+			VkImageCreateInfo imageCI{ m_imageCI };
+			imageCI.queueFamilyIndexCount = static_cast<uint32_t>(m_queueFamilyIndices.size());
+			imageCI.pQueueFamilyIndices = m_queueFamilyIndices.data();
+			VkImage newImage{};
+			EASSERT(vkCreateImage(device, &imageCI, nullptr, &newImage) == VK_SUCCESS, "Vulkan", "Image creation failed.");
+			EASSERT(vmaBindImageMemory(m_memoryManager->getAllocator(), dstTmpAllocation, newImage) == VK_SUCCESS, "VMA", "Image memory binding failed.");
+
+			VkImageSubresourceRange range{ .aspectMask = m_aspects, .baseMipLevel = 0, .levelCount = m_mipLevelCount, .baseArrayLayer = 0, .layerCount = 1 };
+			VkImageMemoryBarrier2 copyBarriers[2] = {
+				SyncOperations::constructImageBarrier(
+					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+					restingLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					m_imageHandle,
+					range),
+				SyncOperations::constructImageBarrier(
+					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+					0, VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					newImage,
+					range)
+			};
+			SyncOperations::cmdExecuteBarrier(cb, std::span<VkImageMemoryBarrier2>{copyBarriers, copyBarriers + 2});
+
+			std::vector<VkImageCopy> regions(m_mipLevelCount);
+			for (uint32_t i{ 0 }; i < m_mipLevelCount; ++i)
+			{
+				regions[i].srcSubresource = VkImageSubresourceLayers{ .aspectMask = m_aspects, .mipLevel = i, .baseArrayLayer = 0, .layerCount = 1 };
+				regions[i].dstSubresource = regions[i].srcSubresource;
+				regions[i].extent = { .width = std::max(m_width >> i, 1u), .height = std::max(m_height >> i, 1u), .depth = std::max(m_depth >> i, 1u) };
+			}
+			vkCmdCopyImage(cb, m_imageHandle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+			SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructImageBarrier(
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, restingLayout,
+				newImage,
+				range)} });
+
+			VkImageViewCreateInfo imageViewCI{};
+			imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			imageViewCI.image = newImage;
+			imageViewCI.format = m_format;
+			imageViewCI.viewType = m_depth == 1 ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_3D;
+			imageViewCI.components = { .r = VK_COMPONENT_SWIZZLE_R, .g = VK_COMPONENT_SWIZZLE_G, .b = VK_COMPONENT_SWIZZLE_B, .a = VK_COMPONENT_SWIZZLE_A };
+			imageViewCI.subresourceRange = range;
+			VkImageView newView{};
+			EASSERT(vkCreateImageView(device, &imageViewCI, nullptr, &newView) == VK_SUCCESS, "Vulkan", "Image view creation failed.");
+
+			VkImage oldImage{ m_imageHandle };
+			VkImageView oldView{ m_imageViewHandle };
+			m_imageHandle = newImage;
+			m_imageViewHandle = newView;
+			onMoved();
+
+			return [device, oldImage, oldView]()
+				{
+					vkDestroyImageView(device, oldView, nullptr);
+					vkDestroyImage(device, oldImage, nullptr);
+				};
+		});
+}
+
 void Image::cmdCreateMipmaps(VkCommandBuffer cb, VkImageLayout currentImageLayout)
 {
 	if (m_mipLevelCount <= 1 || (m_width == 1 && m_height == 1 && m_depth == 1))
@@ -299,7 +378,7 @@ ImageList::ImageList(VkDevice device, uint32_t width, uint32_t height, VkFormat
 	allocCI.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
 
 	auto allocationIter{ m_memoryManager->addAllocation() };
-	EASSERT(vmaCreateImage(m_memoryManager->getAllocator(), &imageCI, &allocCI, &m_imageHandle, &(*allocationIter), nullptr) == VK_SUCCESS, "VMA", "Image creation failed.");
+	m_memoryManager->createImage(imageCI, allocCI, m_imageHandle, *allocationIter);
 	m_imageAllocIter = allocationIter;
 
 	m_aspects = aspects;
@@ -610,7 +689,7 @@ ImageCubeMap::ImageCubeMap(VkDevice device, VkFormat format, uint32_t sideLength
 	allocCI.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
 
 	auto allocationIter{ m_memoryManager->addAllocation() };
-	EASSERT(vmaCreateImage(m_memoryManager->getAllocator(), &imageCI, &allocCI, &m_imageHandle, &(*allocationIter), nullptr) == VK_SUCCESS, "VMA", "Image creation failed.");
+	m_memoryManager->createImage(imageCI, allocCI, m_imageHandle, *allocationIter);
 	m_imageAllocIter = allocationIter;
 
 	VkImageViewCreateInfo imageViewCI{};
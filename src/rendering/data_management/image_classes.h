@@ -3,6 +3,8 @@
 
 #include <list>
 #include <deque>
+#include <vector>
+#include <functional>
 
 #include <vulkan/vulkan.h>
 #include <vma/vk_mem_alloc.h>
@@ -69,6 +71,9 @@ private:
 	uint32_t m_depth{};
 	VkImageAspectFlags m_aspects{};
 
+	VkImageCreateInfo m_imageCI{};
+	std::vector<uint32_t> m_queueFamilyIndices{};
+
 public:
 	enum QueueAccessMask
 	{
@@ -102,6 +107,10 @@ public:
 
 	void cmdCopyDataFromBuffer(VkCommandBuffer cb, VkBuffer srcBuffer, VkDeviceSize bufferOffset, int xOffset, int yOffset, uint32_t width, uint32_t height, uint32_t mipLevel = 0);
 	void cmdCopyDataFromBuffer(VkCommandBuffer cb, VkBuffer srcBuffer, uint32_t mipCount, VkDeviceSize* bufferOffset);
+
+	//Lets defragmentation relocate the image with a GPU copy. The image has to be in restingLayout between frames and have transfer source and destination usage.
+	//Image and view handles change, onMoved has to rewrite the descriptors using them
+	void setMovable(VkImageLayout restingLayout, std::function<void()> onMoved);
 };
 
 class ImageList : public ImageBase
@@ -201,6 +210,7 @@ public:
 	int getImageListCount() const { return m_imageLists.size(); }
 	VkImageSubresourceRange getImageListSubresourceRange(uint32_t index) const { return m_imageLists[index].list.getSubresourceRange();  };
 	void getImageListResolution(uint32_t listIndex, uint32_t& width, uint32_t& height) { width = m_imageLists[listIndex].list.getWidth(); height = m_imageLists[listIndex].list.getHeight(); };
+	VkFormat getImageListFormat(uint32_t listIndex) const { return m_imageLists[listIndex].list.getFormat(); };
 
 	[[nodiscard]] ImageListContainerIndices getNewImage(int width, int height, VkFormat format);
 	void freeImage(ImageListContainerIndices indices);
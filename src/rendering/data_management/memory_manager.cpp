@@ -1,10 +1,12 @@
 #include "memory_manager.h"
+#include "src/rendering/renderer/sync_operations.h"
 #include "src/tools/asserter.h"
+#include "src/tools/logging.h"
 
 MemoryManager::MemoryManager(const VulkanObjectHandler& vulkanObjects) : m_physDevLimits{ vulkanObjects.getPhysDevLimits() }
 {
 	VmaAllocatorCreateInfo createInfo{};
-	createInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+	createInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT | VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 	createInfo.instance = vulkanObjects.getInstance();
 	createInfo.physicalDevice = vulkanObjects.getPhysicalDevice();
 	createInfo.device = vulkanObjects.getLogicalDevice();
@@ -32,9 +34,103 @@ MemoryManager::MemoryManager(const VulkanObjectHandler& vulkanObjects) : m_physD
 
 MemoryManager::~MemoryManager()
 {
+	if (m_defragmentationContext != VK_NULL_HANDLE)
+	{
+		if (m_passPending)
+			vmaEndDefragmentationPass(m_allocator, m_defragmentationContext, &m_passInfo);
+		vmaEndDefragmentation(m_allocator, m_defragmentationContext, nullptr);
+	}
 	vmaDestroyAllocator(m_allocator);
 }
 
+void MemoryManager::updateBudget(uint32_t frameIndex)
+{
+	vmaSetCurrentFrameIndex(m_allocator, frameIndex);
+
+	const VkPhysicalDeviceMemoryProperties* memProperties{};
+	vmaGetMemoryProperties(m_allocator, &memProperties);
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+	vmaGetHeapBudgets(m_allocator, budgets);
+
+	m_heapBudgets.resize(memProperties->memoryHeapCount);
+	for (uint32_t i{ 0 }; i < memProperties->memoryHeapCount; ++i)
+	{
+		m_heapBudgets[i] = {
+			.usage = budgets[i].usage,
+			.budget = budgets[i].budget,
+			.allocationBytes = budgets[i].statistics.allocationBytes,
+			.deviceLocal = (memProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0 };
+	}
+}
+
+void MemoryManager::beginDefragmentation()
+{
+	if (m_defragmentationContext != VK_NULL_HANDLE)
+		return;
+
+	VmaDefragmentationInfo defragmentationInfo{};
+	defragmentationInfo.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+	defragmentationInfo.maxBytesPerPass = DEFRAGMENTATION_MAX_BYTES_PER_PASS;
+	defragmentationInfo.maxAllocationsPerPass = DEFRAGMENTATION_MAX_ALLOCATIONS_PER_PASS;
+	EASSERT(vmaBeginDefragmentation(m_allocator, &defragmentationInfo, &m_defragmentationContext) == VK_SUCCESS, "VMA", "Defragmentation begin failed.");
+	m_defragmentationStats = {};
+}
+
+void MemoryManager::cmdDefragmentationPass(VkCommandBuffer cb)
+{
+	if (m_defragmentationContext == VK_NULL_HANDLE || m_passPending)
+		return;
+
+	m_passInfo = {};
+	if (vmaBeginDefragmentationPass(m_allocator, m_defragmentationContext, &m_passInfo) == VK_SUCCESS)
+	{
+		finishDefragmentation();
+		return;
+	}
+
+	//Writes of earlier frames have to be visible to the copies, and the copies to the next frame
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT)} });
+	//Resources without a handler are left in place
+	for (uint32_t i{ 0 }; i < m_passInfo.moveCount; ++i)
+	{
+		VmaDefragmentationMove& move{ m_passInfo.pMoves[i] };
+		auto handler{ m_movableAllocations.find(move.srcAllocation) };
+		if (handler == m_movableAllocations.end())
+			move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+		else
+			m_passCleanups.push_back(handler->second(move.dstTmpAllocation, cb));
+	}
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT)} });
+	m_passPending = true;
+}
+
+void MemoryManager::endDefragmentationPass()
+{
+	if (!m_passPending)
+		return;
+
+	//Source memory is only released by VMA when the pass ends, so the old contents stay intact until the frame reading them is done
+	for (auto& cleanup : m_passCleanups)
+		cleanup();
+	m_passCleanups.clear();
+	m_passPending = false;
+
+	if (vmaEndDefragmentationPass(m_allocator, m_defragmentationContext, &m_passInfo) == VK_SUCCESS)
+		finishDefragmentation();
+}
+
+void MemoryManager::finishDefragmentation()
+{
+	vmaEndDefragmentation(m_allocator, m_defragmentationContext, &m_defragmentationStats);
+	m_defragmentationContext = VK_NULL_HANDLE;
+	LOG_INFO("Defragmentation finished: {} allocations moved, {} bytes moved, {} bytes and {} device memory blocks freed.",
+		m_defragmentationStats.allocationsMoved, m_defragmentationStats.bytesMoved, m_defragmentationStats.bytesFreed, m_defragmentationStats.deviceMemoryBlocksFreed);
+}
+
 VmaAllocator MemoryManager::getAllocator()
 {
 	return m_allocator;
@@ -45,8 +141,57 @@ std::list<VmaAllocation>::iterator MemoryManager::addAllocation()
 	return m_allocations.insert(m_allocations.end(), VmaAllocation{});
 }
 
+void MemoryManager::createBuffer(const VkBufferCreateInfo& bufferCI, const VmaAllocationCreateInfo& allocCI, VkBuffer& buffer, VmaAllocation& allocation)
+{
+	VmaAllocationCreateInfo budgetAllocCI{ allocCI };
+	budgetAllocCI.flags |= VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+	VkResult result{ vmaCreateBuffer(m_allocator, &bufferCI, &budgetAllocCI, &buffer, &allocation, nullptr) };
+	if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY)
+	{
+		VmaAllocationCreateInfo fallbackAllocCI{ allocCI };
+		fallbackAllocCI.requiredFlags &= ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		fallbackAllocCI.memoryTypeBits = 0;
+		if (fallbackAllocCI.usage == VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
+			fallbackAllocCI.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+		result = vmaCreateBuffer(m_allocator, &bufferCI, &fallbackAllocCI, &buffer, &allocation, nullptr);
+		++m_budgetFallbackCount;
+		LOG_WARNING("Buffer of {} bytes exceeds the memory budget and is placed in system memory.", bufferCI.size);
+	}
+	EASSERT(result == VK_SUCCESS, "VMA", "Buffer creation failed.");
+}
+
+void MemoryManager::createImage(const VkImageCreateInfo& imageCI, const VmaAllocationCreateInfo& allocCI, VkImage& image, VmaAllocation& allocation)
+{
+	VmaAllocationCreateInfo budgetAllocCI{ allocCI };
+	budgetAllocCI.flags |= VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+	VkResult result{ vmaCreateImage(m_allocator, &imageCI, &budgetAllocCI, &image, &allocation, nullptr) };
+	if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY)
+	{
+		VmaAllocationCreateInfo fallbackAllocCI{ allocCI };
+		fallbackAllocCI.requiredFlags &= ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		fallbackAllocCI.memoryTypeBits = 0;
+		if (fallbackAllocCI.usage == VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
+			fallbackAllocCI.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+		result = vmaCreateImage(m_allocator, &imageCI, &fallbackAllocCI, &image, &allocation, nullptr);
+		++m_budgetFallbackCount;
+		LOG_WARNING("Image of {}x{} exceeds the memory budget and is placed in system memory.", imageCI.extent.width, imageCI.extent.height);
+	}
+	EASSERT(result == VK_SUCCESS, "VMA", "Image creation failed.");
+}
+
+void MemoryManager::setMovable(VmaAllocation allocation, const MoveHandler& moveHandler)
+{
+	m_movableAllocations[allocation] = moveHandler;
+}
+
+void MemoryManager::removeMovable(VmaAllocation allocation)
+{
+	m_movableAllocations.erase(allocation);
+}
+
 void MemoryManager::destroyBuffer(VkBuffer buffer, std::list<VmaAllocation>::const_iterator allocIter)
 {
+	removeMovable(*allocIter);
 	vmaDestroyBuffer(m_allocator, buffer, *(allocIter));
 
 	m_allocations.erase(allocIter);
@@ -54,6 +199,7 @@ void MemoryManager::destroyBuffer(VkBuffer buffer, std::list<VmaAllocation>::con
 
 void MemoryManager::destroyImage(VkImage image, std::list<VmaAllocation>::const_iterator allocIter)
 {
+	removeMovable(*allocIter);
 	vmaDestroyImage(m_allocator, image, *(allocIter));
 
 	m_allocations.erase(allocIter);
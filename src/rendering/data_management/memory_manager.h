@@ -5,12 +5,18 @@
 #include <cassert>
 #include <cstdint>
 #include <list>
+#include <vector>
+#include <functional>
+#include <unordered_map>
 
 #include <vulkan/vulkan.h>
 #include <vma/vk_mem_alloc.h>
 
 #include "src/rendering/vulkan_object_handling/vulkan_object_handler.h"
 
+#define DEFRAGMENTATION_MAX_BYTES_PER_PASS 33554432ll
+#define DEFRAGMENTATION_MAX_ALLOCATIONS_PER_PASS 16
+
 class ResourceSet;
 
 class [[nodiscard]] MemoryManager
@@ -28,14 +34,55 @@ private:
 	uint32_t m_computeQueueFamilyIndex{};
 	uint32_t m_transferQueueFamilyIndex{};
 
+public:
+	struct HeapBudget
+	{
+		VkDeviceSize usage;
+		VkDeviceSize budget;
+		VkDeviceSize allocationBytes;
+		bool deviceLocal;
+	};
+
+	//Moves the resource to dstTmpAllocation, GPU copies are recorded into cb. Returns a cleanup that releases the source once the pass has been executed
+	typedef std::function<std::function<void()>(VmaAllocation dstTmpAllocation, VkCommandBuffer cb)> MoveHandler;
+
+private:
+	std::vector<HeapBudget> m_heapBudgets{};
+	uint32_t m_budgetFallbackCount{ 0 };
+
+	VmaDefragmentationContext m_defragmentationContext{ VK_NULL_HANDLE };
+	VmaDefragmentationStats m_defragmentationStats{};
+	std::unordered_map<VmaAllocation, MoveHandler> m_movableAllocations{};
+	VmaDefragmentationPassMoveInfo m_passInfo{};
+	std::vector<std::function<void()>> m_passCleanups{};
+	bool m_passPending{ false };
+
 public:
 	MemoryManager() = delete;
 	MemoryManager(const VulkanObjectHandler& vulkanObjects);
 	~MemoryManager();
 
+	void updateBudget(uint32_t frameIndex);
+	const std::vector<HeapBudget>& getHeapBudgets() const { return m_heapBudgets; }
+	uint32_t getBudgetFallbackCount() const { return m_budgetFallbackCount; }
+
+	//Defragmentation is incremental with one pass per frame. A pass is recorded between frames and submitted ahead of the next frame on the graphics queue,
+	//its sources are released by endDefragmentationPass() once that frame has finished
+	void beginDefragmentation();
+	void cmdDefragmentationPass(VkCommandBuffer cb);
+	void endDefragmentationPass();
+	bool isDefragmenting() const { return m_defragmentationContext != VK_NULL_HANDLE; }
+	const VmaDefragmentationStats& getDefragmentationStats() const { return m_defragmentationStats; }
+
 private:
+	void finishDefragmentation();
 	VmaAllocator getAllocator();
 	std::list<VmaAllocation>::iterator addAllocation();
+	//Allocations are made within the heap budget and fall back to system memory if it would be exceeded
+	void createBuffer(const VkBufferCreateInfo& bufferCI, const VmaAllocationCreateInfo& allocCI, VkBuffer& buffer, VmaAllocation& allocation);
+	void createImage(const VkImageCreateInfo& imageCI, const VmaAllocationCreateInfo& allocCI, VkImage& image, VmaAllocation& allocation);
+	void setMovable(VmaAllocation allocation, const MoveHandler& moveHandler);
+	void removeMovable(VmaAllocation allocation);
 	void destroyBuffer(VkBuffer buffer, std::list<VmaAllocation>::const_iterator allocIter);
 	void destroyImage(VkImage image, std::list<VmaAllocation>::const_iterator allocIter);
 
@@ -48,6 +95,7 @@ private:
 	friend class ImageCubeMap;
 	friend class DescriptorManager;
 	friend class ResourceSet;
+	friend class RenderGraph;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "ring_allocator.h"
+
+#include "src/tools/asserter.h"
+#include "src/tools/alignment.h"
+#include "src/tools/logging.h"
+
+RingAllocator::RingAllocator(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, TimelineSemaphore& frameSemaphore)
+	: m_buffer{ device, ALIGNED_SIZE(size, RING_ALLOCATOR_MAX_ALIGNMENT), usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT }, m_size{ ALIGNED_SIZE(size, RING_ALLOCATOR_MAX_ALIGNMENT) },
+	m_frameSemaphore{ frameSemaphore }
+{
+	m_buffer.setMovable();
+}
+
+RingAllocator::Allocation RingAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	EASSERT(alignment != 0 && alignment <= RING_ALLOCATOR_MAX_ALIGNMENT && (RING_ALLOCATOR_MAX_ALIGNMENT % alignment) == 0, "App", "Unsupported ring allocation alignment: " << alignment);
+	if (size > m_size)
+	{
+		LOG_WARNING("Ring allocation of {} bytes is bigger than the ring.", size);
+		m_failedAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		return Allocation{};
+	}
+
+	uint64_t head{ m_head.load(std::memory_order_relaxed) };
+	uint64_t begin{};
+	uint64_t end{};
+	while (true)
+	{
+		begin = ALIGNED_SIZE(head, alignment);
+		//Allocations never straddle the end of the ring
+		uint64_t physicalOffset{ begin % m_size };
+		if (physicalOffset + size > m_size)
+			begin += m_size - physicalOffset;
+		end = begin + size;
+		if (end - m_tail.load(std::memory_order_acquire) > m_size)
+		{
+			if (!waitForSpace(end))
+			{
+				LOG_WARNING("Ring allocator overflow. The current frame uses more than {} bytes.", m_size);
+				m_failedAllocationCount.fetch_add(1, std::memory_order_relaxed);
+				return Allocation{};
+			}
+			head = m_head.load(std::memory_order_relaxed);
+			continue;
+		}
+		if (m_head.compare_exchange_weak(head, end, std::memory_order_relaxed))
+			break;
+	}
+
+	VkDeviceSize offset{ begin % m_size };
+	return Allocation{ .data = reinterpret_cast<uint8_t*>(m_buffer.getData()) + offset, .buffer = m_buffer.getBufferHandle(), .offset = offset, .size = size, .deviceAddress = m_buffer.getDeviceAddress() + offset };
+}
+
+//Stalls on the oldest frames in flight until the range up to end is free. Only the ranges of the frame being recorded are left when it fails
+bool RingAllocator::waitForSpace(uint64_t end)
+{
+	std::lock_guard lock{ m_framesMutex };
+	while (end - m_tail.load(std::memory_order_acquire) > m_size && !m_frames.empty())
+	{
+		m_stallCount.fetch_add(1, std::memory_order_relaxed);
+		m_frameSemaphore.wait(m_frames.front().timelineValue);
+		m_tail.store(m_frames.front().end, std::memory_order_release);
+		m_frames.pop_front();
+	}
+	return end - m_tail.load(std::memory_order_acquire) <= m_size;
+}
+
+void RingAllocator::endFrame(uint64_t timelineValue)
+{
+	std::lock_guard lock{ m_framesMutex };
+	m_frames.push_back({ .timelineValue = timelineValue, .end = m_head.load(std::memory_order_relaxed) });
+}
+
+void RingAllocator::reclaim(uint64_t completedTimelineValue)
+{
+	std::lock_guard lock{ m_framesMutex };
+	while (!m_frames.empty() && m_frames.front().timelineValue <= completedTimelineValue)
+	{
+		m_tail.store(m_frames.front().end, std::memory_order_release);
+		m_frames.pop_front();
+	}
+}
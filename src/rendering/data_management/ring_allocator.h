@@ -0,0 +1,86 @@
+#ifndef RING_ALLOCATOR_HEADER
+#define RING_ALLOCATOR_HEADER
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <cstring>
+
+#include <vulkan/vulkan.h>
+
+#include "src/rendering/data_management/buffer_class.h"
+#include "src/rendering/renderer/timeline_semaphore.h"
+
+#define RING_ALLOCATOR_MAX_ALIGNMENT 256
+
+//Lock-free linear allocator over a persistently mapped host-visible ring buffer for data that lives for one frame.
+//allocate() can be called from any thread, ranges of a frame are reclaimed once the timeline value the frame was tagged with completes.
+//The ring buffer can be relocated by defragmentation between frames, so allocations must not outlive the frame.
+//When the ring is full allocate() waits for the oldest frame in flight, if the current frame alone doesn't fit the returned allocation has no data.
+class RingAllocator
+{
+public:
+	struct Allocation
+	{
+		void* data;
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		VkDeviceAddress deviceAddress;
+
+		bool failed() const { return data == nullptr; }
+	};
+
+private:
+	struct FrameMark
+	{
+		uint64_t timelineValue;
+		uint64_t end;
+	};
+
+	BufferBaseHostAccessible m_buffer;
+	VkDeviceSize m_size{};
+	TimelineSemaphore& m_frameSemaphore;
+
+	//Offsets grow monotonically, the physical offset is the remainder of the ring size
+	std::atomic<uint64_t> m_head{ 0 };
+	std::atomic<uint64_t> m_tail{ 0 };
+	//Frame marks are only touched on the main thread, except when a full ring makes allocate() wait for frames
+	std::mutex m_framesMutex{};
+	std::deque<FrameMark> m_frames{};
+	std::atomic<uint32_t> m_stallCount{ 0 };
+	std::atomic<uint32_t> m_failedAllocationCount{ 0 };
+
+	bool waitForSpace(uint64_t end);
+
+public:
+	RingAllocator(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, TimelineSemaphore& frameSemaphore);
+	~RingAllocator() = default;
+
+	Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+	template<typename T>
+	Allocation push(std::span<const T> data, VkDeviceSize alignment = alignof(T))
+	{
+		Allocation allocation{ allocate(data.size_bytes(), alignment) };
+		if (!allocation.failed())
+			std::memcpy(allocation.data, data.data(), data.size_bytes());
+		return allocation;
+	}
+
+	//Tags everything allocated since the previous call with the value the frame's submission signals
+	void endFrame(uint64_t timelineValue);
+	void reclaim(uint64_t completedTimelineValue);
+
+	VkBuffer getBufferHandle() const { return m_buffer.getBufferHandle(); }
+	VkDeviceAddress getDeviceAddress() const { return m_buffer.getDeviceAddress(); }
+	VkDeviceSize getSize() const { return m_size; }
+	VkDeviceSize getUsedSize() const { return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_relaxed); }
+	uint32_t getStallCount() const { return m_stallCount.load(std::memory_order_relaxed); }
+	uint32_t getFailedAllocationCount() const { return m_failedAllocationCount.load(std::memory_order_relaxed); }
+
+	RingAllocator(RingAllocator&) = delete;
+	void operator=(RingAllocator&) = delete;
+};
+
+#endif
@@ -4,6 +4,8 @@
 #include <vector>
 #include <list>
 #include <algorithm>
+#include <bit>
+#include <optional>
 #include <intrin.h>
 
 #include <vulkan/vulkan.h>
@@ -12,18 +14,35 @@
 #include <glm/gtx/transform.hpp>
 
 #include "src/rendering/renderer/pipeline_management.h"
+#include "src/rendering/renderer/command_management.h"
 #include "src/rendering/vulkan_object_handling/vulkan_object_handler.h"
 #include "src/rendering/renderer/clusterer.h"
 #include "src/rendering/renderer/culling.h"
 #include "src/rendering/data_management/image_classes.h"
 #include "src/rendering/data_management/buffer_class.h"
+#include "src/rendering/data_management/ring_allocator.h"
 #include "src/rendering/data_abstraction/BB.h"
 
 #include "src/tools/time_measurement.h"
+#include "src/tools/timestamp_queries.h"
+#include "src/tools/logging.h"
 
 #define MAX_POINT_LIGHT_SHADOWS 64
 #define MAX_SPOT_LIGHT_SHADOWS 64
 
+//Every shadowed light needs one view, point light views test all six faces at once
+#define MAX_SHADOW_CULLING_VIEWS (MAX_POINT_LIGHT_SHADOWS + MAX_SPOT_LIGHT_SHADOWS)
+#define SPOT_LIGHT_CULLING_VIEW 0
+#define CUBE_CULLING_VIEW 1
+
+#define CUBE_FACE_MASK_SHIFT 24
+#define CUBE_DRAW_INDEX_MASK ((1u << CUBE_FACE_MASK_SHIFT) - 1)
+
+//CPU-culled passes with at least this many draws are recorded into secondary command buffers in parallel.
+//GPU-culled passes record a single indirect draw per light and are kept in the primary buffer
+#define SHADOW_SECONDARY_CB_MIN_DRAWS 512
+#define SHADOW_SECONDARY_CB_DRAWS 128
+
 class ShadowCaster
 {
 private:
@@ -34,14 +53,18 @@ private:
 	{
 		ImageListContainer::ImageListContainerIndices shadowMapIndices{};
 		uint32_t drawsIndex{};
+		uint32_t cullingViewIndex{};
 		uint32_t viewMatIndex{};
 		float proj00{};
+		glm::vec3 lightPos{};
 	};
 	struct ShadowCubeMapInfo
 	{
 		ImageListContainer::ImageListContainerIndices shadowMapIndices{};
-		uint32_t drawsFirstIndex{};
+		uint32_t drawsIndex{};
+		uint32_t cullingViewIndex{};
 		uint32_t viewMatIndex{};
+		glm::vec3 lightPos{};
 	};
 	std::vector<ShadowMapInfo> m_indicesForShadowMaps{};
 	std::vector<ShadowCubeMapInfo> m_indicesForShadowCubeMaps{};
@@ -51,34 +74,97 @@ private:
 	bool m_newLightsAdded{ false };
 	uint32_t m_viewMatCount{ 0 };
 	const uint32_t m_shadowMapsLayerCount{ 0 };
-	BufferBaseHostAccessible m_shadowMapViewMatrices;
+	//Written whenever a shadowed light moves and pushed to the frame allocator every frame, so frames in flight keep reading their own copy
+	std::vector<glm::mat4> m_shadowMapViewMatrices{};
+	std::vector<std::pair<const ResourceSet*, uint32_t>> m_viewMatrixSets{};
 	BufferMapped* const m_indirectDrawCmdData{ nullptr };
+	const BufferMapped* const m_drawLODData{ nullptr };
+
+	struct CullingView
+	{
+		glm::vec4 lightSphere{};
+		glm::vec3 lightPos{};
+		uint32_t type{};
+		float proj00{};
+		//std430 rounds the struct up to the alignment of vec4
+		float pad[3]{};
+	};
+	const uint32_t m_culledDrawStride{ 0 };
+	RingAllocator* const m_frameAllocator{ nullptr };
+	BufferBaseHostInaccessible m_cullingOutput;
+	Buffer m_culledDrawCommands{};
+	Buffer m_culledDrawDataIndices{};
+	Buffer m_culledDrawCounts{};
+	uint32_t m_cullingViewCount{ 0 };
+	bool m_gpuCulling{ true };
+	VkMemoryBarrier2 m_cullingBarrier{};
+#ifdef _DEBUG
+	BufferBaseHostAccessible m_cullingReadback;
+	struct CullingValidationEntry
+	{
+		uint32_t drawsIndex{};
+		uint32_t cullingViewIndex{};
+		bool cube{};
+	};
+	std::vector<CullingValidationEntry> m_cullingValidationEntries{};
+#endif
 
 	VkDependencyInfo m_dependency{};
 
 	OBBs* m_rUnitsBoundingBoxes{};
 
 	ResourceSet m_resSet{};
+	ResourceSet m_cullingResSet{};
 
 	Pipeline m_shadowMapPass{};
+	Pipeline m_shadowMapPassIndirect{};
+	Pipeline m_shadowCasterCulling{};
 
 	Clusterer* const m_clusterer{ nullptr };
 
 	struct { float far{}; float near{}; float cubeProj00{}; float proj22{}; float proj32{}; } m_frustumData{};
 
+	struct ShadowPassPushConstants { int32_t layer; uint32_t drawDataIndex; float proj00; float proj11; float proj22; float proj32; uint32_t viewMatrixIndex; uint32_t faceMask; };
+	struct ShadowDraw
+	{
+		ShadowPassPushConstants pcData;
+		uint32_t indexCount;
+		uint32_t instanceCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t firstInstance;
+	};
+	std::vector<ShadowDraw> m_shadowDraws{};
+
 public:
 	ShadowCaster(VkDevice device, Clusterer& clusterer,
 		ImageListContainer& shadowMaps,
 		std::vector<ImageList>& shadowCubeMaps,
 		BufferMapped& indirectDrawCmdData,
-		const BufferMapped& modelTransformData,
+		const BufferMapped& drawLODData,
+		const Buffer& modelTransformData,
 		const BufferMapped& drawData,
-		OBBs& boundingBoxes) :
-			m_shadowMaps{ shadowMaps }, m_shadowCubeMaps{ shadowCubeMaps }, m_device{ device }, m_clusterer{ &clusterer }, m_indirectDrawCmdData{ &indirectDrawCmdData },
-			m_shadowMapViewMatrices{ device, sizeof(glm::mat4) * (MAX_POINT_LIGHT_SHADOWS * 6 + MAX_SPOT_LIGHT_SHADOWS), 
-			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, BufferBase::NULL_FLAG, false, true }, m_rUnitsBoundingBoxes{ &boundingBoxes },
-			m_shadowMapsLayerCount{ m_shadowMaps.getMaxImageListLayerCount()}
+		OBBs& boundingBoxes,
+		RingAllocator& frameAllocator) :
+			m_shadowMaps{ shadowMaps }, m_shadowCubeMaps{ shadowCubeMaps }, m_device{ device }, m_clusterer{ &clusterer }, m_indirectDrawCmdData{ &indirectDrawCmdData }, m_drawLODData{ &drawLODData },
+			m_shadowMapViewMatrices(MAX_POINT_LIGHT_SHADOWS * 6 + MAX_SPOT_LIGHT_SHADOWS), m_rUnitsBoundingBoxes{ &boundingBoxes },
+			m_shadowMapsLayerCount{ m_shadowMaps.getMaxImageListLayerCount()},
+			m_culledDrawStride{ boundingBoxes.getBBCount() },
+			m_frameAllocator{ &frameAllocator },
+			m_cullingOutput{ device, (sizeof(VkDrawIndexedIndirectCommand) + sizeof(uint32_t)) * boundingBoxes.getBBCount() * MAX_SHADOW_CULLING_VIEWS + sizeof(uint32_t) * MAX_SHADOW_CULLING_VIEWS + 512,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT }
+#ifdef _DEBUG
+			, m_cullingReadback{ device, sizeof(uint32_t) * (boundingBoxes.getBBCount() + 1) * MAX_SHADOW_CULLING_VIEWS, VK_BUFFER_USAGE_TRANSFER_DST_BIT, BufferBase::NULL_FLAG, false, true }
+#endif
 	{
+		m_culledDrawCommands.initialize(m_cullingOutput, sizeof(VkDrawIndexedIndirectCommand) * m_culledDrawStride * MAX_SHADOW_CULLING_VIEWS);
+		m_culledDrawDataIndices.initialize(m_cullingOutput, sizeof(uint32_t) * m_culledDrawStride * MAX_SHADOW_CULLING_VIEWS);
+		m_culledDrawCounts.initialize(m_cullingOutput, sizeof(uint32_t) * MAX_SHADOW_CULLING_VIEWS);
+
+		m_cullingBarrier = SyncOperations::constructMemoryBarrier(
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
 		PipelineAssembler assembler{ device };
 		assembler.setDynamicState(PipelineAssembler::DYNAMIC_STATE_VIEWPORT);
 		assembler.setViewportState(PipelineAssembler::VIEWPORT_STATE_DYNAMIC);
@@ -91,7 +177,7 @@ public:
 		assembler.setPipelineRenderingState(PipelineAssembler::PIPELINE_RENDERING_STATE_DEPTH_ATTACHMENT_ONLY);
 
 		VkDescriptorSetLayoutBinding shadowMapViewMatricesBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
-		VkDescriptorAddressInfoEXT shadowMapViewMatricesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_shadowMapViewMatrices.getDeviceAddress(), .range = m_shadowMapViewMatrices.getSize() };
+		VkDescriptorAddressInfoEXT shadowMapViewMatricesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = frameAllocator.getDeviceAddress(), .range = getShadowViewMatricesMaxSize() };
 
 		VkDescriptorSetLayoutBinding modelTransformBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
 		VkDescriptorAddressInfoEXT modelTransformAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = modelTransformData.getDeviceAddress(), .range = modelTransformData.getSize() };
@@ -99,20 +185,58 @@ public:
 		VkDescriptorSetLayoutBinding drawDataBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
 		VkDescriptorAddressInfoEXT drawDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = drawData.getDeviceAddress(), .range = drawData.getSize() };
 
+		VkDescriptorSetLayoutBinding culledDrawDataIndicesBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorAddressInfoEXT culledDrawDataIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_culledDrawDataIndices.getDeviceAddress(), .range = m_culledDrawDataIndices.getSize() };
+
 		m_resSet.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlags{},
-			std::array{ shadowMapViewMatricesBinding, modelTransformBinding, drawDataBinding }, std::array<VkDescriptorBindingFlags, 0>{},
+			std::array{ shadowMapViewMatricesBinding, modelTransformBinding, drawDataBinding, culledDrawDataIndicesBinding }, std::array<VkDescriptorBindingFlags, 0>{},
 			std::vector<std::vector<VkDescriptorDataEXT>>{
 				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &shadowMapViewMatricesAddressInfo} },
 				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &modelTransformAddressInfo} },
-				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawDataAddressInfo} }},
-			false);
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawDataAddressInfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &culledDrawDataIndicesAddressInfo} }},
+			false, true);
+
+		VkDescriptorSetLayoutBinding cmdAndSpheresBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorAddressInfoEXT cmdAndSpheresAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = indirectDrawCmdData.getDeviceAddress(), .range = indirectDrawCmdData.getSize() };
+
+		VkDescriptorSetLayoutBinding cullingViewsBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorAddressInfoEXT cullingViewsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = frameAllocator.getDeviceAddress(), .range = sizeof(CullingView) * MAX_SHADOW_CULLING_VIEWS };
+
+		VkDescriptorSetLayoutBinding culledCmdsBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorAddressInfoEXT culledCmdsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_culledDrawCommands.getDeviceAddress(), .range = m_culledDrawCommands.getSize() };
+
+		VkDescriptorSetLayoutBinding culledCountsBinding{ .binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorAddressInfoEXT culledCountsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_culledDrawCounts.getDeviceAddress(), .range = m_culledDrawCounts.getSize() };
+
+		VkDescriptorSetLayoutBinding drawLODsBinding{ .binding = 5, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorAddressInfoEXT drawLODsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = drawLODData.getDeviceAddress(), .range = drawLODData.getSize() };
+
+		m_cullingResSet.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlags{},
+			std::array{ cmdAndSpheresBinding, cullingViewsBinding, culledCmdsBinding, culledDrawDataIndicesBinding, culledCountsBinding, drawLODsBinding }, std::array<VkDescriptorBindingFlags, 0>{},
+			std::vector<std::vector<VkDescriptorDataEXT>>{
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &cmdAndSpheresAddressInfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &cullingViewsAddressInfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &culledCmdsAddressInfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &culledDrawDataIndicesAddressInfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &culledCountsAddressInfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawLODsAddressInfo} }},
+			false, true);
 
 		std::array<std::reference_wrapper<const ResourceSet>, 1> resourceSets{ m_resSet };
 
 		m_shadowMapPass.initializeGraphics(assembler, { {ShaderStage{ VK_SHADER_STAGE_VERTEX_BIT, "shaders/cmpld/shadow_pass_vert.spv"}} }, 
 			resourceSets,
 			{ {StaticVertex::getBindingDescription()} }, { {StaticVertex::getAttributeDescriptions()[0]} }, 
-			{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(uint32_t) * 7}}});
+			{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(uint32_t) * 8}}});
+		m_shadowMapPassIndirect.initializeGraphics(assembler, { {ShaderStage{ VK_SHADER_STAGE_VERTEX_BIT, "shaders/cmpld/shadow_pass_indirect_vert.spv"}} }, 
+			resourceSets,
+			{ {StaticVertex::getBindingDescription()} }, { {StaticVertex::getAttributeDescriptions()[0]} }, 
+			{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(uint32_t) * 8}}});
+
+		std::array<std::reference_wrapper<const ResourceSet>, 1> cullingResourceSets{ m_cullingResSet };
+		m_shadowCasterCulling.initializaCompute(device, "shaders/cmpld/shadow_caster_culling_comp.spv", cullingResourceSets,
+			{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(uint32_t) * 2}} });
 	}
 	~ShadowCaster()
 	{
@@ -131,6 +255,41 @@ public:
 
 	void prepareDataForShadowMapRendering()
 	{
+		RingAllocator::Allocation viewMatricesAllocation{ m_frameAllocator->push(std::span<const glm::mat4>{ m_shadowMapViewMatrices.data(), std::max(m_viewMatCount, 1u) }, RING_ALLOCATOR_MAX_ALIGNMENT) };
+		if (viewMatricesAllocation.failed())
+		{
+			//Shadow maps keep their previous contents, sampling reads the matrix range of an earlier frame
+			LOG_WARNING("Shadow view matrices don't fit into the frame allocator, shadow maps are not rendered this frame.");
+			m_cullingViewCount = 0;
+			return;
+		}
+		VkDescriptorAddressInfoEXT viewMatricesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = viewMatricesAllocation.deviceAddress, .range = viewMatricesAllocation.size };
+		m_resSet.rewriteDescriptor(0, 0, 0, { .pStorageBuffer = &viewMatricesAddressInfo });
+		for (auto& [set, binding] : m_viewMatrixSets)
+			set->rewriteDescriptor(binding, 0, 0, { .pStorageBuffer = &viewMatricesAddressInfo });
+
+		//Culling views are rewritten every frame, so they are taken from the frame allocator and the descriptor is pointed at the new range
+		RingAllocator::Allocation cullingViewsAllocation{ m_frameAllocator->allocate(sizeof(CullingView) * MAX_SHADOW_CULLING_VIEWS, RING_ALLOCATOR_MAX_ALIGNMENT) };
+		if (cullingViewsAllocation.failed())
+		{
+			//Without culling views this frame falls back to CPU culling, setGPUCulling() restores the mode on the next frame
+			LOG_WARNING("Shadow culling views don't fit into the frame allocator, culling on the CPU.");
+			m_gpuCulling = false;
+		}
+		else
+		{
+			VkDescriptorAddressInfoEXT cullingViewsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = cullingViewsAllocation.deviceAddress, .range = cullingViewsAllocation.size };
+			m_cullingResSet.rewriteDescriptor(1, 0, 0, { .pStorageBuffer = &cullingViewsAddressInfo });
+		}
+		CullingView* cullingViews{ reinterpret_cast<CullingView*>(cullingViewsAllocation.data) };
+		m_cullingViewCount = 0;
+		bool cpuCulling{ !m_gpuCulling };
+#ifdef _DEBUG
+		//CPU result is kept to validate the GPU one
+		cpuCulling = true;
+		m_cullingValidationEntries.clear();
+#endif
+
 		for (int i{ 0 }, drawCommandVectorIndex{ 0 }; i < m_clusterer->m_nonculledLightsCount; ++i)
 		{
 			uint32_t index{ m_clusterer->m_nonculledLightsData[i].index };
@@ -140,25 +299,47 @@ public:
 			if (light.shadowListIndex == -1)
 				continue;
 
+			glm::vec4 boundingSphere{ m_clusterer->m_boundingSpheres[index] };
 			if (type == Clusterer::LightFormat::TYPE_SPOT)
 			{
 				m_indicesForShadowMaps.push_back(
 					{.shadowMapIndices = {.listIndex = static_cast<uint16_t>(light.shadowListIndex), .layerIndex = static_cast<uint16_t>(light.shadowLayerIndex)},
 					.drawsIndex = static_cast<uint32_t>(drawCommandVectorIndex),
+					.cullingViewIndex = m_cullingViewCount,
 					.viewMatIndex = static_cast<uint32_t>(light.shadowMatrixIndex),
-					.proj00 = light.cutoffCos / (std::sqrt(1 - light.cutoffCos * light.cutoffCos))});
-				glm::vec4 boundingSphere{ m_clusterer->m_boundingSpheres[index] };
-				cullMeshesSpot(glm::vec3{boundingSphere}, boundingSphere.w, m_drawCommandIndices[drawCommandVectorIndex++]);
+					.proj00 = light.cutoffCos / (std::sqrt(1 - light.cutoffCos * light.cutoffCos)),
+					.lightPos = light.position});
+				if (m_gpuCulling)
+				{
+					EASSERT(m_cullingViewCount + 1 <= MAX_SHADOW_CULLING_VIEWS, "App", "Too many shadow culling views");
+#ifdef _DEBUG
+					m_cullingValidationEntries.push_back({ .drawsIndex = static_cast<uint32_t>(drawCommandVectorIndex), .cullingViewIndex = m_cullingViewCount, .cube = false });
+#endif
+					cullingViews[m_cullingViewCount++] = { .lightSphere = boundingSphere, .lightPos = light.position, .type = SPOT_LIGHT_CULLING_VIEW, .proj00 = m_indicesForShadowMaps.back().proj00 };
+				}
+				if (cpuCulling)
+					cullMeshesSpot(glm::vec3{ boundingSphere }, boundingSphere.w, m_drawCommandIndices[drawCommandVectorIndex]);
+				++drawCommandVectorIndex;
 			}
 			else
 			{
 				m_indicesForShadowCubeMaps.push_back(
 					{.shadowMapIndices = {.listIndex = static_cast<uint16_t>(light.shadowListIndex), .layerIndex = 0}, 
-					.drawsFirstIndex = static_cast<uint32_t>(drawCommandVectorIndex),
-					.viewMatIndex = static_cast<uint32_t>(light.shadowMatrixIndex) });
-				glm::vec4 boundingSphere{ m_clusterer->m_boundingSpheres[index] };
-				cullMeshesPoint(glm::vec3{ boundingSphere }, boundingSphere.w, m_drawCommandIndices, drawCommandVectorIndex);
-				drawCommandVectorIndex += 6;
+					.drawsIndex = static_cast<uint32_t>(drawCommandVectorIndex),
+					.cullingViewIndex = m_cullingViewCount,
+					.viewMatIndex = static_cast<uint32_t>(light.shadowMatrixIndex),
+					.lightPos = light.position });
+				if (m_gpuCulling)
+				{
+					EASSERT(m_cullingViewCount + 1 <= MAX_SHADOW_CULLING_VIEWS, "App", "Too many shadow culling views");
+#ifdef _DEBUG
+					m_cullingValidationEntries.push_back({ .drawsIndex = static_cast<uint32_t>(drawCommandVectorIndex), .cullingViewIndex = m_cullingViewCount, .cube = true });
+#endif
+					cullingViews[m_cullingViewCount++] = { .lightSphere = boundingSphere, .lightPos = light.position, .type = CUBE_CULLING_VIEW, .proj00 = m_frustumData.cubeProj00 };
+				}
+				if (cpuCulling)
+					cullMeshesPoint(glm::vec3{ boundingSphere }, boundingSphere.w, m_drawCommandIndices[drawCommandVectorIndex]);
+				++drawCommandVectorIndex;
 			}
 		}
 		
@@ -236,7 +417,26 @@ public:
 				m_shadowCubeMaps[m_indicesForShadowCubeMaps[i].shadowMapIndices.listIndex].getImageHandle(), m_shadowCubeMaps[m_indicesForShadowCubeMaps[i].shadowMapIndices.listIndex].getSubresourceRange()));
 		}
 		
-		m_dependency = SyncOperations::createDependencyInfo(barriers);
+		m_dependency = SyncOperations::createDependencyInfo(std::span<const VkMemoryBarrier2>{ &m_cullingBarrier, 1 }, {}, barriers);
+	}
+
+	//Writes compacted indirect draws for every spot light and every cube map, cube draws are instanced per overlapped face. Has to be recorded before the event which waits on getDependency()
+	void cmdDispatchShadowCasterCulling(VkCommandBuffer cb)
+	{
+		if (!m_gpuCulling || m_cullingViewCount == 0)
+			return;
+
+		vkCmdFillBuffer(cb, m_culledDrawCounts.getBufferHandle(), m_culledDrawCounts.getOffset(), sizeof(uint32_t) * m_cullingViewCount, 0);
+		SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)} });
+
+		m_shadowCasterCulling.cmdBind(cb);
+		m_shadowCasterCulling.cmdBindResourceSets(cb);
+		struct { uint32_t drawCount; uint32_t viewStride; } pcData{ .drawCount = m_culledDrawStride, .viewStride = m_culledDrawStride };
+		vkCmdPushConstants(cb, m_shadowCasterCulling.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pcData), &pcData);
+		constexpr uint32_t groupsizeX{ 64 };
+		vkCmdDispatch(cb, DISPATCH_SIZE(m_culledDrawStride, groupsizeX), m_cullingViewCount, 1);
 	}
 
 	const VkDependencyInfo& getDependency()
@@ -244,16 +444,77 @@ public:
 		return m_dependency;
 	}
 
-	void cmdRenderShadowMaps(VkCommandBuffer cb, const Buffer& vertexData, const Buffer& indexData)
+	void setGPUCulling(bool enabled)
 	{
-		VkBuffer vertexBindings[1]{ vertexData.getBufferHandle() };
-		VkDeviceSize vertexBindingOffsets[1]{ vertexData.getOffset() };
-		vkCmdBindVertexBuffers(cb, 0, 1, vertexBindings, vertexBindingOffsets);
-		vkCmdBindIndexBuffer(cb, indexData.getBufferHandle(), indexData.getOffset(), VK_INDEX_TYPE_UINT32);
-		m_shadowMapPass.cmdBind(cb);
-		m_shadowMapPass.cmdBindResourceSets(cb);
-		cmdRenderShadowOnedirMaps(cb);
-		cmdRenderShadowCubeMaps(cb);
+		m_gpuCulling = enabled;
+	}
+
+#ifdef _DEBUG
+	//Has to be called after the frame is finished. Bounding spheres enclose OBBs, so every draw accepted by the CPU path must be accepted by the GPU path
+	void validateGPUCulling()
+	{
+		const uint32_t* counts{ reinterpret_cast<const uint32_t*>(m_cullingReadback.getData()) };
+		const uint32_t* indices{ counts + MAX_SHADOW_CULLING_VIEWS };
+		//Returns the face mask the GPU wrote for the draw, spot light views always have an empty mask
+		auto gpuFaceMask{ [&](uint32_t view, uint32_t drawIndex) -> std::optional<uint32_t>
+			{
+				const uint32_t* first{ indices + view * m_culledDrawStride };
+				const uint32_t* found{ std::find_if(first, first + counts[view], [drawIndex](uint32_t packed) { return (packed & CUBE_DRAW_INDEX_MASK) == drawIndex; }) };
+				if (found == first + counts[view])
+					return std::nullopt;
+				return *found >> CUBE_FACE_MASK_SHIFT;
+			} };
+
+		uint32_t mismatchCount{ 0 };
+		for (auto& entry : m_cullingValidationEntries)
+		{
+			for (uint32_t drawIndex : m_drawCommandIndices[entry.drawsIndex])
+			{
+				if (entry.cube)
+				{
+					uint32_t faceMask{ drawIndex >> CUBE_FACE_MASK_SHIFT };
+					std::optional<uint32_t> gpuMask{ gpuFaceMask(entry.cullingViewIndex, drawIndex & CUBE_DRAW_INDEX_MASK) };
+					if (!gpuMask.has_value() || (faceMask & ~gpuMask.value()) != 0)
+						++mismatchCount;
+				}
+				else if (!gpuFaceMask(entry.cullingViewIndex, drawIndex).has_value())
+				{
+					++mismatchCount;
+				}
+			}
+		}
+		LOG_IF_WARNING(mismatchCount != 0, "GPU shadow caster culling rejected {} draws accepted by the CPU path.", mismatchCount);
+		m_cullingValidationEntries.clear();
+	}
+#endif
+
+	template<uint32_t QueryNum>
+	void cmdRenderShadowMaps(VkCommandBuffer cb, CommandBufferSet& cmdBufferSet, const Buffer& vertexData, const Buffer& indexData,
+		TimestampQueries<QueryNum>& queries,
+		const uint32_t queryIndexShadowMaps, const uint32_t queryIndexShadowCubeMaps,
+		bool profile)
+	{
+		cmdBindShadowPassState(cb, vertexData, indexData);
+		if (profile) queries.cmdWriteStart(cb, queryIndexShadowMaps);
+		cmdRenderShadowOnedirMaps(cb, cmdBufferSet, vertexData, indexData);
+		if (profile) queries.cmdWriteEnd(cb, queryIndexShadowMaps);
+		//Cube maps are timed on their own since the layered pass is what scales with point light count and mesh density
+		if (profile) queries.cmdWriteStart(cb, queryIndexShadowCubeMaps);
+		cmdRenderShadowCubeMaps(cb, cmdBufferSet, vertexData, indexData);
+		if (profile) queries.cmdWriteEnd(cb, queryIndexShadowCubeMaps);
+
+#ifdef _DEBUG
+		if (m_gpuCulling && m_cullingViewCount != 0)
+		{
+			SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT)} });
+			VkBufferCopy countsCopy{ .srcOffset = m_culledDrawCounts.getOffset(), .dstOffset = 0, .size = sizeof(uint32_t) * m_cullingViewCount };
+			VkBufferCopy indicesCopy{ .srcOffset = m_culledDrawDataIndices.getOffset(), .dstOffset = sizeof(uint32_t) * MAX_SHADOW_CULLING_VIEWS, .size = sizeof(uint32_t) * m_culledDrawStride * m_cullingViewCount };
+			BufferTools::cmdBufferCopy(cb, m_culledDrawCounts.getBufferHandle(), m_cullingReadback.getBufferHandle(), 1, &countsCopy);
+			BufferTools::cmdBufferCopy(cb, m_culledDrawDataIndices.getBufferHandle(), m_cullingReadback.getBufferHandle(), 1, &indicesCopy);
+		}
+#endif
 
 		cmdChangeLayouts(cb, 
 			VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
@@ -271,9 +532,14 @@ public:
 	{
 		return m_shadowCubeMaps;
 	}
-	BufferBaseHostAccessible& getShadowViewMatrices()
+	VkDeviceSize getShadowViewMatricesMaxSize() const
+	{
+		return sizeof(glm::mat4) * m_shadowMapViewMatrices.size();
+	}
+	//Sets reading the view matrices have to be created with rewrittenPerFrame, the descriptor is pointed at the frame allocator range of the current frame
+	void registerViewMatrixSet(const ResourceSet& set, uint32_t binding)
 	{
-		return m_shadowMapViewMatrices;
+		m_viewMatrixSets.push_back({ &set, binding });
 	}
 
 private:
@@ -290,6 +556,15 @@ private:
 		m_shadowCubeMaps.emplace_back(m_device, sideLength, sideLength, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, false, cubemapLayerCount, VK_IMAGE_ASPECT_DEPTH_BIT);
 		return index;
 	}
+	//Same choice as the caster culling pass, the radius over the light distance scaled by the projection approximates the part of the view covered by the caster
+	uint32_t selectShadowLOD(uint32_t drawIndex, const glm::vec3& lightPos, float proj00, uint32_t lodCount) const
+	{
+		glm::vec3 spherePos{};
+		float rad{};
+		m_rUnitsBoundingBoxes->getBoundingSphere(drawIndex, &spherePos.x, &rad);
+		float lightDistance{ glm::length(spherePos - lightPos) };
+		return lightDistance > rad ? selectLOD(rad / lightDistance * proj00, lodCount) : 0;
+	}
 	void cullMeshesSpot(const glm::vec3& pos, float rad, std::vector<uint32_t>& drawCommandIndices)
 	{
 		drawCommandIndices.clear();
@@ -362,10 +637,10 @@ private:
 			}
 		}
 	}
-	void cullMeshesPoint(const glm::vec3& pos, float rad, std::vector<std::vector<uint32_t>>& drawCommandIndices, const int index)
+	//Every passed mesh is stored once with a mask of the cube faces it overlaps in the upper bits
+	void cullMeshesPoint(const glm::vec3& pos, float rad, std::vector<uint32_t>& drawCommandIndices)
 	{
-		for (int i{ 0 }; i < 6; ++i)
-			drawCommandIndices[index + i].clear();
+		drawCommandIndices.clear();
 
 		int passedMeshesCount{ 0 };
 		std::array<int, 4> passedMeshes{};
@@ -742,13 +1017,11 @@ private:
 						bitSides[j] &= 0b11011101;
 				}
 
-				for (int j{ 0 }; j < 6; ++j)
+				for (int k{ 0 }; k < passedMeshesCount; ++k)
 				{
-					for (int k{ 0 }; k < passedMeshesCount; ++k)
-					{
-						if (bitSides[k] & (1 << j))
-							drawCommandIndices[index + j].push_back(passedMeshes[k]);
-					}
+					uint32_t faceMask{ bitSides[k] & 0b00111111u };
+					if (faceMask)
+						drawCommandIndices.push_back((faceMask << CUBE_FACE_MASK_SHIFT) | static_cast<uint32_t>(passedMeshes[k]));
 				}
 				
 				passedMeshesCount = 0;
@@ -766,12 +1039,12 @@ private:
 
 	void calcViewMatrix(uint32_t index, const glm::vec3& pos, const glm::vec3& dir)
 	{
-		glm::mat4* mat{ reinterpret_cast<glm::mat4*>(m_shadowMapViewMatrices.getData()) + index };
+		glm::mat4* mat{ m_shadowMapViewMatrices.data() + index };
 		*mat = glm::lookAt(pos, pos + dir, (dir.y < 0.999 && dir.y > -0.999) ? glm::vec3{0.0, 1.0, 0.0} : glm::vec3{ 0.0, 0.0, 1.0 });
 	}
 	void calcCubeViewMatrices(uint32_t index, const glm::vec3& pos)
 	{
-		glm::mat4* mat{ reinterpret_cast<glm::mat4*>(m_shadowMapViewMatrices.getData()) + index };
+		glm::mat4* mat{ m_shadowMapViewMatrices.data() + index };
 		*(mat++) = glm::lookAt(pos, pos + glm::vec3{1.0, 0.0, 0.0}, glm::vec3{0.0, 1.0, 0.0});
 		*(mat++) = glm::lookAt(pos, pos + glm::vec3{-1.0, 0.0, 0.0}, glm::vec3{0.0, 1.0, 0.0});
 		*(mat++) = glm::lookAt(pos, pos + glm::vec3{0.0, 1.0, 0.0}, glm::vec3{0.0, 0.0, -1.0});
@@ -830,11 +1103,71 @@ private:
 		barriers.clear();
 	}
 
-	void cmdRenderShadowOnedirMaps(VkCommandBuffer cb)
+	void cmdDrawCulledView(VkCommandBuffer cb, uint32_t view)
+	{
+		vkCmdDrawIndexedIndirectCount(cb,
+			m_culledDrawCommands.getBufferHandle(), m_culledDrawCommands.getOffset() + sizeof(VkDrawIndexedIndirectCommand) * view * m_culledDrawStride,
+			m_culledDrawCounts.getBufferHandle(), m_culledDrawCounts.getOffset() + sizeof(uint32_t) * view,
+			m_culledDrawStride, sizeof(VkDrawIndexedIndirectCommand));
+	}
+	void cmdBindShadowPassState(VkCommandBuffer cb, const Buffer& vertexData, const Buffer& indexData)
+	{
+		VkBuffer vertexBindings[1]{ vertexData.getBufferHandle() };
+		VkDeviceSize vertexBindingOffsets[1]{ vertexData.getOffset() };
+		vkCmdBindVertexBuffers(cb, 0, 1, vertexBindings, vertexBindingOffsets);
+		vkCmdBindIndexBuffer(cb, indexData.getBufferHandle(), indexData.getOffset(), VK_INDEX_TYPE_UINT32);
+		Pipeline& shadowPass{ m_gpuCulling ? m_shadowMapPassIndirect : m_shadowMapPass };
+		shadowPass.cmdBind(cb);
+		shadowPass.cmdBindResourceSets(cb);
+	}
+	void cmdRecordShadowDraws(VkCommandBuffer cb, uint32_t first, uint32_t count)
+	{
+		VkPipelineLayout layout{ m_shadowMapPass.getPipelineLayoutHandle() };
+		for (uint32_t i{ first }; i < first + count; ++i)
+		{
+			const ShadowDraw& draw{ m_shadowDraws[i] };
+			vkCmdPushConstants(cb, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(draw.pcData), &draw.pcData);
+			vkCmdDrawIndexed(cb, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+		}
+	}
+	//Renders the gathered CPU-culled draws, splitting them across secondary command buffers if there are enough of them
+	void cmdRenderShadowDraws(VkCommandBuffer cb, VkRenderingInfo& renderInfo, VkFormat depthFormat, const VkViewport& viewport, CommandBufferSet& cmdBufferSet, const Buffer& vertexData, const Buffer& indexData)
+	{
+		if (m_shadowDraws.size() < SHADOW_SECONDARY_CB_MIN_DRAWS)
+		{
+			vkCmdSetViewport(cb, 0, 1, &viewport);
+			vkCmdBeginRendering(cb, &renderInfo);
+			cmdRecordShadowDraws(cb, 0, m_shadowDraws.size());
+			vkCmdEndRendering(cb);
+		}
+		else
+		{
+			VkCommandBufferInheritanceRenderingInfo inheritanceInfo{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO };
+			inheritanceInfo.depthAttachmentFormat = depthFormat;
+			inheritanceInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+			renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+			vkCmdBeginRendering(cb, &renderInfo);
+			cmdBufferSet.cmdRecordInParallel(cb, inheritanceInfo, m_shadowDraws.size(), SHADOW_SECONDARY_CB_DRAWS, [&](VkCommandBuffer secondaryCB, uint32_t first, uint32_t count)
+				{
+					cmdBindShadowPassState(secondaryCB, vertexData, indexData);
+					vkCmdSetViewport(secondaryCB, 0, 1, &viewport);
+					cmdRecordShadowDraws(secondaryCB, first, count);
+				});
+			vkCmdEndRendering(cb);
+			renderInfo.flags = 0;
+
+			//Primary state is undefined after executing secondary buffers
+			cmdBindShadowPassState(cb, vertexData, indexData);
+		}
+		m_shadowDraws.clear();
+	}
+	void cmdRenderShadowOnedirMaps(VkCommandBuffer cb, CommandBufferSet& cmdBufferSet, const Buffer& vertexData, const Buffer& indexData)
 	{
+		VkPipelineLayout layout{ m_gpuCulling ? m_shadowMapPassIndirect.getPipelineLayoutHandle() : m_shadowMapPass.getPipelineLayoutHandle() };
 		for (int i{ 0 }; i < m_indicesForShadowMaps.size();)
 		{
-			if (m_drawCommandIndices[m_indicesForShadowMaps[i].drawsIndex].size() == 0)
+			if (!m_gpuCulling && m_drawCommandIndices[m_indicesForShadowMaps[i].drawsIndex].size() == 0)
 			{
 				++i;
 				continue;
@@ -859,12 +1192,16 @@ private:
 			int j{ 0 };
 			VkViewport viewports[1]{ {.x = 0, .y = 0,
 				.width = static_cast<float>(renderInfo.renderArea.extent.width), .height = static_cast<float>(renderInfo.renderArea.extent.height), .minDepth = 0.0, .maxDepth = 1.0 } };
-			vkCmdSetViewport(cb, 0, 1, viewports);
-			vkCmdBeginRendering(cb, &renderInfo);
+			if (m_gpuCulling)
+			{
+				vkCmdSetViewport(cb, 0, 1, viewports);
+				vkCmdBeginRendering(cb, &renderInfo);
+			}
 			
-			struct { int32_t layer; uint32_t drawDataIndex; float proj00; float proj11; float proj22; float proj32; uint32_t viewMatrixIndex; } pcData;
+			ShadowPassPushConstants pcData;
 			pcData.proj22 = m_frustumData.proj22;
 			pcData.proj32 = m_frustumData.proj32;
+			pcData.faceMask = 0;
 
 			while ((i + j) < m_indicesForShadowMaps.size())
 			{
@@ -874,25 +1211,41 @@ private:
 				pcData.viewMatrixIndex = m_indicesForShadowMaps[i + j].viewMatIndex;
 				pcData.proj00 = m_indicesForShadowMaps[i + j].proj00;
 				pcData.proj11 = -pcData.proj00;
-				auto& drawIndices{ m_drawCommandIndices[m_indicesForShadowMaps[i + j].drawsIndex] };
-				IndirectData* drawCommands{ reinterpret_cast<IndirectData*>(m_indirectDrawCmdData->getData()) };
-				for (int k{ 0 }; k < drawIndices.size(); ++k)
+				if (m_gpuCulling)
 				{
-					pcData.drawDataIndex = drawIndices[k];
-					vkCmdPushConstants(cb, m_shadowMapPass.getPipelineLayoutHandle(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pcData), &pcData);
-					auto& dc{ drawCommands[pcData.drawDataIndex].cmd };
-					vkCmdDrawIndexed(cb, dc.indexCount, dc.instanceCount, dc.firstIndex, dc.vertexOffset, dc.firstInstance);
+					uint32_t view{ m_indicesForShadowMaps[i + j].cullingViewIndex };
+					pcData.drawDataIndex = view * m_culledDrawStride;
+					vkCmdPushConstants(cb, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pcData), &pcData);
+					cmdDrawCulledView(cb, view);
+				}
+				else
+				{
+					auto& drawIndices{ m_drawCommandIndices[m_indicesForShadowMaps[i + j].drawsIndex] };
+					IndirectData* drawCommands{ reinterpret_cast<IndirectData*>(m_indirectDrawCmdData->getData()) };
+					const DrawLODData* drawLODs{ reinterpret_cast<const DrawLODData*>(m_drawLODData->getData()) };
+					for (int k{ 0 }; k < drawIndices.size(); ++k)
+					{
+						pcData.drawDataIndex = drawIndices[k];
+						auto& dc{ drawCommands[pcData.drawDataIndex].cmd };
+						const DrawLODData& lods{ drawLODs[pcData.drawDataIndex] };
+						uint32_t lod{ selectShadowLOD(pcData.drawDataIndex, m_indicesForShadowMaps[i + j].lightPos, m_indicesForShadowMaps[i + j].proj00, lods.lodCount) };
+						m_shadowDraws.push_back({ .pcData = pcData, .indexCount = lods.indexCount[lod], .instanceCount = dc.instanceCount, .firstIndex = lods.firstIndex[lod], .vertexOffset = dc.vertexOffset, .firstInstance = dc.firstInstance });
+					}
 				}
 
 				++j;
 			}
 			next:
-			vkCmdEndRendering(cb);
+			if (m_gpuCulling)
+				vkCmdEndRendering(cb);
+			else
+				cmdRenderShadowDraws(cb, renderInfo, m_shadowMaps.getImageListFormat(list), viewports[0], cmdBufferSet, vertexData, indexData);
 			i += j;
 		}
 	}
-	void cmdRenderShadowCubeMaps(VkCommandBuffer cb)
+	void cmdRenderShadowCubeMaps(VkCommandBuffer cb, CommandBufferSet& cmdBufferSet, const Buffer& vertexData, const Buffer& indexData)
 	{
+		VkPipelineLayout layout{ m_gpuCulling ? m_shadowMapPassIndirect.getPipelineLayoutHandle() : m_shadowMapPass.getPipelineLayoutHandle() };
 		for (int i{ 0 }; i < m_indicesForShadowCubeMaps.size(); ++i)
 		{
 			uint32_t list{ m_indicesForShadowCubeMaps[i].shadowMapIndices.listIndex };
@@ -913,38 +1266,46 @@ private:
 			renderInfo.pDepthAttachment = &attachment;
 			renderInfo.colorAttachmentCount = 0;
 
-			int j{ 0 };
 			VkViewport viewports[1]{ {.x = 0, .y = 0,
 				.width = static_cast<float>(renderInfo.renderArea.extent.width), .height = static_cast<float>(renderInfo.renderArea.extent.height), .minDepth = 0.0, .maxDepth = 1.0 } };
-			vkCmdSetViewport(cb, 0, 1, viewports);
-			vkCmdBeginRendering(cb, &renderInfo);
 
-			struct { int32_t layer; uint32_t drawDataIndex; float proj00; float proj11; float proj22; float proj32; uint32_t viewMatrixIndex; } pcData;
+			ShadowPassPushConstants pcData;
+			pcData.layer = 0;
 			pcData.proj00 = m_frustumData.cubeProj00;
 			pcData.proj11 = -m_frustumData.cubeProj00;
 			pcData.proj22 = m_frustumData.proj22;
 			pcData.proj32 = m_frustumData.proj32;
+			pcData.viewMatrixIndex = m_indicesForShadowCubeMaps[i].viewMatIndex;
 
-			
-			for (int j{ 0 }; j < 6; ++j)
+			if (m_gpuCulling)
+			{
+				//GPU culling produces one compacted list per cube map, each command is instanced per overlapped face and the face mask is packed into its draw data index
+				vkCmdSetViewport(cb, 0, 1, viewports);
+				vkCmdBeginRendering(cb, &renderInfo);
+				uint32_t view{ m_indicesForShadowCubeMaps[i].cullingViewIndex };
+				pcData.faceMask = 0;
+				pcData.drawDataIndex = view * m_culledDrawStride;
+				vkCmdPushConstants(cb, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pcData), &pcData);
+				cmdDrawCulledView(cb, view);
+				vkCmdEndRendering(cb);
+			}
+			else
 			{
-				//
-				auto& drawIndices{ m_drawCommandIndices[m_indicesForShadowCubeMaps[i].drawsFirstIndex + j] };
-				//
-				pcData.layer = j;
-				pcData.viewMatrixIndex = m_indicesForShadowCubeMaps[i].viewMatIndex + j;
+				//Each mesh is drawn once, one instance per overlapped face; the vertex shader maps the instance to a layer using the face mask
+				auto& drawIndices{ m_drawCommandIndices[m_indicesForShadowCubeMaps[i].drawsIndex] };
 				IndirectData* drawCommands{ reinterpret_cast<IndirectData*>(m_indirectDrawCmdData->getData()) };
+				const DrawLODData* drawLODs{ reinterpret_cast<const DrawLODData*>(m_drawLODData->getData()) };
 				for (int k{ 0 }; k < drawIndices.size(); ++k)
 				{
-					pcData.drawDataIndex = drawIndices[k];
-					vkCmdPushConstants(cb, m_shadowMapPass.getPipelineLayoutHandle(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pcData), &pcData);
+					pcData.drawDataIndex = drawIndices[k] & CUBE_DRAW_INDEX_MASK;
+					pcData.faceMask = drawIndices[k] >> CUBE_FACE_MASK_SHIFT;
 					auto& dc{ drawCommands[pcData.drawDataIndex].cmd };
-					vkCmdDrawIndexed(cb, dc.indexCount, dc.instanceCount, dc.firstIndex, dc.vertexOffset, dc.firstInstance);
+					const DrawLODData& lods{ drawLODs[pcData.drawDataIndex] };
+					uint32_t lod{ selectShadowLOD(pcData.drawDataIndex, m_indicesForShadowCubeMaps[i].lightPos, m_frustumData.cubeProj00, lods.lodCount) };
+					m_shadowDraws.push_back({ .pcData = pcData, .indexCount = lods.indexCount[lod], .instanceCount = static_cast<uint32_t>(std::popcount(pcData.faceMask)), .firstIndex = lods.firstIndex[lod], .vertexOffset = dc.vertexOffset, .firstInstance = 0 });
 				}
+				cmdRenderShadowDraws(cb, renderInfo, m_shadowCubeMaps[list].getFormat(), viewports[0], cmdBufferSet, vertexData, indexData);
 			}
-
-			vkCmdEndRendering(cb);
-			i += j;
 		}
 	}
 
@@ -1,41 +1,72 @@
 #include "src/rendering/renderer/GI.h"
 
+static_assert(GI_SCROLL_STEP_PROBES * VOXELMAP_RESOLUTION == GI_SCROLL_STEP_VOXELS * DDGI_PROBE_X_COUNT
+	&& GI_SCROLL_STEP_PROBES * VOXELMAP_RESOLUTION == GI_SCROLL_STEP_VOXELS * DDGI_PROBE_Y_COUNT
+	&& GI_SCROLL_STEP_PROBES * VOXELMAP_RESOLUTION == GI_SCROLL_STEP_VOXELS * DDGI_PROBE_Z_COUNT, "Scroll step must be whole in both voxels and probes.");
+//Keeps the packed occupancy and its first mips aligned under the scroll
+static_assert(GI_SCROLL_STEP_VOXELS % 4 == 0 && VOXELMAP_RESOLUTION == OCCUPANCY_RESOLUTION, "Scroll step must be a multiple of the occupancy packing.");
+static_assert(DESCRIPTOR_FRAME_RING_SIZE == 2, "Metadata buffers are initialized for two frames in flight.");
+
 GI::GI(VkDevice device, uint32_t windowWidth, uint32_t windowHeight, BufferBaseHostAccessible& baseHostBuffer, BufferBaseHostInaccessible& baseDeviceBuffer, Clusterer& clusterer) :
-	m_occupancyMaps{ device, VK_FORMAT_R32_UINT, 
-	BOM_PACKED_WIDTH, BOM_PACKED_HEIGHT, BOM_PACKED_DEPTH, 
-	VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, Image::GRAPHICS_AND_COMPUTE_BIT, true },
-	m_emissionMetRoughVoxelmap{ device, VK_FORMAT_R16G16B16A16_UINT, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, false },
-	m_dynamicEmissionVoxelmap{ device, VK_FORMAT_R16G16B16A16_UINT, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, false },
-	m_albedoNormalVoxelmap{ device, VK_FORMAT_R8G8B8A8_UINT, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, false },
+	m_occupancyMaps{
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT>
+			(device, VK_FORMAT_R32_UINT, 
+			BOM_PACKED_WIDTH, BOM_PACKED_HEIGHT, BOM_PACKED_DEPTH, 
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, Image::GRAPHICS_AND_COMPUTE_BIT, true)
+		},
+	m_emissionMetRoughVoxelmap{
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT>
+			(device, VK_FORMAT_R16G16B16A16_UINT, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, false)
+		},
+	m_dynamicEmissionVoxelmap{
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT>
+			(device, VK_FORMAT_R16G16B16A16_UINT, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, false)
+		},
+	m_albedoNormalVoxelmap{
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT>
+			(device, VK_FORMAT_R8G8B8A8_UINT, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VOXELMAP_RESOLUTION, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, false)
+		},
 	m_rayAlignedOccupancyMapArray{
-		CompileTimeArray::uniform_array_from_args<Image, ROM_NUMBER>
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT * ROM_NUMBER>
 			(device, VK_FORMAT_R32_UINT, ROM_PACKED_WIDTH, ROM_PACKED_HEIGHT, ROM_PACKED_DEPTH, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, false)
 	},
-	m_probeOffsetsImage{ device, VK_FORMAT_R8G8B8A8_SNORM,
-		DDGI_PROBE_X_COUNT, DDGI_PROBE_Y_COUNT, DDGI_PROBE_Z_COUNT,
-		VK_IMAGE_USAGE_STORAGE_BIT,
-		VK_IMAGE_ASPECT_COLOR_BIT, false },
-	m_probeStateImage{ device, VK_FORMAT_R8_UINT,
-		DDGI_PROBE_X_COUNT, DDGI_PROBE_Y_COUNT, DDGI_PROBE_Z_COUNT,
-		VK_IMAGE_USAGE_STORAGE_BIT,
-		VK_IMAGE_ASPECT_COLOR_BIT, false },
-	m_ddgiRadianceProbes{ device, VK_FORMAT_R16G16B16A16_SFLOAT,
-		DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT, DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_Y_COUNT,
-		VK_IMAGE_USAGE_STORAGE_BIT,
-		VK_IMAGE_ASPECT_COLOR_BIT, false },
-	m_ddgiDistanceProbes{ device, VK_FORMAT_R16_SFLOAT,
-		DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT, DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_Y_COUNT,
-		VK_IMAGE_USAGE_STORAGE_BIT,
-		VK_IMAGE_ASPECT_COLOR_BIT, false },
+	m_probeOffsetsImage{
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT>
+			(device, VK_FORMAT_R8G8B8A8_SNORM,
+			DDGI_PROBE_X_COUNT, DDGI_PROBE_Y_COUNT, DDGI_PROBE_Z_COUNT,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, false)
+		},
+	m_probeStateImage{
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT>
+			(device, VK_FORMAT_R8_UINT,
+			DDGI_PROBE_X_COUNT, DDGI_PROBE_Y_COUNT, DDGI_PROBE_Z_COUNT,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, false)
+		},
+	m_ddgiRadianceProbes{
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT>
+			(device, VK_FORMAT_R16G16B16A16_SFLOAT,
+			DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT, DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_Y_COUNT,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, false)
+		},
+	m_ddgiDistanceProbes{
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT>
+			(device, VK_FORMAT_R16_SFLOAT,
+			DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT, DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_Y_COUNT,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, false)
+		},
 	m_ddgiIrradianceProbes{
-		CompileTimeArray::uniform_array_from_args<Image, 2>
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT * 2>
 			(device, VK_FORMAT_A2B10G10R10_UNORM_PACK32,
 			DDGI_PROBE_LIGHT_SIDE_SIZE_WITH_BORDERS * DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT, DDGI_PROBE_LIGHT_SIDE_SIZE_WITH_BORDERS * DDGI_PROBE_Y_COUNT,
 			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 			VK_IMAGE_ASPECT_COLOR_BIT, false)
 		},
 	m_ddgiVisibilityProbes{
-		CompileTimeArray::uniform_array_from_args<Image, 2>
+		CompileTimeArray::uniform_array_from_args<Image, GI_CASCADE_COUNT * 2>
 			(device, VK_FORMAT_R16G16_SFLOAT,
 			DDGI_PROBE_VISIBILITY_SIDE_SIZE_WITH_BORDERS * DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT, DDGI_PROBE_VISIBILITY_SIDE_SIZE_WITH_BORDERS * DDGI_PROBE_Y_COUNT,
 			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
@@ -49,12 +80,22 @@ GI::GI(VkDevice device, uint32_t windowWidth, uint32_t windowHeight, BufferBaseH
 		windowWidth / 2, windowHeight / 2,
 		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VK_IMAGE_ASPECT_COLOR_BIT, false },
-	m_hierarchicalOMImageViews{ device },
+	m_specularHistory{ device, VK_FORMAT_B10G11R11_UFLOAT_PACK32,
+		windowWidth / 2, windowHeight / 2,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT, false },
+	m_specularGuide{ device, VK_FORMAT_R16G16B16A16_SFLOAT,
+		windowWidth / 2, windowHeight / 2,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT, false },
+	m_hierarchicalOMImageViews{ CompileTimeArray::uniform_array_from_args<ExteriorImageViews, GI_CASCADE_COUNT>(device) },
 	m_sphereVertexData{ baseDeviceBuffer },
-	m_pcDataBOM{ OCCUPANCY_METER_SIZE / 2.0, OCCUPANCY_RESOLUTION, VOXELMAP_RESOLUTION },
+	m_pcDataBOM{ .center = SCENE_ORIGIN, .halfSide = OCCUPANCY_METER_SIZE / 2.0, .resolutionBOM = OCCUPANCY_RESOLUTION, .resolutionVM = VOXELMAP_RESOLUTION },
 	m_ROMAtransformMatrices{ {baseHostBuffer, sizeof(glm::mat4x3) * ROM_NUMBER}, {baseHostBuffer, sizeof(glm::mat4x3) * ROM_NUMBER} },
 	m_mappedDirections{ {baseHostBuffer, sizeof(glm::vec4) * DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_LIGHT_SIDE_SIZE}, {baseHostBuffer, sizeof(glm::vec4) * DDGI_PROBE_LIGHT_SIDE_SIZE * DDGI_PROBE_LIGHT_SIDE_SIZE} },
-	m_giMetadata{ baseHostBuffer, sizeof(GIMetaData) },
+	m_probeScheduleList{ {baseHostBuffer, DDGI_PROBE_SCHEDULE_LIST_SECTION_SIZE * GI_CASCADE_COUNT}, {baseHostBuffer, DDGI_PROBE_SCHEDULE_LIST_SECTION_SIZE * GI_CASCADE_COUNT} },
+	m_probeScheduleMask{ {baseHostBuffer, DDGI_PROBE_SCHEDULE_MASK_SECTION_SIZE * GI_CASCADE_COUNT}, {baseHostBuffer, DDGI_PROBE_SCHEDULE_MASK_SECTION_SIZE * GI_CASCADE_COUNT} },
+	m_giMetadata{ {baseHostBuffer, sizeof(GIMetaData)}, {baseHostBuffer, sizeof(GIMetaData)} },
 	m_clusterer{ &clusterer }
 {
 }
@@ -71,46 +112,55 @@ void GI::initialize(VkDevice device,
 	const ResourceSet& shadowMapsRS,
 	VkSampler generalSampler)
 {
+	//Sets over a single image of every cascade, copy c points to the image of cascade c
+	auto initializeCascadeImageSet{ [device](ResourceSet& resSet, const std::array<Image, GI_CASCADE_COUNT>& images, const VkDescriptorSetLayoutBinding& binding, VkImageLayout layout, bool rewrittenPerFrame)
+		{
+			std::array<VkDescriptorImageInfo, GI_CASCADE_COUNT> imageInfos{};
+			std::vector<VkDescriptorDataEXT> descData(GI_CASCADE_COUNT);
+			for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+			{
+				imageInfos[c] = { .imageView = images[c].getImageView(), .imageLayout = layout };
+				descData[c].pStorageImage = &imageInfos[c];
+			}
+			resSet.initializeSet(device, GI_CASCADE_COUNT, {},
+				std::array{ binding },
+				std::array<VkDescriptorBindingFlags, 0>{},
+				std::vector<std::vector<VkDescriptorDataEXT>>{
+				descData },
+				false, rewrittenPerFrame);
+		} };
+
 	VkDescriptorSetLayoutBinding bindingBOM{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorImageInfo imageInfoBOM{ .imageView = m_occupancyMaps.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	m_resSetWriteBOM.initializeSet(device, 1, {},
-		std::array{ bindingBOM },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoBOM} }},
-		false);
-	imageInfoBOM.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	m_resSetReadBOM.initializeSet(device, 1, {},
-		std::array{ bindingBOM },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoBOM} }},
-		false);
+	initializeCascadeImageSet(m_resSetWriteBOM, m_occupancyMaps, bindingBOM, VK_IMAGE_LAYOUT_GENERAL, false);
+	initializeCascadeImageSet(m_resSetReadBOM, m_occupancyMaps, bindingBOM, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, false);
 
 	const uint32_t maxMipLevelHOM{ static_cast<uint32_t>(std::floor(std::log2(std::min(std::min(BOM_PACKED_WIDTH, BOM_PACKED_HEIGHT), BOM_PACKED_DEPTH))) + 0.1) };
 	const uint32_t mipCountHOM{ maxMipLevelHOM + 1 };
 	m_omMipsToGenerate = maxMipLevelHOM;
-	m_hierarchicalOMImageViews.initialize(m_occupancyMaps, 0, mipCountHOM);
 	VkDescriptorSetLayoutBinding bindingHierarchicalOM{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = HOM_MAX_MIP_LEVELS, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
-	std::vector<VkDescriptorImageInfo> imageInfosHierarchicalOM(mipCountHOM);
-	std::vector<VkDescriptorDataEXT> descDataHierarchicalOM(mipCountHOM);
-	for (int i{ 0 }; i < mipCountHOM; ++i)
+	std::vector<VkDescriptorImageInfo> imageInfosHierarchicalOM(mipCountHOM * GI_CASCADE_COUNT);
+	std::vector<VkDescriptorDataEXT> descDataHierarchicalOM(mipCountHOM * GI_CASCADE_COUNT);
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
 	{
-		imageInfosHierarchicalOM[i].imageView = m_hierarchicalOMImageViews.getImageView(i);
-		imageInfosHierarchicalOM[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-		descDataHierarchicalOM[i].pStorageImage = &imageInfosHierarchicalOM[i];
+		m_hierarchicalOMImageViews[c].initialize(m_occupancyMaps[c], 0, mipCountHOM);
+		for (int i{ 0 }; i < mipCountHOM; ++i)
+		{
+			imageInfosHierarchicalOM[c * mipCountHOM + i].imageView = m_hierarchicalOMImageViews[c].getImageView(i);
+			imageInfosHierarchicalOM[c * mipCountHOM + i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			descDataHierarchicalOM[c * mipCountHOM + i].pStorageImage = &imageInfosHierarchicalOM[c * mipCountHOM + i];
+		}
 	}
-	m_resSetWriteHierarchicalOM.initializeSet(device, 1, {},
+	m_resSetWriteHierarchicalOM.initializeSet(device, GI_CASCADE_COUNT, {},
 		std::array{ bindingHierarchicalOM },
 		std::array<VkDescriptorBindingFlags, 1>{ {VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT} },
 		std::vector<std::vector<VkDescriptorDataEXT>>{
 			descDataHierarchicalOM },
 		false);
-	for (int i{ 0 }; i < mipCountHOM; ++i)
+	for (auto& imageInfo : imageInfosHierarchicalOM)
 	{
-		imageInfosHierarchicalOM[i].imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
 	}
-	m_resSetReadHierarchicalOM.initializeSet(device, 1, {},
+	m_resSetReadHierarchicalOM.initializeSet(device, GI_CASCADE_COUNT, {},
 		std::array{ bindingHierarchicalOM },
 		std::array<VkDescriptorBindingFlags, 1>{ {VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT} },
 		std::vector<std::vector<VkDescriptorDataEXT>>{
@@ -118,15 +168,15 @@ void GI::initialize(VkDevice device,
 		false);
 
 	VkDescriptorSetLayoutBinding bindingROMA{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = ROM_NUMBER, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT };
-	std::array<VkDescriptorImageInfo, ROM_NUMBER> imageInfosROMA{};
-	std::vector<VkDescriptorDataEXT> descDataROMA(ROM_NUMBER);
+	std::array<VkDescriptorImageInfo, GI_CASCADE_COUNT * ROM_NUMBER> imageInfosROMA{};
+	std::vector<VkDescriptorDataEXT> descDataROMA(GI_CASCADE_COUNT * ROM_NUMBER);
 	for (int i{ 0 }; i < imageInfosROMA.size(); ++i)
 	{
 		imageInfosROMA[i].imageView = m_rayAlignedOccupancyMapArray[i].getImageView();
 		imageInfosROMA[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 		descDataROMA[i].pStorageImage = &imageInfosROMA[i];
 	}
-	m_resSetWriteROMA.initializeSet(device, 1, {},
+	m_resSetWriteROMA.initializeSet(device, GI_CASCADE_COUNT, {},
 		std::array{ bindingROMA },
 		std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
@@ -136,166 +186,152 @@ void GI::initialize(VkDevice device,
 	{
 		imageInfosROMA[i].imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
 	}
+	//Copy c * 2 + i reads the ROMs of cascade c with the view matrices of buffer i
 	VkDescriptorSetLayoutBinding bindingViewmatsROMA{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT };
-	VkDescriptorAddressInfoEXT viewmatsROMAAddressInfo0{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_ROMAtransformMatrices[0].getDeviceAddress(), .range = m_ROMAtransformMatrices[0].getSize() };
-	VkDescriptorAddressInfoEXT viewmatsROMAAddressInfo1{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_ROMAtransformMatrices[1].getDeviceAddress(), .range = m_ROMAtransformMatrices[1].getSize() };
-	descDataROMA.resize(ROM_NUMBER * 2);
-	for (int i{ 0 }; i < imageInfosROMA.size(); ++i)
+	VkDescriptorAddressInfoEXT viewmatsROMAAddressInfos[2]{
+		{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_ROMAtransformMatrices[0].getDeviceAddress(), .range = m_ROMAtransformMatrices[0].getSize() },
+		{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_ROMAtransformMatrices[1].getDeviceAddress(), .range = m_ROMAtransformMatrices[1].getSize() } };
+	std::vector<VkDescriptorDataEXT> descDataReadROMA(GI_CASCADE_COUNT * 2 * ROM_NUMBER);
+	std::vector<VkDescriptorDataEXT> descDataViewmatsROMA(GI_CASCADE_COUNT * 2);
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
 	{
-		descDataROMA[ROM_NUMBER + i].pStorageImage = &imageInfosROMA[i];
+		for (int j{ 0 }; j < 2; ++j)
+		{
+			for (int i{ 0 }; i < ROM_NUMBER; ++i)
+			{
+				descDataReadROMA[(c * 2 + j) * ROM_NUMBER + i].pStorageImage = &imageInfosROMA[c * ROM_NUMBER + i];
+			}
+			descDataViewmatsROMA[c * 2 + j].pUniformBuffer = &viewmatsROMAAddressInfos[j];
+		}
 	}
-	m_resSetReadROMA.initializeSet(device, 2, {},
+	m_resSetReadROMA.initializeSet(device, GI_CASCADE_COUNT * 2, {},
 		std::array{ bindingROMA, bindingViewmatsROMA },
 		std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
-		descDataROMA,
-			std::vector<VkDescriptorDataEXT>{ {.pUniformBuffer = &viewmatsROMAAddressInfo0}, { .pUniformBuffer = &viewmatsROMAAddressInfo1 } }},
+		descDataReadROMA,
+			descDataViewmatsROMA },
 		false);
 
 	VkDescriptorSetLayoutBinding bindingProbeOffsets{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorImageInfo imageInfoProbeOffsets{ .imageView = m_probeOffsetsImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	m_resSetWriteProbeOffsets.initializeSet(device, 1, {},
-		std::array{ bindingProbeOffsets },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoProbeOffsets} }},
-		false);
-	imageInfoProbeOffsets.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	m_resSetReadProbeOffsets.initializeSet(device, 1, {},
-		std::array{ bindingProbeOffsets },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoProbeOffsets} }},
-		false);
+	initializeCascadeImageSet(m_resSetWriteProbeOffsets, m_probeOffsetsImage, bindingProbeOffsets, VK_IMAGE_LAYOUT_GENERAL, false);
+	initializeCascadeImageSet(m_resSetReadProbeOffsets, m_probeOffsetsImage, bindingProbeOffsets, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, false);
 
 	VkDescriptorSetLayoutBinding bindingProbeState{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorImageInfo imageInfoProbeState{ .imageView = m_probeStateImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	m_resSetWriteProbeState.initializeSet(device, 1, {},
-		std::array{ bindingProbeState },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoProbeState} }},
-		false);
-	imageInfoProbeState.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	m_resSetReadProbeState.initializeSet(device, 1, {},
-		std::array{ bindingProbeState },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoProbeState} }},
-		false);
+	initializeCascadeImageSet(m_resSetWriteProbeState, m_probeStateImage, bindingProbeState, VK_IMAGE_LAYOUT_GENERAL, false);
+	initializeCascadeImageSet(m_resSetReadProbeState, m_probeStateImage, bindingProbeState, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, false);
 
 	VkDescriptorSetLayoutBinding bindingEmissionMetRoughVM{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorImageInfo imageInfoEmissionMetRoughVM{ .imageView = m_emissionMetRoughVoxelmap.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	m_resSetEmissionMetRoughWrite.initializeSet(device, 1, {},
-		std::array{ bindingEmissionMetRoughVM },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoEmissionMetRoughVM} } },
-		false);
-	imageInfoEmissionMetRoughVM.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	m_resSetEmissionMetRoughRead.initializeSet(device, 1, {},
-		std::array{ bindingEmissionMetRoughVM },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoEmissionMetRoughVM} } },
-		false);
+	initializeCascadeImageSet(m_resSetEmissionMetRoughWrite, m_emissionMetRoughVoxelmap, bindingEmissionMetRoughVM, VK_IMAGE_LAYOUT_GENERAL, true);
+	initializeCascadeImageSet(m_resSetEmissionMetRoughRead, m_emissionMetRoughVoxelmap, bindingEmissionMetRoughVM, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, true);
 	VkDescriptorSetLayoutBinding bindingAlbedoNormalVM{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorImageInfo imageInfoAlbedoNormalVM{ .imageView = m_albedoNormalVoxelmap.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	m_resSetAlbedoNormalWrite.initializeSet(device, 1, {},
-		std::array{ bindingAlbedoNormalVM },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoAlbedoNormalVM} } },
-		false);
-	imageInfoAlbedoNormalVM.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	m_resSetAlbedoNormalRead.initializeSet(device, 1, {},
-		std::array{ bindingAlbedoNormalVM },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoAlbedoNormalVM} } },
-		false);
+	initializeCascadeImageSet(m_resSetAlbedoNormalWrite, m_albedoNormalVoxelmap, bindingAlbedoNormalVM, VK_IMAGE_LAYOUT_GENERAL, true);
+	initializeCascadeImageSet(m_resSetAlbedoNormalRead, m_albedoNormalVoxelmap, bindingAlbedoNormalVM, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, true);
+	//The largest GI volumes can be relocated by defragmentation, their sets are rewritten per frame so frames in flight keep the old views
+	auto rewriteVoxelmap{ [](Image& voxelmap, uint32_t cascade, ResourceSet& writeSet, ResourceSet& readSet)
+		{
+			VkDescriptorImageInfo imageInfo{ .imageView = voxelmap.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+			writeSet.rewriteDescriptor(0, cascade, 0, {.pStorageImage = &imageInfo});
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+			readSet.rewriteDescriptor(0, cascade, 0, {.pStorageImage = &imageInfo});
+		} };
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		m_emissionMetRoughVoxelmap[c].setMovable(VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, [this, rewriteVoxelmap, c]() { rewriteVoxelmap(m_emissionMetRoughVoxelmap[c], c, m_resSetEmissionMetRoughWrite, m_resSetEmissionMetRoughRead); });
+		m_albedoNormalVoxelmap[c].setMovable(VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, [this, rewriteVoxelmap, c]() { rewriteVoxelmap(m_albedoNormalVoxelmap[c], c, m_resSetAlbedoNormalWrite, m_resSetAlbedoNormalRead); });
+	}
 	VkDescriptorSetLayoutBinding bindingDynamicEmissionVM{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorImageInfo imageInfoDynamicEmissionVM{ .imageView = m_dynamicEmissionVoxelmap.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	m_resSetDynamicEmissionWrite.initializeSet(device, 1, {},
-		std::array{ bindingDynamicEmissionVM },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoDynamicEmissionVM} } },
-		false);
-	imageInfoDynamicEmissionVM.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	m_resSetDynamicEmissionRead.initializeSet(device, 1, {},
-		std::array{ bindingDynamicEmissionVM },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &imageInfoDynamicEmissionVM} } },
-		false);
+	initializeCascadeImageSet(m_resSetDynamicEmissionWrite, m_dynamicEmissionVoxelmap, bindingDynamicEmissionVM, VK_IMAGE_LAYOUT_GENERAL, false);
+	initializeCascadeImageSet(m_resSetDynamicEmissionRead, m_dynamicEmissionVoxelmap, bindingDynamicEmissionVM, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, false);
 
 	VkDescriptorSetLayoutBinding bindingRadianceProbes{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
-	VkDescriptorImageInfo radianceProbesAddressInfo{ .imageView = m_ddgiRadianceProbes.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
 	VkDescriptorSetLayoutBinding bindingDistanceProbes{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
-	VkDescriptorImageInfo distanceProbesAddressInfo{ .imageView = m_ddgiDistanceProbes.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	m_resSetProbesWrite.initializeSet(device, 1, {},
+	std::array<VkDescriptorImageInfo, GI_CASCADE_COUNT> radianceProbesAddressInfos{};
+	std::array<VkDescriptorImageInfo, GI_CASCADE_COUNT> distanceProbesAddressInfos{};
+	std::vector<VkDescriptorDataEXT> descDataRadianceProbes(GI_CASCADE_COUNT);
+	std::vector<VkDescriptorDataEXT> descDataDistanceProbes(GI_CASCADE_COUNT);
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		radianceProbesAddressInfos[c] = { .imageView = m_ddgiRadianceProbes[c].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+		distanceProbesAddressInfos[c] = { .imageView = m_ddgiDistanceProbes[c].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+		descDataRadianceProbes[c].pStorageImage = &radianceProbesAddressInfos[c];
+		descDataDistanceProbes[c].pStorageImage = &distanceProbesAddressInfos[c];
+	}
+	m_resSetProbesWrite.initializeSet(device, GI_CASCADE_COUNT, {},
 		std::array{ bindingRadianceProbes, bindingDistanceProbes },
 		std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &radianceProbesAddressInfo} },
-			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &distanceProbesAddressInfo} }},
-		false);
-	radianceProbesAddressInfo.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	m_resSetRadianceProbesRead.initializeSet(device, 1, {},
-		std::array{ bindingRadianceProbes },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &radianceProbesAddressInfo} }},
+		descDataRadianceProbes,
+			descDataDistanceProbes },
 		false);
+	initializeCascadeImageSet(m_resSetRadianceProbesRead, m_ddgiRadianceProbes, bindingRadianceProbes, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, false);
 	bindingDistanceProbes.binding = 0;
-	distanceProbesAddressInfo.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	m_resSetDistanceProbesRead.initializeSet(device, 1, {},
-		std::array{ bindingDistanceProbes },
-		std::array<VkDescriptorBindingFlags, 0>{},
-		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &distanceProbesAddressInfo} }},
-		false);
+	initializeCascadeImageSet(m_resSetDistanceProbesRead, m_ddgiDistanceProbes, bindingDistanceProbes, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, false);
 
+	//Copy c * 2 + i writes the image i of cascade c and reads the other one as history
 	VkDescriptorSetLayoutBinding bindingIrradianceProbeHistory{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
 	VkDescriptorSetLayoutBinding bindingIrradianceProbeNew{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
-	VkDescriptorImageInfo irradianceProbesAddressInfo0{ .imageView = m_ddgiIrradianceProbes[0].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	VkDescriptorImageInfo irradianceProbesAddressInfo1{ .imageView = m_ddgiIrradianceProbes[1].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	m_resSetIrradProbesWrite.initializeSet(device, 2, {},
+	VkDescriptorSetLayoutBinding bindingVisibilityProbeHistory{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+	VkDescriptorSetLayoutBinding bindingVisibilityProbeNew{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+	std::array<VkDescriptorImageInfo, GI_CASCADE_COUNT * 2> irradianceProbesAddressInfos{};
+	std::array<VkDescriptorImageInfo, GI_CASCADE_COUNT * 2> visibilityProbesAddressInfos{};
+	std::vector<VkDescriptorDataEXT> descDataIrradianceProbeHistory(GI_CASCADE_COUNT * 2);
+	std::vector<VkDescriptorDataEXT> descDataIrradianceProbeNew(GI_CASCADE_COUNT * 2);
+	std::vector<VkDescriptorDataEXT> descDataVisibilityProbeHistory(GI_CASCADE_COUNT * 2);
+	std::vector<VkDescriptorDataEXT> descDataVisibilityProbeNew(GI_CASCADE_COUNT * 2);
+	for (int i{ 0 }; i < GI_CASCADE_COUNT * 2; ++i)
+	{
+		irradianceProbesAddressInfos[i] = { .imageView = m_ddgiIrradianceProbes[i].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+		visibilityProbesAddressInfos[i] = { .imageView = m_ddgiVisibilityProbes[i].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	}
+	for (int i{ 0 }; i < GI_CASCADE_COUNT * 2; ++i)
+	{
+		const int history{ i ^ 1 };
+		descDataIrradianceProbeHistory[i].pStorageImage = &irradianceProbesAddressInfos[history];
+		descDataIrradianceProbeNew[i].pStorageImage = &irradianceProbesAddressInfos[i];
+		descDataVisibilityProbeHistory[i].pStorageImage = &visibilityProbesAddressInfos[history];
+		descDataVisibilityProbeNew[i].pStorageImage = &visibilityProbesAddressInfos[i];
+	}
+	m_resSetIrradProbesWrite.initializeSet(device, GI_CASCADE_COUNT * 2, {},
 		std::array{ bindingIrradianceProbeHistory, bindingIrradianceProbeNew },
 		std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &irradianceProbesAddressInfo1}, { .pStorageImage = &irradianceProbesAddressInfo0 } },
-			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &irradianceProbesAddressInfo0}, { .pStorageImage = &irradianceProbesAddressInfo1 } }, },
+		descDataIrradianceProbeHistory,
+			descDataIrradianceProbeNew },
 		false);
-	VkDescriptorSetLayoutBinding bindingVisibilityProbeHistory{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
-	VkDescriptorSetLayoutBinding bindingVisibilityProbeNew{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
-	VkDescriptorImageInfo visibilityProbesAddressInfo0{ .imageView = m_ddgiVisibilityProbes[0].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	VkDescriptorImageInfo visibilityProbesAddressInfo1{ .imageView = m_ddgiVisibilityProbes[1].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-	m_resSetVisibProbesWrite.initializeSet(device, 2, {},
+	m_resSetVisibProbesWrite.initializeSet(device, GI_CASCADE_COUNT * 2, {},
 		std::array{ bindingVisibilityProbeHistory, bindingVisibilityProbeNew },
 		std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &visibilityProbesAddressInfo1}, { .pStorageImage = &visibilityProbesAddressInfo0 } },
-			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &visibilityProbesAddressInfo0}, { .pStorageImage = &visibilityProbesAddressInfo1 } }, },
+		descDataVisibilityProbeHistory,
+			descDataVisibilityProbeNew },
 		false);
 
-	VkDescriptorSetLayoutBinding bindingIrradianceProbes{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
-	VkDescriptorSetLayoutBinding bindingVisibilityProbes{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
-	irradianceProbesAddressInfo0.sampler = generalSampler;
-	irradianceProbesAddressInfo1.sampler = generalSampler;
-	irradianceProbesAddressInfo0.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	irradianceProbesAddressInfo1.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	visibilityProbesAddressInfo0.sampler = generalSampler;
-	visibilityProbesAddressInfo1.sampler = generalSampler;
-	visibilityProbesAddressInfo0.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-	visibilityProbesAddressInfo1.imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+	//Copy i holds the image i of every cascade, indexed by cascade
+	VkDescriptorSetLayoutBinding bindingIrradianceProbes{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = GI_CASCADE_COUNT, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+	VkDescriptorSetLayoutBinding bindingVisibilityProbes{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = GI_CASCADE_COUNT, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+	std::vector<VkDescriptorDataEXT> descDataIrradianceProbes(2 * GI_CASCADE_COUNT);
+	std::vector<VkDescriptorDataEXT> descDataVisibilityProbes(2 * GI_CASCADE_COUNT);
+	for (int i{ 0 }; i < GI_CASCADE_COUNT * 2; ++i)
+	{
+		irradianceProbesAddressInfos[i].sampler = generalSampler;
+		irradianceProbesAddressInfos[i].imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+		visibilityProbesAddressInfos[i].sampler = generalSampler;
+		visibilityProbesAddressInfos[i].imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+	}
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		for (int i{ 0 }; i < 2; ++i)
+		{
+			descDataIrradianceProbes[i * GI_CASCADE_COUNT + c].pCombinedImageSampler = &irradianceProbesAddressInfos[c * 2 + i];
+			descDataVisibilityProbes[i * GI_CASCADE_COUNT + c].pCombinedImageSampler = &visibilityProbesAddressInfos[c * 2 + i];
+		}
+	}
 	m_resSetIndirectDiffuseLighting.initializeSet(device, 2, {},
 		std::array{ bindingIrradianceProbes, bindingVisibilityProbes },
 		std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
-		std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &irradianceProbesAddressInfo0}, { .pCombinedImageSampler = &irradianceProbesAddressInfo1 } },
-		std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &visibilityProbesAddressInfo0}, { .pCombinedImageSampler = &visibilityProbesAddressInfo1 } }},
+		descDataIrradianceProbes,
+		descDataVisibilityProbes },
 		true);
 	VkDescriptorSetLayoutBinding bindingMappedDirections{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT };
 	VkDescriptorAddressInfoEXT mappedDirectionsAddressInfo0{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_mappedDirections[0].getDeviceAddress(), .range = m_mappedDirections[0].getSize() };
@@ -306,6 +342,32 @@ void GI::initialize(VkDevice device,
 		std::vector<std::vector<VkDescriptorDataEXT>>{{
 				std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pUniformBuffer = &mappedDirectionsAddressInfo0 }, VkDescriptorDataEXT{ .pUniformBuffer = &mappedDirectionsAddressInfo1 } }}},
 		false);
+	//Copy c * 2 + i points to the section of cascade c in the buffers i
+	VkDescriptorSetLayoutBinding bindingProbeScheduleList{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorSetLayoutBinding bindingProbeScheduleMask{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	std::array<VkDescriptorAddressInfoEXT, GI_CASCADE_COUNT * 2> probeScheduleListAddressInfos{};
+	std::array<VkDescriptorAddressInfoEXT, GI_CASCADE_COUNT * 2> probeScheduleMaskAddressInfos{};
+	std::vector<VkDescriptorDataEXT> descDataProbeScheduleList(GI_CASCADE_COUNT * 2);
+	std::vector<VkDescriptorDataEXT> descDataProbeScheduleMask(GI_CASCADE_COUNT * 2);
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		for (int i{ 0 }; i < 2; ++i)
+		{
+			probeScheduleListAddressInfos[c * 2 + i] = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+				.address = m_probeScheduleList[i].getDeviceAddress() + DDGI_PROBE_SCHEDULE_LIST_SECTION_SIZE * c, .range = sizeof(uint32_t) * DDGI_PROBE_COUNT };
+			probeScheduleMaskAddressInfos[c * 2 + i] = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+				.address = m_probeScheduleMask[i].getDeviceAddress() + DDGI_PROBE_SCHEDULE_MASK_SECTION_SIZE * c, .range = sizeof(uint32_t) * ((DDGI_PROBE_COUNT + 31) / 32) };
+			descDataProbeScheduleList[c * 2 + i].pStorageBuffer = &probeScheduleListAddressInfos[c * 2 + i];
+			descDataProbeScheduleMask[c * 2 + i].pStorageBuffer = &probeScheduleMaskAddressInfos[c * 2 + i];
+		}
+	}
+	m_resSetProbeSchedule.initializeSet(device, GI_CASCADE_COUNT * 2, VkDescriptorSetLayoutCreateFlagBits{},
+		std::array{ bindingProbeScheduleList, bindingProbeScheduleMask },
+		std::array<VkDescriptorBindingFlags, 0>{},
+		std::vector<std::vector<VkDescriptorDataEXT>>{
+			descDataProbeScheduleList,
+			descDataProbeScheduleMask },
+		false);
 
 	{
 		VkDescriptorSetLayoutBinding bindingReflectionImage{ .binding = 0,
@@ -314,11 +376,17 @@ void GI::initialize(VkDevice device,
 		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
 		VkDescriptorImageInfo reflecGlossyImageInfo{ .sampler = generalSampler, .imageView = m_specularReflectionGlossy.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL };
 		VkDescriptorImageInfo reflecRoughImageInfo{ .sampler = generalSampler, .imageView = m_specularReflectionRough.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL };
+		VkDescriptorSetLayoutBinding bindingGuideImage{ .binding = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorImageInfo guideImageInfo{ .sampler = generalSampler, .imageView = m_specularGuide.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL };
 		m_resSetIndirectSpecularLighting.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
-			std::array{ bindingReflectionImage },
+			std::array{ bindingReflectionImage, bindingGuideImage },
 			std::array<VkDescriptorBindingFlags, 0>{},
 			std::vector<std::vector<VkDescriptorDataEXT>>{{
 					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pSampledImage = &reflecGlossyImageInfo }, VkDescriptorDataEXT{ .pSampledImage = &reflecRoughImageInfo } },
+					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pSampledImage = &guideImageInfo } },
 				}},
 			false);
 	}
@@ -330,25 +398,31 @@ void GI::initialize(VkDevice device,
 		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 		.descriptorCount = 1,
 		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorSetLayoutBinding bindingHistoryImage{ .binding = 2,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
 	VkDescriptorImageInfo srcImageInfo{ .imageView = m_specularReflectionGlossy.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL };
 	VkDescriptorImageInfo dstImageInfo{ .imageView = m_specularReflectionRough.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo historyImageInfo{ .imageView = m_specularHistory.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
 	m_resSetBilateral.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
-		std::array{ bindingSrcImage, bindingDstImage },
+		std::array{ bindingSrcImage, bindingDstImage, bindingHistoryImage },
 		std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{{
 				std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pStorageImage = &srcImageInfo } },
 					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pStorageImage = &dstImageInfo } },
+					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pStorageImage = &historyImageInfo } },
 			}},
 		false);
 
 	VkDescriptorSetLayoutBinding bindingProbesParameters{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT };
-	VkDescriptorAddressInfoEXT probesParametersAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_giMetadata.getDeviceAddress(), .range = m_giMetadata.getSize() };
+	VkDescriptorAddressInfoEXT probesParametersAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_giMetadata[0].getDeviceAddress(), .range = m_giMetadata[0].getSize() };
 	m_resSetGIMetadata.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
 		std::array{ bindingProbesParameters },
 		std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{{
 			std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pUniformBuffer = &probesParametersAddressInfo } }}},
-		false);
+		false, true);
 
 
 
@@ -371,7 +445,7 @@ void GI::initialize(VkDevice device,
 		resourceSetsVoxelize,
 		{ {StaticVertex::getBindingDescription()} },
 		{ StaticVertex::getAttributeDescriptions() },
-		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, .offset = 0, .size = sizeof(m_pcDataBOM)}} });
+		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, .offset = 0, .size = sizeof(m_pcDataBOM)}} });
 
 	std::array<std::reference_wrapper<const ResourceSet>, 1> resourceSetsCreateHOM{ m_resSetWriteHierarchicalOM };
 	m_createHierarchicalOM.initializaCompute(device, "shaders/cmpld/gi_create_hierarchical_OM_comp.spv", resourceSetsCreateHOM,
@@ -385,19 +459,19 @@ void GI::initialize(VkDevice device,
 	m_calcProbeOffsets.initializaCompute(device, "shaders/cmpld/gi_offset_probes_comp.spv", resourceSetsOffsetProbes,
 		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcDataOffsetProbes)}} });
 
-	std::array<std::reference_wrapper<const ResourceSet>, 10> resourceSetsTraceProbes{
+	std::array<std::reference_wrapper<const ResourceSet>, 11> resourceSetsTraceProbes{
 		m_resSetProbesWrite, m_resSetGIMetadata, 
 		m_resSetReadROMA, 
 		m_resSetDynamicEmissionRead, m_resSetAlbedoNormalRead, 
-		m_resSetIndirectDiffuseLighting, m_resSetReadProbeOffsets, m_resSetWriteProbeState, distantProbeRS, BRDFLUTRS };
+		m_resSetIndirectDiffuseLighting, m_resSetReadProbeOffsets, m_resSetWriteProbeState, distantProbeRS, BRDFLUTRS, m_resSetProbeSchedule };
 	m_traceProbes.initializaCompute(device, "shaders/cmpld/gi_probe_tracing_comp.spv", resourceSetsTraceProbes,
 	{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcDataTraceProbes)}} });
 
 
-	std::array<std::reference_wrapper<const ResourceSet>, 4> resourceSetsComputeIrradiance{ m_resSetRadianceProbesRead, m_resSetIrradProbesWrite, m_resSetMappedDirections, m_resSetReadProbeState };
+	std::array<std::reference_wrapper<const ResourceSet>, 5> resourceSetsComputeIrradiance{ m_resSetRadianceProbesRead, m_resSetIrradProbesWrite, m_resSetMappedDirections, m_resSetReadProbeState, m_resSetProbeSchedule };
 	m_computeIrradiance.initializaCompute(device, "shaders/cmpld/gi_compute_irradiance_comp.spv", resourceSetsComputeIrradiance);
 
-	std::array<std::reference_wrapper<const ResourceSet>, 4> resourceSetsComputeVisibility{ m_resSetDistanceProbesRead, m_resSetVisibProbesWrite, m_resSetMappedDirections, m_resSetReadProbeState };
+	std::array<std::reference_wrapper<const ResourceSet>, 5> resourceSetsComputeVisibility{ m_resSetDistanceProbesRead, m_resSetVisibProbesWrite, m_resSetMappedDirections, m_resSetReadProbeState, m_resSetProbeSchedule };
 	m_computeVisibility.initializaCompute(device, "shaders/cmpld/gi_compute_visibility_comp.spv", resourceSetsComputeVisibility);
 
 
@@ -408,53 +482,81 @@ void GI::initialize(VkDevice device,
 	std::array<std::reference_wrapper<const ResourceSet>, 2> resourceSetsMergeEmission{ m_resSetEmissionMetRoughRead, m_resSetDynamicEmissionWrite };
 	m_mergeEmission.initializaCompute(device, "shaders/cmpld/gi_emission_merge_comp.spv", resourceSetsMergeEmission);
 
+	std::array<std::reference_wrapper<const ResourceSet>, 3> resourceSetsClearVoxels{ m_resSetWriteBOM, m_resSetEmissionMetRoughWrite, m_resSetAlbedoNormalWrite };
+	m_clearVoxels.initializaCompute(device, "shaders/cmpld/gi_clear_voxels_comp.spv", resourceSetsClearVoxels,
+		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcDataClearVoxels)}} });
+
 	std::array<std::reference_wrapper<const ResourceSet>, 1> resourceSetsBilateral{ m_resSetBilateral };
 	m_bilateral.initializaCompute(device, "shaders/cmpld/bilateral_comp.spv", resourceSetsBilateral,
 	{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcDataBilateral)}} });
 
 
 
-	GIMetaData* metaData{ reinterpret_cast<GIMetaData*>(m_giMetadata.getData()) };
-	auto& gridData{ metaData->cascades[0].gridData };
-	gridData.relOriginProbePos = -glm::vec3(OCCUPANCY_METER_SIZE / 2.0) + glm::vec3(DDGI_PROBE_X_OFFSET, DDGI_PROBE_Y_OFFSET, DDGI_PROBE_Z_OFFSET);
-	gridData.relEndProbePos = glm::vec3(OCCUPANCY_METER_SIZE / 2.0) - glm::vec3(DDGI_PROBE_X_OFFSET, DDGI_PROBE_Y_OFFSET, DDGI_PROBE_Z_OFFSET);
-	gridData.invProbeTextureResolution = glm::vec2(1.0 / m_ddgiIrradianceProbes[0].getWidth(), 1.0 / m_ddgiIrradianceProbes[0].getHeight());
-	gridData.probeFurthestActiveDistance = DDGI_PROBE_MAX_VISIBILITY_RANGE;
-	gridData.probeCountX = DDGI_PROBE_X_COUNT;
-	gridData.probeCountY = DDGI_PROBE_Y_COUNT;
-	gridData.probeCountZ = DDGI_PROBE_Z_COUNT;
-	gridData.probeDistX = DDGI_PROBE_X_DISTANCE;
-	gridData.probeDistY = DDGI_PROBE_Y_DISTANCE;
-	gridData.probeDistZ = DDGI_PROBE_Z_DISTANCE;
-	gridData.probeInvDistX = static_cast<float>(1.0 / DDGI_PROBE_X_DISTANCE);
-	gridData.probeInvDistY = static_cast<float>(1.0 / DDGI_PROBE_Y_DISTANCE);
-	gridData.probeInvDistZ = static_cast<float>(1.0 / DDGI_PROBE_Z_DISTANCE);
-	gridData.shadowBias = 0.75 * glm::min(glm::min(DDGI_PROBE_X_DISTANCE, DDGI_PROBE_Y_DISTANCE), DDGI_PROBE_Z_DISTANCE) * TUNABLE_SHADOW_BIAS;
-	auto& voxelData{ metaData->cascades[0].voxelData };
-	voxelData.resolutionROM = OCCUPANCY_RESOLUTION;
-	voxelData.resolutionVM = VOXELMAP_RESOLUTION;
-	voxelData.maxMipOM = maxMipLevelHOM;
-	voxelData.occupationMeterSize = OCCUPANCY_METER_SIZE;
-	voxelData.occupationHalfMeterSize = OCCUPANCY_METER_SIZE / 2.0;
-	voxelData.invOccupationHalfMeterSize = static_cast<float>(1.0 / voxelData.occupationHalfMeterSize);
-	voxelData.offsetNormalScaleROM = BIT_TO_METER_SCALE * 1.5;
-	auto& specData{ metaData->specData };
-	specData.specImageRes = glm::ivec2(m_specularReflectionGlossy.getWidth(), m_specularReflectionGlossy.getHeight());
-	specData.invSpecImageRes = glm::vec2(1.0 / m_specularReflectionGlossy.getWidth(), 1.0 / m_specularReflectionGlossy.getHeight());
+	//Cascade c covers a volume 2^c times larger than the finest one with the same resolution, every distance scales with it
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		const float scale{ GI_CASCADE_SCALE(c) };
+		auto& gridData{ m_metadata.cascades[c].gridData };
+		gridData.relOriginProbePos = (-glm::vec3(OCCUPANCY_METER_SIZE / 2.0) + glm::vec3(DDGI_PROBE_X_OFFSET, DDGI_PROBE_Y_OFFSET, DDGI_PROBE_Z_OFFSET)) * scale;
+		gridData.relEndProbePos = (glm::vec3(OCCUPANCY_METER_SIZE / 2.0) - glm::vec3(DDGI_PROBE_X_OFFSET, DDGI_PROBE_Y_OFFSET, DDGI_PROBE_Z_OFFSET)) * scale;
+		gridData.invProbeTextureResolution = glm::vec2(1.0 / m_ddgiIrradianceProbes[0].getWidth(), 1.0 / m_ddgiIrradianceProbes[0].getHeight());
+		gridData.probeFurthestActiveDistance = DDGI_PROBE_MAX_VISIBILITY_RANGE * scale;
+		gridData.probeCountX = DDGI_PROBE_X_COUNT;
+		gridData.probeCountY = DDGI_PROBE_Y_COUNT;
+		gridData.probeCountZ = DDGI_PROBE_Z_COUNT;
+		gridData.probeDistX = DDGI_PROBE_X_DISTANCE * scale;
+		gridData.probeDistY = DDGI_PROBE_Y_DISTANCE * scale;
+		gridData.probeDistZ = DDGI_PROBE_Z_DISTANCE * scale;
+		gridData.probeInvDistX = static_cast<float>(1.0 / (DDGI_PROBE_X_DISTANCE * scale));
+		gridData.probeInvDistY = static_cast<float>(1.0 / (DDGI_PROBE_Y_DISTANCE * scale));
+		gridData.probeInvDistZ = static_cast<float>(1.0 / (DDGI_PROBE_Z_DISTANCE * scale));
+		gridData.shadowBias = 0.75 * glm::min(glm::min(DDGI_PROBE_X_DISTANCE, DDGI_PROBE_Y_DISTANCE), DDGI_PROBE_Z_DISTANCE) * TUNABLE_SHADOW_BIAS * scale;
+		auto& voxelData{ m_metadata.cascades[c].voxelData };
+		voxelData.resolutionROM = OCCUPANCY_RESOLUTION;
+		voxelData.resolutionVM = VOXELMAP_RESOLUTION;
+		voxelData.maxMipOM = maxMipLevelHOM;
+		voxelData.occupationMeterSize = OCCUPANCY_METER_SIZE * scale;
+		voxelData.occupationHalfMeterSize = OCCUPANCY_METER_SIZE / 2.0 * scale;
+		voxelData.invOccupationHalfMeterSize = static_cast<float>(1.0 / voxelData.occupationHalfMeterSize);
+		voxelData.offsetNormalScaleROM = BIT_TO_METER_SCALE * 1.5 * scale;
+	}
+	m_specularExtent = glm::ivec2(m_specularReflectionGlossy.getWidth(), m_specularReflectionGlossy.getHeight());
+	auto& specData{ m_metadata.specData };
+	specData.specImageRes = m_specularExtent;
+	specData.invSpecImageRes = glm::vec2(1.0 / m_specularExtent.x, 1.0 / m_specularExtent.y);
+	uploadMetadata();
+}
+void GI::setSpecularRenderExtent(uint32_t renderWidth, uint32_t renderHeight)
+{
+	glm::ivec2 extent{ glm::min(glm::ivec2(DISPATCH_SIZE(renderWidth, 2u), DISPATCH_SIZE(renderHeight, 2u)), glm::ivec2(m_specularReflectionGlossy.getWidth(), m_specularReflectionGlossy.getHeight())) };
+	if (extent == m_specularExtent)
+		return;
+	m_specularExtent = extent;
+	//History was accumulated over a different part of the images
+	m_specularHistoryValid = false;
+
+	auto& specData{ m_metadata.specData };
+	specData.specImageRes = m_specularExtent;
+	specData.invSpecImageRes = glm::vec2(1.0 / m_specularExtent.x, 1.0 / m_specularExtent.y);
 }
 
 void GI::initializeSpecular(VkDevice device,
 	const DepthBuffer& depthBuffer,
 	const Image& tangentFrameImage,
+	const Image& velocityImage,
+	const ResourceSet& viewprojRS,
 	const ResourceSet& distantProbeRS,
 	const ResourceSet& BRDFLUTRS,
-	VkSampler generalSampler)
+	VkSampler generalSampler,
+	CommandBufferSet& cmdBufferSet,
+	VkQueue queue)
 {
 	VkDescriptorSetLayoutBinding bindingReflectionImage{ .binding = 0,
 	.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 	.descriptorCount = 1,
 	.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorImageInfo reflectionImageInfo{ .imageView = m_specularReflectionGlossy.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	//Traced image is a transient of the render graph and is set after the graph is compiled
+	VkDescriptorImageInfo reflectionImageInfo{ .imageView = m_specularHistory.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
 	VkDescriptorSetLayoutBinding bindingTangentFrameImage{ .binding = 1,
 		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 		.descriptorCount = 1,
@@ -483,92 +585,543 @@ void GI::initializeSpecular(VkDevice device,
 	m_traceSpecular.initializaCompute(device, "shaders/cmpld/gi_trace_specular_comp.spv", resourceSetsTraceSpecular,
 		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcDataTraceSpecular)}} });
 
-	m_specularTraceAndBlurBarriers[0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-		m_specularReflectionGlossy.getImageHandle(), m_specularReflectionGlossy.getSubresourceRange());
-	m_specularTraceAndBlurBarriers[1] =	SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+	VkDescriptorSetLayoutBinding bindingTracedImage{ .binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorImageInfo tracedImageInfo{ .imageView = m_specularHistory.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorSetLayoutBinding bindingHistoryImage{ .binding = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorImageInfo historyImageInfo{ .sampler = generalSampler, .imageView = m_specularHistory.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL };
+	VkDescriptorSetLayoutBinding bindingGlossyImage{ .binding = 2,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorImageInfo glossyImageInfo{ .imageView = m_specularReflectionGlossy.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorSetLayoutBinding bindingGuideImage{ .binding = 3,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorImageInfo guideImageInfo{ .imageView = m_specularGuide.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorSetLayoutBinding bindingReconstructDepthImage{ .binding = 4,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorSetLayoutBinding bindingReconstructTangentFrameImage{ .binding = 5,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorSetLayoutBinding bindingReconstructVelocityImage{ .binding = 6,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorImageInfo velocityImageInfo{ .sampler = generalSampler, .imageView = velocityImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	m_resSetSpecularReconstruct.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
+		std::array{ bindingTracedImage, bindingHistoryImage, bindingGlossyImage, bindingGuideImage, bindingReconstructDepthImage, bindingReconstructTangentFrameImage, bindingReconstructVelocityImage },
+		std::array<VkDescriptorBindingFlags, 0>{},
+		std::vector<std::vector<VkDescriptorDataEXT>>{{
+				std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pStorageImage = &tracedImageInfo } },
+					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pCombinedImageSampler = &historyImageInfo } },
+					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pStorageImage = &glossyImageInfo } },
+					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pStorageImage = &guideImageInfo } },
+					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pCombinedImageSampler = &depthImageInfo } },
+					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pStorageImage = &tangentFrameImageInfo } },
+					std::vector<VkDescriptorDataEXT>{ VkDescriptorDataEXT{ .pCombinedImageSampler = &velocityImageInfo } },
+			}},
+		true);
+
+	std::array<std::reference_wrapper<const ResourceSet>, 2> resourceSetsReconstructSpecular{ viewprojRS, m_resSetSpecularReconstruct };
+	m_reconstructSpecular.initializaCompute(device, "shaders/cmpld/gi_specular_reconstruct_comp.spv", resourceSetsReconstructSpecular,
+		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcDataReconstructSpecular)}} });
+
+	//History is kept in GENERAL between frames
+	VkCommandBuffer cb{ cmdBufferSet.beginTransientRecording() };
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_NONE,
+		0, 0,
 		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-		m_specularReflectionRough.getImageHandle(), m_specularReflectionRough.getSubresourceRange());
-	m_specularTraceAndBlurDependency = SyncOperations::createDependencyInfo(m_specularTraceAndBlurBarriers);
+		m_specularHistory.getImageHandle(), m_specularHistory.getSubresourceRange())} });
+	cmdBufferSet.endRecording(cb);
+	VkSubmitInfo submitInfo{ .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .commandBufferCount = 1, .pCommandBuffers = &cb };
+	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(queue);
+	cmdBufferSet.resetAll();
+}
+
+void GI::setSpecularTracedImage(VkImageView tracedImageView)
+{
+	VkDescriptorImageInfo tracedImageInfo{ .imageView = tracedImageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	m_resSetSpecularWrite.rewriteDescriptor(0, 0, 0, VkDescriptorDataEXT{ .pStorageImage = &tracedImageInfo });
+	m_resSetSpecularReconstruct.rewriteDescriptor(0, 0, 0, VkDescriptorDataEXT{ .pStorageImage = &tracedImageInfo });
 }
 
 void GI::cmdVoxelize(VkCommandBuffer cb, const BufferMapped& indirectDrawCmdData, const Buffer& vertexData, const Buffer& indexData, uint32_t drawCmdCount, uint32_t drawCmdOffset, uint32_t drawCmdStride)
 {
+	m_dirtyDrawRanges.assign(1, DrawRange{ .first = drawCmdOffset / drawCmdStride, .count = drawCmdCount });
+	for (auto& cascade : m_cascades)
+	{
+		cascade.dirtyRegions[0] = { .min = glm::ivec3(0), .max = glm::ivec3(VOXELMAP_RESOLUTION), .firstDrawRange = 0, .drawRangeCount = 1 };
+		cascade.dirtyRegionCount = 1;
+	}
+
 	cmdTransferClearVoxelized(cb);
 
-	VkImageSubresourceRange subresourceRangeBOM{};
-	subresourceRangeBOM = m_occupancyMaps.getSubresourceRange();
-	subresourceRangeBOM.baseMipLevel = 0;
-	subresourceRangeBOM.levelCount = 1;
-	VkImageMemoryBarrier2 barriers[3]{ SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-		m_occupancyMaps.getImageHandle(), subresourceRangeBOM),
-	SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-		m_albedoNormalVoxelmap.getImageHandle(), m_albedoNormalVoxelmap.getSubresourceRange()),
-	SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-		m_emissionMetRoughVoxelmap.getImageHandle(), m_emissionMetRoughVoxelmap.getSubresourceRange()) };
+	VkImageMemoryBarrier2 barriers[3 * GI_CASCADE_COUNT]{};
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		VkImageSubresourceRange subresourceRangeBOM{ m_occupancyMaps[c].getSubresourceRange() };
+		subresourceRangeBOM.baseMipLevel = 0;
+		subresourceRangeBOM.levelCount = 1;
+		barriers[c * 3 + 0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+			m_occupancyMaps[c].getImageHandle(), subresourceRangeBOM);
+		barriers[c * 3 + 1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+			m_albedoNormalVoxelmap[c].getImageHandle(), m_albedoNormalVoxelmap[c].getSubresourceRange());
+		barriers[c * 3 + 2] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+			m_emissionMetRoughVoxelmap[c].getImageHandle(), m_emissionMetRoughVoxelmap[c].getSubresourceRange());
+	}
 	SyncOperations::cmdExecuteBarrier(cb, barriers);
 
-	cmdPassVoxelize(cb, indirectDrawCmdData, vertexData, indexData, drawCmdCount, drawCmdOffset, drawCmdStride);
-
-	barriers[0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
-		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
-		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-		m_occupancyMaps.getImageHandle(), subresourceRangeBOM);
-	barriers[1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
-		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
-		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-		m_albedoNormalVoxelmap.getImageHandle(), m_albedoNormalVoxelmap.getSubresourceRange());
-	barriers[2] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
-		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
-		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-		m_emissionMetRoughVoxelmap.getImageHandle(), m_emissionMetRoughVoxelmap.getSubresourceRange());
+	cmdPassVoxelize(cb, indirectDrawCmdData, vertexData, indexData, drawCmdStride);
+
+	for (auto& barrier : barriers)
+	{
+		barrier.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_NONE;
+		barrier.dstAccessMask = VK_ACCESS_NONE;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+	}
 	SyncOperations::cmdExecuteBarrier(cb, barriers);
 }
 
+void GI::cmdRevoxelizeDirtyRegions(VkCommandBuffer cb, const BufferMapped& indirectDrawCmdData, const Buffer& vertexData, const Buffer& indexData, uint32_t drawCmdStride)
+{
+	//Only the cascades with dirty regions are transitioned, contents outside of the regions are kept
+	VkImageMemoryBarrier2 barriers[3 * GI_CASCADE_COUNT]{};
+	uint32_t barrierCount{ 0 };
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		if (m_cascades[c].dirtyRegionCount == 0)
+			continue;
+		VkImageSubresourceRange subresourceRangeBOM{ m_occupancyMaps[c].getSubresourceRange() };
+		subresourceRangeBOM.baseMipLevel = 0;
+		subresourceRangeBOM.levelCount = 1;
+		barriers[barrierCount++] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+			m_occupancyMaps[c].getImageHandle(), subresourceRangeBOM);
+		barriers[barrierCount++] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+			m_albedoNormalVoxelmap[c].getImageHandle(), m_albedoNormalVoxelmap[c].getSubresourceRange());
+		barriers[barrierCount++] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+			m_emissionMetRoughVoxelmap[c].getImageHandle(), m_emissionMetRoughVoxelmap[c].getSubresourceRange());
+	}
+	if (barrierCount == 0)
+		return;
+	SyncOperations::cmdExecuteBarrier(cb, std::span<const VkImageMemoryBarrier2>(barriers, barrierCount));
+
+	cmdDispatchClearDirtyRegions(cb);
 
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)} });
+
+	cmdPassVoxelize(cb, indirectDrawCmdData, vertexData, indexData, drawCmdStride);
+
+	for (uint32_t i{ 0 }; i < barrierCount; ++i)
+	{
+		barriers[i].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		barriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barriers[i].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[i].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barriers[i].newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+	}
+	SyncOperations::cmdExecuteBarrier(cb, std::span<const VkImageMemoryBarrier2>(barriers, barrierCount));
+}
+
+void GI::updateCameraPosition(const glm::vec3& camPos)
+{
+	auto wrap{ [](const glm::ivec3& value, const glm::ivec3& range) { return ((value % range) + range) % range; } };
+
+	m_dirtyDrawRanges.clear();
+
+	//Every cascade snaps to its own step, in voxels and probes the steps are the same for all of them
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		CascadeState& cascade{ m_cascades[c] };
+		cascade.dirtyRegionCount = 0;
+
+		glm::ivec3 step{ getScrollStep(camPos, c) };
+		glm::ivec3 delta{ step - cascade.scrollStep };
+
+		cascade.probeScrollDeltas[1] = cascade.probeScrollDeltas[0];
+		cascade.probeScrollDeltas[0] = delta * GI_SCROLL_STEP_PROBES;
+
+		if (delta == glm::ivec3(0))
+			continue;
+
+		cascade.scrollStep = step;
+		cascade.scenePosition = SCENE_ORIGIN + glm::vec3(step) * (GI_SCROLL_STEP_METERS * GI_CASCADE_SCALE(c));
+		cascade.voxelScroll = wrap(cascade.voxelScroll + delta * GI_SCROLL_STEP_VOXELS, glm::ivec3(VOXELMAP_RESOLUTION));
+		cascade.probeScroll = wrap(cascade.probeScroll + delta * GI_SCROLL_STEP_PROBES, glm::ivec3(DDGI_PROBE_X_COUNT, DDGI_PROBE_Y_COUNT, DDGI_PROBE_Z_COUNT));
+		cascade.dirtyProbeMin = glm::max(cascade.dirtyProbeMin - cascade.probeScrollDeltas[0], glm::ivec3(0));
+		cascade.dirtyProbeMax = glm::max(cascade.dirtyProbeMax - cascade.probeScrollDeltas[0], glm::ivec3(0));
+
+		//Exposed slabs are in the logical coordinates of the new position
+		glm::ivec3 voxelDelta{ delta * GI_SCROLL_STEP_VOXELS };
+		for (int axis{ 0 }; axis < 3; ++axis)
+		{
+			if (voxelDelta[axis] == 0)
+				continue;
+
+			if (std::abs(voxelDelta[axis]) >= VOXELMAP_RESOLUTION)
+			{
+				cascade.dirtyRegionCount = 0;
+				addDirtyRegion(cascade, glm::ivec3(0), glm::ivec3(VOXELMAP_RESOLUTION));
+				break;
+			}
+			glm::ivec3 min{ 0 };
+			glm::ivec3 max{ VOXELMAP_RESOLUTION };
+			if (voxelDelta[axis] > 0)
+				min[axis] = VOXELMAP_RESOLUTION - voxelDelta[axis];
+			else
+				max[axis] = -voxelDelta[axis];
+			addDirtyRegion(cascade, min, max);
+		}
+	}
+}
+void GI::updateDirtyRegions(const OBBs& boundingBoxes, uint32_t drawCount)
+{
+	const glm::ivec3 probeCount{ DDGI_PROBE_X_COUNT, DDGI_PROBE_Y_COUNT, DDGI_PROBE_Z_COUNT };
+	uint32_t totalRegionCount{ 0 };
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		CascadeState& cascade{ m_cascades[c] };
+		if (cascade.dirtyProbeFramesLeft != 0 && --cascade.dirtyProbeFramesLeft == 0)
+		{
+			cascade.dirtyProbeMin = glm::ivec3(0);
+			cascade.dirtyProbeMax = glm::ivec3(0);
+		}
+
+		const float voxelSize{ static_cast<float>(VOXEL_METER_SCALE) * GI_CASCADE_SCALE(c) };
+		const glm::vec3 volumeOrigin{ cascade.scenePosition - glm::vec3(OCCUPANCY_METER_SIZE / 2.0) * GI_CASCADE_SCALE(c) };
+		for (const WorldBounds& bounds : m_dirtyBounds)
+		{
+			//Dilated by a voxel to account for conservative rasterization
+			glm::ivec3 min{ glm::ivec3(glm::floor((bounds.min - volumeOrigin) / voxelSize)) - 1 };
+			glm::ivec3 max{ glm::ivec3(glm::ceil((bounds.max - volumeOrigin) / voxelSize)) + 1 };
+			min = glm::clamp(min, glm::ivec3(0), glm::ivec3(VOXELMAP_RESOLUTION));
+			max = glm::clamp(max, glm::ivec3(0), glm::ivec3(VOXELMAP_RESOLUTION));
+			if (glm::any(glm::lessThanEqual(max, min)))
+				continue;
+			addDirtyRegion(cascade, min, max);
+
+			//Probes whose cell touches the region
+			glm::ivec3 probeMin{ glm::clamp(min * probeCount / VOXELMAP_RESOLUTION - 1, glm::ivec3(0), probeCount) };
+			glm::ivec3 probeMax{ glm::clamp((max * probeCount + VOXELMAP_RESOLUTION - 1) / VOXELMAP_RESOLUTION + 1, glm::ivec3(0), probeCount) };
+			if (cascade.dirtyProbeFramesLeft != 0)
+			{
+				probeMin = glm::min(probeMin, cascade.dirtyProbeMin);
+				probeMax = glm::max(probeMax, cascade.dirtyProbeMax);
+			}
+			cascade.dirtyProbeMin = probeMin;
+			cascade.dirtyProbeMax = probeMax;
+			cascade.dirtyProbeFramesLeft = GI_DIRTY_PROBE_FRAMES;
+		}
+		totalRegionCount += cascade.dirtyRegionCount;
+	}
+	m_dirtyBounds.clear();
+
+	if (totalRegionCount == 0)
+		return;
+
+	//Only the draws overlapping a region in world space are voxelized into it, grouped into contiguous ranges
+	m_drawBounds.resize(drawCount);
+	for (uint32_t i{ 0 }; i < drawCount; ++i)
+		boundingBoxes.getAABB(i, m_drawBounds[i].min, m_drawBounds[i].max);
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		CascadeState& cascade{ m_cascades[c] };
+		const float voxelSize{ static_cast<float>(VOXEL_METER_SCALE) * GI_CASCADE_SCALE(c) };
+		const glm::vec3 volumeOrigin{ cascade.scenePosition - glm::vec3(OCCUPANCY_METER_SIZE / 2.0) * GI_CASCADE_SCALE(c) };
+		for (uint32_t i{ 0 }; i < cascade.dirtyRegionCount; ++i)
+		{
+			DirtyRegion& region{ cascade.dirtyRegions[i] };
+			glm::vec3 regionMin{ volumeOrigin + glm::vec3(region.min) * voxelSize };
+			glm::vec3 regionMax{ volumeOrigin + glm::vec3(region.max) * voxelSize };
+			region.firstDrawRange = static_cast<uint32_t>(m_dirtyDrawRanges.size());
+			for (uint32_t j{ 0 }; j < drawCount; ++j)
+			{
+				if (glm::any(glm::lessThan(m_drawBounds[j].max, regionMin)) || glm::any(glm::greaterThan(m_drawBounds[j].min, regionMax)))
+					continue;
+				if (m_dirtyDrawRanges.size() > region.firstDrawRange && m_dirtyDrawRanges.back().first + m_dirtyDrawRanges.back().count == j)
+					++m_dirtyDrawRanges.back().count;
+				else
+					m_dirtyDrawRanges.push_back({ .first = j, .count = 1 });
+			}
+			region.drawRangeCount = static_cast<uint32_t>(m_dirtyDrawRanges.size()) - region.firstDrawRange;
+
+			//Physical box of the region, axes that wrap around fall back to the whole extent
+			glm::ivec3 physicalMin{ 0 };
+			glm::ivec3 physicalMax{ VOXELMAP_RESOLUTION };
+			for (int axis{ 0 }; axis < 3; ++axis)
+			{
+				int extent{ region.max[axis] - region.min[axis] };
+				int min{ (region.min[axis] + cascade.voxelScroll[axis]) % VOXELMAP_RESOLUTION };
+				if (min + extent <= VOXELMAP_RESOLUTION)
+				{
+					physicalMin[axis] = min;
+					physicalMax[axis] = min + extent;
+				}
+			}
+			if (cascade.rebuildHOM)
+			{
+				cascade.dirtyHOMMin = glm::min(cascade.dirtyHOMMin, physicalMin);
+				cascade.dirtyHOMMax = glm::max(cascade.dirtyHOMMax, physicalMax);
+			}
+			else
+			{
+				cascade.dirtyHOMMin = physicalMin;
+				cascade.dirtyHOMMax = physicalMax;
+				cascade.rebuildHOM = true;
+			}
+		}
+	}
+}
+void GI::addDirtyRegion(CascadeState& cascade, glm::ivec3 min, glm::ivec3 max)
+{
+	//Aligned to the occupancy packing so that packed texels are cleared whole
+	min = (min / GI_DIRTY_REGION_ALIGNMENT) * GI_DIRTY_REGION_ALIGNMENT;
+	max = glm::min(((max + GI_DIRTY_REGION_ALIGNMENT - 1) / GI_DIRTY_REGION_ALIGNMENT) * GI_DIRTY_REGION_ALIGNMENT, glm::ivec3(VOXELMAP_RESOLUTION));
+
+	if (cascade.dirtyRegionCount == GI_MAX_DIRTY_REGIONS)
+	{
+		DirtyRegion& last{ cascade.dirtyRegions[GI_MAX_DIRTY_REGIONS - 1] };
+		last.min = glm::min(last.min, min);
+		last.max = glm::max(last.max, max);
+		return;
+	}
+	cascade.dirtyRegions[cascade.dirtyRegionCount++] = { .min = min, .max = max };
+}
+void GI::uploadMetadata()
+{
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		const CascadeState& cascade{ m_cascades[c] };
+		auto& gridData{ m_metadata.cascades[c].gridData };
+		gridData.probeScrollX = cascade.probeScroll.x;
+		gridData.probeScrollY = cascade.probeScroll.y;
+		gridData.probeScrollZ = cascade.probeScroll.z;
+		auto& voxelData{ m_metadata.cascades[c].voxelData };
+		voxelData.voxelScrollX = cascade.voxelScroll.x;
+		voxelData.voxelScrollY = cascade.voxelScroll.y;
+		voxelData.voxelScrollZ = cascade.voxelScroll.z;
+		m_metadata.cascades[c].center = cascade.scenePosition;
+	}
+
+	//Every frame writes its own copy, so the host never changes the data a frame in flight reads
+	m_currentMetadata = (m_currentMetadata + 1) % DESCRIPTOR_FRAME_RING_SIZE;
+	std::memcpy(m_giMetadata[m_currentMetadata].getData(), &m_metadata, sizeof(m_metadata));
+	VkDescriptorAddressInfoEXT addressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_giMetadata[m_currentMetadata].getDeviceAddress(), .range = m_giMetadata[m_currentMetadata].getSize() };
+	m_resSetGIMetadata.rewriteDescriptor(0, 0, 0, { .pUniformBuffer = &addressInfo });
+}
+
+void GI::scheduleProbeUpdates(const glm::vec3& camPos, const glm::mat4& viewProjection)
+{
+	++m_probeScheduleFrame;
+
+	//Changed injected lights affect the probes within their range
+	DirtySphere dirtySpheres[MAX_LIGHTS]{};
+	uint32_t dirtySphereCount{ 0 };
+	for (int i{ 0 }; i < m_injectedLightsCount; ++i)
+	{
+		InjectedLightState& state{ m_injectedLightsStates[i] };
+		const Clusterer::LightFormat& lightData{ m_clusterer->m_lightData[m_injectedLightsIndices[i]] };
+		if (lightData.position != state.data.position || lightData.length != state.data.length || lightData.spectrum != state.data.spectrum ||
+			lightData.lightDir != state.data.lightDir || lightData.cutoffCos != state.data.cutoffCos)
+		{
+			state.data = lightData;
+			state.dirtyFramesLeft = GI_DIRTY_PROBE_FRAMES;
+		}
+		if (state.dirtyFramesLeft == 0)
+			continue;
+		--state.dirtyFramesLeft;
+		dirtySpheres[dirtySphereCount++] = { .center = lightData.position, .radius = lightData.length };
+	}
+
+	//Coarser cascades get a decreasing share of the budget, their probes cover less of the screen
+	float weightSum{ 0.0f };
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+		weightSum += std::pow(DDGI_PROBE_CASCADE_BUDGET_FALLOFF, static_cast<float>(c));
+	m_scheduledProbeCount = 0;
+	m_maxProbeAge = 0;
+	m_meanProbeAge = 0.0f;
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		uint32_t budget{ std::max(1u, static_cast<uint32_t>(m_probeUpdateBudget * std::pow(DDGI_PROBE_CASCADE_BUDGET_FALLOFF, static_cast<float>(c)) / weightSum)) };
+		scheduleCascadeProbeUpdates(c, budget, camPos, viewProjection, std::span<const DirtySphere>(dirtySpheres, dirtySphereCount));
+		m_scheduledProbeCount += m_cascades[c].scheduledProbeCount;
+	}
+}
+void GI::scheduleCascadeProbeUpdates(uint32_t cascadeIndex, uint32_t budget, const glm::vec3& camPos, const glm::mat4& viewProjection, std::span<const DirtySphere> dirtySpheres)
+{
+	CascadeState& cascade{ m_cascades[cascadeIndex] };
+	const float scale{ GI_CASCADE_SCALE(cascadeIndex) };
+	const glm::ivec3 probeCount{ DDGI_PROBE_X_COUNT, DDGI_PROBE_Y_COUNT, DDGI_PROBE_Z_COUNT };
+	const glm::vec3 probeDistance{ glm::vec3(DDGI_PROBE_X_DISTANCE, DDGI_PROBE_Y_DISTANCE, DDGI_PROBE_Z_DISTANCE) * scale };
+	const glm::vec3 firstProbePos{ cascade.scenePosition + (-glm::vec3(OCCUPANCY_METER_SIZE / 2.0) + glm::vec3(DDGI_PROBE_X_OFFSET, DDGI_PROBE_Y_OFFSET, DDGI_PROBE_Z_OFFSET)) * scale };
+	const float dirtyRadiusExtension{ DDGI_PROBE_MAX_PROBE_DISTANCE * scale };
+	const uint32_t tileRowSize{ DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT };
+
+	//Every cascade owns a section of the schedule buffers
+	uint32_t* scheduleList{ reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(m_probeScheduleList[m_currentBuffers].getData()) + DDGI_PROBE_SCHEDULE_LIST_SECTION_SIZE * cascadeIndex) };
+	uint32_t* scheduleMask{ reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(m_probeScheduleMask[m_currentBuffers].getData()) + DDGI_PROBE_SCHEDULE_MASK_SECTION_SIZE * cascadeIndex) };
+	std::memset(scheduleMask, 0, DDGI_PROBE_SCHEDULE_MASK_SECTION_SIZE);
+	cascade.scheduledProbeCount = 0;
+
+	//Probes are identified by their tile in the probe images, same as the workgroup mapping in the probe shaders
+	auto schedule{ [&](uint32_t linear)
+		{
+			if (scheduleMask[linear / 32] & (1u << (linear % 32)))
+				return;
+			scheduleMask[linear / 32] |= 1u << (linear % 32);
+			scheduleList[cascade.scheduledProbeCount++] = (linear % tileRowSize) | ((linear / tileRowSize) << 16);
+			cascade.probeLastUpdateFrame[linear] = m_probeScheduleFrame;
+		} };
+	auto isEntering{ [&probeCount](const glm::ivec3& logicalID, const glm::ivec3& scrollDelta)
+		{
+			if (glm::any(glm::lessThan(logicalID, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(logicalID, probeCount)))
+				return false;
+			for (int axis{ 0 }; axis < 3; ++axis)
+			{
+				if (scrollDelta[axis] > 0 ? logicalID[axis] >= probeCount[axis] - scrollDelta[axis] : logicalID[axis] < -scrollDelta[axis])
+					return true;
+			}
+			return false;
+		} };
+
+	//Entering probes have no valid history and are always updated, dirty ones come next, the rest is prioritized by distance and visibility
+	m_probeDirtyCandidates.clear();
+	m_probePriorityCandidates.clear();
+	for (int z{ 0 }; z < probeCount.z; ++z)
+	{
+		for (int y{ 0 }; y < probeCount.y; ++y)
+		{
+			for (int x{ 0 }; x < probeCount.x; ++x)
+			{
+				glm::ivec3 logicalID{ x, y, z };
+				glm::ivec3 physicalID{ (logicalID + cascade.probeScroll) % probeCount };
+				uint32_t linear{ static_cast<uint32_t>(physicalID.y) * tileRowSize + static_cast<uint32_t>(physicalID.z * DDGI_PROBE_Z_COUNT + physicalID.x) };
+
+				if (!cascade.probeStateValid || isEntering(logicalID, cascade.probeScrollDeltas[0]) || isEntering(logicalID + cascade.probeScrollDeltas[0], cascade.probeScrollDeltas[1]))
+				{
+					schedule(linear);
+					continue;
+				}
+
+				glm::vec3 probePos{ firstProbePos + glm::vec3(logicalID) * probeDistance };
+				bool dirty{ glm::all(glm::greaterThanEqual(logicalID, cascade.dirtyProbeMin)) && glm::all(glm::lessThan(logicalID, cascade.dirtyProbeMax)) };
+				for (uint32_t i{ 0 }; i < dirtySpheres.size() && !dirty; ++i)
+					dirty = glm::distance(probePos, dirtySpheres[i].center) < dirtySpheres[i].radius + dirtyRadiusExtension;
+				if (dirty)
+				{
+					m_probeDirtyCandidates.push_back(linear);
+					continue;
+				}
+
+				glm::vec4 clip{ viewProjection * glm::vec4(probePos, 1.0f) };
+				bool inView{ clip.w > 0.0f && std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w };
+				float priority{ glm::distance(probePos, camPos) * (inView ? 1.0f : DDGI_PROBE_OUT_OF_VIEW_PENALTY) };
+				m_probePriorityCandidates.push_back({ priority, linear });
+			}
+		}
+	}
+
+	for (uint32_t i{ 0 }; i < m_probeDirtyCandidates.size() && cascade.scheduledProbeCount < budget; ++i)
+		schedule(m_probeDirtyCandidates[i]);
+
+	//Part of the budget is reserved for the round robin so that every probe is refreshed eventually
+	uint32_t priorityBudget{ static_cast<uint32_t>(budget * (1.0f - DDGI_PROBE_ROUND_ROBIN_SHARE)) };
+	if (cascade.scheduledProbeCount < priorityBudget)
+	{
+		uint32_t priorityCount{ std::min(priorityBudget - cascade.scheduledProbeCount, static_cast<uint32_t>(m_probePriorityCandidates.size())) };
+		std::nth_element(m_probePriorityCandidates.begin(), m_probePriorityCandidates.begin() + priorityCount, m_probePriorityCandidates.end());
+		for (uint32_t i{ 0 }; i < priorityCount; ++i)
+			schedule(m_probePriorityCandidates[i].second);
+	}
+
+	for (uint32_t i{ 0 }; i < DDGI_PROBE_COUNT && cascade.scheduledProbeCount < budget; ++i)
+	{
+		schedule(cascade.probeRoundRobinCursor);
+		cascade.probeRoundRobinCursor = (cascade.probeRoundRobinCursor + 1) % DDGI_PROBE_COUNT;
+	}
+
+	uint64_t ageSum{ 0 };
+	for (uint32_t lastUpdate : cascade.probeLastUpdateFrame)
+	{
+		m_maxProbeAge = std::max(m_maxProbeAge, m_probeScheduleFrame - lastUpdate);
+		ageSum += m_probeScheduleFrame - lastUpdate;
+	}
+	m_meanProbeAge += static_cast<float>(static_cast<double>(ageSum) / (DDGI_PROBE_COUNT * GI_CASCADE_COUNT));
+}
 void GI::cmdTransferClearVoxelized(VkCommandBuffer cb)
 {
-	VkImageSubresourceRange subresourceRange{};
-	subresourceRange = m_occupancyMaps.getSubresourceRange();
-	subresourceRange.baseMipLevel = 0;
-	subresourceRange.levelCount = 1;
-	VkImageMemoryBarrier2 barriers[3]{ SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		m_occupancyMaps.getImageHandle(), subresourceRange),
-	SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		m_albedoNormalVoxelmap.getImageHandle(), m_albedoNormalVoxelmap.getSubresourceRange()),
-	SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		m_emissionMetRoughVoxelmap.getImageHandle(), m_emissionMetRoughVoxelmap.getSubresourceRange()) };
+	VkImageMemoryBarrier2 barriers[3 * GI_CASCADE_COUNT]{};
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		VkImageSubresourceRange subresourceRange{ m_occupancyMaps[c].getSubresourceRange() };
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = 1;
+		barriers[c * 3 + 0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			m_occupancyMaps[c].getImageHandle(), subresourceRange);
+		barriers[c * 3 + 1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			m_albedoNormalVoxelmap[c].getImageHandle(), m_albedoNormalVoxelmap[c].getSubresourceRange());
+		barriers[c * 3 + 2] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			m_emissionMetRoughVoxelmap[c].getImageHandle(), m_emissionMetRoughVoxelmap[c].getSubresourceRange());
+	}
 
 	SyncOperations::cmdExecuteBarrier(cb, barriers);
 
 	VkClearColorValue clearVal{ .uint32 = {0, 0, 0, 0} };
-	vkCmdClearColorImage(cb, m_occupancyMaps.getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subresourceRange);
-	subresourceRange = m_albedoNormalVoxelmap.getSubresourceRange();
-	vkCmdClearColorImage(cb, m_albedoNormalVoxelmap.getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subresourceRange);
-	subresourceRange = m_emissionMetRoughVoxelmap.getSubresourceRange();
-	vkCmdClearColorImage(cb, m_emissionMetRoughVoxelmap.getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subresourceRange);
+	for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		VkImageSubresourceRange subresourceRange{ m_occupancyMaps[c].getSubresourceRange() };
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = 1;
+		vkCmdClearColorImage(cb, m_occupancyMaps[c].getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subresourceRange);
+		subresourceRange = m_albedoNormalVoxelmap[c].getSubresourceRange();
+		vkCmdClearColorImage(cb, m_albedoNormalVoxelmap[c].getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subresourceRange);
+		subresourceRange = m_emissionMetRoughVoxelmap[c].getSubresourceRange();
+		vkCmdClearColorImage(cb, m_emissionMetRoughVoxelmap[c].getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subresourceRange);
+	}
 }
 void GI::cmdTransferClearDynamicEmissionVoxelmap(VkCommandBuffer cb)
 {
 	VkClearColorValue clearVal{ .uint32 = {0, 0, 0, 0} };
-	VkImageSubresourceRange subresourceRange{ m_dynamicEmissionVoxelmap.getSubresourceRange() };
-	vkCmdClearColorImage(cb, m_dynamicEmissionVoxelmap.getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subresourceRange);
+	for (auto& voxelmap : m_dynamicEmissionVoxelmap)
+	{
+		VkImageSubresourceRange subresourceRange{ voxelmap.getSubresourceRange() };
+		vkCmdClearColorImage(cb, voxelmap.getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subresourceRange);
+	}
 }
-void GI::cmdPassVoxelize(VkCommandBuffer cb, const BufferMapped& indirectDrawCmdData, const Buffer& vertexData, const Buffer& indexData, uint32_t drawCmdCount, uint32_t drawCmdOffset, uint32_t drawCmdStride)
+void GI::cmdPassVoxelize(VkCommandBuffer cb, const BufferMapped& indirectDrawCmdData, const Buffer& vertexData, const Buffer& indexData, uint32_t drawCmdStride)
 {
 	VkRenderingInfo renderInfo{};
 	renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
@@ -583,10 +1136,33 @@ void GI::cmdPassVoxelize(VkCommandBuffer cb, const BufferMapped& indirectDrawCmd
 
 	vkCmdBindVertexBuffers(cb, 0, 1, vertexBindings, vertexBindingOffsets);
 	vkCmdBindIndexBuffer(cb, indexData.getBufferHandle(), indexData.getOffset(), VK_INDEX_TYPE_UINT32);
-	m_voxelize.cmdBindResourceSets(cb);
 	m_voxelize.cmdBind(cb);
-	vkCmdPushConstants(cb, m_voxelize.getPipelineLayoutHandle(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(m_pcDataBOM), &m_pcDataBOM);
-	vkCmdDrawIndexedIndirect(cb, indirectDrawCmdData.getBufferHandle(), drawCmdOffset, drawCmdCount, drawCmdStride);
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		const CascadeState& cascade{ m_cascades[c] };
+		if (cascade.dirtyRegionCount == 0)
+			continue;
+		m_voxelize.setResourceInUse(3, c);
+		m_voxelize.setResourceInUse(4, c);
+		m_voxelize.setResourceInUse(5, c);
+		m_voxelize.cmdBindResourceSets(cb);
+		m_pcDataBOM.center = cascade.scenePosition;
+		m_pcDataBOM.halfSide = OCCUPANCY_METER_SIZE / 2.0 * GI_CASCADE_SCALE(c);
+		m_pcDataBOM.voxelScroll = cascade.voxelScroll;
+		for (uint32_t i{ 0 }; i < cascade.dirtyRegionCount; ++i)
+		{
+			const DirtyRegion& region{ cascade.dirtyRegions[i] };
+			m_pcDataBOM.slabMin = region.min;
+			m_pcDataBOM.slabMax = region.max;
+			for (uint32_t j{ region.firstDrawRange }; j < region.firstDrawRange + region.drawRangeCount; ++j)
+			{
+				//gl_DrawID restarts with every draw call, the offset keeps per draw data indexing intact
+				m_pcDataBOM.drawOffset = m_dirtyDrawRanges[j].first;
+				vkCmdPushConstants(cb, m_voxelize.getPipelineLayoutHandle(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(m_pcDataBOM), &m_pcDataBOM);
+				vkCmdDrawIndexedIndirect(cb, indirectDrawCmdData.getBufferHandle(), indirectDrawCmdData.getOffset() + m_dirtyDrawRanges[j].first * drawCmdStride, m_dirtyDrawRanges[j].count, drawCmdStride);
+			}
+		}
+	}
 
 	vkCmdEndRendering(cb);
 }
@@ -597,16 +1173,33 @@ void GI::cmdDispatchCreateHierarchicalOM(VkCommandBuffer cb)
 	constexpr uint32_t groupSizeZ{ 4 };
 
 	m_createHierarchicalOM.cmdBind(cb);
-	m_createHierarchicalOM.cmdBindResourceSets(cb);
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		//The hierarchy is only rebuilt above the bricks touched by voxelization
+		CascadeState& cascade{ m_cascades[c] };
+		if (!cascade.rebuildHOM)
+			continue;
+		cascade.rebuildHOM = false;
 
-	m_pcDataCreateHOM.dstResolution = glm::ivec3(BOM_PACKED_WIDTH, BOM_PACKED_HEIGHT, BOM_PACKED_DEPTH);
+		m_createHierarchicalOM.setResourceInUse(0, c);
+		m_createHierarchicalOM.cmdBindResourceSets(cb);
 
-	for (int i{ 0 }; i < m_omMipsToGenerate; ++i)
-	{
-		m_pcDataCreateHOM.srcMipLevel = i;
-		m_pcDataCreateHOM.dstResolution /= 2;
-		vkCmdPushConstants(cb, m_createHierarchicalOM.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataCreateHOM), &m_pcDataCreateHOM);
-		vkCmdDispatch(cb, DISPATCH_SIZE(m_pcDataCreateHOM.dstResolution.x, groupSizeX), DISPATCH_SIZE(m_pcDataCreateHOM.dstResolution.y, groupSizeY), DISPATCH_SIZE(m_pcDataCreateHOM.dstResolution.z, groupSizeZ));
+		m_pcDataCreateHOM.dstResolution = glm::ivec3(BOM_PACKED_WIDTH, BOM_PACKED_HEIGHT, BOM_PACKED_DEPTH);
+		const glm::ivec3 packing{ glm::ivec3(OCCUPANCY_RESOLUTION) / m_pcDataCreateHOM.dstResolution };
+		glm::ivec3 srcMin{ cascade.dirtyHOMMin / packing };
+		glm::ivec3 srcMax{ (cascade.dirtyHOMMax + packing - 1) / packing };
+
+		for (int i{ 0 }; i < m_omMipsToGenerate; ++i)
+		{
+			m_pcDataCreateHOM.srcMipLevel = i;
+			m_pcDataCreateHOM.dstResolution /= 2;
+			srcMin /= 2;
+			srcMax = (srcMax + 1) / 2;
+			m_pcDataCreateHOM.dstOffset = srcMin;
+			glm::ivec3 extent{ srcMax - srcMin };
+			vkCmdPushConstants(cb, m_createHierarchicalOM.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataCreateHOM), &m_pcDataCreateHOM);
+			vkCmdDispatch(cb, DISPATCH_SIZE(extent.x, groupSizeX), DISPATCH_SIZE(extent.y, groupSizeY), DISPATCH_SIZE(extent.z, groupSizeZ));
+		}
 	}
 }
 void GI::cmdDispatchCreateROMA(VkCommandBuffer cb)
@@ -621,8 +1214,7 @@ void GI::cmdDispatchCreateROMA(VkCommandBuffer cb)
 	constexpr float stratumHorSize{ 1.0f / DDGI_PROBE_LIGHT_SIDE_SIZE };
 	constexpr float stratumVertSize{ 1.0f / DDGI_PROBE_LIGHT_SIDE_SIZE };
 
-	m_createROMA.cmdBind(cb);
-	m_createROMA.cmdBindResourceSets(cb);
+	glm::mat3x4* trMats{ reinterpret_cast<glm::mat3x4*>(m_ROMAtransformMatrices[m_currentBuffers].getData()) };
 	for (int i{ 0 }; i < ROM_NUMBER; ++i)
 	{
 		float u{};
@@ -631,7 +1223,6 @@ void GI::cmdDispatchCreateROMA(VkCommandBuffer cb)
 		v = ((i / strataCountVert) + haltonSequence.getElement(n, 1)) * stratumVertSize;
 		//u = ((i % strataCountHor) + 0.5) * stratumHorSize;
 		//v = ((i / strataCountVert) + 0.5) * stratumVertSize;
-		m_pcDataROM.stable = 0u;
 		m_pcDataROM.directionZ = generateHemisphereDirectionOctohedral(u, v);
 		m_pcDataROM.directionX =
 			glm::normalize(std::abs(m_pcDataROM.directionZ.y) < 0.9999
@@ -640,20 +1231,36 @@ void GI::cmdDispatchCreateROMA(VkCommandBuffer cb)
 				:
 				glm::cross(glm::vec3{ 0.0, 0.0, glm::sign(-m_pcDataROM.directionZ.y) }, m_pcDataROM.directionZ));
 		m_pcDataROM.directionY = glm::cross(m_pcDataROM.directionZ, m_pcDataROM.directionX);
-		glm::mat3x4* trMat{ reinterpret_cast<glm::mat3x4*>(m_ROMAtransformMatrices[m_currentBuffers].getData()) + i };
-		(*trMat)[0] = glm::vec4{ m_pcDataROM.directionX, 0.0 };
-		(*trMat)[1] = glm::vec4{ m_pcDataROM.directionY, 0.0 };
-		(*trMat)[2] = glm::vec4{ m_pcDataROM.directionZ, 0.0 };
-		m_pcDataROM.indexROM = i;
-		m_pcDataROM.resolution = OCCUPANCY_RESOLUTION;
-		glm::vec3 originShift{ m_pcDataROM.directionX + m_pcDataROM.directionY + m_pcDataROM.directionZ };
-		m_pcDataROM.originROMInLocalBOM = (glm::vec3(1.0f) - originShift) * (static_cast<float>(OCCUPANCY_RESOLUTION / 2));
-		m_pcDataROM.originROMInLocalBOM += originShift * 0.5f;
-		vkCmdPushConstants(cb, m_createROMA.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataROM), &m_pcDataROM);
-		constexpr uint32_t groupSizeX{ 8 };
-		constexpr uint32_t groupSizeY{ 8 };
-		constexpr uint32_t groupSizeZ{ 1 };
-		vkCmdDispatch(cb, DISPATCH_SIZE(ROM_PACKED_WIDTH, groupSizeX), DISPATCH_SIZE(ROM_PACKED_HEIGHT, groupSizeY), DISPATCH_SIZE(ROM_PACKED_DEPTH, groupSizeZ));
+		trMats[i][0] = glm::vec4{ m_pcDataROM.directionX, 0.0 };
+		trMats[i][1] = glm::vec4{ m_pcDataROM.directionY, 0.0 };
+		trMats[i][2] = glm::vec4{ m_pcDataROM.directionZ, 0.0 };
+	}
+
+	//Directions are shared by the cascades, the ROMs are in normalized occupancy coordinates
+	m_createROMA.cmdBind(cb);
+	m_pcDataROM.stable = 0u;
+	m_pcDataROM.resolution = OCCUPANCY_RESOLUTION;
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		m_createROMA.setResourceInUse(0, c);
+		m_createROMA.setResourceInUse(1, c);
+		m_createROMA.cmdBindResourceSets(cb);
+		m_pcDataROM.voxelScroll = m_cascades[c].voxelScroll;
+		for (int i{ 0 }; i < ROM_NUMBER; ++i)
+		{
+			m_pcDataROM.directionX = glm::vec3(trMats[i][0]);
+			m_pcDataROM.directionY = glm::vec3(trMats[i][1]);
+			m_pcDataROM.directionZ = glm::vec3(trMats[i][2]);
+			m_pcDataROM.indexROM = i;
+			glm::vec3 originShift{ m_pcDataROM.directionX + m_pcDataROM.directionY + m_pcDataROM.directionZ };
+			m_pcDataROM.originROMInLocalBOM = (glm::vec3(1.0f) - originShift) * (static_cast<float>(OCCUPANCY_RESOLUTION / 2));
+			m_pcDataROM.originROMInLocalBOM += originShift * 0.5f;
+			vkCmdPushConstants(cb, m_createROMA.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataROM), &m_pcDataROM);
+			constexpr uint32_t groupSizeX{ 8 };
+			constexpr uint32_t groupSizeY{ 8 };
+			constexpr uint32_t groupSizeZ{ 1 };
+			vkCmdDispatch(cb, DISPATCH_SIZE(ROM_PACKED_WIDTH, groupSizeX), DISPATCH_SIZE(ROM_PACKED_HEIGHT, groupSizeY), DISPATCH_SIZE(ROM_PACKED_DEPTH, groupSizeZ));
+		}
 	}
 
 	constexpr uint32_t indexLookUp[32]
@@ -677,95 +1284,132 @@ void GI::cmdDispatchCreateROMA(VkCommandBuffer cb)
 void GI::cmdDispatchInjectLights(VkCommandBuffer cb)
 {
 	m_injectLight.cmdBind(cb);
-	m_injectLight.cmdBindResourceSets(cb);
 
-	m_pcDataLightInjection.voxelmapOriginWorld = SCENE_ORIGIN - glm::vec3(OCCUPANCY_METER_SIZE / 2.0);
-	m_pcDataLightInjection.voxelmapScale = 1.0 / VOXEL_METER_SCALE;
 	m_pcDataLightInjection.voxelmapResolution = VOXELMAP_RESOLUTION;
 
-	for (int i{ 0 }, lightID{ 1 }; i < m_injectedLightsCount; ++i, ++lightID)
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
 	{
-		const Clusterer::LightFormat& lightData{ m_clusterer->m_lightData[m_injectedLightsIndices[i]] };
-		Clusterer::LightFormat::Types type{ m_clusterer->m_typeData[m_injectedLightsIndices[i]] };
+		m_injectLight.setResourceInUse(1, c);
+		m_injectLight.setResourceInUse(2, c);
+		m_injectLight.cmdBindResourceSets(cb);
+
+		const float voxelSize{ static_cast<float>(VOXEL_METER_SCALE) * GI_CASCADE_SCALE(c) };
+		m_pcDataLightInjection.voxelmapOriginWorld = m_cascades[c].scenePosition - glm::vec3(OCCUPANCY_METER_SIZE / 2.0) * GI_CASCADE_SCALE(c);
+		m_pcDataLightInjection.voxelmapScale = 1.0 / voxelSize;
+		m_pcDataLightInjection.voxelScroll = m_cascades[c].voxelScroll;
 
+		for (int i{ 0 }, lightID{ 1 }; i < m_injectedLightsCount; ++i, ++lightID)
+		{
+			const Clusterer::LightFormat& lightData{ m_clusterer->m_lightData[m_injectedLightsIndices[i]] };
+			Clusterer::LightFormat::Types type{ m_clusterer->m_typeData[m_injectedLightsIndices[i]] };
 
-		m_pcDataLightInjection.spectrum = lightData.spectrum;
-		m_pcDataLightInjection.lightLength = lightData.length;
-		m_pcDataLightInjection.listIndex = lightData.shadowListIndex;
-		m_pcDataLightInjection.lightID = lightID;
 
-		if (lightData.length < VOXEL_METER_SCALE)
-			continue;
+			m_pcDataLightInjection.spectrum = lightData.spectrum;
+			m_pcDataLightInjection.lightLength = lightData.length;
+			m_pcDataLightInjection.listIndex = lightData.shadowListIndex;
+			m_pcDataLightInjection.lightID = lightID;
 
-		constexpr uint32_t groupSize{ 8 };
-		if (type == Clusterer::LightFormat::Types::TYPE_POINT)
-		{
-			for (int j{ 0 }; j < 6; ++j)
+			if (lightData.length < voxelSize)
+				continue;
+
+			constexpr uint32_t groupSize{ 8 };
+			if (type == Clusterer::LightFormat::Types::TYPE_POINT)
+			{
+				for (int j{ 0 }; j < 6; ++j)
+				{
+					m_pcDataLightInjection.type = type;
+					m_pcDataLightInjection.fovScale = 1.0f;
+					const uint32_t injectionSize{ std::min(DISPATCH_SIZE(uint32_t((lightData.length * 2 * m_pcDataLightInjection.fovScale) / voxelSize), groupSize), static_cast<uint32_t>(VOXELMAP_RESOLUTION / groupSize)) };
+					m_pcDataLightInjection.injectionScale = 1.0f / injectionSize;
+					m_pcDataLightInjection.layerIndex = j;
+					m_pcDataLightInjection.viewmatIndex = lightData.shadowMatrixIndex + j;
+					vkCmdPushConstants(cb, m_injectLight.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataLightInjection), &m_pcDataLightInjection);
+					vkCmdDispatch(cb, injectionSize, injectionSize, 1);
+				}
+			}
+			else
 			{
 				m_pcDataLightInjection.type = type;
-				m_pcDataLightInjection.fovScale = 1.0f;
-				const uint32_t injectionSize{ std::min(DISPATCH_SIZE(uint32_t((lightData.length * 2 * m_pcDataLightInjection.fovScale) / VOXEL_METER_SCALE), groupSize), static_cast<uint32_t>(VOXELMAP_RESOLUTION / groupSize)) };
+				m_pcDataLightInjection.fovScale = std::sqrt(1.0f - lightData.cutoffCos * lightData.cutoffCos) / lightData.cutoffCos;
+				const uint32_t injectionSize{ std::min(DISPATCH_SIZE(uint32_t((lightData.length * 2 * m_pcDataLightInjection.fovScale) / voxelSize), groupSize), static_cast<uint32_t>(VOXELMAP_RESOLUTION / groupSize)) };
 				m_pcDataLightInjection.injectionScale = 1.0f / injectionSize;
-				m_pcDataLightInjection.layerIndex = j;
-				m_pcDataLightInjection.viewmatIndex = lightData.shadowMatrixIndex + j;
+				m_pcDataLightInjection.layerIndex = lightData.shadowLayerIndex;
+				m_pcDataLightInjection.viewmatIndex = lightData.shadowMatrixIndex;
+				m_pcDataLightInjection.lightDir = lightData.lightDir;
+				m_pcDataLightInjection.cutoffCos = lightData.cutoffCos;
+				m_pcDataLightInjection.falloffCos = lightData.falloffCos;
 				vkCmdPushConstants(cb, m_injectLight.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataLightInjection), &m_pcDataLightInjection);
 				vkCmdDispatch(cb, injectionSize, injectionSize, 1);
 			}
-		}
-		else
-		{
-			m_pcDataLightInjection.type = type;
-			m_pcDataLightInjection.fovScale = std::sqrt(1.0f - lightData.cutoffCos * lightData.cutoffCos) / lightData.cutoffCos;
-			const uint32_t injectionSize{ std::min(DISPATCH_SIZE(uint32_t((lightData.length * 2 * m_pcDataLightInjection.fovScale) / VOXEL_METER_SCALE), groupSize), static_cast<uint32_t>(VOXELMAP_RESOLUTION / groupSize)) };
-			m_pcDataLightInjection.injectionScale = 1.0f / injectionSize;
-			m_pcDataLightInjection.layerIndex = lightData.shadowLayerIndex;
-			m_pcDataLightInjection.viewmatIndex = lightData.shadowMatrixIndex;
-			m_pcDataLightInjection.lightDir = lightData.lightDir;
-			m_pcDataLightInjection.cutoffCos = lightData.cutoffCos;
-			m_pcDataLightInjection.falloffCos = lightData.falloffCos;
-			vkCmdPushConstants(cb, m_injectLight.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataLightInjection), &m_pcDataLightInjection);
-			vkCmdDispatch(cb, injectionSize, injectionSize, 1);
-		}
 
-		SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)} });
+			SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)} });
+		}
 	}
 }
 void GI::cmdDispatchMergeEmission(VkCommandBuffer cb)
 {
 	m_mergeEmission.cmdBind(cb);
-	m_mergeEmission.cmdBindResourceSets(cb);
 
 	constexpr uint32_t groupSize{ 4 };
-	vkCmdDispatch(cb, DISPATCH_SIZE(VOXELMAP_RESOLUTION, groupSize), DISPATCH_SIZE(VOXELMAP_RESOLUTION, groupSize), DISPATCH_SIZE(VOXELMAP_RESOLUTION, groupSize));
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		m_mergeEmission.setResourceInUse(0, c);
+		m_mergeEmission.setResourceInUse(1, c);
+		m_mergeEmission.cmdBindResourceSets(cb);
+		vkCmdDispatch(cb, DISPATCH_SIZE(VOXELMAP_RESOLUTION, groupSize), DISPATCH_SIZE(VOXELMAP_RESOLUTION, groupSize), DISPATCH_SIZE(VOXELMAP_RESOLUTION, groupSize));
+	}
 }
 void GI::cmdDispatchCalculateOffsets(VkCommandBuffer cb)
 {
 	m_calcProbeOffsets.cmdBind(cb);
-	m_calcProbeOffsets.cmdBindResourceSets(cb);
 
+	//Probe spacing and resolution scale together, distances in voxels are the same for every cascade
 	m_pcDataOffsetProbes.probeDistancesInVoxels = glm::vec3(DDGI_PROBE_X_DISTANCE / VOXEL_METER_SCALE, DDGI_PROBE_Y_DISTANCE / VOXEL_METER_SCALE, DDGI_PROBE_Z_DISTANCE / VOXEL_METER_SCALE);
 	m_pcDataOffsetProbes.offsetNormalized = VOXEL_METER_SCALE / DDGI_PROBE_MIN_PROBE_DISTANCE;
 
-	vkCmdPushConstants(cb, m_calcProbeOffsets.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataOffsetProbes), &m_pcDataOffsetProbes);
-
 	constexpr uint32_t groupSize{ 4 };
-	vkCmdDispatch(cb, DISPATCH_SIZE(DDGI_PROBE_X_COUNT, groupSize), DISPATCH_SIZE(DDGI_PROBE_Y_COUNT, groupSize), DISPATCH_SIZE(DDGI_PROBE_Z_COUNT, groupSize));
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		m_calcProbeOffsets.setResourceInUse(1, c);
+		m_calcProbeOffsets.setResourceInUse(2, c);
+		m_calcProbeOffsets.setResourceInUse(3, c);
+		m_calcProbeOffsets.cmdBindResourceSets(cb);
+		m_pcDataOffsetProbes.cascadeIndex = c;
+		vkCmdPushConstants(cb, m_calcProbeOffsets.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataOffsetProbes), &m_pcDataOffsetProbes);
+		vkCmdDispatch(cb, DISPATCH_SIZE(DDGI_PROBE_X_COUNT, groupSize), DISPATCH_SIZE(DDGI_PROBE_Y_COUNT, groupSize), DISPATCH_SIZE(DDGI_PROBE_Z_COUNT, groupSize));
+	}
 }
 void GI::cmdDispatchTraceProbes(VkCommandBuffer cb, bool skyboxEnabled)
 {
-	m_traceProbes.setResourceInUse(2, m_currentBuffers);
 	m_traceProbes.setResourceInUse(5, m_currentNewProbes);
 	m_traceProbes.cmdBind(cb);
-	m_traceProbes.cmdBindResourceSets(cb);
 
 	m_pcDataTraceProbes.skyboxEnabled = skyboxEnabled ? 1u : 0u;
-	m_pcDataTraceProbes.minProbeDist = DDGI_PROBE_MIN_PROBE_DISTANCE;
-	vkCmdPushConstants(cb, m_traceProbes.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &m_pcDataTraceProbes);
-	constexpr uint32_t groupSizeX{ DDGI_PROBE_LIGHT_SIDE_SIZE };
-	constexpr uint32_t groupSizeY{ DDGI_PROBE_LIGHT_SIDE_SIZE };
-	constexpr uint32_t groupSizeZ{ 1 };
-	vkCmdDispatch(cb, DISPATCH_SIZE(DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeX), DISPATCH_SIZE(DDGI_PROBE_Y_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeY), 1);
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		const CascadeState& cascade{ m_cascades[c] };
+		if (cascade.scheduledProbeCount == 0)
+			continue;
+		m_traceProbes.setResourceInUse(0, c);
+		m_traceProbes.setResourceInUse(2, c * 2 + m_currentBuffers);
+		m_traceProbes.setResourceInUse(3, c);
+		m_traceProbes.setResourceInUse(4, c);
+		m_traceProbes.setResourceInUse(6, c);
+		m_traceProbes.setResourceInUse(7, c);
+		m_traceProbes.setResourceInUse(10, c * 2 + m_currentBuffers);
+		m_traceProbes.cmdBindResourceSets(cb);
+
+		m_pcDataTraceProbes.minProbeDist = DDGI_PROBE_MIN_PROBE_DISTANCE * GI_CASCADE_SCALE(c);
+		m_pcDataTraceProbes.cascadeIndex = c;
+		m_pcDataTraceProbes.probeScrollDelta = cascade.probeScrollDeltas[0];
+		m_pcDataTraceProbes.probeScrollDeltaPrevious = cascade.probeScrollDeltas[1];
+		m_pcDataTraceProbes.dirtyProbeMin = cascade.dirtyProbeMin;
+		m_pcDataTraceProbes.dirtyProbeMax = cascade.dirtyProbeMax;
+		vkCmdPushConstants(cb, m_traceProbes.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataTraceProbes), &m_pcDataTraceProbes);
+		//One workgroup per scheduled probe
+		vkCmdDispatch(cb, cascade.scheduledProbeCount, 1, 1);
+	}
 }
 void GI::cmdDispatchTraceSpecular(VkCommandBuffer cb, const glm::mat4& worldFromNDC, const glm::vec3& campos, bool skyboxEnabled)
 {
@@ -773,47 +1417,106 @@ void GI::cmdDispatchTraceSpecular(VkCommandBuffer cb, const glm::mat4& worldFrom
 	m_traceSpecular.cmdBind(cb);
 	m_traceSpecular.cmdBindResourceSets(cb);
 
-	m_pcDataTraceSpecular.sceneCenter = SCENE_ORIGIN;
+	//Specular rays are only traced through the finest cascade
+	m_pcDataTraceSpecular.sceneCenter = m_cascades[0].scenePosition;
 	m_pcDataTraceSpecular.worldFromNDC = worldFromNDC;
 	m_pcDataTraceSpecular.campos = campos;
 	m_pcDataTraceSpecular.skyboxEnabled = skyboxEnabled ? 1u : 0u;
+	m_pcDataTraceSpecular.sampleOffset = m_specularSampleOffset;
+	m_pcDataTraceSpecular.checkerboard = m_specularTraceMode == UiData::CHECKERBOARD_SPECULAR_TRACE ? 1u : 0u;
+	m_pcDataTraceSpecular.frameParity = m_specularFrameParity;
 	vkCmdPushConstants(cb, m_traceSpecular.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataTraceSpecular), &m_pcDataTraceSpecular);
 	constexpr uint32_t groupSizeX{ 8 };
 	constexpr uint32_t groupSizeY{ 8 };
-	constexpr uint32_t groupSizeZ{ 1 };
-	vkCmdDispatch(cb, DISPATCH_SIZE(m_specularReflectionGlossy.getWidth(), groupSizeX), DISPATCH_SIZE(m_specularReflectionGlossy.getHeight(), groupSizeY), 1);
+	//In checkerboard mode every row traces only every other texel
+	uint32_t traceWidth{ m_pcDataTraceSpecular.checkerboard ? (m_specularExtent.x + 1) / 2 : m_specularExtent.x };
+	vkCmdDispatch(cb, DISPATCH_SIZE(traceWidth, groupSizeX), DISPATCH_SIZE(m_specularExtent.y, groupSizeY), 1);
+}
+void GI::cmdDispatchReconstructSpecular(VkCommandBuffer cb)
+{
+	m_reconstructSpecular.cmdBind(cb);
+	m_reconstructSpecular.cmdBindResourceSets(cb);
+
+	m_pcDataReconstructSpecular.imgRes = m_specularExtent;
+	m_pcDataReconstructSpecular.sampleOffset = m_specularSampleOffset;
+	m_pcDataReconstructSpecular.checkerboard = m_specularTraceMode == UiData::CHECKERBOARD_SPECULAR_TRACE ? 1u : 0u;
+	m_pcDataReconstructSpecular.frameParity = m_specularFrameParity;
+	m_pcDataReconstructSpecular.historyValid = m_specularHistoryValid ? 1u : 0u;
+	m_pcDataReconstructSpecular.historyWeight = GI_SPECULAR_HISTORY_WEIGHT;
+	vkCmdPushConstants(cb, m_reconstructSpecular.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataReconstructSpecular), &m_pcDataReconstructSpecular);
+	constexpr uint32_t groupSizeX{ 8 };
+	constexpr uint32_t groupSizeY{ 8 };
+	vkCmdDispatch(cb, DISPATCH_SIZE(m_pcDataReconstructSpecular.imgRes.x, groupSizeX), DISPATCH_SIZE(m_pcDataReconstructSpecular.imgRes.y, groupSizeY), 1);
 }
 void GI::cmdDispatchBlurSpecular(VkCommandBuffer cb)
 {
 	m_bilateral.cmdBindResourceSets(cb);
 	m_bilateral.cmdBind(cb);
 
-	m_pcDataBilateral.imgRes = glm::ivec2(m_specularReflectionGlossy.getWidth(), m_specularReflectionGlossy.getHeight());
+	m_pcDataBilateral.imgRes = m_specularExtent;
 	vkCmdPushConstants(cb, m_bilateral.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataBilateral), &m_pcDataBilateral);
 	constexpr uint32_t groupSizeX{ 8 };
 	constexpr uint32_t groupSizeY{ 8 };
 	constexpr uint32_t groupSizeZ{ 1 };
 	vkCmdDispatch(cb, DISPATCH_SIZE(m_pcDataBilateral.imgRes.x, groupSizeX), DISPATCH_SIZE(m_pcDataBilateral.imgRes.y, groupSizeY), groupSizeZ);
 }
+void GI::cmdDispatchClearDirtyRegions(VkCommandBuffer cb)
+{
+	m_clearVoxels.cmdBind(cb);
+
+	m_pcDataClearVoxels.resolution = VOXELMAP_RESOLUTION;
+	constexpr uint32_t groupSize{ 4 };
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		const CascadeState& cascade{ m_cascades[c] };
+		if (cascade.dirtyRegionCount == 0)
+			continue;
+		m_clearVoxels.setResourceInUse(0, c);
+		m_clearVoxels.setResourceInUse(1, c);
+		m_clearVoxels.setResourceInUse(2, c);
+		m_clearVoxels.cmdBindResourceSets(cb);
+		m_pcDataClearVoxels.voxelScroll = cascade.voxelScroll;
+		for (uint32_t i{ 0 }; i < cascade.dirtyRegionCount; ++i)
+		{
+			m_pcDataClearVoxels.slabMin = cascade.dirtyRegions[i].min;
+			m_pcDataClearVoxels.slabMax = cascade.dirtyRegions[i].max;
+			vkCmdPushConstants(cb, m_clearVoxels.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataClearVoxels), &m_pcDataClearVoxels);
+			glm::ivec3 extent{ cascade.dirtyRegions[i].max - cascade.dirtyRegions[i].min };
+			vkCmdDispatch(cb, DISPATCH_SIZE(extent.x, groupSize), DISPATCH_SIZE(extent.y, groupSize), DISPATCH_SIZE(extent.z, groupSize));
+		}
+	}
+}
 void GI::cmdDispatchComputeIrradianceAndVisibility(VkCommandBuffer cb)
 {
-	m_computeIrradiance.setResourceInUse(1, m_currentNewProbes);
-	m_computeIrradiance.setResourceInUse(2, m_currentBuffers);
-	m_computeIrradiance.cmdBind(cb);
-	m_computeIrradiance.cmdBindResourceSets(cb);
 	constexpr uint32_t groupSizeXI{ DDGI_PROBE_LIGHT_SIDE_SIZE };
 	constexpr uint32_t groupSizeYI{ DDGI_PROBE_LIGHT_SIDE_SIZE };
 	constexpr uint32_t groupSizeZI{ 1 };
-	vkCmdDispatch(cb, DISPATCH_SIZE(DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeXI), DISPATCH_SIZE(DDGI_PROBE_Y_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeYI), groupSizeZI);
+	m_computeIrradiance.setResourceInUse(2, m_currentBuffers);
+	m_computeIrradiance.cmdBind(cb);
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		m_computeIrradiance.setResourceInUse(0, c);
+		m_computeIrradiance.setResourceInUse(1, c * 2 + m_currentNewProbes);
+		m_computeIrradiance.setResourceInUse(3, c);
+		m_computeIrradiance.setResourceInUse(4, c * 2 + m_currentBuffers);
+		m_computeIrradiance.cmdBindResourceSets(cb);
+		vkCmdDispatch(cb, DISPATCH_SIZE(DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeXI), DISPATCH_SIZE(DDGI_PROBE_Y_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeYI), groupSizeZI);
+	}
 
-	m_computeVisibility.setResourceInUse(1, m_currentNewProbes);
-	m_computeVisibility.setResourceInUse(2, m_currentBuffers);
-	m_computeVisibility.cmdBind(cb);
-	m_computeVisibility.cmdBindResourceSets(cb);
 	constexpr uint32_t groupSizeXV{ DDGI_PROBE_VISIBILITY_SIDE_SIZE };
 	constexpr uint32_t groupSizeYV{ DDGI_PROBE_VISIBILITY_SIDE_SIZE };
 	constexpr uint32_t groupSizeZV{ 1 };
-	vkCmdDispatch(cb, DISPATCH_SIZE(DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeXV), DISPATCH_SIZE(DDGI_PROBE_Y_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeYV), groupSizeZV);
+	m_computeVisibility.setResourceInUse(2, m_currentBuffers);
+	m_computeVisibility.cmdBind(cb);
+	for (uint32_t c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+	{
+		m_computeVisibility.setResourceInUse(0, c);
+		m_computeVisibility.setResourceInUse(1, c * 2 + m_currentNewProbes);
+		m_computeVisibility.setResourceInUse(3, c);
+		m_computeVisibility.setResourceInUse(4, c * 2 + m_currentBuffers);
+		m_computeVisibility.cmdBindResourceSets(cb);
+		vkCmdDispatch(cb, DISPATCH_SIZE(DDGI_PROBE_X_COUNT * DDGI_PROBE_Z_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeXV), DISPATCH_SIZE(DDGI_PROBE_Y_COUNT * DDGI_PROBE_LIGHT_SIDE_SIZE, groupSizeYV), groupSizeZV);
+	}
 }
 
 void GI::initializeDebug(VkDevice device, const ResourceSet& viewprojRS, uint32_t width, uint32_t height, BufferBaseHostAccessible& baseHostBuffer, VkSampler generalSampler, CommandBufferSet& cmdBufferSet, VkQueue queue)
@@ -849,7 +1552,7 @@ void GI::initializeDebug(VkDevice device, const ResourceSet& viewprojRS, uint32_
 	assembler.setPipelineRenderingState(PipelineAssembler::PIPELINE_RENDERING_STATE_DEFAULT);
 
 	VkDescriptorSetLayoutBinding bindingRadianceProbes{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
-	VkDescriptorImageInfo radianceProbesAddressInfo{ .imageView = m_ddgiRadianceProbes.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo radianceProbesAddressInfo{ .imageView = m_ddgiRadianceProbes[0].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL };
 	VkDescriptorSetLayoutBinding bindingIrradianceProbeHistory{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
 	VkDescriptorImageInfo irradianceProbesAddressInfo0{ .sampler = generalSampler, .imageView = m_ddgiIrradianceProbes[0].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL };
 	VkDescriptorImageInfo irradianceProbesAddressInfo1{ .sampler = generalSampler, .imageView = m_ddgiIrradianceProbes[1].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL };
@@ -882,6 +1585,8 @@ void GI::cmdDrawBOM(VkCommandBuffer cb, const glm::vec3& camPos)
 	m_pcDataDebugVoxel.resolution = OCCUPANCY_RESOLUTION;
 	m_pcDataDebugVoxel.voxelSize = OCCUPANCY_METER_SIZE / OCCUPANCY_RESOLUTION;
 	m_pcDataDebugVoxel.camPos = camPos;
+	m_pcDataDebugVoxel.center = m_cascades[0].scenePosition;
+	m_pcDataDebugVoxel.voxelScroll = m_cascades[0].voxelScroll;
 	m_pcDataDebugVoxel.debugType = UiData::VoxelDebugType::BOM_VOXEL_DEBUG;
 	m_debugVoxel.cmdBindResourceSets(cb);
 	m_debugVoxel.cmdBind(cb);
@@ -893,6 +1598,8 @@ void GI::cmdDrawROM(VkCommandBuffer cb, const glm::vec3& camPos, uint32_t romaIn
 	m_pcDataDebugVoxel.resolution = OCCUPANCY_RESOLUTION;
 	m_pcDataDebugVoxel.voxelSize = OCCUPANCY_METER_SIZE / OCCUPANCY_RESOLUTION;
 	m_pcDataDebugVoxel.camPos = camPos;
+	m_pcDataDebugVoxel.center = m_cascades[0].scenePosition;
+	m_pcDataDebugVoxel.voxelScroll = m_cascades[0].voxelScroll;
 	m_pcDataDebugVoxel.debugType = UiData::VoxelDebugType::ROM_VOXEL_DEBUG;
 	m_pcDataDebugVoxel.indexROMA = romaIndex;
 	m_debugVoxel.cmdBindResourceSets(cb);
@@ -905,6 +1612,8 @@ void GI::cmdDrawAlbedo(VkCommandBuffer cb, const glm::vec3& camPos)
 	m_pcDataDebugVoxel.resolution = VOXELMAP_RESOLUTION;
 	m_pcDataDebugVoxel.voxelSize = OCCUPANCY_METER_SIZE / VOXELMAP_RESOLUTION;
 	m_pcDataDebugVoxel.camPos = camPos;
+	m_pcDataDebugVoxel.center = m_cascades[0].scenePosition;
+	m_pcDataDebugVoxel.voxelScroll = m_cascades[0].voxelScroll;
 	m_pcDataDebugVoxel.debugType = UiData::VoxelDebugType::ALBEDO_VOXEL_DEBUG;
 	m_debugVoxel.cmdBindResourceSets(cb);
 	m_debugVoxel.cmdBind(cb);
@@ -916,6 +1625,8 @@ void GI::cmdDrawMetalness(VkCommandBuffer cb, const glm::vec3& camPos)
 	m_pcDataDebugVoxel.resolution = VOXELMAP_RESOLUTION;
 	m_pcDataDebugVoxel.voxelSize = OCCUPANCY_METER_SIZE / VOXELMAP_RESOLUTION;
 	m_pcDataDebugVoxel.camPos = camPos;
+	m_pcDataDebugVoxel.center = m_cascades[0].scenePosition;
+	m_pcDataDebugVoxel.voxelScroll = m_cascades[0].voxelScroll;
 	m_pcDataDebugVoxel.debugType = UiData::VoxelDebugType::METALNESS_VOXEL_DEBUG;
 	m_debugVoxel.cmdBindResourceSets(cb);
 	m_debugVoxel.cmdBind(cb);
@@ -927,6 +1638,8 @@ void GI::cmdDrawRoughness(VkCommandBuffer cb, const glm::vec3& camPos)
 	m_pcDataDebugVoxel.resolution = VOXELMAP_RESOLUTION;
 	m_pcDataDebugVoxel.voxelSize = OCCUPANCY_METER_SIZE / VOXELMAP_RESOLUTION;
 	m_pcDataDebugVoxel.camPos = camPos;
+	m_pcDataDebugVoxel.center = m_cascades[0].scenePosition;
+	m_pcDataDebugVoxel.voxelScroll = m_cascades[0].voxelScroll;
 	m_pcDataDebugVoxel.debugType = UiData::VoxelDebugType::ROUGHNESS_VOXEL_DEBUG;
 	m_debugVoxel.cmdBindResourceSets(cb);
 	m_debugVoxel.cmdBind(cb);
@@ -938,6 +1651,8 @@ void GI::cmdDrawEmission(VkCommandBuffer cb, const glm::vec3& camPos)
 	m_pcDataDebugVoxel.resolution = VOXELMAP_RESOLUTION;
 	m_pcDataDebugVoxel.voxelSize = OCCUPANCY_METER_SIZE / VOXELMAP_RESOLUTION;
 	m_pcDataDebugVoxel.camPos = camPos;
+	m_pcDataDebugVoxel.center = m_cascades[0].scenePosition;
+	m_pcDataDebugVoxel.voxelScroll = m_cascades[0].voxelScroll;
 	m_pcDataDebugVoxel.debugType = UiData::VoxelDebugType::EMISSION_VOXEL_DEBUG;
 	m_debugVoxel.cmdBindResourceSets(cb);
 	m_debugVoxel.cmdBind(cb);
@@ -947,7 +1662,8 @@ void GI::cmdDrawEmission(VkCommandBuffer cb, const glm::vec3& camPos)
 
 void GI::cmdDrawRadianceProbes(VkCommandBuffer cb)
 {
-	m_pcDataDebugProbes.firstProbePosition = glm::vec3((1.0f / DDGI_PROBE_X_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Y_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Z_COUNT) - 1.0f) * (OCCUPANCY_METER_SIZE / 2);
+	m_pcDataDebugProbes.firstProbePosition = m_cascades[0].scenePosition + glm::vec3((1.0f / DDGI_PROBE_X_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Y_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Z_COUNT) - 1.0f) * (OCCUPANCY_METER_SIZE / 2);
+	m_pcDataDebugProbes.probeScroll = m_cascades[0].probeScroll;
 	m_pcDataDebugProbes.probeCountX = DDGI_PROBE_X_COUNT;
 	m_pcDataDebugProbes.probeCountY = DDGI_PROBE_Y_COUNT;
 	m_pcDataDebugProbes.probeCountZ = DDGI_PROBE_Z_COUNT;
@@ -965,7 +1681,8 @@ void GI::cmdDrawRadianceProbes(VkCommandBuffer cb)
 }
 void GI::cmdDrawIrradianceProbes(VkCommandBuffer cb)
 {
-	m_pcDataDebugProbes.firstProbePosition = glm::vec3((1.0f / DDGI_PROBE_X_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Y_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Z_COUNT) - 1.0f) * (OCCUPANCY_METER_SIZE / 2);
+	m_pcDataDebugProbes.firstProbePosition = m_cascades[0].scenePosition + glm::vec3((1.0f / DDGI_PROBE_X_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Y_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Z_COUNT) - 1.0f) * (OCCUPANCY_METER_SIZE / 2);
+	m_pcDataDebugProbes.probeScroll = m_cascades[0].probeScroll;
 	m_pcDataDebugProbes.probeCountX = DDGI_PROBE_X_COUNT;
 	m_pcDataDebugProbes.probeCountY = DDGI_PROBE_Y_COUNT;
 	m_pcDataDebugProbes.probeCountZ = DDGI_PROBE_Z_COUNT;
@@ -986,7 +1703,8 @@ void GI::cmdDrawIrradianceProbes(VkCommandBuffer cb)
 }
 void GI::cmdDrawVisibilityProbes(VkCommandBuffer cb)
 {
-	m_pcDataDebugProbes.firstProbePosition = glm::vec3((1.0f / DDGI_PROBE_X_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Y_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Z_COUNT) - 1.0f) * (OCCUPANCY_METER_SIZE / 2);
+	m_pcDataDebugProbes.firstProbePosition = m_cascades[0].scenePosition + glm::vec3((1.0f / DDGI_PROBE_X_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Y_COUNT) - 1.0f, (1.0f / DDGI_PROBE_Z_COUNT) - 1.0f) * (OCCUPANCY_METER_SIZE / 2);
+	m_pcDataDebugProbes.probeScroll = m_cascades[0].probeScroll;
 	m_pcDataDebugProbes.probeCountX = DDGI_PROBE_X_COUNT;
 	m_pcDataDebugProbes.probeCountY = DDGI_PROBE_Y_COUNT;
 	m_pcDataDebugProbes.probeCountZ = DDGI_PROBE_Z_COUNT;
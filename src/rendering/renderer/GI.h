@@ -2,8 +2,12 @@
 #define GI_CLASS_HEADER
 
 #include <cmath>
+#include <cstring>
 #include <numbers>
 #include <random>
+#include <algorithm>
+#include <vector>
+#include <span>
 
 #include <glm/glm.hpp>
 #include <glm/geometric.hpp>
@@ -16,6 +20,8 @@
 #include "src/rendering/data_abstraction/vertex_layouts.h"
 #include "src/rendering/renderer/clusterer.h"
 #include "src/rendering/renderer/depth_buffer.h"
+#include "src/rendering/renderer/culling.h"
+#include "src/rendering/data_abstraction/BB.h"
 #include "src/rendering/UI/UIData.h"
 
 #include "src/tools/compile_time_array.h"
@@ -44,6 +50,22 @@
 
 #define HOM_MAX_MIP_LEVELS 16
 
+//Nested volumes centered around the camera with the same resolution, every cascade covers twice the extent of the previous one
+#define GI_CASCADE_COUNT 3
+#define GI_CASCADE_SCALE(cascade) float(1u << (cascade))
+
+//The volume follows the camera in steps which are whole in both voxels and probes, the step of a cascade is scaled with its extent
+#define GI_SCROLL_STEP_VOXELS 16
+#define GI_SCROLL_STEP_PROBES 3
+#define GI_SCROLL_STEP_METERS (GI_SCROLL_STEP_VOXELS * VOXEL_METER_SCALE)
+//Regions of the volume that are cleared and voxelized again during a frame (scroll slabs and moved objects)
+#define GI_MAX_DIRTY_REGIONS 16
+#define GI_DIRTY_REGION_ALIGNMENT 4
+//Frames during which probes around moved objects converge faster
+#define GI_DIRTY_PROBE_FRAMES 8
+//Weight of the reprojected specular history during reconstruction
+#define GI_SPECULAR_HISTORY_WEIGHT 0.9f
+
 #define DDGI_PROBE_LIGHT_SIDE_SIZE 8
 #define DDGI_PROBE_VISIBILITY_SIDE_SIZE 8
 #define DDGI_PROBE_LIGHT_SIDE_SIZE_WITH_BORDERS (DDGI_PROBE_LIGHT_SIDE_SIZE + 2)
@@ -60,28 +82,47 @@
 #define DDGI_PROBE_MIN_PROBE_DISTANCE (std::min(std::min(DDGI_PROBE_X_DISTANCE, DDGI_PROBE_Y_DISTANCE), DDGI_PROBE_Z_DISTANCE))
 #define DDGI_PROBE_MAX_PROBE_DISTANCE (std::sqrt(DDGI_PROBE_X_DISTANCE * DDGI_PROBE_X_DISTANCE + DDGI_PROBE_Y_DISTANCE * DDGI_PROBE_Y_DISTANCE + DDGI_PROBE_Z_DISTANCE * DDGI_PROBE_Z_DISTANCE))
 #define DDGI_PROBE_MAX_VISIBILITY_RANGE DDGI_PROBE_MAX_PROBE_DISTANCE
+#define DDGI_PROBE_COUNT (DDGI_PROBE_X_COUNT * DDGI_PROBE_Y_COUNT * DDGI_PROBE_Z_COUNT)
+//Probe update scheduling
+#define DDGI_PROBE_UPDATE_BUDGET_DEFAULT (DDGI_PROBE_COUNT / 4)
+#define DDGI_PROBE_ROUND_ROBIN_SHARE 0.25f
+#define DDGI_PROBE_OUT_OF_VIEW_PENALTY 4.0f
+//Every coarser cascade gets this fraction of the budget share of the previous one
+#define DDGI_PROBE_CASCADE_BUDGET_FALLOFF 0.5f
+//Schedule buffers hold a section per cascade, each one aligned for storage buffer descriptors
+#define DDGI_PROBE_SCHEDULE_SECTION_ALIGNMENT 256
+#define DDGI_PROBE_SCHEDULE_ALIGN_SECTION(size) ((((size) + DDGI_PROBE_SCHEDULE_SECTION_ALIGNMENT - 1) / DDGI_PROBE_SCHEDULE_SECTION_ALIGNMENT) * DDGI_PROBE_SCHEDULE_SECTION_ALIGNMENT)
+#define DDGI_PROBE_SCHEDULE_LIST_SECTION_SIZE DDGI_PROBE_SCHEDULE_ALIGN_SECTION(sizeof(uint32_t) * DDGI_PROBE_COUNT)
+#define DDGI_PROBE_SCHEDULE_MASK_SECTION_SIZE DDGI_PROBE_SCHEDULE_ALIGN_SECTION(sizeof(uint32_t) * ((DDGI_PROBE_COUNT + 31) / 32))
 
 #define TUNABLE_SHADOW_BIAS 0.7
 
 class GI
 {
 private:
-	Image m_occupancyMaps;
-	Image m_albedoNormalVoxelmap;
-	Image m_emissionMetRoughVoxelmap;
-	Image m_dynamicEmissionVoxelmap;
+	//Volume images are held per cascade, resource sets over them have a copy per cascade
+	std::array<Image, GI_CASCADE_COUNT> m_occupancyMaps;
+	std::array<Image, GI_CASCADE_COUNT> m_albedoNormalVoxelmap;
+	std::array<Image, GI_CASCADE_COUNT> m_emissionMetRoughVoxelmap;
+	std::array<Image, GI_CASCADE_COUNT> m_dynamicEmissionVoxelmap;
 	Image m_specularReflectionGlossy;
 	Image m_specularReflectionRough;
-	Image m_probeOffsetsImage;
-	Image m_probeStateImage;
-	Image m_ddgiRadianceProbes;
-	Image m_ddgiDistanceProbes;
-	std::array<Image, 2> m_ddgiIrradianceProbes;
-	std::array<Image, 2> m_ddgiVisibilityProbes;
-	std::array<Image, ROM_NUMBER> m_rayAlignedOccupancyMapArray;
+	Image m_specularHistory;
+	Image m_specularGuide;
+	std::array<Image, GI_CASCADE_COUNT> m_probeOffsetsImage;
+	std::array<Image, GI_CASCADE_COUNT> m_probeStateImage;
+	std::array<Image, GI_CASCADE_COUNT> m_ddgiRadianceProbes;
+	std::array<Image, GI_CASCADE_COUNT> m_ddgiDistanceProbes;
+	//Ping-pong images of cascade c are at c * 2 and c * 2 + 1
+	std::array<Image, GI_CASCADE_COUNT * 2> m_ddgiIrradianceProbes;
+	std::array<Image, GI_CASCADE_COUNT * 2> m_ddgiVisibilityProbes;
+	//ROMs of cascade c start at c * ROM_NUMBER, their directions are shared by all cascades
+	std::array<Image, GI_CASCADE_COUNT * ROM_NUMBER> m_rayAlignedOccupancyMapArray;
 	BufferMapped m_ROMAtransformMatrices[2]{};
 	BufferMapped m_mappedDirections[2]{};
-	ExteriorImageViews m_hierarchicalOMImageViews;
+	BufferMapped m_probeScheduleList[2]{};
+	BufferMapped m_probeScheduleMask[2]{};
+	std::array<ExteriorImageViews, GI_CASCADE_COUNT> m_hierarchicalOMImageViews;
 
 	uint16_t m_injectedLightsCount{ 0 };
 	uint16_t m_injectedLightsIndices[MAX_LIGHTS]{};
@@ -111,7 +152,9 @@ private:
 	ResourceSet m_resSetIndirectDiffuseLighting{};
 	ResourceSet m_resSetIndirectSpecularLighting{};
 	ResourceSet m_resSetMappedDirections{};
+	ResourceSet m_resSetProbeSchedule{};
 	ResourceSet m_resSetBilateral{};
+	ResourceSet m_resSetSpecularReconstruct{};
 
 	Pipeline m_voxelize{};
 	Pipeline m_createROMA{};
@@ -123,28 +166,119 @@ private:
 	Pipeline m_computeVisibility{};
 	Pipeline m_injectLight{};
 	Pipeline m_mergeEmission{};
+	Pipeline m_reconstructSpecular{};
 	Pipeline m_bilateral{};
+	Pipeline m_clearVoxels{};
 
 	uint32_t m_currentNewProbes{ 0 };
 	uint32_t m_currentBuffers{ 0 };
 	uint32_t m_omMipsToGenerate{ 0 };
 
-	VkImageMemoryBarrier2 m_specularTraceAndBlurBarriers[2]{};
-	VkDependencyInfo m_specularTraceAndBlurDependency{};
+	//Specular is traced at half resolution, either every texel or half of them in a checkerboard, and reconstructed temporally
+	UiData::SpecularTraceMode m_specularTraceMode{ UiData::CHECKERBOARD_SPECULAR_TRACE };
+	uint32_t m_specularFrameParity{ 0 };
+	glm::ivec2 m_specularSampleOffset{ 0 };
+	bool m_specularHistoryValid{ false };
+	//Part of the specular images covered at the current render resolution
+	glm::ivec2 m_specularExtent{ 0 };
 
 	Clusterer* const m_clusterer{ nullptr };
 
+	//Dirty regions are in logical voxel coordinates of their cascade. Each one is voxelized only with the draws overlapping it
+	struct DrawRange
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+	struct DirtyRegion
+	{
+		glm::ivec3 min;
+		glm::ivec3 max;
+		uint32_t firstDrawRange;
+		uint32_t drawRangeCount;
+	};
+	std::vector<DrawRange> m_dirtyDrawRanges{};
+	struct WorldBounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+	std::vector<WorldBounds> m_dirtyBounds{};
+	std::vector<WorldBounds> m_drawBounds{};
+
+	//Camera following state of a cascade. Voxel and probe data is addressed toroidally, physical coordinate = (logical + scroll) % resolution
+	struct CascadeState
+	{
+		glm::vec3 scenePosition{ SCENE_ORIGIN };
+		glm::ivec3 scrollStep{ 0 };
+		glm::ivec3 voxelScroll{ 0 };
+		glm::ivec3 probeScroll{ 0 };
+		glm::ivec3 probeScrollDeltas[2]{};
+
+		DirtyRegion dirtyRegions[GI_MAX_DIRTY_REGIONS]{};
+		uint32_t dirtyRegionCount{ 0 };
+		//Physical voxel box of the occupancy map whose hierarchy has to be rebuilt
+		bool rebuildHOM{ true };
+		glm::ivec3 dirtyHOMMin{ 0 };
+		glm::ivec3 dirtyHOMMax{ VOXELMAP_RESOLUTION };
+		glm::ivec3 dirtyProbeMin{ 0 };
+		glm::ivec3 dirtyProbeMax{ 0 };
+		uint32_t dirtyProbeFramesLeft{ 0 };
+
+		uint32_t scheduledProbeCount{ 0 };
+		uint32_t probeRoundRobinCursor{ 0 };
+		bool probeStateValid{ false };
+		std::vector<uint32_t> probeLastUpdateFrame = std::vector<uint32_t>(DDGI_PROBE_COUNT);
+	};
+	std::array<CascadeState, GI_CASCADE_COUNT> m_cascades{};
+
+	//Probe update scheduling. Only the scheduled probes are traced, the rest keep their history
+	uint32_t m_probeUpdateBudget{ DDGI_PROBE_UPDATE_BUDGET_DEFAULT };
+	uint32_t m_scheduledProbeCount{ 0 };
+	uint32_t m_probeScheduleFrame{ 0 };
+	uint32_t m_maxProbeAge{ 0 };
+	float m_meanProbeAge{ 0.0f };
+	std::vector<std::pair<float, uint32_t>> m_probePriorityCandidates{};
+	std::vector<uint32_t> m_probeDirtyCandidates{};
+	struct InjectedLightState
+	{
+		Clusterer::LightFormat data;
+		uint32_t dirtyFramesLeft;
+	};
+	std::vector<InjectedLightState> m_injectedLightsStates{};
+	//Changed injected lights affect the probes within their range
+	struct DirtySphere
+	{
+		glm::vec3 center;
+		float radius;
+	};
+
 	struct
 	{
+		glm::vec3 center{};
 		float halfSide{};
+		glm::ivec3 slabMin{};
 		uint32_t resolutionBOM{};
+		glm::ivec3 slabMax{};
 		uint32_t resolutionVM{};
+		glm::ivec3 voxelScroll{};
+		uint32_t drawOffset{};
 	} m_pcDataBOM{};
 
+	struct
+	{
+		glm::ivec3 slabMin;
+		int resolution;
+		glm::ivec3 slabMax;
+		uint32_t pad;
+		glm::ivec3 voxelScroll;
+	} m_pcDataClearVoxels{};
+
 	struct
 	{
 		glm::ivec3 dstResolution;
 		uint32_t srcMipLevel;
+		glm::ivec3 dstOffset;
 	} m_pcDataCreateHOM{};
 
 	struct
@@ -156,6 +290,7 @@ private:
 		alignas(16) glm::vec3 directionY{};
 		alignas(16) glm::vec3 originROMInLocalBOM{};
 		uint32_t stable;
+		alignas(16) glm::ivec3 voxelScroll{};
 	} m_pcDataROM{};
 
 	struct
@@ -175,18 +310,25 @@ private:
 		uint32_t layerIndex;
 		uint32_t viewmatIndex;
 		uint32_t type;
+		alignas(16) glm::ivec3 voxelScroll;
 	} m_pcDataLightInjection{};
 
 	struct
 	{
 		glm::vec3 probeDistancesInVoxels;
 		float offsetNormalized;
+		uint32_t cascadeIndex;
 	} m_pcDataOffsetProbes{};
 
 	struct
 	{
 		uint32_t skyboxEnabled;
 		float minProbeDist;
+		uint32_t cascadeIndex;
+		alignas(16) glm::ivec3 probeScrollDelta;
+		alignas(16) glm::ivec3 probeScrollDeltaPrevious;
+		alignas(16) glm::ivec3 dirtyProbeMin;
+		alignas(16) glm::ivec3 dirtyProbeMax;
 	} m_pcDataTraceProbes{};
 
 	struct 
@@ -196,8 +338,21 @@ private:
 		float pad; 
 		glm::vec3 campos; 
 		uint32_t skyboxEnabled;
+		glm::ivec2 sampleOffset;
+		uint32_t checkerboard;
+		uint32_t frameParity;
 	} m_pcDataTraceSpecular{};
 
+	struct
+	{
+		glm::ivec2 imgRes;
+		glm::ivec2 sampleOffset;
+		uint32_t checkerboard;
+		uint32_t frameParity;
+		uint32_t historyValid;
+		float historyWeight;
+	} m_pcDataReconstructSpecular{};
+
 	struct 
 	{ 
 		glm::ivec2 imgRes;
@@ -223,7 +378,9 @@ private:
 		float probeInvDistY;
 		float probeInvDistZ;
 		float shadowBias;
-		//pad3
+		int32_t probeScrollX;
+		int32_t probeScrollY;
+		int32_t probeScrollZ;
 	};
 	static_assert(sizeof(ProbeGridData) == 96);
 	struct alignas(16) SpecularData
@@ -241,20 +398,29 @@ private:
 		float occupationHalfMeterSize;
 		float invOccupationHalfMeterSize;
 		float offsetNormalScaleROM;
-		//pad1
+		int32_t voxelScrollX;
+		int32_t voxelScrollY;
+		int32_t voxelScrollZ;
+		//pad2
 	};
-	static_assert(sizeof(VoxelizationData) == 32);
+	static_assert(sizeof(VoxelizationData) == 48);
 	struct Cascade
 	{
 		ProbeGridData gridData;
 		VoxelizationData voxelData;
+		alignas(16) glm::vec3 center;
+		//pad
 	};
+	static_assert(sizeof(Cascade) == 160);
 	struct GIMetaData
 	{
-		Cascade cascades[1];
+		Cascade cascades[GI_CASCADE_COUNT];
 		SpecularData specData;
 	};
-	BufferMapped m_giMetadata;
+	//Metadata is written on the host and uploaded into the copy of the current frame, frames in flight keep reading their own copy
+	GIMetaData m_metadata{};
+	BufferMapped m_giMetadata[DESCRIPTOR_FRAME_RING_SIZE]{};
+	uint32_t m_currentMetadata{ 0 };
 	ResourceSet m_resSetGIMetadata;
 
 	struct
@@ -264,6 +430,8 @@ private:
 		uint32_t resolution{};
 		float voxelSize{};
 		uint32_t indexROMA{};
+		alignas(16) glm::vec3 center{};
+		alignas(16) glm::ivec3 voxelScroll{};
 	} m_pcDataDebugVoxel{};
 	Pipeline m_debugVoxel{};
 
@@ -279,6 +447,7 @@ private:
 		uint32_t debugType;
 		glm::vec2 invIrradianceTextureResolution;
 		float invProbeMaxActiveDistance;
+		alignas(16) glm::ivec3 probeScroll;
 	} m_pcDataDebugProbes{};
 	ResourceSet m_resSetProbesDebug{};
 	Pipeline m_debugProbes{};
@@ -312,9 +481,42 @@ public:
 		return ROM_NUMBER;
 	}
 
+	//Center of the finest cascade
 	const glm::vec3& getScenePosition() const
 	{
-		return SCENE_ORIGIN;
+		return m_cascades[0].scenePosition;
+	}
+
+	//Must be called once per frame
+	void updateCameraPosition(const glm::vec3& camPos);
+	//Must be called once per frame after the GI state of the frame is updated
+	void uploadMetadata();
+	//World space bounds of geometry that moved. Must be called for both the old and the new bounds of a moved object
+	void markDirtyBounds(const glm::vec3& worldMin, const glm::vec3& worldMax)
+	{
+		m_dirtyBounds.push_back({ .min = worldMin, .max = worldMax });
+	}
+	//Must be called once per frame after updateCameraPosition(). Selects the draws to voxelize for every dirty region
+	void updateDirtyRegions(const OBBs& boundingBoxes, uint32_t drawCount);
+
+	void setProbeUpdateBudget(uint32_t budget)
+	{
+		m_probeUpdateBudget = std::clamp(budget, 1u, static_cast<uint32_t>(DDGI_PROBE_COUNT));
+	}
+	//Summed over all cascades
+	uint32_t getScheduledProbeCount() const
+	{
+		return m_scheduledProbeCount;
+	}
+	//Frames since the least recently updated probe of any cascade was traced
+	uint32_t getMaxProbeAge() const
+	{
+		return m_maxProbeAge;
+	}
+	//Average over the probes of all cascades, tracks how far the volume lags behind a fully updated one as the budget changes
+	float getMeanProbeAge() const
+	{
+		return m_meanProbeAge;
 	}
 
 	void initialize(VkDevice device,
@@ -329,11 +531,17 @@ public:
 	void initializeSpecular(VkDevice device,
 		const DepthBuffer& depthBuffer,
 		const Image& tangentFrameImage,
+		const Image& velocityImage,
+		const ResourceSet& viewprojRS,
 		const ResourceSet& distantProbeRS,
 		const ResourceSet& BRDFLUTRS,
-		VkSampler generalSampler);
+		VkSampler generalSampler,
+		CommandBufferSet& cmdBufferSet,
+		VkQueue queue);
 
 	void cmdVoxelize(VkCommandBuffer cb, const BufferMapped& indirectDrawCmdData, const Buffer& vertexData, const Buffer& indexData, uint32_t drawCmdCount, uint32_t drawCmdOffset, uint32_t drawCmdStride);
+	//Clears and voxelizes only the regions collected by updateCameraPosition() and updateDirtyRegions()
+	void cmdRevoxelizeDirtyRegions(VkCommandBuffer cb, const BufferMapped& indirectDrawCmdData, const Buffer& vertexData, const Buffer& indexData, uint32_t drawCmdStride);
 	
 	template<uint32_t QueryNum>
 	void cmdComputeIndirect(VkCommandBuffer cb,
@@ -341,14 +549,18 @@ public:
 		const uint32_t queryIndexGICreateROMA, 
 		const uint32_t queryIndexGITraceProbes,
 		const uint32_t queryIndexGIComputeIrradianceAndVisibility, 
+		const glm::vec3& camPos,
+		const glm::mat4& viewProjection,
 		bool skyboxEnabled,
 		bool profile)
 	{
 		changeCurrentBuffers();
 
+		scheduleProbeUpdates(camPos, viewProjection);
+
 		{
-			constexpr int romCount{ ROM_NUMBER };
-			VkImageMemoryBarrier2 barriers[romCount + 2]{};
+			constexpr int romCount{ ROM_NUMBER * GI_CASCADE_COUNT };
+			VkImageMemoryBarrier2 barriers[romCount + GI_CASCADE_COUNT * 2]{};
 
 			for (int i{ 0 }; i < romCount; ++i)
 			{
@@ -358,15 +570,18 @@ public:
 					m_rayAlignedOccupancyMapArray[i].getImageHandle(), m_rayAlignedOccupancyMapArray[i].getSubresourceRange());
 			}
 
-			barriers[romCount + 0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-				m_probeOffsetsImage.getImageHandle(), m_probeOffsetsImage.getSubresourceRange());
+			for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+			{
+				barriers[romCount + c * 2 + 0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+					m_probeOffsetsImage[c].getImageHandle(), m_probeOffsetsImage[c].getSubresourceRange());
 
-			barriers[romCount + 1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-				m_occupancyMaps.getImageHandle(), m_occupancyMaps.getSubresourceRange());
+				barriers[romCount + c * 2 + 1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+					m_occupancyMaps[c].getImageHandle(), m_occupancyMaps[c].getSubresourceRange());
+			}
 
 			SyncOperations::cmdExecuteBarrier(cb, barriers);
 		}
@@ -380,8 +595,8 @@ public:
 		if (profile) queries.cmdWriteEnd(cb, queryIndexGICreateROMA);
 
 		{
-			constexpr int romCount{ ROM_NUMBER };
-			VkImageMemoryBarrier2 barriers[romCount + 5]{};
+			constexpr int romCount{ ROM_NUMBER * GI_CASCADE_COUNT };
+			VkImageMemoryBarrier2 barriers[romCount + GI_CASCADE_COUNT * 5]{};
 			for (int i{ 0 }; i < romCount; ++i)
 			{
 				barriers[i] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
@@ -390,30 +605,37 @@ public:
 					m_rayAlignedOccupancyMapArray[i].getImageHandle(), m_rayAlignedOccupancyMapArray[i].getSubresourceRange());
 			}
 
-			barriers[romCount + 0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-				m_ddgiRadianceProbes.getImageHandle(), m_ddgiRadianceProbes.getSubresourceRange());
+			for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+			{
+				VkImageMemoryBarrier2* cascadeBarriers{ barriers + romCount + c * 5 };
+
+				cascadeBarriers[0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+					m_ddgiRadianceProbes[c].getImageHandle(), m_ddgiRadianceProbes[c].getSubresourceRange());
 
-			barriers[romCount + 1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-				m_ddgiDistanceProbes.getImageHandle(), m_ddgiDistanceProbes.getSubresourceRange());
+				cascadeBarriers[1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+					m_ddgiDistanceProbes[c].getImageHandle(), m_ddgiDistanceProbes[c].getSubresourceRange());
 
-			barriers[romCount + 2] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-				m_probeOffsetsImage.getImageHandle(), m_probeOffsetsImage.getSubresourceRange());
+				cascadeBarriers[2] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+					m_probeOffsetsImage[c].getImageHandle(), m_probeOffsetsImage[c].getSubresourceRange());
 
-			barriers[romCount + 3] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-				m_probeStateImage.getImageHandle(), m_probeStateImage.getSubresourceRange());
+				//States of the probes not scheduled this frame are kept
+				cascadeBarriers[3] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+					m_cascades[c].probeStateValid ? VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+					m_probeStateImage[c].getImageHandle(), m_probeStateImage[c].getSubresourceRange());
+				m_cascades[c].probeStateValid = true;
 
-			barriers[romCount + 4] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-				m_occupancyMaps.getImageHandle(), m_occupancyMaps.getSubresourceRange());
+				cascadeBarriers[4] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+					m_occupancyMaps[c].getImageHandle(), m_occupancyMaps[c].getSubresourceRange());
+			}
 
 			SyncOperations::cmdExecuteBarrier(cb, barriers);
 		}
@@ -425,33 +647,38 @@ public:
 		changeHistoryAndNewProbes();
 
 		{
-			VkImageMemoryBarrier2 barriers[5]{};
+			VkImageMemoryBarrier2 barriers[GI_CASCADE_COUNT * 5]{};
 
-			barriers[0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-				m_ddgiRadianceProbes.getImageHandle(), m_ddgiRadianceProbes.getSubresourceRange());
+			for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+			{
+				VkImageMemoryBarrier2* cascadeBarriers{ barriers + c * 5 };
+				const uint32_t newProbes{ c * 2 + m_currentNewProbes };
 
-			barriers[1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-				m_ddgiDistanceProbes.getImageHandle(), m_ddgiDistanceProbes.getSubresourceRange());
+				cascadeBarriers[0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+					m_ddgiRadianceProbes[c].getImageHandle(), m_ddgiRadianceProbes[c].getSubresourceRange());
 
+				cascadeBarriers[1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+					m_ddgiDistanceProbes[c].getImageHandle(), m_ddgiDistanceProbes[c].getSubresourceRange());
 
-			barriers[2] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-				m_ddgiIrradianceProbes[m_currentNewProbes].getImageHandle(), m_ddgiIrradianceProbes[m_currentNewProbes].getSubresourceRange());
+				cascadeBarriers[2] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+					m_ddgiIrradianceProbes[newProbes].getImageHandle(), m_ddgiIrradianceProbes[newProbes].getSubresourceRange());
 
-			barriers[3] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-				m_ddgiVisibilityProbes[m_currentNewProbes].getImageHandle(), m_ddgiVisibilityProbes[m_currentNewProbes].getSubresourceRange());
+				cascadeBarriers[3] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+					m_ddgiVisibilityProbes[newProbes].getImageHandle(), m_ddgiVisibilityProbes[newProbes].getSubresourceRange());
 
-			barriers[4] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-				m_probeStateImage.getImageHandle(), m_probeStateImage.getSubresourceRange());
+				cascadeBarriers[4] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+					m_probeStateImage[c].getImageHandle(), m_probeStateImage[c].getSubresourceRange());
+			}
 
 			SyncOperations::cmdExecuteBarrier(cb, barriers);
 		}
@@ -461,17 +688,22 @@ public:
 		if (profile) queries.cmdWriteEnd(cb, queryIndexGIComputeIrradianceAndVisibility);
 
 		{
-			VkImageMemoryBarrier2 barriers[2]{};
+			VkImageMemoryBarrier2 barriers[GI_CASCADE_COUNT * 2]{};
 
-			barriers[0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
-				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
-				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-				m_ddgiIrradianceProbes[m_currentNewProbes].getImageHandle(), m_ddgiIrradianceProbes[m_currentNewProbes].getSubresourceRange());
+			for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+			{
+				const uint32_t newProbes{ c * 2 + m_currentNewProbes };
 
-			barriers[1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
-				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
-				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-				m_ddgiVisibilityProbes[m_currentNewProbes].getImageHandle(), m_ddgiVisibilityProbes[m_currentNewProbes].getSubresourceRange());
+				barriers[c * 2 + 0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
+					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
+					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+					m_ddgiIrradianceProbes[newProbes].getImageHandle(), m_ddgiIrradianceProbes[newProbes].getSubresourceRange());
+
+				barriers[c * 2 + 1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
+					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
+					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+					m_ddgiVisibilityProbes[newProbes].getImageHandle(), m_ddgiVisibilityProbes[newProbes].getSubresourceRange());
+			}
 
 			SyncOperations::cmdExecuteBarrier(cb, barriers);
 		}
@@ -483,23 +715,27 @@ public:
 		const uint32_t queryIndexGIInjectLights,
 		bool profile)
 	{
-		SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			m_dynamicEmissionVoxelmap.getImageHandle(), m_dynamicEmissionVoxelmap.getSubresourceRange())} });
+		VkImageMemoryBarrier2 barriers[GI_CASCADE_COUNT]{};
+
+		for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+		{
+			barriers[c] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				m_dynamicEmissionVoxelmap[c].getImageHandle(), m_dynamicEmissionVoxelmap[c].getSubresourceRange());
+		}
+		SyncOperations::cmdExecuteBarrier(cb, barriers);
 
 		cmdTransferClearDynamicEmissionVoxelmap(cb);
 
+		for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
 		{
-			VkImageMemoryBarrier2 barriers[1]{};
-
-			barriers[0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			barriers[c] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-				m_dynamicEmissionVoxelmap.getImageHandle(), m_dynamicEmissionVoxelmap.getSubresourceRange());
-
-			SyncOperations::cmdExecuteBarrier(cb, barriers);
+				m_dynamicEmissionVoxelmap[c].getImageHandle(), m_dynamicEmissionVoxelmap[c].getSubresourceRange());
 		}
+		SyncOperations::cmdExecuteBarrier(cb, barriers);
 
 		if (profile) queries.cmdWriteStart(cb, queryIndexGIInjectLights);
 		cmdDispatchInjectLights(cb);
@@ -510,41 +746,70 @@ public:
 
 		cmdDispatchMergeEmission(cb);
 
-		SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
-			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
-			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-			m_dynamicEmissionVoxelmap.getImageHandle(), m_dynamicEmissionVoxelmap.getSubresourceRange())} });
+		for (int c{ 0 }; c < GI_CASCADE_COUNT; ++c)
+		{
+			barriers[c] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+				m_dynamicEmissionVoxelmap[c].getImageHandle(), m_dynamicEmissionVoxelmap[c].getSubresourceRange());
+		}
+		SyncOperations::cmdExecuteBarrier(cb, barriers);
+	}
+
+	void setSpecularRenderExtent(uint32_t renderWidth, uint32_t renderHeight);
+	void setSpecularTraceMode(UiData::SpecularTraceMode mode)
+	{
+		if (mode != m_specularTraceMode)
+			m_specularHistoryValid = false;
+		m_specularTraceMode = mode;
 	}
 
+	//The jitter of the current frame selects which full resolution pixel of every 2x2 block is traced
 	void cmdTraceSpecular(VkCommandBuffer cb,
 		const glm::mat4& inverseViewProjectionMatrix,
 		const glm::vec3 camPos,
+		const glm::vec2& jitter,
 		bool skyboxEnabled)
 	{
-		{
-			VkImageMemoryBarrier2 barriers[1]{};
-
-			barriers[0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-				m_specularReflectionGlossy.getImageHandle(), m_specularReflectionGlossy.getSubresourceRange());
-
-			SyncOperations::cmdExecuteBarrier(cb, barriers);
-		}
-
+		m_specularFrameParity = m_specularFrameParity ? 0 : 1;
+		m_specularSampleOffset = glm::ivec2(jitter.x >= 0.0f ? 1 : 0, jitter.y >= 0.0f ? 1 : 0);
 		cmdDispatchTraceSpecular(cb, inverseViewProjectionMatrix, camPos, skyboxEnabled);
 	}
+	void cmdReconstructSpecular(VkCommandBuffer cb)
+	{
+		cmdDispatchReconstructSpecular(cb);
+		m_specularHistoryValid = true;
+	}
 
-	VkDependencyInfo getSpecularTraceAndBlurDependency()
+	const Image& getSpecularReflectionGlossy() const
+	{
+		return m_specularReflectionGlossy;
+	}
+	const Image& getSpecularReflectionRough() const
+	{
+		return m_specularReflectionRough;
+	}
+	VkFormat getSpecularTracedFormat() const
+	{
+		return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+	}
+	uint32_t getSpecularTracedWidth() const
 	{
-		return m_specularTraceAndBlurDependency;
+		return m_specularReflectionGlossy.getWidth();
 	}
-	VkImageMemoryBarrier2 getBlurredSpecularBarrier()
+	uint32_t getSpecularTracedHeight() const
 	{
-		return SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-			m_specularReflectionRough.getImageHandle(), m_specularReflectionRough.getSubresourceRange());
+		return m_specularReflectionGlossy.getHeight();
+	}
+	//Traced image is a transient of the render graph and is only alive between the trace and the reconstruct passes
+	void setSpecularTracedImage(VkImageView tracedImageView);
+	const Image& getSpecularHistory() const
+	{
+		return m_specularHistory;
+	}
+	const Image& getSpecularGuide() const
+	{
+		return m_specularGuide;
 	}
 
 	void cmdBlurSpecular(VkCommandBuffer cb)
@@ -555,7 +820,7 @@ public:
 private:
 	void cmdTransferClearVoxelized(VkCommandBuffer cb);
 	void cmdTransferClearDynamicEmissionVoxelmap(VkCommandBuffer cb);
-	void cmdPassVoxelize(VkCommandBuffer cb, const BufferMapped& indirectDrawCmdData, const Buffer& vertexData, const Buffer& indexData, uint32_t drawCmdCount, uint32_t drawCmdOffset, uint32_t drawCmdStride);
+	void cmdPassVoxelize(VkCommandBuffer cb, const BufferMapped& indirectDrawCmdData, const Buffer& vertexData, const Buffer& indexData, uint32_t drawCmdStride);
 	void cmdDispatchCreateHierarchicalOM(VkCommandBuffer cb);
 	void cmdDispatchCreateROMA(VkCommandBuffer cb);
 	void cmdDispatchInjectLights(VkCommandBuffer cb);
@@ -564,7 +829,17 @@ private:
 	void cmdDispatchTraceProbes(VkCommandBuffer cb, bool skyboxEnabled);
 	void cmdDispatchTraceSpecular(VkCommandBuffer cb, const glm::mat4& worldFromNDC, const glm::vec3& campos, bool skyboxEnabled);
 	void cmdDispatchComputeIrradianceAndVisibility(VkCommandBuffer cb);
+	void cmdDispatchReconstructSpecular(VkCommandBuffer cb);
 	void cmdDispatchBlurSpecular(VkCommandBuffer cb);
+	void cmdDispatchClearDirtyRegions(VkCommandBuffer cb);
+
+	glm::ivec3 getScrollStep(const glm::vec3& camPos, uint32_t cascade) const
+	{
+		return glm::ivec3(glm::floor((camPos - SCENE_ORIGIN) / (GI_SCROLL_STEP_METERS * GI_CASCADE_SCALE(cascade)) + 0.5f));
+	}
+	void addDirtyRegion(CascadeState& cascade, glm::ivec3 min, glm::ivec3 max);
+	void scheduleProbeUpdates(const glm::vec3& camPos, const glm::mat4& viewProjection);
+	void scheduleCascadeProbeUpdates(uint32_t cascadeIndex, uint32_t budget, const glm::vec3& camPos, const glm::mat4& viewProjection, std::span<const DirtySphere> dirtySpheres);
 
 	void changeHistoryAndNewProbes()
 	{
@@ -594,6 +869,7 @@ private:
 	void addLightToInject(uint32_t index)
 	{
 		m_injectedLightsIndices[m_injectedLightsCount++] = index;
+		m_injectedLightsStates.push_back({ .data = m_clusterer->m_lightData[index], .dirtyFramesLeft = GI_DIRTY_PROBE_FRAMES });
 	}
 
 	glm::vec3 generateHemisphereDirectionOctohedral(float u, float v)
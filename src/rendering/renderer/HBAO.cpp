@@ -1,8 +1,11 @@
 #include "src/rendering/renderer/HBAO.h"
 
-HBAO::HBAO(VkDevice device, uint32_t aoRenderWidth, uint32_t aoRenderHeight, const DepthBuffer& depthBuffer, CommandBufferSet& cmdBufferSet, VkQueue queue) :
-	m_AOImage{ device, VK_FORMAT_R8_UNORM, aoRenderWidth, aoRenderHeight, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT },
+HBAO::HBAO(VkDevice device, uint32_t aoRenderWidth, uint32_t aoRenderHeight, const DepthBuffer& depthBuffer, const ResourceSet& viewprojRS, CommandBufferSet& cmdBufferSet, VkQueue queue) :
 	m_blurredAOImage{ device, VK_FORMAT_R8_UNORM, aoRenderWidth, aoRenderHeight, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT },
+	m_historyAO{ Image{ device, VK_FORMAT_R16G16_SFLOAT, aoRenderWidth, aoRenderHeight, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT },
+				 Image{ device, VK_FORMAT_R16G16_SFLOAT, aoRenderWidth, aoRenderHeight, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT } },
+	m_deinterleavedDepth{ device, DISPATCH_SIZE(aoRenderWidth, HBAO_DEINTERLEAVE_FACTOR), DISPATCH_SIZE(aoRenderHeight, HBAO_DEINTERLEAVE_FACTOR), VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false, HBAO_DEINTERLEAVED_LAYER_COUNT },
 	m_randTex{ device, VK_FORMAT_R16G16B16A16_SNORM, RANDOM_TEXTURE_SIZE, RANDOM_TEXTURE_SIZE, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT },
 	m_device{ device }
 {
@@ -40,52 +43,91 @@ HBAO::HBAO(VkDevice device, uint32_t aoRenderWidth, uint32_t aoRenderHeight, con
 	VkDescriptorImageInfo randImageInfo{ .sampler = m_randSampler, .imageView = m_randTex.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
 
 	VkDescriptorSetLayoutBinding aoOutImageBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorImageInfo aoOutImageInfo{ .imageView = m_AOImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	//Placeholder until the raw AO image is assigned through setRawAOImage()
+	VkDescriptorImageInfo aoOutImageInfo{ .imageView = m_blurredAOImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+
+	VkDescriptorSetLayoutBinding deinterleavedDepthBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorImageInfo deinterleavedDepthInfo{ .sampler = m_hbaoSampler, .imageView = m_deinterleavedDepth.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
 
 	m_resSets[0].initializeSet(device, 1, VkDescriptorSetLayoutCreateFlags{},
-		std::array{ depthImageBinding, randBinding, aoOutImageBinding }, std::array<VkDescriptorBindingFlags, 0>{},
+		std::array{ depthImageBinding, randBinding, aoOutImageBinding, deinterleavedDepthBinding }, std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
 			std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &depthImageInfo} },
 			std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &randImageInfo} },
-			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &aoOutImageInfo} }},
+			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &aoOutImageInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &deinterleavedDepthInfo} }},
+		true);
+
+	VkDescriptorSetLayoutBinding deinterleavedDepthOutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorImageInfo deinterleavedDepthOutInfo{ .imageView = m_deinterleavedDepth.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+
+	m_resSets[3].initializeSet(device, 1, VkDescriptorSetLayoutCreateFlags{},
+		std::array{ depthImageBinding, deinterleavedDepthOutBinding }, std::array<VkDescriptorBindingFlags, 0>{},
+		std::vector<std::vector<VkDescriptorDataEXT>>{
+			std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &depthImageInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &deinterleavedDepthOutInfo} }},
 		true);
 
-	std::reference_wrapper<const ResourceSet> resSet[1]{ m_resSets[0] };
+	std::reference_wrapper<const ResourceSet> resSet[1]{ m_resSets[3] };
+
+	m_deinterleavePass.initializaCompute(device, "shaders/cmpld/hbao_deinterleave_comp.spv", resSet,
+		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(glm::vec2) + sizeof(glm::uvec2) + sizeof(glm::vec2) + sizeof(float) * 2}} });
+
+	resSet[0] = m_resSets[0];
 
 	m_HBAOpass.initializaCompute(device, "shaders/cmpld/hbao_comp.spv", resSet, 
 		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_hbaoInfo)}} });
 
+	//Copy N of the accumulation set writes history N and reads the other one
+	VkDescriptorSetLayoutBinding rawAOBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	//Placeholder until the raw AO image is assigned through setRawAOImage()
+	VkDescriptorImageInfo rawAOInfo{ .sampler = m_hbaoSampler, .imageView = m_blurredAOImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorSetLayoutBinding accumulateDepthBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorSetLayoutBinding oldHistoryBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorImageInfo oldHistoryInfo0{ .sampler = m_hbaoSampler, .imageView = m_historyAO[1].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo oldHistoryInfo1{ .sampler = m_hbaoSampler, .imageView = m_historyAO[0].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorSetLayoutBinding newHistoryBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorImageInfo newHistoryInfo0{ .imageView = m_historyAO[0].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo newHistoryInfo1{ .imageView = m_historyAO[1].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+
+	m_resSets[2].initializeSet(device, 2, VkDescriptorSetLayoutCreateFlags{},
+		std::array{ rawAOBinding, accumulateDepthBinding, oldHistoryBinding, newHistoryBinding }, std::array<VkDescriptorBindingFlags, 0>{},
+		std::vector<std::vector<VkDescriptorDataEXT>>{
+			std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &rawAOInfo}, {.pCombinedImageSampler = &rawAOInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &depthImageInfo}, {.pCombinedImageSampler = &depthImageInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &oldHistoryInfo0}, {.pCombinedImageSampler = &oldHistoryInfo1} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &newHistoryInfo0}, {.pStorageImage = &newHistoryInfo1} }},
+		true);
+
+	std::reference_wrapper<const ResourceSet> accumulateResSets[2]{ viewprojRS, m_resSets[2] };
+
+	m_accumulateHBAOpass.initializaCompute(device, "shaders/cmpld/hbao_accumulate_comp.spv", accumulateResSets,
+		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcDataAccumulate)}} });
+
+	//The blur reads the history written this frame
 	VkDescriptorSetLayoutBinding aoInImageBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
-	VkDescriptorImageInfo aoInImageInfo{ .sampler = m_hbaoSampler, .imageView = m_AOImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo aoInImageInfo0{ .sampler = m_hbaoSampler, .imageView = m_historyAO[0].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo aoInImageInfo1{ .sampler = m_hbaoSampler, .imageView = m_historyAO[1].getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
 
 	VkDescriptorSetLayoutBinding aoBlurredBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
 	VkDescriptorImageInfo aoBlurredInfo{ .imageView = m_blurredAOImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
 
-	m_resSets[1].initializeSet(device, 1, VkDescriptorSetLayoutCreateFlags{},
+	m_resSets[1].initializeSet(device, 2, VkDescriptorSetLayoutCreateFlags{},
 		std::array{ aoInImageBinding, aoBlurredBinding }, std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
-			std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &aoInImageInfo} },
-			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &aoBlurredInfo} }},
+			std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &aoInImageInfo0}, {.pCombinedImageSampler = &aoInImageInfo1} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageImage = &aoBlurredInfo}, {.pStorageImage = &aoBlurredInfo} }},
 		true);
 
 	resSet[0] = m_resSets[1];
 
 	m_blurHBAOpass.initializaCompute(device, "shaders/cmpld/hbao_blur_comp.spv", resSet, 
-		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(glm::vec2) + sizeof(glm::uvec2)}}});
-
-	m_imageBarriers[0] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-		m_AOImage.getImageHandle(), m_AOImage.getSubresourceRange());
-	m_imageBarriers[1] = SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-		m_blurredAOImage.getImageHandle(), m_blurredAOImage.getSubresourceRange());
-
-	m_dependencyInfo = SyncOperations::createDependencyInfo(std::span(m_imageBarriers + 0, m_imageBarriers + 2));
+		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(glm::vec2) + sizeof(glm::uvec2) + sizeof(glm::vec2)}}});
 
-	m_hbaoInfo.invResolution = glm::vec2{ 1.0 / m_aoRenderWidth, 1.0 / m_aoRenderHeight };
-	m_hbaoInfo.resolution = glm::uvec2{ m_aoRenderWidth, m_aoRenderHeight };
+	updateScaledExtent();
+	m_hbaoInfo.directionCount = HBAO_DIRECTION_COUNT_DEFAULT;
+	m_hbaoInfo.stepCount = HBAO_STEP_COUNT_DEFAULT;
+	m_hbaoInfo.frameIndex = 0;
 
 	m_hbaoInfo.radius = 4.5;
 	m_hbaoInfo.aoExponent = 1.22;
@@ -93,6 +135,26 @@ HBAO::HBAO(VkDevice device, uint32_t aoRenderWidth, uint32_t aoRenderHeight, con
 	m_hbaoInfo.negInvR2 = -1.0 / (m_hbaoInfo.radius * m_hbaoInfo.radius);
 
 	fiilRandomRotationImage(cmdBufferSet, queue);
+
+	//History and deinterleaved depth are kept in GENERAL between frames
+	VkCommandBuffer cb{ cmdBufferSet.beginTransientRecording() };
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_NONE,
+		0, 0,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+		m_historyAO[0].getImageHandle(), m_historyAO[0].getSubresourceRange()),
+		SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_NONE,
+		0, 0,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+		m_historyAO[1].getImageHandle(), m_historyAO[1].getSubresourceRange()),
+		SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_NONE,
+		0, 0,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+		m_deinterleavedDepth.getImageHandle(), m_deinterleavedDepth.getSubresourceRange())} });
+	cmdBufferSet.endRecording(cb);
+	VkSubmitInfo submitInfo{ .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .commandBufferCount = 1, .pCommandBuffers = &cb };
+	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(queue);
+	cmdBufferSet.resetAll();
 }
 HBAO::~HBAO()
 {
@@ -100,49 +162,96 @@ HBAO::~HBAO()
 	vkDestroySampler(m_device, m_randSampler, nullptr);
 }
 
+void HBAO::setRawAOImage(VkImageView rawAOImageView)
+{
+	VkDescriptorImageInfo aoOutImageInfo{ .imageView = rawAOImageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	m_resSets[0].rewriteDescriptor(2, 0, 0, VkDescriptorDataEXT{ .pStorageImage = &aoOutImageInfo });
+	VkDescriptorImageInfo aoInImageInfo{ .sampler = m_hbaoSampler, .imageView = rawAOImageView, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	m_resSets[2].rewriteDescriptor(0, 0, 0, VkDescriptorDataEXT{ .pCombinedImageSampler = &aoInImageInfo });
+	m_resSets[2].rewriteDescriptor(0, 1, 0, VkDescriptorDataEXT{ .pCombinedImageSampler = &aoInImageInfo });
+}
+
 void HBAO::cmdTransferClearBuffers(VkCommandBuffer cb)
 {
 	SyncOperations::cmdExecuteBarrier(cb,
 		{ {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
 		VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
 		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		m_AOImage.getImageHandle(), m_AOImage.getSubresourceRange()),
-		SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_ACCESS_NONE, VK_ACCESS_TRANSFER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 		m_blurredAOImage.getImageHandle(), m_blurredAOImage.getSubresourceRange())} });
 
 	VkClearColorValue clearVal{ .float32 = {1.0} };
-	VkImageSubresourceRange subrRange{ m_AOImage.getSubresourceRange() };
-	vkCmdClearColorImage(cb, m_AOImage.getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subrRange);
-	subrRange = m_blurredAOImage.getSubresourceRange();
+	VkImageSubresourceRange subrRange{ m_blurredAOImage.getSubresourceRange() };
 	vkCmdClearColorImage(cb, m_blurredAOImage.getImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1, &subrRange);
 }
 
 void HBAO::cmdDispatchHBAO(VkCommandBuffer cb)
 {
-	SyncOperations::cmdExecuteBarrier(cb,
-		{ {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-		VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-		m_AOImage.getImageHandle(), m_AOImage.getSubresourceRange())} });
+	constexpr uint32_t groupSize{ 8 };
+	uint32_t layerWidth{ DISPATCH_SIZE(m_aoScaledWidth, HBAO_DEINTERLEAVE_FACTOR) };
+	uint32_t layerHeight{ DISPATCH_SIZE(m_aoScaledHeight, HBAO_DEINTERLEAVE_FACTOR) };
+
+	m_deinterleavePass.cmdBindResourceSets(cb);
+	m_deinterleavePass.cmdBind(cb);
+	struct { glm::vec2 invResolution; glm::uvec2 resolution; glm::vec2 depthUVScale; float nearPlane; float farPlane; } pcData;
+	pcData.invResolution = m_hbaoInfo.invResolution;
+	pcData.resolution = m_hbaoInfo.resolution;
+	pcData.depthUVScale = m_hbaoInfo.depthUVScale;
+	pcData.nearPlane = m_hbaoInfo.nearPlane;
+	pcData.farPlane = m_hbaoInfo.farPlane;
+	vkCmdPushConstants(cb, m_deinterleavePass.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pcData), &pcData);
+	vkCmdDispatch(cb, DISPATCH_SIZE(layerWidth, groupSize), DISPATCH_SIZE(layerHeight, groupSize), HBAO_DEINTERLEAVED_LAYER_COUNT);
+
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+		m_deinterleavedDepth.getImageHandle(), m_deinterleavedDepth.getSubresourceRange())} });
 
 	m_HBAOpass.cmdBindResourceSets(cb);
 	m_HBAOpass.cmdBind(cb);
-	vkCmdPushConstants(cb, m_HBAOpass.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_hbaoInfo), &m_hbaoInfo);
+	//Radius is stored in pixels of the full AO image
+	auto hbaoInfo{ m_hbaoInfo };
+	hbaoInfo.radius *= float(m_aoScaledHeight) / m_aoRenderHeight;
+	vkCmdPushConstants(cb, m_HBAOpass.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(hbaoInfo), &hbaoInfo);
+	vkCmdDispatch(cb, DISPATCH_SIZE(layerWidth, groupSize), DISPATCH_SIZE(layerHeight, groupSize), HBAO_DEINTERLEAVED_LAYER_COUNT);
+	++m_hbaoInfo.frameIndex;
+}
+void HBAO::cmdDispatchHBAOAccumulate(VkCommandBuffer cb)
+{
+	m_historyIndex = m_historyIndex ? 0 : 1;
+
+	constexpr uint32_t accumulateResSetIndex{ 1 };
+	m_accumulateHBAOpass.setResourceInUse(accumulateResSetIndex, m_historyIndex);
+	m_accumulateHBAOpass.cmdBindResourceSets(cb);
+	m_accumulateHBAOpass.cmdBind(cb);
+	m_pcDataAccumulate.resolution = m_hbaoInfo.resolution;
+	m_pcDataAccumulate.invResolution = m_hbaoInfo.invResolution;
+	m_pcDataAccumulate.depthUVScale = m_hbaoInfo.depthUVScale;
+	m_pcDataAccumulate.historyUVScale = getAOUVScale();
+	m_pcDataAccumulate.historyWeight = HBAO_HISTORY_WEIGHT;
+	m_pcDataAccumulate.historyValid = m_historyValid ? 1u : 0u;
+	vkCmdPushConstants(cb, m_accumulateHBAOpass.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcDataAccumulate), &m_pcDataAccumulate);
 	constexpr uint32_t groupSize{ 8 };
-	vkCmdDispatch(cb, DISPATCH_SIZE(m_aoRenderWidth, groupSize), DISPATCH_SIZE(m_aoRenderHeight, groupSize), 1);
+	vkCmdDispatch(cb, DISPATCH_SIZE(m_aoScaledWidth, groupSize), DISPATCH_SIZE(m_aoScaledHeight, groupSize), 1);
+	m_historyValid = true;
+
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+		m_historyAO[m_historyIndex].getImageHandle(), m_historyAO[m_historyIndex].getSubresourceRange())} });
 }
 void HBAO::cmdDispatchHBAOBlur(VkCommandBuffer cb)
 {
+	constexpr uint32_t blurResSetIndex{ 0 };
+	m_blurHBAOpass.setResourceInUse(blurResSetIndex, m_historyIndex);
 	m_blurHBAOpass.cmdBindResourceSets(cb);
 	m_blurHBAOpass.cmdBind(cb);
-	struct { glm::vec2 invResolution; glm::uvec2 resolution; } pcData;
+	struct { glm::vec2 invResolution; glm::uvec2 resolution; glm::vec2 uvScale; } pcData;
 	pcData.invResolution = m_hbaoInfo.invResolution;
 	pcData.resolution = m_hbaoInfo.resolution;
+	pcData.uvScale = getAOUVScale();
 	vkCmdPushConstants(cb, m_blurHBAOpass.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pcData), &pcData);
 	constexpr uint32_t groupSize{ 8 };
-	vkCmdDispatch(cb, DISPATCH_SIZE(m_aoRenderWidth, groupSize), DISPATCH_SIZE(m_aoRenderHeight, groupSize), 1);
+	vkCmdDispatch(cb, DISPATCH_SIZE(m_aoScaledWidth, groupSize), DISPATCH_SIZE(m_aoScaledHeight, groupSize), 1);
 }
 
 void HBAO::setHBAOsettings(float radius, float aoExponent, float angleBias)
@@ -152,6 +261,31 @@ void HBAO::setHBAOsettings(float radius, float aoExponent, float angleBias)
 	m_hbaoInfo.angleBias = angleBias;
 	m_hbaoInfo.negInvR2 = -1.0 / (m_hbaoInfo.radius * m_hbaoInfo.radius);
 }
+void HBAO::setRenderScale(glm::vec2 scale)
+{
+	m_renderScale = scale;
+	updateScaledExtent();
+}
+void HBAO::setResolutionDivisor(uint32_t divisor)
+{
+	EASSERT(divisor != 0, "App", "AO resolution divisor cannot be zero.");
+	m_resolutionDivisor = divisor;
+	updateScaledExtent();
+}
+void HBAO::updateScaledExtent()
+{
+	uint32_t scaledWidth{ std::max(uint32_t(std::ceil(m_aoRenderWidth * m_renderScale.x / m_resolutionDivisor)), 1u) };
+	uint32_t scaledHeight{ std::max(uint32_t(std::ceil(m_aoRenderHeight * m_renderScale.y / m_resolutionDivisor)), 1u) };
+	//History was accumulated over a different part of the images
+	if (scaledWidth != m_aoScaledWidth || scaledHeight != m_aoScaledHeight)
+		m_historyValid = false;
+	m_aoScaledWidth = scaledWidth;
+	m_aoScaledHeight = scaledHeight;
+	m_hbaoInfo.invResolution = glm::vec2{ 1.0 / m_aoScaledWidth, 1.0 / m_aoScaledHeight };
+	m_hbaoInfo.resolution = glm::uvec2{ m_aoScaledWidth, m_aoScaledHeight };
+	//Depth is sampled at the render resolution regardless of the divisor
+	m_hbaoInfo.depthUVScale = m_renderScale;
+}
 
 void HBAO::fiilRandomRotationImage(CommandBufferSet& cmdBufferSet, VkQueue queue)
 {
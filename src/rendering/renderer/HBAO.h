@@ -2,6 +2,13 @@
 #define HBAO_CLASS_HEADER
 
 #define RANDOM_TEXTURE_SIZE 4
+//Weight of the accumulated AO when the reprojected history is valid
+#define HBAO_HISTORY_WEIGHT 0.9f
+#define HBAO_DIRECTION_COUNT_DEFAULT 4
+#define HBAO_STEP_COUNT_DEFAULT 3
+//Depth is split into 4x4 quarter resolution layers so that horizon samples stay local in the texture cache
+#define HBAO_DEINTERLEAVE_FACTOR 4
+#define HBAO_DEINTERLEAVED_LAYER_COUNT (HBAO_DEINTERLEAVE_FACTOR * HBAO_DEINTERLEAVE_FACTOR)
 
 #include <cstdint>
 #include <random>
@@ -23,19 +30,28 @@ private:
 
 	uint32_t m_aoRenderWidth{};
 	uint32_t m_aoRenderHeight{};
+	//Part of the AO images covered at the current render resolution and AO resolution divisor
+	uint32_t m_aoScaledWidth{};
+	uint32_t m_aoScaledHeight{};
+	glm::vec2 m_renderScale{ 1.0f };
+	uint32_t m_resolutionDivisor{ 2 };
 
 	Image m_randTex;
-	Image m_AOImage;
 	Image m_blurredAOImage;
+	//AO and linear depth accumulated over frames, ping-ponged
+	Image m_historyAO[2];
+	uint32_t m_historyIndex{ 0 };
+	bool m_historyValid{ false };
+	//Linear depth of the AO pixels, one layer per position in the 4x4 block
+	ImageList m_deinterleavedDepth;
 
-	std::array<ResourceSet, 2> m_resSets{};
+	std::array<ResourceSet, 4> m_resSets{};
 
+	Pipeline m_deinterleavePass;
 	Pipeline m_HBAOpass;
+	Pipeline m_accumulateHBAOpass;
 	Pipeline m_blurHBAOpass;
 
-	VkImageMemoryBarrier2 m_imageBarriers[2]{};
-	VkDependencyInfo m_dependencyInfo{};
-
 	float m_frustumFar{};
 	float m_frustumFOV{};
 	struct
@@ -52,13 +68,30 @@ private:
 
 		float farPlane;
 		float nearPlane;
+
+		glm::vec2 depthUVScale;
+
+		uint32_t directionCount;
+		uint32_t stepCount;
+		uint32_t frameIndex;
+		uint32_t pad;
 	} m_hbaoInfo;
 
+	struct
+	{
+		glm::uvec2 resolution;
+		glm::vec2 invResolution;
+		glm::vec2 depthUVScale;
+		glm::vec2 historyUVScale;
+		float historyWeight;
+		uint32_t historyValid;
+	} m_pcDataAccumulate;
+
 	VkSampler m_hbaoSampler{};
 	VkSampler m_randSampler{};
 
 public:
-	HBAO(VkDevice device, uint32_t aoRenderWidth, uint32_t aoRenderHeight, const DepthBuffer& depthBuffer, CommandBufferSet& cmdBufferSet, VkQueue queue);
+	HBAO(VkDevice device, uint32_t aoRenderWidth, uint32_t aoRenderHeight, const DepthBuffer& depthBuffer, const ResourceSet& viewprojRS, CommandBufferSet& cmdBufferSet, VkQueue queue);
 	~HBAO();
 
 	uint32_t getAOImageWidth()
@@ -73,10 +106,12 @@ public:
 	{
 		return m_blurredAOImage;
 	}
-	const VkDependencyInfo& getDependency()
+	VkFormat getRawAOFormat() const
 	{
-		return m_dependencyInfo;
+		return VK_FORMAT_R8_UNORM;
 	}
+	//Raw AO is a transient of the render graph and is only alive between the HBAO and the blur passes
+	void setRawAOImage(VkImageView rawAOImageView);
 
 	void setRadius(float radius)
 	{
@@ -92,7 +127,23 @@ public:
 		m_hbaoInfo.angleBias = bias;
 	}
 
+	//Sample pattern is rotated every frame, fewer samples per frame are compensated by the accumulation
+	void setSampleCounts(uint32_t directionCount, uint32_t stepCount)
+	{
+		m_hbaoInfo.directionCount = directionCount;
+		m_hbaoInfo.stepCount = stepCount;
+	}
+
 	void setHBAOsettings(float radius, float aoExponent, float angleBias);
+	//Scale of the render resolution relative to the output resolution
+	void setRenderScale(glm::vec2 scale);
+	//AO is computed at the render resolution divided by this value
+	void setResolutionDivisor(uint32_t divisor);
+	//Maps UVs over the rendered part of the screen to UVs of the AO image
+	glm::vec2 getAOUVScale() const
+	{
+		return glm::vec2(float(m_aoScaledWidth) / m_aoRenderWidth, float(m_aoScaledHeight) / m_aoRenderHeight);
+	}
 
 
 	void submitFrustum(double near, double far, double aspect, double FOV);
@@ -100,10 +151,12 @@ public:
 	void cmdTransferClearBuffers(VkCommandBuffer cb);
 
 	void cmdDispatchHBAO(VkCommandBuffer cb);
+	void cmdDispatchHBAOAccumulate(VkCommandBuffer cb);
 	void cmdDispatchHBAOBlur(VkCommandBuffer cb);
 
 private:
 	void fiilRandomRotationImage(CommandBufferSet& cmdBufferSet, VkQueue queue);
+	void updateScaledExtent();
 };
 
 #endif
\ No newline at end of file
@@ -37,12 +37,14 @@ private:
 		glm::vec2 jitterValue;
 		glm::vec2 jitterValuePrev;
 		float smoothingFactor;
+		float pad;
+		glm::vec2 uvScale;
 	} m_pcData;
 
 	VkSampler m_sampler{};
 
 public:
-	TAA(VkDevice device, const DepthBuffer& depthBuffer, const Image& framebuffer, const ResourceSet& viewportRS, CommandBufferSet& cmdBufferSet, VkQueue queue) :
+	TAA(VkDevice device, const DepthBuffer& depthBuffer, const Image& framebuffer, const Image& velocity, const ResourceSet& viewportRS, CommandBufferSet& cmdBufferSet, VkQueue queue) :
 		m_device{ device }, m_windowWidth{ framebuffer.getWidth() }, m_windowHeight{ framebuffer.getHeight() },
 		m_historyFramebuffers{ Image{ device, framebuffer.getFormat(), framebuffer.getWidth(), framebuffer.getHeight(), VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT},
 							   Image{ device, framebuffer.getFormat(), framebuffer.getWidth(), framebuffer.getHeight(), VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT}}
@@ -71,14 +73,17 @@ public:
 		VkDescriptorSetLayoutBinding depthBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
 		VkDescriptorImageInfo depthImageInfo{ .sampler = m_sampler, .imageView = depthBuffer.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL};
 		VkDescriptorSetLayoutBinding outputBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorSetLayoutBinding velocityBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorImageInfo velocityImageInfo{ .sampler = m_sampler, .imageView = velocity.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
 
 		m_resSet0.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlags{},
-			std::array{ inputImageBinding, depthBinding, outputBinding }, std::array<VkDescriptorBindingFlags, 0>{},
+			std::array{ inputImageBinding, depthBinding, outputBinding, velocityBinding }, std::array<VkDescriptorBindingFlags, 0>{},
 			std::vector<std::vector<VkDescriptorDataEXT>>{
 				std::vector<VkDescriptorDataEXT>{{.pCombinedImageSampler = &inputImageInfo}},
 				std::vector<VkDescriptorDataEXT>{{.pCombinedImageSampler = &depthImageInfo}},
-				std::vector<VkDescriptorDataEXT>{}},
-			true);
+				std::vector<VkDescriptorDataEXT>{},
+				std::vector<VkDescriptorDataEXT>{{.pCombinedImageSampler = &velocityImageInfo}}},
+			true, true);
 
 		VkDescriptorSetLayoutBinding oldHistoryBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
 		VkDescriptorSetLayoutBinding newHistoryBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
@@ -102,6 +107,7 @@ public:
 		m_pcData.resolution = {m_windowWidth, m_windowHeight};
 		m_pcData.invResolution = { 1.0 / (m_windowWidth), 1.0 / (m_windowHeight) };
 		m_pcData.smoothingFactor = 0.1;
+		m_pcData.uvScale = glm::vec2{ 1.0f };
 
 		VkCommandBuffer cb{ cmdBufferSet.beginTransientRecording() };
 			SyncOperations::cmdExecuteBarrier(cb, 
@@ -130,10 +136,17 @@ public:
 		m_pcData.jitterValue = jitter;
 	}
 
+	//The input is upsampled from its top left part when rendering below the window resolution
+	void setRenderExtent(uint32_t width, uint32_t height)
+	{
+		m_pcData.uvScale = glm::vec2{ float(width) / m_windowWidth, float(height) / m_windowHeight };
+	}
+
 	void adjustSmoothingFactor(double deltaTime, double camSpeed, bool camPosChanged)
 	{
+		//History is reprojected with per pixel motion vectors, so camera movement only needs a small push towards the current frame
 		constexpr double convergenceTime{ 0.07 };
-		m_pcData.smoothingFactor = static_cast<float>(glm::clamp(1.0 - glm::exp(-deltaTime / convergenceTime) + (camPosChanged ? glm::sqrt(camSpeed * 0.1) * 0.15 : 0.0), 0.05, 0.4));
+		m_pcData.smoothingFactor = static_cast<float>(glm::clamp(1.0 - glm::exp(-deltaTime / convergenceTime) + (camPosChanged ? glm::sqrt(camSpeed * 0.1) * 0.05 : 0.0), 0.05, 0.25));
 	}
 
 	void cmdDispatchTAA(VkCommandBuffer cb, VkImageView outputAttachment)
@@ -151,18 +164,18 @@ public:
 		constexpr uint32_t groupSize{ 8 };
 		vkCmdDispatch(cb, DISPATCH_SIZE(m_windowWidth, groupSize), DISPATCH_SIZE(m_windowHeight, groupSize), 1);
 
-		SyncOperations::cmdExecuteBarrier(cb, 
-			{{SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
-				VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_NONE,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-				m_historyFramebuffers[resCopyIndex].getImageHandle(), m_historyFramebuffers[resCopyIndex].getSubresourceRange()),
-			SyncOperations::constructImageBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_NONE,
-				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE,
-				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				m_historyFramebuffers[!resCopyIndex].getImageHandle(), m_historyFramebuffers[!resCopyIndex].getSubresourceRange())}});
-
 		resCopyIndex = !resCopyIndex;
 	}
+
+	//History images swap roles every frame, the render graph transitions them for the next frame after the dispatch
+	const Image& getHistoryRead() const
+	{
+		return m_historyFramebuffers[resCopyIndex];
+	}
+	const Image& getHistoryWrite() const
+	{
+		return m_historyFramebuffers[!resCopyIndex];
+	}
 };
 
 #endif
\ No newline at end of file
@@ -1,10 +1,9 @@
 #include "src/rendering/renderer/clusterer.h"
 
-Clusterer::Clusterer(VkDevice device, CommandBufferSet& cmdBufferSet, VkQueue queue, uint32_t windowWidth, uint32_t windowHeight, const ResourceSet& viewprojRS)
-	: m_motherBufferShared{ device, CLUSTERED_BUFFERS_SIZE, 
-		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, BufferBase::DEDICATED_FLAG, true },
-	m_sortedTypeData{ device, MAX_LIGHTS * sizeof(uint8_t), 
-		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, BufferBase::NULL_FLAG, true, false },
+#include "src/tools/logging.h"
+
+Clusterer::Clusterer(VkDevice device, CommandBufferSet& cmdBufferSet, VkQueue queue, uint32_t windowWidth, uint32_t windowHeight, const ResourceSet& viewprojRS, RingAllocator& frameAllocator)
+	: m_frameAllocator{ &frameAllocator },
 	m_tileData{ device, TILE_DATA_SIZE * (windowWidth / TILE_PIXEL_WIDTH) * (windowHeight / TILE_PIXEL_HEIGHT), 
 		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, BufferBase::NULL_FLAG },
 	m_constData{ device, sizeof(float) * 3,
@@ -21,11 +20,6 @@ Clusterer::Clusterer(VkDevice device, CommandBufferSet& cmdBufferSet, VkQueue qu
 	m_boundingSpheres.reserve(MAX_LIGHTS);
 	m_nonculledLightsData = { new CulledLightData[MAX_LIGHTS] };
 
-	m_sortedLightData.initialize(m_motherBufferShared, MAX_LIGHTS * sizeof(LightFormat)); //Allocate worst case
-	m_binsMinMax.initialize(m_motherBufferShared, Z_BIN_COUNT * sizeof(uint16_t) * 2);
-	m_instancePointLightIndexData.initialize(m_motherBufferShared, MAX_LIGHTS * sizeof(uint16_t));
-	m_instanceSpotLightIndexData.initialize(m_motherBufferShared, MAX_LIGHTS * sizeof(uint16_t));
-
 	createTileTestObjects(viewprojRS);
 	uploadBuffersData(cmdBufferSet, queue);
 
@@ -43,10 +37,6 @@ Clusterer::~Clusterer()
 {
 	delete m_visPipelines;
 	delete[] m_nonculledLightsData;
-	m_sortedLightData.reset();
-	m_binsMinMax.reset();
-	m_instancePointLightIndexData.reset();
-	m_instanceSpotLightIndexData.reset();
 }
 
 void Clusterer::submitFrustum(double near, double far, double aspect, double FOV)
@@ -90,34 +80,81 @@ void Clusterer::sortLights()
 	}
 	m_currentFurthestLight = std::max(100.0f, m_currentFurthestLight);
 	oneapi::tbb::parallel_sort(m_nonculledLightsData, m_nonculledLightsData + m_nonculledLightsCount, [](const CulledLightData& data1, const CulledLightData& data2) -> bool { return data1.front < data2.front; });
+
+	allocateLightBuffers();
 }
-void Clusterer::fillLightBuffers()
+void Clusterer::allocateLightBuffers()
 {
-	LightFormat* sortedLightDataPtr{ reinterpret_cast<LightFormat*>(m_sortedLightData.getData()) };
-	LightFormat::Types* sortedTypeDataPtr{ reinterpret_cast<LightFormat::Types*>(m_sortedTypeData.getData()) };
+	//Runs before the buffers are filled in parallel, so a failed allocation drops the lights for both fills
+	uint32_t lightCount{ std::max(m_nonculledLightsCount, 1u) };
+	m_sortedLightData = m_frameAllocator->allocate(lightCount * sizeof(LightFormat), RING_ALLOCATOR_MAX_ALIGNMENT);
+	m_sortedTypeData = m_frameAllocator->allocate(MAX_WORDS * sizeof(uint32_t), RING_ALLOCATOR_MAX_ALIGNMENT);
+	m_binsMinMax = m_frameAllocator->allocate(Z_BIN_COUNT * sizeof(uint16_t) * 2, RING_ALLOCATOR_MAX_ALIGNMENT);
+	m_instancePointLightIndexData = m_frameAllocator->allocate(lightCount * sizeof(uint16_t), RING_ALLOCATOR_MAX_ALIGNMENT);
+	m_instanceSpotLightIndexData = m_frameAllocator->allocate(lightCount * sizeof(uint16_t), RING_ALLOCATOR_MAX_ALIGNMENT);
+	if (m_sortedLightData.failed() || m_sortedTypeData.failed() || m_binsMinMax.failed() || m_instancePointLightIndexData.failed() || m_instanceSpotLightIndexData.failed())
+	{
+		//Descriptors keep the previous ranges, nothing reads them because no light reaches the tiles this frame
+		LOG_WARNING("Light lists don't fit into the frame allocator, local lights are skipped this frame.");
+		m_nonculledLightsCount = 0;
+		m_binsMinMax.data = nullptr;
+		return;
+	}
 
+	VkDescriptorAddressInfoEXT lightDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_sortedLightData.deviceAddress, .range = m_sortedLightData.size };
+	VkDescriptorAddressInfoEXT typeDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_sortedTypeData.deviceAddress, .range = m_sortedTypeData.size };
+	VkDescriptorAddressInfoEXT zBinAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_binsMinMax.deviceAddress, .range = m_binsMinMax.size };
+	VkDescriptorAddressInfoEXT pointLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_instancePointLightIndexData.deviceAddress, .range = m_instancePointLightIndexData.size };
+	VkDescriptorAddressInfoEXT spotLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_instanceSpotLightIndexData.deviceAddress, .range = m_instanceSpotLightIndexData.size };
+
+	m_resourceSets[0].rewriteDescriptor(2, 0, 0, { .pStorageBuffer = &pointLightIndicesAddressInfo });
+	m_resourceSets[0].rewriteDescriptor(3, 0, 0, { .pStorageBuffer = &lightDataAddressInfo });
+	m_resourceSets[1].rewriteDescriptor(2, 0, 0, { .pStorageBuffer = &spotLightIndicesAddressInfo });
+	m_resourceSets[1].rewriteDescriptor(3, 0, 0, { .pStorageBuffer = &lightDataAddressInfo });
+	m_resourceSets[2].rewriteDescriptor(0, 0, 0, { .pStorageBuffer = &pointLightIndicesAddressInfo });
+	m_resourceSets[2].rewriteDescriptor(1, 0, 0, { .pStorageBuffer = &lightDataAddressInfo });
+	m_resourceSets[3].rewriteDescriptor(0, 0, 0, { .pStorageBuffer = &spotLightIndicesAddressInfo });
+	m_resourceSets[3].rewriteDescriptor(1, 0, 0, { .pStorageBuffer = &lightDataAddressInfo });
+	for (auto& lightDataSet : m_lightDataSets)
+	{
+		lightDataSet.set->rewriteDescriptor(lightDataSet.sortedLightsBinding, 0, 0, { .pStorageBuffer = &lightDataAddressInfo });
+		lightDataSet.set->rewriteDescriptor(lightDataSet.typeDataBinding, 0, 0, { .pStorageBuffer = &typeDataAddressInfo });
+		lightDataSet.set->rewriteDescriptor(lightDataSet.zBinBinding, 0, 0, { .pStorageBuffer = &zBinAddressInfo });
+	}
+}
+void Clusterer::fillLightBuffers()
+{
 	m_nonculledPointLightCount = 0;
 	m_nonculledSpotLightCount = 0;
+	if (m_nonculledLightsCount == 0)
+		return;
+
+	LightFormat* sortedLightDataPtr{ reinterpret_cast<LightFormat*>(m_sortedLightData.data) };
+	uint32_t* pointLightWordsPtr{ reinterpret_cast<uint32_t*>(m_sortedTypeData.data) };
+	std::memset(pointLightWordsPtr, 0, MAX_WORDS * sizeof(uint32_t));
 
 	for (int i{ 0 }; i < m_nonculledLightsCount; ++i)
 	{
 		uint32_t index{ m_nonculledLightsData[i].index };
 
 		sortedLightDataPtr[i] = m_lightData[index];
-		sortedTypeDataPtr[i] = m_typeData[index];
 
 		if (m_typeData[index] == LightFormat::TYPE_POINT)
 		{
-			*(reinterpret_cast<uint16_t*>(m_instancePointLightIndexData.getData()) + m_nonculledPointLightCount++) = static_cast<uint16_t>(i);
+			pointLightWordsPtr[i / 32] |= 1u << (i % 32);
+			*(reinterpret_cast<uint16_t*>(m_instancePointLightIndexData.data) + m_nonculledPointLightCount++) = static_cast<uint16_t>(i);
 		}
 		else
 		{
-			*(reinterpret_cast<uint16_t*>(m_instanceSpotLightIndexData.getData()) + m_nonculledSpotLightCount++) = static_cast<uint16_t>(i);
+			*(reinterpret_cast<uint16_t*>(m_instanceSpotLightIndexData.data) + m_nonculledSpotLightCount++) = static_cast<uint16_t>(i);
 		}
 	}
 }
 void Clusterer::fillZBins()
 {
+	if (m_binsMinMax.failed())
+		return;
+
 	float binWidth{ m_currentFurthestLight / Z_BIN_COUNT };
 
 	static oneapi::tbb::affinity_partitioner ap{};
@@ -143,7 +180,7 @@ void Clusterer::fillZBins()
 				}
 
 			}
-			uint16_t* minMax{ reinterpret_cast<uint16_t*>(m_binsMinMax.getData()) + i * 2 };
+			uint16_t* minMax{ reinterpret_cast<uint16_t*>(m_binsMinMax.data) + i * 2 };
 			minMax[0] = min;
 			minMax[1] = max;
 		}, ap);
@@ -301,15 +338,15 @@ void Clusterer::createTileTestObjects(const ResourceSet& viewprojRS)
 	//Binding 2 Point
 	//Light indices
 	VkDescriptorSetLayoutBinding pointLightIndicesBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
-	VkDescriptorAddressInfoEXT pointLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_instancePointLightIndexData.getDeviceAddress(), .range = m_instancePointLightIndexData.getSize() };
+	VkDescriptorAddressInfoEXT pointLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_frameAllocator->getDeviceAddress(), .range = MAX_LIGHTS * sizeof(uint16_t) };
 	//Binding 2 Spot
 	//Light indices
 	VkDescriptorSetLayoutBinding spotLightIndicesBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
-	VkDescriptorAddressInfoEXT spotLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_instanceSpotLightIndexData.getDeviceAddress(), .range = m_instanceSpotLightIndexData.getSize() };
+	VkDescriptorAddressInfoEXT spotLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_frameAllocator->getDeviceAddress(), .range = MAX_LIGHTS * sizeof(uint16_t) };
 	//Binding 3
 	//Light data
 	VkDescriptorSetLayoutBinding lightDataBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
-	VkDescriptorAddressInfoEXT lightDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_sortedLightData.getDeviceAddress(), .range = m_sortedLightData.getSize() };
+	VkDescriptorAddressInfoEXT lightDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_frameAllocator->getDeviceAddress(), .range = MAX_LIGHTS * sizeof(LightFormat) };
 
 	m_resourceSets[0].initializeSet(m_device, 1, VkDescriptorSetLayoutCreateFlags{},
 	std::array{ constDataBinding, tilesLightsDataBinding, pointLightIndicesBinding, lightDataBinding }, std::array<VkDescriptorBindingFlags, 0>{},
@@ -318,7 +355,7 @@ void Clusterer::createTileTestObjects(const ResourceSet& viewprojRS)
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &tilesLightsDataAddressInfo} },
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &pointLightIndicesAddressInfo} },
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &lightDataAddressInfo} }}, 
-		false);
+		false, true);
 	m_resourceSets[1].initializeSet(m_device, 1, VkDescriptorSetLayoutCreateFlags{},
 		std::array{ constDataBinding, tilesLightsDataBinding, spotLightIndicesBinding, lightDataBinding }, std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
@@ -326,7 +363,7 @@ void Clusterer::createTileTestObjects(const ResourceSet& viewprojRS)
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &tilesLightsDataAddressInfo} },
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &spotLightIndicesAddressInfo} },
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &lightDataAddressInfo} }},
-		false);
+		false, true);
 
 
 	std::array<std::reference_wrapper<const ResourceSet>, 2> res{ viewprojRS, m_resourceSets[0] };
@@ -406,28 +443,28 @@ void Clusterer::createVisualizationPipelines(const ResourceSet& viewprojRS, uint
 	//Binding 0 Point
 	//Light indices
 	VkDescriptorSetLayoutBinding pointLightIndicesBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
-	VkDescriptorAddressInfoEXT pointLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_instancePointLightIndexData.getDeviceAddress(), .range = m_instancePointLightIndexData.getSize() };
+	VkDescriptorAddressInfoEXT pointLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_frameAllocator->getDeviceAddress(), .range = MAX_LIGHTS * sizeof(uint16_t) };
 	//Binding 0 Spot
 	//Light indices
 	VkDescriptorSetLayoutBinding spotLightIndicesBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
-	VkDescriptorAddressInfoEXT spotLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_instanceSpotLightIndexData.getDeviceAddress(), .range = m_instanceSpotLightIndexData.getSize() };
+	VkDescriptorAddressInfoEXT spotLightIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_frameAllocator->getDeviceAddress(), .range = MAX_LIGHTS * sizeof(uint16_t) };
 	//Binding 1
 	//Light data
 	VkDescriptorSetLayoutBinding lightDataBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };
-	VkDescriptorAddressInfoEXT lightDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_sortedLightData.getDeviceAddress(), .range = m_sortedLightData.getSize() };
+	VkDescriptorAddressInfoEXT lightDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_frameAllocator->getDeviceAddress(), .range = MAX_LIGHTS * sizeof(LightFormat) };
 
 	m_resourceSets[2].initializeSet(m_device, 1, VkDescriptorSetLayoutCreateFlags{},
 		std::array{ pointLightIndicesBinding, lightDataBinding }, std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &pointLightIndicesAddressInfo} },
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &lightDataAddressInfo} }},
-		false);
+		false, true);
 	m_resourceSets[3].initializeSet(m_device, 1, VkDescriptorSetLayoutCreateFlags{},
 		std::array{ spotLightIndicesBinding, lightDataBinding }, std::array<VkDescriptorBindingFlags, 0>{},
 		std::vector<std::vector<VkDescriptorDataEXT>>{
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &spotLightIndicesAddressInfo} },
 			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &lightDataAddressInfo} }},
-		false);
+		false, true);
 
 	std::array<std::reference_wrapper<const ResourceSet>, 2> res{ viewprojRS, m_resourceSets[2] };
 
@@ -8,6 +8,7 @@
 #include <cmath>
 #include <mutex>
 #include <condition_variable> 
+#include <cstring>
 
 #include <tbb/flow_graph.h>
 #include <tbb/parallel_for.h>
@@ -22,12 +23,12 @@
 #include "src/rendering/renderer/descriptor_management.h"
 #include "src/rendering/renderer/sync_operations.h"
 #include "src/rendering/data_management/buffer_class.h"
+#include "src/rendering/data_management/ring_allocator.h"
 #include "src/rendering/data_abstraction/vertex_layouts.h"
 
 #define MAX_LIGHTS 1024u
 #define MAX_WORDS uint32_t(std::ceil(MAX_LIGHTS / 32u))
 #define Z_BIN_COUNT 8096u
-#define CLUSTERED_BUFFERS_SIZE (MAX_LIGHTS * sizeof(Clusterer::LightFormat) + Z_BIN_COUNT * sizeof(uint16_t) * 2 + MAX_LIGHTS * sizeof(uint16_t) + MAX_LIGHTS * sizeof(uint16_t) + 512)/*possible alignment correction*/
 #define TILE_DATA_SIZE  MAX_WORDS * 4
 #define TILE_PIXEL_WIDTH 8
 #define TILE_PIXEL_HEIGHT 8
@@ -69,10 +70,12 @@ public:
 
 private:
 	VkDevice m_device;
-	BufferBaseHostAccessible m_motherBufferShared;
-	BufferMapped m_sortedLightData;
-	BufferMapped m_binsMinMax;
-	BufferBaseHostAccessible m_sortedTypeData;
+	//Sorted light lists are rebuilt every frame, so they are taken from the frame allocator and the descriptors are pointed at the new ranges
+	RingAllocator* const m_frameAllocator{ nullptr };
+	RingAllocator::Allocation m_sortedLightData{};
+	RingAllocator::Allocation m_binsMinMax{};
+	//One bit per sorted light, set for point lights. Words match the tile words so the lighting pass splits a light mask by type without reading types per light
+	RingAllocator::Allocation m_sortedTypeData{};
 	BufferBaseHostInaccessible m_tileData;
 	std::vector<LightFormat> m_lightData{};
 	std::vector<LightFormat::Types> m_typeData{};
@@ -97,10 +100,19 @@ private:
 
 	Pipeline m_pointLightTileTestPipeline{};
 	uint32_t m_nonculledPointLightCount{ 0 };
-	BufferMapped m_instancePointLightIndexData{};
+	RingAllocator::Allocation m_instancePointLightIndexData{};
 	Pipeline m_spotLightTileTestPipeline{};
 	uint32_t m_nonculledSpotLightCount{ 0 };
-	BufferMapped m_instanceSpotLightIndexData{};
+	RingAllocator::Allocation m_instanceSpotLightIndexData{};
+
+	struct LightDataSet
+	{
+		const ResourceSet* set;
+		uint32_t sortedLightsBinding;
+		uint32_t typeDataBinding;
+		uint32_t zBinBinding;
+	};
+	std::vector<LightDataSet> m_lightDataSets{};
 
 	VkMemoryBarrier2 m_memBarrier{};
 	VkDependencyInfo m_dependencyInfo{};
@@ -122,7 +134,7 @@ private:
 	} *m_visPipelines{ nullptr };
 
 public:
-	Clusterer(VkDevice device, CommandBufferSet& cmdBufferSet, VkQueue queue, uint32_t windowWidth, uint32_t windowHeight, const ResourceSet& viewprojRS);
+	Clusterer(VkDevice device, CommandBufferSet& cmdBufferSet, VkQueue queue, uint32_t windowWidth, uint32_t windowHeight, const ResourceSet& viewprojRS, RingAllocator& frameAllocator);
 	~Clusterer();
 
 	void submitFrustum(double near, double far, double aspect, double FOV);
@@ -152,30 +164,15 @@ public:
 	void cmdDrawBVs(VkCommandBuffer cb);
 	void cmdDrawProxies(VkCommandBuffer cb);
 
-	const BufferMapped& getSortedLights() const
+	//External sets reading the sorted lights, the point light words and the z bins have to be created with rewrittenPerFrame, their descriptors are rewritten with the clusterer's own
+	void registerLightDataSet(const ResourceSet& set, uint32_t sortedLightsBinding, uint32_t typeDataBinding, uint32_t zBinBinding)
 	{
-		return m_sortedLightData;
-	}
-	const BufferBaseHostAccessible& getSortedTypeData() const
-	{
-		return m_sortedTypeData;
+		m_lightDataSets.push_back({ .set = &set, .sortedLightsBinding = sortedLightsBinding, .typeDataBinding = typeDataBinding, .zBinBinding = zBinBinding });
 	}
 	const BufferBaseHostInaccessible& getTileData() const
 	{
 		return m_tileData;
 	}
-	const BufferMapped& getPointIndices() const
-	{
-		return m_instancePointLightIndexData;
-	}
-	const BufferMapped& getSpotIndices() const
-	{
-		return m_instanceSpotLightIndexData;
-	}
-	const BufferMapped& getZBin() const
-	{
-		return m_binsMinMax;
-	}
 	uint32_t getLightNumber() const
 	{
 		return m_lightData.size();
@@ -196,6 +193,7 @@ public:
 private:
 	void cullLights();
 	void sortLights();
+	void allocateLightBuffers();
 	void fillLightBuffers();
 	void fillZBins();
 
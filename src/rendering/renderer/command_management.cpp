@@ -14,6 +14,10 @@ CommandBufferSet::CommandBufferSet(const VulkanObjectHandler& vulkanObjects)
 	{
 		pool = createCommandPool(m_device, NULL, graphicsFamilyIndex);
 	}
+	for (auto& pool : m_secondaryCommandPools)
+	{
+		pool = createCommandPool(m_device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, graphicsFamilyIndex);
+	}
 
 	m_transientPool = createCommandPool(m_device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, graphicsFamilyIndex);
 	m_asyncComputePool = createCommandPool(m_device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, computeFamilyIndex);
@@ -54,6 +58,12 @@ CommandBufferSet::~CommandBufferSet()
 	vkDestroyCommandPool(m_device, m_asyncTransferPool, nullptr);
 	vkDestroyCommandPool(m_device, m_asyncComputePool, nullptr);
 	vkDestroyCommandPool(m_device, m_transientPool, nullptr);
+	for (int i{ 0 }; i < m_secondaryCommandPools.size(); ++i)
+	{
+		if (!m_secondaryCBs[i].empty())
+			vkFreeCommandBuffers(m_device, m_secondaryCommandPools[i], m_secondaryCBs[i].size(), m_secondaryCBs[i].data());
+		vkDestroyCommandPool(m_device, m_secondaryCommandPools[i], nullptr);
+	}
 	for (auto& pool : m_threadCommandPools)
 	{
 		vkDestroyCommandPool(m_device, pool, nullptr);
@@ -148,6 +158,30 @@ CommandBufferSet::~CommandBufferSet()
 	EASSERT(vkBeginCommandBuffer(cb, &beginInfo) == VK_SUCCESS, "Vulkan", "Couldn't begin a command buffer");
 	return cb;
 }
+[[nodiscard]] VkCommandBuffer CommandBufferSet::beginSecondaryRecording(const VkCommandBufferInheritanceRenderingInfo& renderingInfo)
+{
+	int threadIndex{ oneapi::tbb::this_task_arena::current_thread_index() };
+	EASSERT(threadIndex >= 0 && threadIndex < m_secondaryCommandPools.size(), "App", "Secondary command buffers can only be recorded on TBB threads of the default arena.");
+
+	auto& cbs{ m_secondaryCBs[threadIndex] };
+	uint32_t& inUse{ m_secondaryCBsInUse[threadIndex] };
+	if (inUse == cbs.size())
+	{
+		VkCommandBuffer newCB{};
+		allocateBuffers(&newCB, m_secondaryCommandPools[threadIndex], VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+		cbs.push_back(newCB);
+	}
+	VkCommandBuffer cb{ cbs[inUse++] };
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO, .pNext = &renderingInfo };
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	EASSERT(vkBeginCommandBuffer(cb, &beginInfo) == VK_SUCCESS, "Vulkan", "Couldn't begin a command buffer");
+	return cb;
+}
 
 void CommandBufferSet::endRecording(VkCommandBuffer recordedBuffer)
 {
@@ -212,6 +246,9 @@ void CommandBufferSet::resetPoolsOnThreads()
 {
 	for (auto& pool : m_threadCommandPools)
 		vkResetCommandPool(m_device, pool, 0);
+	for (auto& pool : m_secondaryCommandPools)
+		vkResetCommandPool(m_device, pool, 0);
+	std::fill(m_secondaryCBsInUse.begin(), m_secondaryCBsInUse.end(), 0);
 }
 void CommandBufferSet::resetAllTransient()
 {
@@ -6,8 +6,11 @@
 #include <cassert>
 #include <stack>
 #include <utility>
+#include <algorithm>
 
 #include <vulkan/vulkan.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 
 #include "src/rendering/vulkan_object_handling/vulkan_object_handler.h"
 #include "src/tools/asserter.h"
@@ -33,6 +36,11 @@ private:
 	std::stack<uint32_t> m_buffersToResetIndices{};
 	std::vector<VkCommandBuffer> m_perThreadCBs{ std::thread::hardware_concurrency(), VkCommandBuffer{} };
 
+	//Secondary buffers are taken from the pool of the recording TBB thread, so pools are never accessed concurrently
+	std::vector<VkCommandPool> m_secondaryCommandPools{ std::thread::hardware_concurrency(), VkCommandPool{} };
+	std::vector<std::vector<VkCommandBuffer>> m_secondaryCBs{ std::thread::hardware_concurrency() };
+	std::vector<uint32_t> m_secondaryCBsInUse{ std::vector<uint32_t>(std::thread::hardware_concurrency(), 0) };
+
 	VkCommandPool m_interchangeableMainCB{};
 	VkCommandPool m_interchangeableAsyncComputeCB{};
 	VkCommandPool m_interchangeableAsyncTransferCB{};
@@ -62,6 +70,24 @@ public:
 	[[nodiscard]] VkCommandBuffer beginTransientRecording();
 	[[nodiscard]] VkCommandBuffer beginPerThreadRecording(int32_t index);
 	[[nodiscard]] VkCommandBuffer beginInterchangeableRecording(uint32_t indexToSet, uint32_t commandBufferIndex);
+	[[nodiscard]] VkCommandBuffer beginSecondaryRecording(const VkCommandBufferInheritanceRenderingInfo& renderingInfo);
+
+	//Splits itemCount items into chunks recorded into secondary buffers on TBB threads and executes them in order.
+	//Must be called inside dynamic rendering begun with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT. No state is inherited, so record has to bind everything it uses.
+	template<typename Record>
+	void cmdRecordInParallel(VkCommandBuffer cb, const VkCommandBufferInheritanceRenderingInfo& renderingInfo, uint32_t itemCount, uint32_t itemsPerBuffer, Record record)
+	{
+		uint32_t bufferCount{ (itemCount + itemsPerBuffer - 1) / itemsPerBuffer };
+		std::vector<VkCommandBuffer> secondaryCBs(bufferCount);
+		oneapi::tbb::parallel_for(uint32_t{ 0 }, bufferCount, [&](uint32_t i)
+			{
+				secondaryCBs[i] = beginSecondaryRecording(renderingInfo);
+				uint32_t first{ i * itemsPerBuffer };
+				record(secondaryCBs[i], first, std::min(itemsPerBuffer, itemCount - first));
+				endRecording(secondaryCBs[i]);
+			});
+		vkCmdExecuteCommands(cb, bufferCount, secondaryCBs.data());
+	}
 
 	void endRecording(VkCommandBuffer recordedBuffer);
 
@@ -2,6 +2,8 @@
 #define CULLING_CLASS_HEADER
 
 #include <cstdint>
+#include <cmath>
+#include <algorithm>
 
 #include <glm/glm.hpp>
 
@@ -12,10 +14,16 @@
 #include "src/rendering/data_management/buffer_class.h"
 #include "src/rendering/data_management/image_classes.h"
 #include "src/rendering/data_abstraction/BB.h"
+#include "src/rendering/data_abstraction/runit.h"
 #include "src/rendering/renderer/sync_operations.h"
 #include "src/rendering/renderer/depth_buffer.h"
 #include "src/tools/comp_s.h"
 
+//Per draw result of the culling passes, draws rejected by the frustum test keep the cleared value
+#define CULLING_STATUS_FRUSTUM_CULLED 0
+#define CULLING_STATUS_OCCLUDED 1
+#define CULLING_STATUS_VISIBLE 2
+
 struct IndirectData
 {
 	VkDrawIndexedIndirectCommand cmd{};
@@ -24,6 +32,25 @@ struct IndirectData
 	float bsRad{};
 };
 
+//Draws projected larger than this part of the view use full detail, every halving of the projected size moves one LOD further.
+//Simplification error bounds double with every LOD, so the error stays roughly constant in pixels
+#define LOD_FULL_DETAIL_PROJECTED_SIZE 0.25f
+
+//Index ranges of the LODs of a draw, LOD 0 is the range of the command in IndirectData
+struct DrawLODData
+{
+	uint32_t lodCount{};
+	uint32_t firstIndex[LOD_MAX_COUNT]{};
+	uint32_t indexCount[LOD_MAX_COUNT]{};
+};
+
+//Same as selectLOD in lod_selection.h
+inline uint32_t selectLOD(float projectedSize, uint32_t lodCount)
+{
+	float lod{ std::floor(std::log2(LOD_FULL_DETAIL_PROJECTED_SIZE / std::max(projectedSize, 1e-6f))) };
+	return static_cast<uint32_t>(std::clamp(lod, 0.0f, static_cast<float>(lodCount - 1)));
+}
+
 struct FrustumInfo
 {
 	glm::vec4 planes[6]{};
@@ -44,9 +71,12 @@ private:
 	Buffer m_drawCount{};
 	Buffer m_targetDrawCommands{};
 	Buffer m_targetDrawDataIndices{};
+	Buffer m_drawCullingStatus{};
+	Buffer m_drawFirstIndices{};
 
 	uint32_t m_frustumNonculledCount{};
 	uint32_t m_hiZmipmax{};
+	glm::vec2 m_hiZUVScale{};
 	uint32_t m_maxDrawCount{};
 	float m_zNear{};
 
@@ -58,11 +88,12 @@ public:
 		float zNearProjPlane,
 		const ResourceSet& viewprojRS,
 		const BufferMapped& indirectDrawCmdData,
+		const BufferMapped& drawLODData,
 		const DepthBuffer& depthBuffer,
 		uint32_t computeQueueIndex,
 		uint32_t graphicsQueueIndex)
 		: m_baseShared{ device, sizeof(uint32_t) * drawCommandsMax + 512, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, BufferBase::NULL_FLAG, true },
-		m_baseDevice{ device, (sizeof(uint32_t) * 2 + sizeof(VkDrawIndexedIndirectCommand)) * drawCommandsMax + 512, 
+		m_baseDevice{ device, (sizeof(uint32_t) * 4 + sizeof(VkDrawIndexedIndirectCommand)) * drawCommandsMax + 512, 
 			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 
 			{{graphicsQueueIndex, computeQueueIndex}}, BufferBase::NULL_FLAG }
 	{
@@ -74,6 +105,7 @@ public:
 		m_dependencyInfo.pMemoryBarriers = &m_memBarrier;
 
 		m_hiZmipmax = depthBuffer.getMipLevelCountHiZ();
+		m_hiZUVScale = depthBuffer.getUVScaleHiZ();
 		m_zNear = zNearProjPlane;
 		m_maxDrawCount = drawCommandsMax;
 
@@ -81,6 +113,8 @@ public:
 		m_drawCount.initialize(m_baseDevice, sizeof(uint32_t));
 		m_targetDrawCommands.initialize(m_baseDevice, sizeof(VkDrawIndexedIndirectCommand) * drawCommandsMax);
 		m_targetDrawDataIndices.initialize(m_baseDevice, sizeof(uint32_t) * drawCommandsMax);
+		m_drawCullingStatus.initialize(m_baseDevice, sizeof(uint32_t) * drawCommandsMax);
+		m_drawFirstIndices.initialize(m_baseDevice, sizeof(uint32_t) * drawCommandsMax);
 
 		VkDescriptorSetLayoutBinding indicesBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
 		VkDescriptorAddressInfoEXT indicesAddressinfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_indicesCmds.getDeviceAddress(), .range = m_indicesCmds.getSize() };
@@ -97,18 +131,30 @@ public:
 		VkDescriptorSetLayoutBinding drawDataIndicesBinding{ .binding = 5, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
 		VkDescriptorAddressInfoEXT drawDataIndicesAddressinfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_targetDrawDataIndices.getDeviceAddress(), .range = m_targetDrawDataIndices.getSize() };
 
+		VkDescriptorSetLayoutBinding cullingStatusBinding{ .binding = 6, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorAddressInfoEXT cullingStatusAddressinfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_drawCullingStatus.getDeviceAddress(), .range = m_drawCullingStatus.getSize() };
+
+		VkDescriptorSetLayoutBinding drawLODsBinding{ .binding = 7, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorAddressInfoEXT drawLODsAddressinfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = drawLODData.getDeviceAddress(), .range = drawLODData.getSize() };
+
+		VkDescriptorSetLayoutBinding drawFirstIndicesBinding{ .binding = 8, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		VkDescriptorAddressInfoEXT drawFirstIndicesAddressinfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_drawFirstIndices.getDeviceAddress(), .range = m_drawFirstIndices.getSize() };
+
 		VkDescriptorSetLayoutBinding hiZBinding{ .binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
 		VkDescriptorImageInfo hiZImageInfo{ .sampler = depthBuffer.getReductionSampler(), .imageView = depthBuffer.getImageViewHiZ(), .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
 
 		m_resSet.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlags{},
-			std::array{ indicesBinding, cmdAndSpheresBinding, targetCmdsBinding, drawCountBinding, hiZBinding, drawDataIndicesBinding }, std::array<VkDescriptorBindingFlags, 0>{},
+			std::array{ indicesBinding, cmdAndSpheresBinding, targetCmdsBinding, drawCountBinding, hiZBinding, drawDataIndicesBinding, cullingStatusBinding, drawLODsBinding, drawFirstIndicesBinding }, std::array<VkDescriptorBindingFlags, 0>{},
 			std::vector<std::vector<VkDescriptorDataEXT>>{
 				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &indicesAddressinfo} },
 				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &cmdAndSpheresAddressinfo} },
 				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &targetCmdsAddressinfo} },
 				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawCountAddressinfo} },
 				std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &hiZImageInfo} },
-				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawDataIndicesAddressinfo} }},
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawDataIndicesAddressinfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &cullingStatusAddressinfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawLODsAddressinfo} },
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawFirstIndicesAddressinfo} }},
 			true);
 
 		std::array<std::reference_wrapper<const ResourceSet>, 2> resourceSets{ viewprojRS, m_resSet };
@@ -116,7 +162,7 @@ public:
 		m_occlusionPass.initializaCompute(device,
 			"shaders/cmpld/occlusion_culling_comp.spv",
 			resourceSets,
-			{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(uint32_t) * 2 + sizeof(float)}} });
+			{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(uint32_t) * 2 + sizeof(float) * 3}} });
 	}
 
 	uint32_t cullAgainstFrustum(const OBBs& boundingBoxes, const FrustumInfo& frustumInfo, const glm::mat4& viewMat)
@@ -187,6 +233,7 @@ public:
 	{
 		uint32_t zero{ 0 };
 		vkCmdUpdateBuffer(cb, m_drawCount.getBufferHandle(), m_drawCount.getOffset(), sizeof(zero), &zero);
+		vkCmdFillBuffer(cb, m_drawCullingStatus.getBufferHandle(), m_drawCullingStatus.getOffset(), m_drawCullingStatus.getSize(), CULLING_STATUS_FRUSTUM_CULLED);
 	}
 
 	const VkDependencyInfo& getDependency()
@@ -194,15 +241,23 @@ public:
 		return m_dependencyInfo;
 	}
 
+	//The part of Hi-Z covered by the screen follows the render resolution
+	void updateHiZUVScale(const DepthBuffer& depthBuffer)
+	{
+		m_hiZUVScale = depthBuffer.getUVScaleHiZ();
+	}
+
 	void cmdDispatchCullOccluded(VkCommandBuffer cb)
 	{
 		m_occlusionPass.cmdBind(cb);
 		m_occlusionPass.cmdBindResourceSets(cb);
-		struct {uint32_t commandCount; uint32_t mipMax; float zNear;} pcData;
+		struct {uint32_t commandCount; uint32_t mipMax; float zNear; float uvScaleX; float uvScaleY;} pcData;
 		pcData.commandCount = m_frustumNonculledCount;
 		pcData.mipMax = m_hiZmipmax;
 		pcData.zNear = m_zNear;
-		vkCmdPushConstants(cb, m_occlusionPass.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t) * 2 + sizeof(float), &pcData);
+		pcData.uvScaleX = m_hiZUVScale.x;
+		pcData.uvScaleY = m_hiZUVScale.y;
+		vkCmdPushConstants(cb, m_occlusionPass.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t) * 2 + sizeof(float) * 3, &pcData);
 		constexpr uint32_t groupsizeX{ 64 };
 		vkCmdDispatch(cb, DISPATCH_SIZE(m_frustumNonculledCount, groupsizeX), 1, 1);
 	}
@@ -233,6 +288,16 @@ public:
 	{
 		return m_targetDrawDataIndices;
 	}
+	//CULLING_STATUS_* of every draw in the frame
+	const Buffer& getDrawCullingStatusBuffer() const
+	{
+		return m_drawCullingStatus;
+	}
+	//First index of the LOD each visible draw was rendered with this frame
+	const Buffer& getDrawFirstIndexBuffer() const
+	{
+		return m_drawFirstIndices;
+	}
 
 	uint32_t getMaxDrawCount() const
 	{
@@ -14,24 +14,35 @@ DeferredLighting::DeferredLighting(VkDevice device, uint32_t width, uint32_t hei
 	const ResourceSet& drawDataRS,
 	const ResourceSet& BRDFLUTRS,
 	const ResourceSet& directLightingRS,
+	const Buffer& vertexData,
+	const Buffer& indexData,
+	const BufferMapped& indirectDrawCmdData,
+	const Buffer& drawFirstIndices,
 	VkSampler generalSampler)
 	: m_UV{ device, VK_FORMAT_R32_UINT, width, height, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT },
 	m_tangentFrame{ device, VK_FORMAT_A2B10G10R10_UNORM_PACK32, width, height, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT },
 	m_drawID{ device, VK_FORMAT_R16_UINT, width, height, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT },
+	m_velocity{ device, VK_FORMAT_R16G16_SFLOAT, width, height, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT },
 	m_outputFramebuffer{ device, VK_FORMAT_R16G16B16A16_SFLOAT, width, height, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT },
-	m_depthBuffer{ depthBuffer }
+	m_depthBuffer{ depthBuffer },
+	m_renderWidth{ width },
+	m_renderHeight{ height },
+	m_tileClassificationBase{ device, 
+		sizeof(VkDispatchIndirectCommand) * LIGHTING_TILE_CLASS_COUNT + sizeof(uint32_t) * LIGHTING_TILE_CLASS_COUNT * DISPATCH_SIZE(width, LIGHTING_TILE_SIZE) * DISPATCH_SIZE(height, LIGHTING_TILE_SIZE) + 512,
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT }
 {
 	PipelineAssembler assembler{ device };
 
-	assembler.setDynamicState(PipelineAssembler::DYNAMIC_STATE_DEFAULT);
-	assembler.setViewportState(PipelineAssembler::VIEWPORT_STATE_DEFAULT, width, height);
+	//The viewport follows the render extent chosen by dynamic resolution
+	assembler.setDynamicState(PipelineAssembler::DYNAMIC_STATE_VIEWPORT);
+	assembler.setViewportState(PipelineAssembler::VIEWPORT_STATE_DYNAMIC);
 	assembler.setInputAssemblyState(PipelineAssembler::INPUT_ASSEMBLY_STATE_DEFAULT);
 	assembler.setTesselationState(PipelineAssembler::TESSELATION_STATE_DEFAULT);
 	assembler.setMultisamplingState(PipelineAssembler::MULTISAMPLING_STATE_DISABLED);
 	assembler.setRasterizationState(PipelineAssembler::RASTERIZATION_STATE_DEFAULT);
 	assembler.setDepthStencilState(PipelineAssembler::DEPTH_STENCIL_STATE_DEFAULT);
-	assembler.setColorBlendState(PipelineAssembler::COLOR_BLEND_STATE_DISABLED, 3);
-	VkFormat formats[3]{ VK_FORMAT_R32_UINT, VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_FORMAT_R16_UINT };
+	assembler.setColorBlendState(PipelineAssembler::COLOR_BLEND_STATE_DISABLED, 4);
+	VkFormat formats[4]{ VK_FORMAT_R32_UINT, VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_FORMAT_R16_UINT, VK_FORMAT_R16G16_SFLOAT };
 	assembler.setPipelineRenderingState(PipelineAssembler::PIPELINE_RENDERING_STATE_DEFAULT, formats, ARRAYSIZE(formats));
 
 	std::array<std::reference_wrapper<const ResourceSet>, 3> resourceSets0{ viewprojRS, transformMatricesRS, drawDataRS };
@@ -42,6 +53,15 @@ DeferredLighting::DeferredLighting(VkDevice device, uint32_t width, uint32_t hei
 		{ {StaticVertex::getBindingDescription()} },
 		{ StaticVertex::getAttributeDescriptions() });
 
+	VkFormat visibilityFormats[3]{ VK_FORMAT_R32_UINT, VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_FORMAT_R16G16_SFLOAT };
+	assembler.setColorBlendState(PipelineAssembler::COLOR_BLEND_STATE_DISABLED, ARRAYSIZE(visibilityFormats));
+	assembler.setPipelineRenderingState(PipelineAssembler::PIPELINE_RENDERING_STATE_DEFAULT, visibilityFormats, ARRAYSIZE(visibilityFormats));
+	m_visibilityBufferPipeline.initializeGraphics(assembler,
+		{ { ShaderStage{.stage = VK_SHADER_STAGE_VERTEX_BIT, .filepath = "shaders/cmpld/uv_buffer_vert.spv"},  ShaderStage{.stage = VK_SHADER_STAGE_FRAGMENT_BIT, .filepath = "shaders/cmpld/visibility_buffer_frag.spv"} } },
+		resourceSets0,
+		{ {StaticVertex::getBindingDescription()} },
+		{ StaticVertex::getAttributeDescriptions() });
+
 
 	VkDescriptorSetLayoutBinding uvBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
 	VkDescriptorImageInfo uvImageInfo{ .imageView = m_UV.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
@@ -68,76 +88,81 @@ DeferredLighting::DeferredLighting(VkDevice device, uint32_t width, uint32_t hei
 		true);
 
 
-	std::array<std::reference_wrapper<const ResourceSet>, 11> resourceSets1{
+	//Lists are sized for the full resolution tile count so that they never overflow when the render extent changes
+	m_pcData.tileListStride = DISPATCH_SIZE(width, LIGHTING_TILE_SIZE) * DISPATCH_SIZE(height, LIGHTING_TILE_SIZE);
+	m_tileDispatches.initialize(m_tileClassificationBase, sizeof(VkDispatchIndirectCommand) * LIGHTING_TILE_CLASS_COUNT);
+	m_tileLists.initialize(m_tileClassificationBase, sizeof(uint32_t) * LIGHTING_TILE_CLASS_COUNT * m_pcData.tileListStride);
+
+	VkDescriptorSetLayoutBinding tileDispatchesBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT tileDispatchesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_tileDispatches.getDeviceAddress(), .range = m_tileDispatches.getSize() };
+	VkDescriptorSetLayoutBinding tileListsBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT tileListsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_tileLists.getDeviceAddress(), .range = m_tileLists.getSize() };
+	m_tileClassificationRS.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
+		std::array{ tileDispatchesBinding, tileListsBinding },
+		std::array<VkDescriptorBindingFlags, 0>{},
+		std::vector<std::vector<VkDescriptorDataEXT>>{
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &tileDispatchesAddressInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &tileListsAddressInfo} } },
+		false);
+
+	std::array<std::reference_wrapper<const ResourceSet>, 3> resourceSetsClassification{ m_resSet, directLightingRS, m_tileClassificationRS };
+	m_classifyTilesPipeline.initializaCompute(device, "shaders/cmpld/lighting_classify_comp.spv", resourceSetsClassification,
+		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcData) }} });
+
+	VkDescriptorSetLayoutBinding vertexDataBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT vertexDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = vertexData.getDeviceAddress(), .range = vertexData.getSize() };
+	VkDescriptorSetLayoutBinding indexDataBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT indexDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = indexData.getDeviceAddress(), .range = indexData.getSize() };
+	VkDescriptorSetLayoutBinding drawCommandsBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT drawCommandsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = indirectDrawCmdData.getDeviceAddress(), .range = indirectDrawCmdData.getSize() };
+	VkDescriptorSetLayoutBinding drawFirstIndicesBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT drawFirstIndicesAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = drawFirstIndices.getDeviceAddress(), .range = drawFirstIndices.getSize() };
+	m_geometryRS.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
+		std::array{ vertexDataBinding, indexDataBinding, drawCommandsBinding, drawFirstIndicesBinding },
+		std::array<VkDescriptorBindingFlags, 0>{},
+		std::vector<std::vector<VkDescriptorDataEXT>>{
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &vertexDataAddressInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &indexDataAddressInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawCommandsAddressInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawFirstIndicesAddressInfo} } },
+		false, true);
+
+	std::array<std::reference_wrapper<const ResourceSet>, 14> resourceSets1{
 		viewprojRS, m_resSet, 
 		materialsTexturesRS, shadowMapsRS, 
 		indirectDiffiseLightingRS, indirectSpecularLightingRS, indirectLightingMetadataRS,
 		distantProbeRS,
 		drawDataRS, 
 		BRDFLUTRS, 
-		directLightingRS };
-	m_lightingComputePipeline.initializaCompute(device, "shaders/cmpld/lighting_pass_comp.spv", resourceSets1,
-		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcData) }} });
+		directLightingRS,
+		m_tileClassificationRS,
+		transformMatricesRS,
+		m_geometryRS };
+	for (uint32_t tileClass{ 0 }; tileClass < LIGHTING_TILE_CLASS_COUNT; ++tileClass)
+	{
+		m_lightingComputePipelines[tileClass].initializaCompute(device, "shaders/cmpld/lighting_pass_comp.spv", resourceSets1,
+			{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcData) }} },
+			{ {tileClass, 0} });
+		m_visibilityLightingComputePipelines[tileClass].initializaCompute(device, "shaders/cmpld/lighting_pass_comp.spv", resourceSets1,
+			{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcData) }} },
+			{ {tileClass, 1} });
+	}
 
-	m_pcData.invResolution = { 1.0 / width, 1.0 / height };
+	setRenderExtent(width, height);
+	m_pcData.aoUVScale = m_pcData.uvScale;
+}
 
-	m_imageBarriers = {
-		SyncOperations::constructImageBarrier(
-			VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT,
-			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-			m_outputFramebuffer.getImageHandle(), m_outputFramebuffer.getSubresourceRange()),
-		SyncOperations::constructImageBarrier(
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			m_UV.getImageHandle(), m_UV.getSubresourceRange()),
-		SyncOperations::constructImageBarrier(
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			m_tangentFrame.getImageHandle(), m_tangentFrame.getSubresourceRange()),
-		SyncOperations::constructImageBarrier(
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			m_drawID.getImageHandle(), m_drawID.getSubresourceRange()),
-		SyncOperations::constructImageBarrier(
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
-			m_depthBuffer.getImageHandle(), m_depthBuffer.getDepthBufferSubresourceRange()) };
-
-	m_dependencyInfo = SyncOperations::createDependencyInfo(m_imageBarriers);
+void DeferredLighting::setRenderExtent(uint32_t width, uint32_t height)
+{
+	m_renderWidth = width;
+	m_renderHeight = height;
+	m_pcData.invResolution = { 1.0 / width, 1.0 / height };
+	m_pcData.uvScale = { float(width) / m_UV.getWidth(), float(height) / m_UV.getHeight() };
 }
 
 void DeferredLighting::cmdPassDrawToUVBuffer(VkCommandBuffer cb, const Culling& culling, const Buffer& vertexData, const Buffer& indexData)
 	{
-		SyncOperations::cmdExecuteBarrier(cb, 
-			{{
-			SyncOperations::constructImageBarrier(
-				VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-				m_UV.getImageHandle(), m_UV.getSubresourceRange()),
-			SyncOperations::constructImageBarrier(
-				VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-				m_tangentFrame.getImageHandle(), m_tangentFrame.getSubresourceRange()),
-			SyncOperations::constructImageBarrier(
-				VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-				m_drawID.getImageHandle(), m_drawID.getSubresourceRange()),
-			SyncOperations::constructImageBarrier(
-				VK_PIPELINE_STAGE_NONE, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-				VK_ACCESS_NONE, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-				m_depthBuffer.getImageHandle(), m_depthBuffer.getDepthBufferSubresourceRange())
-			}});
-
-		VkRenderingAttachmentInfo colorAttachmentInfos[3]{ 
+		VkRenderingAttachmentInfo colorAttachmentInfos[4]{ 
 			{
 				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
 				.imageView = m_UV.getImageView(),
@@ -161,6 +186,14 @@ void DeferredLighting::cmdPassDrawToUVBuffer(VkCommandBuffer cb, const Culling&
 				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
 				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
 				.clearValue = VkClearValue{.color{.uint32 = 0} }
+			}, 
+			{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+				.imageView = m_velocity.getImageView(),
+				.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.clearValue = VkClearValue{.color{.float32{0.0f, 0.0f}} }
 			}};
 		VkRenderingAttachmentInfo depthAttachmentInfo{
 			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
@@ -171,15 +204,19 @@ void DeferredLighting::cmdPassDrawToUVBuffer(VkCommandBuffer cb, const Culling&
 			.clearValue = {.depthStencil = {.depth = 0.0f, .stencil = 0} }
 		};
 
-		uint32_t width{ m_UV.getWidth() };
-		uint32_t height{ m_UV.getHeight() };
+		uint32_t width{ m_renderWidth };
+		uint32_t height{ m_renderHeight };
+		VkViewport viewport{ .x = 0.0f, .y = 0.0f, .width = float(width), .height = float(height), .minDepth = 0.0f, .maxDepth = 1.0f };
+
+		//Visibility, tangent frame and velocity
+		VkRenderingAttachmentInfo visibilityAttachmentInfos[3]{ colorAttachmentInfos[0], colorAttachmentInfos[1], colorAttachmentInfos[3] };
 
 		VkRenderingInfo renderInfo{};
 		renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
 		renderInfo.renderArea = { .offset{0,0}, .extent{.width = width, .height = height} };
 		renderInfo.layerCount = 1;
-		renderInfo.colorAttachmentCount = ARRAYSIZE(colorAttachmentInfos);
-		renderInfo.pColorAttachments = colorAttachmentInfos;
+		renderInfo.colorAttachmentCount = m_visibilityBufferEnabled ? ARRAYSIZE(visibilityAttachmentInfos) : ARRAYSIZE(colorAttachmentInfos);
+		renderInfo.pColorAttachments = m_visibilityBufferEnabled ? visibilityAttachmentInfos : colorAttachmentInfos;
 		renderInfo.pDepthAttachment = &depthAttachmentInfo;
 
 		VkBuffer vertexBindings[1]{ vertexData.getBufferHandle() };
@@ -187,10 +224,12 @@ void DeferredLighting::cmdPassDrawToUVBuffer(VkCommandBuffer cb, const Culling&
 
 		vkCmdBeginRendering(cb, &renderInfo);
 			
+			vkCmdSetViewport(cb, 0, 1, &viewport);
 			vkCmdBindVertexBuffers(cb, 0, 1, vertexBindings, vertexBindingOffsets);
 			vkCmdBindIndexBuffer(cb, indexData.getBufferHandle(), indexData.getOffset(), VK_INDEX_TYPE_UINT32);
-			m_uvBufferPipeline.cmdBindResourceSets(cb);
-			m_uvBufferPipeline.cmdBind(cb);
+			Pipeline& uvBufferPipeline{ m_visibilityBufferEnabled ? m_visibilityBufferPipeline : m_uvBufferPipeline };
+			uvBufferPipeline.cmdBindResourceSets(cb);
+			uvBufferPipeline.cmdBind(cb);
 			vkCmdDrawIndexedIndirectCount(cb,
 				culling.getDrawCommandBufferHandle(), culling.getDrawCommandBufferOffset(),
 				culling.getDrawCountBufferHandle(), culling.getDrawCountBufferOffset(),
@@ -201,11 +240,32 @@ void DeferredLighting::cmdPassDrawToUVBuffer(VkCommandBuffer cb, const Culling&
 
 void DeferredLighting::cmdDispatchLightingCompute(VkCommandBuffer cb, uint32_t indirectCurrentSet)
 {
+	VkDispatchIndirectCommand emptyDispatches[LIGHTING_TILE_CLASS_COUNT];
+	for (auto& dispatch : emptyDispatches)
+		dispatch = VkDispatchIndirectCommand{ .x = 0, .y = 1, .z = 1 };
+	vkCmdUpdateBuffer(cb, m_tileDispatches.getBufferHandle(), m_tileDispatches.getOffset(), sizeof(emptyDispatches), emptyDispatches);
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)} });
+
+	m_classifyTilesPipeline.cmdBindResourceSets(cb);
+	m_classifyTilesPipeline.cmdBind(cb);
+	vkCmdPushConstants(cb, m_classifyTilesPipeline.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcData), &m_pcData);
+	vkCmdDispatch(cb, DISPATCH_SIZE(m_renderWidth, LIGHTING_TILE_SIZE), DISPATCH_SIZE(m_renderHeight, LIGHTING_TILE_SIZE), 1);
+
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT)} });
+
+	//Sky tiles are in none of the lists
 	constexpr uint32_t indirectResourceSetIndex{ 4 };
-	m_lightingComputePipeline.setResourceInUse(indirectResourceSetIndex, indirectCurrentSet);
-	m_lightingComputePipeline.cmdBindResourceSets(cb);
-	m_lightingComputePipeline.cmdBind(cb);
-	vkCmdPushConstants(cb, m_lightingComputePipeline.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcData), &m_pcData);
-	constexpr uint32_t groupSize{ 8 };
-	vkCmdDispatch(cb, DISPATCH_SIZE(m_UV.getWidth(), groupSize), DISPATCH_SIZE(m_UV.getHeight(), groupSize), 1);
+	for (uint32_t tileClass{ 0 }; tileClass < LIGHTING_TILE_CLASS_COUNT; ++tileClass)
+	{
+		Pipeline& lightingPipeline{ m_visibilityBufferEnabled ? m_visibilityLightingComputePipelines[tileClass] : m_lightingComputePipelines[tileClass] };
+		lightingPipeline.setResourceInUse(indirectResourceSetIndex, indirectCurrentSet);
+		lightingPipeline.cmdBindResourceSets(cb);
+		lightingPipeline.cmdBind(cb);
+		vkCmdPushConstants(cb, lightingPipeline.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcData), &m_pcData);
+		vkCmdDispatchIndirect(cb, m_tileDispatches.getBufferHandle(), m_tileDispatches.getOffset() + sizeof(VkDispatchIndirectCommand) * tileClass);
+	}
 }
\ No newline at end of file
@@ -15,24 +15,50 @@
 #include "src/tools/arraysize.h"
 #include "src/tools/comp_s.h"
 
+//Lighting tiles are classified every frame and each class is lit by a specialized variant of the lighting shader
+#define LIGHTING_TILE_SIZE 8
+#define LIGHTING_TILE_CLASS_UNLIT 0
+#define LIGHTING_TILE_CLASS_LIT 1
+#define LIGHTING_TILE_CLASS_SHADOWED 2
+#define LIGHTING_TILE_CLASS_COUNT 3
+
+//Visibility buffer layout stores a draw index and a triangle index of the draw in one 32 bit value
+#define VISIBILITY_TRIANGLE_ID_BITS 20
+#define VISIBILITY_MAX_DRAW_COUNT (1u << (32 - VISIBILITY_TRIANGLE_ID_BITS))
+
 class DeferredLighting
 {
 private:
 	Image m_UV;
 	Image m_tangentFrame;
 	Image m_drawID;
+	Image m_velocity;
 
 	Image m_outputFramebuffer;
 
 	const DepthBuffer& m_depthBuffer;
 
-	Pipeline m_uvBufferPipeline{};
-	Pipeline m_lightingComputePipeline{};
+	//Part of the images covered by the scaled rendering
+	uint32_t m_renderWidth{};
+	uint32_t m_renderHeight{};
 
-	std::array<VkImageMemoryBarrier2, 5> m_imageBarriers{};
-	VkDependencyInfo m_dependencyInfo{};
+	Pipeline m_uvBufferPipeline{};
+	Pipeline m_visibilityBufferPipeline{};
+	Pipeline m_classifyTilesPipeline{};
+	std::array<Pipeline, LIGHTING_TILE_CLASS_COUNT> m_lightingComputePipelines{};
+	std::array<Pipeline, LIGHTING_TILE_CLASS_COUNT> m_visibilityLightingComputePipelines{};
 
 	ResourceSet m_resSet{};
+	//Geometry the lighting pass reconstructs surfaces from in the visibility buffer mode
+	ResourceSet m_geometryRS{};
+
+	bool m_visibilityBufferEnabled{ false };
+
+	//Per class dispatch commands followed by per class tile lists
+	BufferBaseHostInaccessible m_tileClassificationBase;
+	Buffer m_tileDispatches{};
+	Buffer m_tileLists{};
+	ResourceSet m_tileClassificationRS{};
 	
 	struct
 	{
@@ -41,10 +67,12 @@ private:
 		glm::vec2 invResolution;
 		uint32_t windowTileWidth;
 		float nearPlane;
-		glm::vec3 giSceneCenter;
 		float farPlane;
 		uint32_t skyboxEnabled;
 		uint32_t debugOptionsBitfield;
+		uint32_t tileListStride;
+		glm::vec2 uvScale;
+		glm::vec2 aoUVScale;
 	} m_pcData;
 
 public:
@@ -62,6 +90,10 @@ public:
 		const ResourceSet& drawDataRS,
 		const ResourceSet& pbrRS,
 		const ResourceSet& directLightingRS,
+		const Buffer& vertexData,
+		const Buffer& indexData,
+		const BufferMapped& indirectDrawCmdData,
+		const Buffer& drawFirstIndices,
 		VkSampler generalSampler);
 	~DeferredLighting() = default;
 
@@ -82,10 +114,6 @@ public:
 	{
 		m_pcData.windowTileWidth = tileWidth;
 	}
-	void updateGISceneCenter(const glm::vec3& giSceneCenter)
-	{
-		m_pcData.giSceneCenter = giSceneCenter;
-	}
 	void updateSkyboxState(bool enabled)
 	{
 		m_pcData.skyboxEnabled = enabled ? 1u : 0u;
@@ -94,6 +122,17 @@ public:
 	{
 		m_pcData.debugOptionsBitfield = bitfield;
 	}
+	void setRenderExtent(uint32_t width, uint32_t height);
+	//The UV image holds packed draw and triangle IDs instead of UVs, and the draw ID image is not written
+	void setVisibilityBufferEnabled(bool enabled)
+	{
+		m_visibilityBufferEnabled = enabled;
+	}
+	//AO may be computed at a fraction of the render resolution
+	void updateAOUVScale(glm::vec2 aoUVScale)
+	{
+		m_pcData.aoUVScale = aoUVScale;
+	}
 
 	const Image& getFramebuffer() const
 	{
@@ -116,11 +155,28 @@ public:
 		return m_tangentFrame;
 	}
 
+	//Geometry can be relocated by defragmentation
+	void updateGeometryData(const Buffer& vertexData, const Buffer& indexData)
+	{
+		VkDescriptorAddressInfoEXT vertexDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = vertexData.getDeviceAddress(), .range = vertexData.getSize() };
+		m_geometryRS.rewriteDescriptor(0, 0, 0, {.pStorageBuffer = &vertexDataAddressInfo});
+		VkDescriptorAddressInfoEXT indexDataAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = indexData.getDeviceAddress(), .range = indexData.getSize() };
+		m_geometryRS.rewriteDescriptor(1, 0, 0, {.pStorageBuffer = &indexDataAddressInfo});
+	}
+
 	void cmdPassDrawToUVBuffer(VkCommandBuffer cb, const Culling& culling, const Buffer& vertexData, const Buffer& indexData);
 
-	const VkDependencyInfo& getDependency()
+	const Image& getUVImage() const
+	{
+		return m_UV;
+	}
+	const Image& getDrawIDImage() const
+	{
+		return m_drawID;
+	}
+	const Image& getVelocityImage() const
 	{
-		return m_dependencyInfo;
+		return m_velocity;
 	}
 
 	void cmdDispatchLightingCompute(VkCommandBuffer cb, uint32_t indirectCurrentSet);
@@ -2,13 +2,23 @@
 #define DEPTH_BUFFER_CLASS
 
 #include <cstdint>
+#include <bit>
+
+#include <glm/glm.hpp>
 
 #include "src/rendering/renderer/pipeline_management.h"
 #include "src/rendering/renderer/descriptor_management.h"
 #include "src/rendering/renderer/command_management.h"
 #include "src/rendering/renderer/sync_operations.h"
 #include "src/rendering/data_management/image_classes.h"
+#include "src/rendering/data_management/buffer_class.h"
 #include "src/tools/comp_s.h"
+#include "src/tools/asserter.h"
+
+//Hi-Z is built in a single dispatch. Every workgroup reduces a tile of mip 0 down to a single texel of mip HIZ_TILE_MIP_COUNT, the last one to finish reduces the rest
+#define HIZ_MAX_MIP_COUNT 13
+#define HIZ_TILE_SIZE 64
+#define HIZ_TILE_MIP_COUNT 6
 
 class DepthBuffer
 {
@@ -17,6 +27,19 @@ private:
 
 	Image m_depthImage;
 	Image m_hierarchicalZ;
+	//Hi-Z has power of two dimensions so that every mip is an exact 2x2 reduction of the previous one, the screen covers its top left part
+	uint32_t m_validWidthHiZ{};
+	uint32_t m_validHeightHiZ{};
+	//Depth is rendered into the top left part of the image when the render resolution is scaled down.
+	//Hi-Z is built at the start of the frame from the depth of the previous one, so the extent it was drawn with is kept separately
+	uint32_t m_renderWidth{};
+	uint32_t m_renderHeight{};
+	uint32_t m_drawnWidth{};
+	uint32_t m_drawnHeight{};
+
+	BufferBaseHostInaccessible m_baseDevice;
+	Buffer m_workgroupCounter{};
+	bool m_workgroupCounterCleared{ false };
 
 	ResourceSet m_resSet{};
 	Pipeline m_calcHiZ{};
@@ -30,7 +53,14 @@ public:
 	DepthBuffer(VkDevice device, uint32_t width, uint32_t heigth)
 		: m_device{ device },
 		m_depthImage{ device, VK_FORMAT_D32_SFLOAT, width, heigth, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT },
-		m_hierarchicalZ{ device, VK_FORMAT_R32_SFLOAT, width / 2, heigth / 2, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, true }
+		m_hierarchicalZ{ device, VK_FORMAT_R32_SFLOAT, std::bit_ceil(DISPATCH_SIZE(width, 2u)), std::bit_ceil(DISPATCH_SIZE(heigth, 2u)), VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT, true },
+		m_validWidthHiZ{ DISPATCH_SIZE(width, 2u) },
+		m_validHeightHiZ{ DISPATCH_SIZE(heigth, 2u) },
+		m_renderWidth{ width },
+		m_renderHeight{ heigth },
+		m_drawnWidth{ width },
+		m_drawnHeight{ heigth },
+		m_baseDevice{ device, 512, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT }
 	{
 		VkSamplerCreateInfo samplerCI{
 			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -69,32 +99,34 @@ public:
 			vkCreateImageView(device, &imageViewCI, nullptr, &m_imageViewsHiZ[i]);
 		}
 
-		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
-		std::vector<VkDescriptorImageInfo> imageInfos(operationNum * 2);
-
-		bindings[0] = { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
-		bindings[1] = { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
-
-		imageInfos[0] = { .sampler = m_samplerHiZ, .imageView = m_depthImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-		imageInfos[1] = { .imageView = m_imageViewsHiZ[0], .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-		for (int i{ 1 }; i < activeMips; ++i)
-		{
-			imageInfos[2 * i] = { .sampler = m_samplerHiZ, .imageView = m_imageViewsHiZ[i - 1], .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-			imageInfos[2 * i + 1] = { .imageView = m_imageViewsHiZ[i + 0], .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
-		}
+		EASSERT(activeMips <= HIZ_MAX_MIP_COUNT, "App", "Hi-Z has more mips than a single pass reduction can produce.");
 
-		std::vector<std::vector<VkDescriptorDataEXT>> descData(2);
+		m_workgroupCounter.initialize(m_baseDevice, sizeof(uint32_t));
 
-		for (int i{ 0 }; i < m_hiZopCount; ++i)
+		std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+		bindings[0] = { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		bindings[1] = { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = HIZ_MAX_MIP_COUNT, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+		bindings[2] = { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+
+		VkDescriptorImageInfo depthImageInfo{ .sampler = m_samplerHiZ, .imageView = m_depthImage.getImageView(), .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		//Unused array elements point to the last mip, the shader never writes past the mip count
+		std::array<VkDescriptorImageInfo, HIZ_MAX_MIP_COUNT> mipImageInfos{};
+		std::vector<VkDescriptorDataEXT> mipDescData(HIZ_MAX_MIP_COUNT);
+		for (int i{ 0 }; i < HIZ_MAX_MIP_COUNT; ++i)
 		{
-			descData[0].push_back(VkDescriptorDataEXT{ .pCombinedImageSampler = &imageInfos[2 * i + 0] });
-			descData[1].push_back(VkDescriptorDataEXT{ .pStorageImage = &imageInfos[2 * i + 1] });
+			mipImageInfos[i] = { .imageView = m_imageViewsHiZ[std::min(i, static_cast<int>(activeMips) - 1)], .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+			mipDescData[i].pStorageImage = &mipImageInfos[i];
 		}
+		VkDescriptorAddressInfoEXT counterAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_workgroupCounter.getDeviceAddress(), .range = m_workgroupCounter.getSize() };
 
-		m_resSet.initializeSet(device, operationNum, VkDescriptorSetLayoutCreateFlags{},
+		m_resSet.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlags{},
 			bindings, 
 			std::array<VkDescriptorBindingFlags, 0>{},
-			descData, true);
+			std::vector<std::vector<VkDescriptorDataEXT>>{
+				std::vector<VkDescriptorDataEXT>{ {.pCombinedImageSampler = &depthImageInfo} },
+				mipDescData,
+				std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &counterAddressInfo} }},
+			true);
 
 		std::array<std::reference_wrapper<const ResourceSet>, 1> resourceSets{ m_resSet };
 
@@ -113,8 +145,29 @@ public:
 		delete[] m_imageViewsHiZ;
 	}
 
+	void setRenderExtent(uint32_t width, uint32_t height)
+	{
+		m_renderWidth = width;
+		m_renderHeight = height;
+	}
+
 	void cmdCalcHiZ(VkCommandBuffer cb)
 	{
+		m_validWidthHiZ = DISPATCH_SIZE(m_drawnWidth, 2u);
+		m_validHeightHiZ = DISPATCH_SIZE(m_drawnHeight, 2u);
+		m_drawnWidth = m_renderWidth;
+		m_drawnHeight = m_renderHeight;
+
+		//The last workgroup resets the counter, it only has to be cleared once
+		if (!m_workgroupCounterCleared)
+		{
+			vkCmdFillBuffer(cb, m_workgroupCounter.getBufferHandle(), m_workgroupCounter.getOffset(), m_workgroupCounter.getSize(), 0);
+			SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)} });
+			m_workgroupCounterCleared = true;
+		}
+
 		SyncOperations::cmdExecuteBarrier(cb, { 
 			{SyncOperations::constructImageBarrier(
 					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
@@ -129,60 +182,31 @@ public:
 					m_hierarchicalZ.getImageHandle(),
 					{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = static_cast<uint32_t>(m_hiZopCount), .baseArrayLayer = 0, .layerCount = 1 })} });
 
-		uint32_t width{ m_depthImage.getWidth() };
-		uint32_t height{ m_depthImage.getHeight() };
+		uint32_t groupCountX{ DISPATCH_SIZE(m_hierarchicalZ.getWidth(), HIZ_TILE_SIZE) };
+		uint32_t groupCountY{ DISPATCH_SIZE(m_hierarchicalZ.getHeight(), HIZ_TILE_SIZE) };
 
+		struct { uint32_t mipCount; uint32_t workgroupCount; float invDepthWidth; float invDepthHeight; uint32_t validWidth; uint32_t validHeight; } pushC;
+		pushC.mipCount = m_hiZopCount;
+		pushC.workgroupCount = groupCountX * groupCountY;
+		pushC.invDepthWidth = 1.0f / m_depthImage.getWidth();
+		pushC.invDepthHeight = 1.0f / m_depthImage.getHeight();
+		pushC.validWidth = m_validWidthHiZ;
+		pushC.validHeight = m_validHeightHiZ;
 
-		struct { uint32_t width; uint32_t height; float invPrevWidth; float invPrevHeight; uint32_t widthPrev; uint32_t heightPrev; } pushC;
 		m_calcHiZ.cmdBind(cb);
-
 		m_calcHiZ.setResourceInUse(0, 0);
 		m_calcHiZ.cmdBindResourceSets(cb);
-		constexpr uint32_t groupsizeX{ 16 };
-		constexpr uint32_t groupsizeY{ 16 };
-		pushC.widthPrev = width;
-		pushC.heightPrev = height;
-		pushC.invPrevWidth = 1.0f / width;
-		pushC.invPrevHeight = 1.0f / height;
-		width = width / 2;
-		height = height / 2;
-		pushC.width = width;
-		pushC.height = height;
 		vkCmdPushConstants(cb, m_calcHiZ.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushC), &pushC);
-		vkCmdDispatch(cb, DISPATCH_SIZE(width, groupsizeX), DISPATCH_SIZE(height, groupsizeY), 1);
+		vkCmdDispatch(cb, groupCountX, groupCountY, 1);
 
-		VkImageMemoryBarrier2 barrier{ 
-			SyncOperations::constructImageBarrier(
+		SyncOperations::cmdExecuteBarrier(cb, {
+			{SyncOperations::constructImageBarrier(
 					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
 					VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 					m_hierarchicalZ.getImageHandle(),
-					{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1 }) };
-
-		SyncOperations::cmdExecuteBarrier(cb, { {barrier} });
-		
-		for (int i{ 1 }; i < m_hiZopCount; ++i)
-		{
-			m_calcHiZ.setResourceInUse(0, i);
-			m_calcHiZ.cmdBindResourceSets(cb);
-			pushC.widthPrev = width;
-			pushC.heightPrev = height;
-			pushC.invPrevWidth = 1.0f / width;
-			pushC.invPrevHeight = 1.0f / height;
-			width = width != 1 ? width / 2 : 1;
-			height = height != 1 ? height / 2 : 1;
-			pushC.width = width;
-			pushC.height = height;
-			vkCmdPushConstants(cb, m_calcHiZ.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushC), &pushC);
-			vkCmdDispatch(cb, DISPATCH_SIZE(width, groupsizeX), DISPATCH_SIZE(height, groupsizeY), 1);
-		
-			barrier.subresourceRange.baseMipLevel = i;
-		
-			SyncOperations::cmdExecuteBarrier(cb, { {barrier} });
-		}
-
-		SyncOperations::cmdExecuteBarrier(cb, {
-			{SyncOperations::constructImageBarrier(
+					{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = static_cast<uint32_t>(m_hiZopCount), .baseArrayLayer = 0, .layerCount = 1 }),
+			SyncOperations::constructImageBarrier(
 					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 					0, 0,
 					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
@@ -221,6 +245,11 @@ public:
 	{
 		return m_samplerHiZ;
 	}
+	//Maps screen UVs to the part of Hi-Z covered by the screen
+	glm::vec2 getUVScaleHiZ() const
+	{
+		return glm::vec2(float(m_validWidthHiZ) / m_hierarchicalZ.getWidth(), float(m_validHeightHiZ) / m_hierarchicalZ.getHeight());
+	}
 
 	void cmdVisualizeHiZ(VkCommandBuffer cb, VkImage outImage, VkImageLayout outImageLayout, uint32_t mipLevel)
 	{
@@ -244,7 +273,7 @@ public:
 		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		blit.dstSubresource.layerCount = 1;
 		blit.srcOffsets[0] = { 0, 0, 0 };
-		blit.srcOffsets[1] = { int((m_hierarchicalZ.getWidth() + 0.5) / std::pow(2.0, mipLevel)), int((m_hierarchicalZ.getHeight() + 0.5) / std::pow(2.0, mipLevel)), 1 };
+		blit.srcOffsets[1] = { std::max(1, int(DISPATCH_SIZE(m_validWidthHiZ, 1u << mipLevel))), std::max(1, int(DISPATCH_SIZE(m_validHeightHiZ, 1u << mipLevel))), 1 };
 		blit.dstOffsets[0] = { 0, 0, 0 };
 		blit.dstOffsets[1] = { int(m_depthImage.getWidth()), int(m_depthImage.getHeight()), 1 };
 
@@ -1,6 +1,73 @@
 #include <algorithm>
+#include <cstring>
 
 #include "src/rendering/renderer/descriptor_management.h"
+#include "src/tools/logging.h"
+
+void DescriptorManager::allocateRange(DescriptorBufferType type, DescriptorAllocation& allocation)
+{
+    VmaVirtualAllocationCreateInfo allocationCI{};
+    allocationCI.size = allocation.size;
+    allocationCI.alignment = m_descriptorBufferAlignment;
+    allocationCI.flags = VMA_VIRTUAL_ALLOCATION_CREATE_STRATEGY_MIN_TIME_BIT;
+
+    for (uint32_t i{ 0 }; i < m_descriptorBuffers.size(); ++i)
+    {
+        if (m_descriptorBuffers[i].type == type && vmaVirtualAllocate(m_descriptorBuffers[i].memoryProxy, &allocationCI, &allocation.memProxyAlloc, &allocation.offset) == VK_SUCCESS)
+        {
+            allocation.bufferIndex = i;
+            return;
+        }
+    }
+
+    createNewDescriptorBuffer(type, allocation.size);
+    allocation.bufferIndex = static_cast<uint32_t>(m_descriptorBuffers.size() - 1);
+    EASSERT(vmaVirtualAllocate(m_descriptorBuffers.back().memoryProxy, &allocationCI, &allocation.memProxyAlloc, &allocation.offset) == VK_SUCCESS, "App", "Descriptor set allocation failed. || Should never happen.");
+}
+
+void DescriptorManager::advanceFrame()
+{
+    m_frameSlot = (m_frameSlot + 1) % DESCRIPTOR_FRAME_RING_SIZE;
+    for (auto& allocation : m_descriptorSetAllocations)
+    {
+        if (allocation.owner->m_rewrittenPerFrame)
+            allocation.owner->writePayloadToBuffer(m_frameSlot);
+    }
+}
+
+bool DescriptorManager::needsCompaction() const
+{
+    return m_freedBytes[RESOURCE_TYPE] >= DESCRIPTOR_COMPACTION_THRESHOLD || m_freedBytes[SAMPLER_TYPE] >= DESCRIPTOR_COMPACTION_THRESHOLD;
+}
+
+void DescriptorManager::compact()
+{
+    for (int type{ 0 }; type < TYPES_MAX_NUM; ++type)
+    {
+        if (m_freedBytes[type] < DESCRIPTOR_COMPACTION_THRESHOLD)
+            continue;
+
+        std::vector<DescriptorAllocation*> allocations{};
+        for (auto& allocation : m_descriptorSetAllocations)
+            if (m_descriptorBuffers[allocation.bufferIndex].type == type)
+                allocations.push_back(&allocation);
+        for (auto& descBuf : m_descriptorBuffers)
+            if (descBuf.type == type)
+                vmaClearVirtualBlock(descBuf.memoryProxy);
+
+        //Biggest sets first so they land in the earliest buffers and fewer buffers have to be bound
+        std::sort(allocations.begin(), allocations.end(), [](const DescriptorAllocation* a, const DescriptorAllocation* b) { return a->size > b->size; });
+        for (auto allocation : allocations)
+        {
+            allocateRange(static_cast<DescriptorBufferType>(type), *allocation);
+            for (uint32_t frameSlot{ 0 }; frameSlot < (allocation->owner->m_rewrittenPerFrame ? DESCRIPTOR_FRAME_RING_SIZE : 1); ++frameSlot)
+                allocation->owner->writePayloadToBuffer(frameSlot);
+        }
+
+        LOG_INFO("Descriptor buffers compacted, {} bytes of freed ranges reclaimed.", m_freedBytes[type]);
+        m_freedBytes[type] = 0;
+    }
+}
 
 ResourceSet::ResourceSet(ResourceSet&& srcResourceSet) noexcept
 {
@@ -9,8 +76,11 @@ ResourceSet::ResourceSet(ResourceSet&& srcResourceSet) noexcept
     m_layout = srcResourceSet.m_layout;
 
     m_allocationIter = srcResourceSet.m_allocationIter;
+    if (!srcResourceSet.m_invalid)
+        m_allocationIter->owner = this;
 
     m_resCopies = srcResourceSet.m_resCopies;
+    m_rewrittenPerFrame = srcResourceSet.m_rewrittenPerFrame;
     
     m_resources = srcResourceSet.m_resources;
 
@@ -18,7 +88,6 @@ ResourceSet::ResourceSet(ResourceSet&& srcResourceSet) noexcept
     m_descSetByteSize = srcResourceSet.m_descSetByteSize;
     m_descSetAlignedByteSize = srcResourceSet.m_descSetAlignedByteSize;
 
-    m_descBufferOffset = srcResourceSet.m_descBufferOffset;
     m_resourcePayload = srcResourceSet.m_resourcePayload;
 
     srcResourceSet.m_invalid = true;
@@ -56,14 +125,19 @@ VkDeviceSize ResourceSet::getDescriptorSetAlignedSize()
     return m_descSetAlignedByteSize;
 }
 
-void ResourceSet::setDescBufferOffset(VkDeviceSize offset)
+VkDeviceSize ResourceSet::getPayloadSize() const
 {
-    m_descBufferOffset = offset;
+    return m_descSetAlignedByteSize * m_resCopies;
+}
+
+VkDeviceSize ResourceSet::getFrameSlotOffset(uint32_t frameSlot) const
+{
+    return m_allocationIter->offset + (m_rewrittenPerFrame ? frameSlot * getPayloadSize() : 0);
 }
 
 VkDeviceSize ResourceSet::getDescriptorSetOffset(uint32_t resIndex)  const
 {
-    return m_descBufferOffset + (resIndex * m_descSetAlignedByteSize);
+    return getFrameSlotOffset(m_descManager->m_frameSlot) + (resIndex * m_descSetAlignedByteSize);
 }
 
 const void* ResourceSet::getResourcePayload() const
@@ -99,35 +173,18 @@ uint32_t ResourceSet::getDescriptorTypeSize(VkDescriptorType type) const
 
 void ResourceSet::insertResourceSetInBuffer(bool containsSampledData)
 {
-    VmaVirtualAllocationCreateInfo allocationCI{};
-    allocationCI.size = getDescriptorSetAlignedSize() * getCopiesCount();
-    allocationCI.alignment = m_descManager->m_descriptorBufferAlignment;
-    allocationCI.flags = VMA_VIRTUAL_ALLOCATION_CREATE_STRATEGY_MIN_TIME_BIT;
-
-
-    VmaVirtualAllocation allocation{};
-    uint32_t bufferIndex{};
-    auto bufferIter{ m_descManager->m_descriptorBuffers.begin() };
-    VkDeviceSize offset{};
-    DescriptorBufferType requiredType{ containsSampledData ? SAMPLER_TYPE : RESOURCE_TYPE };
-    while (bufferIter->type == requiredType ? vmaVirtualAllocate(bufferIter->memoryProxy, &allocationCI, &allocation, &offset) == VK_ERROR_OUT_OF_DEVICE_MEMORY : true)
-    {
-        if (++bufferIter == m_descManager->m_descriptorBuffers.end())
-        {
-            m_descManager->createNewDescriptorBuffer(requiredType);
-            bufferIter = m_descManager->m_descriptorBuffers.end() - 1;
-        }
-    }
-    if (allocation == VK_NULL_HANDLE)
-    {
-        EASSERT(false, "App", "Descriptor set allocation failed. || Should never happen.")
-    }
-    setDescBufferOffset(offset);
-    bufferIndex = static_cast<uint32_t>(bufferIter - m_descManager->m_descriptorBuffers.begin());
-    m_descManager->m_descriptorSetAllocations.push_back({ allocation, bufferIndex });
+    DescriptorAllocation allocation{ .size = getPayloadSize() * (m_rewrittenPerFrame ? DESCRIPTOR_FRAME_RING_SIZE : 1), .owner = this };
+    m_descManager->allocateRange(containsSampledData ? SAMPLER_TYPE : RESOURCE_TYPE, allocation);
+    m_descManager->m_descriptorSetAllocations.push_back(allocation);
     m_allocationIter = --m_descManager->m_descriptorSetAllocations.end();
 
-    std::memcpy(reinterpret_cast<uint8_t*>(bufferIter->descriptorBuffer.getData()) + offset, getResourcePayload(), allocationCI.size);
+    for (uint32_t frameSlot{ 0 }; frameSlot < (m_rewrittenPerFrame ? DESCRIPTOR_FRAME_RING_SIZE : 1); ++frameSlot)
+        writePayloadToBuffer(frameSlot);
+}
+
+void ResourceSet::writePayloadToBuffer(uint32_t frameSlot) const
+{
+    std::memcpy(reinterpret_cast<uint8_t*>(m_descManager->m_descriptorBuffers[m_allocationIter->bufferIndex].descriptorBuffer.getData()) + getFrameSlotOffset(frameSlot), getResourcePayload(), getPayloadSize());
 }
 
 void ResourceSet::rewriteDescriptor(uint32_t bindingIndex, uint32_t copyIndex, uint32_t arrayIndex, const VkDescriptorDataEXT& descriptorData) const
@@ -140,5 +197,6 @@ void ResourceSet::rewriteDescriptor(uint32_t bindingIndex, uint32_t copyIndex, u
     uint64_t payloadOffset{ copyIndex * m_descSetAlignedByteSize + m_resources[bindingIndex].inSetOffset + arrayIndex * descriptorTypeSize };
     lvkGetDescriptorEXT(m_device, &descGetInfo, descriptorTypeSize, m_resourcePayload + payloadOffset);
 
-    std::memcpy(reinterpret_cast<uint8_t*>(m_descManager->m_descriptorBuffers[m_allocationIter->bufferIndex].descriptorBuffer.getData()) + m_descBufferOffset + payloadOffset, m_resourcePayload + payloadOffset, descriptorTypeSize);
+    //Per-frame sets only write the current frame's copy, the copies earlier frames read stay intact
+    std::memcpy(reinterpret_cast<uint8_t*>(m_descManager->m_descriptorBuffers[m_allocationIter->bufferIndex].descriptorBuffer.getData()) + getFrameSlotOffset(m_descManager->m_frameSlot) + payloadOffset, m_resourcePayload + payloadOffset, descriptorTypeSize);
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <vector>
 #include <array>
 #include <span>
+#include <list>
+#include <algorithm>
 
 #include "src/rendering/data_management/buffer_class.h"
 
@@ -15,6 +17,11 @@ extern PFN_vkGetDescriptorEXT lvkGetDescriptorEXT;
 extern PFN_vkCmdBindDescriptorBufferEmbeddedSamplersEXT lvkCmdBindDescriptorBufferEmbeddedSamplersEXT;
 
 #define DESCRIPTOR_BUFFER_DEFAULT_SIZE  51200
+//Every new descriptor buffer of a type is twice as big as the previous one up to the device range limit
+#define DESCRIPTOR_BUFFER_GROWTH_FACTOR 2
+//Sets rewritten every frame keep a copy per frame in flight
+#define DESCRIPTOR_FRAME_RING_SIZE 2
+#define DESCRIPTOR_COMPACTION_THRESHOLD DESCRIPTOR_BUFFER_DEFAULT_SIZE
 
 enum DescriptorBufferType
 {
@@ -22,17 +29,23 @@ enum DescriptorBufferType
     SAMPLER_TYPE,
     TYPES_MAX_NUM
 };
+class ResourceSet;
+
 struct DescriptorBuffer
 {
     VmaVirtualBlock memoryProxy{};
     BufferBaseHostAccessible descriptorBuffer;
     VkDeviceAddress deviceAddress{};
+    VkDeviceSize size{};
     DescriptorBufferType type{};
 };
 struct DescriptorAllocation
 {
     VmaVirtualAllocation memProxyAlloc{};
     uint32_t bufferIndex{};
+    VkDeviceSize offset{};
+    VkDeviceSize size{};
+    ResourceSet* owner{ nullptr };
 };
 
 class DescriptorManager
@@ -49,11 +62,24 @@ private:
     inline static thread_local std::vector<VkDeviceSize> m_offsetsToSet{};
 
     std::list<DescriptorAllocation> m_descriptorSetAllocations{};
+    std::array<VkDeviceSize, TYPES_MAX_NUM> m_freedBytes{};
+
+    uint32_t m_frameSlot{ 0 };
 
     const VkPhysicalDeviceDescriptorBufferPropertiesEXT* m_descriptorBufferProperties{ nullptr };
 
-    void createNewDescriptorBuffer(DescriptorBufferType type)
+    void createNewDescriptorBuffer(DescriptorBufferType type, VkDeviceSize requiredSize = 0)
     {
+        VkDeviceSize maxSize{ type == RESOURCE_TYPE ? m_descriptorBufferProperties->maxResourceDescriptorBufferRange : m_descriptorBufferProperties->maxSamplerDescriptorBufferRange };
+        VkDeviceSize size{ DESCRIPTOR_BUFFER_DEFAULT_SIZE };
+        for (auto& descBuf : m_descriptorBuffers)
+            if (descBuf.type == type)
+                size = std::max(size, std::min(descBuf.size * DESCRIPTOR_BUFFER_GROWTH_FACTOR, maxSize));
+        while (size < requiredSize)
+            size *= DESCRIPTOR_BUFFER_GROWTH_FACTOR;
+        size = std::min(size, maxSize);
+        EASSERT(requiredSize <= size, "App", "Descriptor set of " << requiredSize << " bytes exceeds the descriptor buffer range limit.");
+
         VkBufferCreateInfo bufferCI{};
         bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         if (type == RESOURCE_TYPE)
@@ -65,21 +91,24 @@ private:
         bufferCI.queueFamilyIndexCount = m_queueFamilyIndices.size();
         bufferCI.pQueueFamilyIndices = m_queueFamilyIndices.data();
 
-        bufferCI.size = DESCRIPTOR_BUFFER_DEFAULT_SIZE;
+        bufferCI.size = size;
 
-        m_descriptorBuffers.push_back(DescriptorBuffer{ .memoryProxy = VmaVirtualBlock{}, .descriptorBuffer = BufferBaseHostAccessible{ m_device, bufferCI, BufferBase::NULL_FLAG, false, true}, .type = type });
+        m_descriptorBuffers.push_back(DescriptorBuffer{ .memoryProxy = VmaVirtualBlock{}, .descriptorBuffer = BufferBaseHostAccessible{ m_device, bufferCI, BufferBase::NULL_FLAG, false, true}, .size = size, .type = type });
         DescriptorBuffer& newBuffer{ m_descriptorBuffers.back() };
         VkBufferDeviceAddressInfo addrInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = newBuffer.descriptorBuffer.getBufferHandle() };
         newBuffer.deviceAddress = vkGetBufferDeviceAddress(m_device, &addrInfo);
         VmaVirtualBlockCreateInfo virtualBlockCI{};
-        virtualBlockCI.size = DESCRIPTOR_BUFFER_DEFAULT_SIZE;
+        virtualBlockCI.size = size;
         EASSERT(vmaCreateVirtualBlock(&virtualBlockCI, &newBuffer.memoryProxy) == VK_SUCCESS, "VMA", "Virtual block creation failed.")
     }
     void removeResourceSetFromBuffer(std::list<DescriptorAllocation>::const_iterator allocationIter)
     {
         vmaVirtualFree(m_descriptorBuffers[allocationIter->bufferIndex].memoryProxy, allocationIter->memProxyAlloc);
+        m_freedBytes[m_descriptorBuffers[allocationIter->bufferIndex].type] += allocationIter->size;
         m_descriptorSetAllocations.erase(allocationIter);
     }
+    //First fit over the buffers of the type, a new buffer is created if none has space
+    void allocateRange(DescriptorBufferType type, DescriptorAllocation& allocation);
 
 public:
     DescriptorManager(VulkanObjectHandler& vulkanObjectHandler)
@@ -105,6 +134,12 @@ public:
         m_descriptorBuffers.clear();
     }
 
+    //Has to be called between frames. Per-frame sets switch to the next copy which receives their latest descriptors
+    void advanceFrame();
+    //Freed ranges are compacted by repacking every set from its CPU copy. Descriptor buffers must not be in use by the GPU
+    bool needsCompaction() const;
+    void compact();
+
     friend class Pipeline;
     friend class ResourceSet;
 };
@@ -124,7 +159,7 @@ private:
 
     VkDescriptorSetLayout m_layout{};
 
-    std::list<DescriptorAllocation>::const_iterator m_allocationIter{};
+    std::list<DescriptorAllocation>::iterator m_allocationIter{};
 
     struct BindingData
     {
@@ -137,11 +172,11 @@ private:
     std::vector<BindingData> m_resources{};
 
     uint32_t m_resCopies{};
+    bool m_rewrittenPerFrame{ false };
 
     VkDeviceSize m_descSetByteSize{};
     VkDeviceSize m_descSetAlignedByteSize{};
 
-    VkDeviceSize m_descBufferOffset{};
     uint8_t* m_resourcePayload{ nullptr };
 
     bool m_invalid{ true };
@@ -155,9 +190,10 @@ public:
         const Range1& bindings,
         const Range2& bindingFlags,
         const Range3& bindingsDescriptorData,
-        bool containsSampledData)
+        bool containsSampledData,
+        bool rewrittenPerFrame = false)
     {
-        initializeSet(device, resCopies, flags, bindings, bindingFlags, bindingsDescriptorData, containsSampledData);
+        initializeSet(device, resCopies, flags, bindings, bindingFlags, bindingsDescriptorData, containsSampledData, rewrittenPerFrame);
     }
     ResourceSet(ResourceSet&& srcResourceSet) noexcept;
     ~ResourceSet();
@@ -166,13 +202,15 @@ public:
     const VkDescriptorSetLayout& getSetLayout() const;
 
     template<std::ranges::contiguous_range Range1, std::ranges::contiguous_range Range2, std::ranges::contiguous_range Range3>
-    void initializeSet(VkDevice device, uint32_t resCopies, VkDescriptorSetLayoutCreateFlags flags, const Range1& bindings, const Range2& bindingFlags, const Range3& bindingsDescriptorData, bool containsSampledData)
+    //Sets that are rewritten while earlier frames can still read them should be created with rewrittenPerFrame
+    void initializeSet(VkDevice device, uint32_t resCopies, VkDescriptorSetLayoutCreateFlags flags, const Range1& bindings, const Range2& bindingFlags, const Range3& bindingsDescriptorData, bool containsSampledData, bool rewrittenPerFrame = false)
     {
         if (!m_invalid)
             return;
 
         m_device = device;
         m_resCopies = resCopies;
+        m_rewrittenPerFrame = rewrittenPerFrame;
 
         EASSERT(bindings.size() == bindingsDescriptorData.size(), "App", "Descriptors are not provided for every binding");
 
@@ -235,15 +273,20 @@ public:
         m_invalid = false;
     }
 
+    //Owners of a set rewrite it directly when the resources it points to are recreated or relocated
+    void rewriteDescriptor(uint32_t bindingIndex, uint32_t copyIndex, uint32_t arrayIndex, const VkDescriptorDataEXT& descriptorData) const;
+
 private:
     uint32_t getDescBufferIndex() const;
     VkDeviceSize getDescriptorSetAlignedSize();
-    void setDescBufferOffset(VkDeviceSize offset);
+    //Byte size of all copies, per-frame sets hold it once per frame slot
+    VkDeviceSize getPayloadSize() const;
+    VkDeviceSize getFrameSlotOffset(uint32_t frameSlot) const;
     VkDeviceSize getDescriptorSetOffset(uint32_t resIndex)  const;
     const void* getResourcePayload() const;
     uint32_t getDescriptorTypeSize(VkDescriptorType type) const;
     void insertResourceSetInBuffer(bool containsSampledData);
-    void rewriteDescriptor(uint32_t bindingIndex, uint32_t copyIndex, uint32_t arrayIndex, const VkDescriptorDataEXT& descriptorData) const;
+    void writePayloadToBuffer(uint32_t frameSlot) const;
 
     ResourceSet(ResourceSet&) = delete;
     void operator=(ResourceSet&) = delete;
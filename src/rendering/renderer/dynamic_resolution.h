@@ -0,0 +1,97 @@
+#ifndef DYNAMIC_RESOLUTION_HEADER
+#define DYNAMIC_RESOLUTION_HEADER
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "src/tools/asserter.h"
+
+//Render extents are kept a multiple of this so that half resolution images and light tiles stay aligned
+#define DYNAMIC_RESOLUTION_ALIGNMENT 8
+//Scale changes smaller than this are ignored so that the extent does not oscillate between neighbouring values
+#define DYNAMIC_RESOLUTION_HYSTERESIS 0.02
+#define DYNAMIC_RESOLUTION_FRAME_TIME_FILTER 0.2
+#define DYNAMIC_RESOLUTION_STEP_DAMPING 0.5
+
+//Picks the internal render extent from the measured GPU frame time.
+//Images are allocated at output size and the scaled passes render into their top left part, so changing the extent never reallocates.
+class DynamicResolution
+{
+private:
+	uint32_t m_outputWidth{};
+	uint32_t m_outputHeight{};
+	uint32_t m_renderWidth{};
+	uint32_t m_renderHeight{};
+
+	bool m_enabled{ false };
+	double m_targetFrameTimeMS{ 16.6 };
+	double m_minScale{ 0.5 };
+	double m_maxScale{ 1.0 };
+	double m_scale{ 1.0 };
+	double m_filteredFrameTimeMS{ 0.0 };
+
+public:
+	DynamicResolution(uint32_t outputWidth, uint32_t outputHeight)
+		: m_outputWidth{ outputWidth }, m_outputHeight{ outputHeight }, m_renderWidth{ outputWidth }, m_renderHeight{ outputHeight }
+	{}
+	~DynamicResolution() = default;
+
+	void setEnabled(bool enabled)
+	{
+		m_enabled = enabled;
+		if (!m_enabled)
+			setScale(1.0);
+	}
+	void setTargetFrameTime(double frameTimeMS)
+	{
+		EASSERT(frameTimeMS > 0.0, "App", "Target frame time has to be positive.");
+		m_targetFrameTimeMS = frameTimeMS;
+	}
+	void setScaleBounds(double minScale, double maxScale)
+	{
+		EASSERT(minScale > 0.0 && minScale <= maxScale && maxScale <= 1.0, "App", "Invalid dynamic resolution scale bounds.");
+		m_minScale = minScale;
+		m_maxScale = maxScale;
+		if (m_enabled)
+			setScale(std::clamp(m_scale, m_minScale, m_maxScale));
+	}
+
+	//The cost of the scaled passes is roughly proportional to the pixel count, hence the square root of the time ratio
+	void submitFrameTime(double gpuFrameTimeMS)
+	{
+		if (!m_enabled || gpuFrameTimeMS <= 0.0)
+			return;
+
+		m_filteredFrameTimeMS = m_filteredFrameTimeMS == 0.0 ? gpuFrameTimeMS : glm::mix(m_filteredFrameTimeMS, gpuFrameTimeMS, DYNAMIC_RESOLUTION_FRAME_TIME_FILTER);
+		double desiredScale{ std::clamp(m_scale * std::sqrt(m_targetFrameTimeMS / m_filteredFrameTimeMS), m_minScale, m_maxScale) };
+		if (std::abs(desiredScale - m_scale) < DYNAMIC_RESOLUTION_HYSTERESIS * m_scale && desiredScale != m_minScale && desiredScale != m_maxScale)
+			return;
+		setScale(m_scale + (desiredScale - m_scale) * DYNAMIC_RESOLUTION_STEP_DAMPING);
+	}
+
+	uint32_t getRenderWidth() const { return m_renderWidth; }
+	uint32_t getRenderHeight() const { return m_renderHeight; }
+	double getScale() const { return m_scale; }
+	//Maps UVs over the rendered part to UVs of the output sized images
+	glm::vec2 getUVScale() const { return glm::vec2(float(m_renderWidth) / m_outputWidth, float(m_renderHeight) / m_outputHeight); }
+
+private:
+	void setScale(double scale)
+	{
+		m_scale = scale;
+		auto alignedExtent{ [scale](uint32_t outputSize) -> uint32_t
+			{
+				if (scale >= 1.0)
+					return outputSize;
+				uint32_t size{ static_cast<uint32_t>(std::round(outputSize * scale / DYNAMIC_RESOLUTION_ALIGNMENT)) * DYNAMIC_RESOLUTION_ALIGNMENT };
+				return std::clamp(size, uint32_t(DYNAMIC_RESOLUTION_ALIGNMENT), outputSize);
+			} };
+		m_renderWidth = alignedExtent(m_outputWidth);
+		m_renderHeight = alignedExtent(m_outputHeight);
+	}
+};
+
+#endif
@@ -1,9 +1,15 @@
 #include "pipeline_management.h"
 
+#include <fstream>
+#include <cstring>
+
 #include "src/rendering/shader_management/shader_operations.h"
 #include "src/rendering/data_abstraction/vertex_layouts.h"
 #include "src/tools/asserter.h"
 #include "src/tools/arraysize.h"
+#include "src/tools/logging.h"
+
+#define PIPELINE_CACHE_FILE_MAGIC 0x504B4554
 
 
 PipelineAssembler::PipelineAssembler(VkDevice device)
@@ -367,6 +373,181 @@ const VkPipelineRenderingCreateInfo& PipelineAssembler::getPipelineRenderingStat
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+PipelineCache::PipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const fs::path& filepath) : m_device{ device }, m_filepath{ filepath }
+{
+	VkPhysicalDeviceIDProperties idProperties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+	VkPhysicalDeviceProperties2 properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &idProperties };
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	m_header.magic = PIPELINE_CACHE_FILE_MAGIC;
+	m_header.headerSize = sizeof(FileHeader);
+	m_header.vendorID = properties.properties.vendorID;
+	m_header.deviceID = properties.properties.deviceID;
+	m_header.driverVersion = properties.properties.driverVersion;
+	std::memcpy(m_header.deviceUUID, idProperties.deviceUUID, VK_UUID_SIZE);
+	std::memcpy(m_header.pipelineCacheUUID, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	std::vector<char> cacheData{};
+	std::ifstream stream{ m_filepath, std::ios::ate | std::ios::binary };
+	if (stream.is_open())
+	{
+		size_t fileSize{ static_cast<size_t>(stream.tellg()) };
+		stream.seekg(std::ios_base::beg);
+
+		FileHeader fileHeader{};
+		bool valid{ fileSize >= sizeof(FileHeader) };
+		if (valid)
+		{
+			stream.read(reinterpret_cast<char*>(&fileHeader), sizeof(FileHeader));
+			valid = fileHeader.magic == m_header.magic &&
+				fileHeader.headerSize == m_header.headerSize &&
+				fileHeader.vendorID == m_header.vendorID &&
+				fileHeader.deviceID == m_header.deviceID &&
+				fileHeader.driverVersion == m_header.driverVersion &&
+				std::memcmp(fileHeader.deviceUUID, m_header.deviceUUID, VK_UUID_SIZE) == 0 &&
+				std::memcmp(fileHeader.pipelineCacheUUID, m_header.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+				fileHeader.dataSize == fileSize - sizeof(FileHeader);
+		}
+		LOG_IF_WARNING(!valid, "Pipeline cache \"{}\" doesn't match the current device or driver and is discarded.", m_filepath.string());
+
+		if (valid)
+		{
+			cacheData.resize(fileHeader.dataSize);
+			stream.read(cacheData.data(), cacheData.size());
+			m_warm = true;
+		}
+	}
+
+	VkPipelineCacheCreateInfo cacheCI{ .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+	cacheCI.initialDataSize = cacheData.size();
+	cacheCI.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+	EASSERT(vkCreatePipelineCache(m_device, &cacheCI, nullptr, &m_cacheHandle) == VK_SUCCESS, "Vulkan", "Pipeline cache creation failed.");
+}
+PipelineCache::~PipelineCache()
+{
+	m_compilationTasks.wait();
+	save();
+	vkDestroyPipelineCache(m_device, m_cacheHandle, nullptr);
+}
+
+void PipelineCache::waitForCompilation()
+{
+	m_compilationTasks.wait();
+
+	if (!m_compilationStarted)
+		return;
+
+	double wallTime{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_firstCompilation).count() };
+	LOG_INFO("{} pipelines created in {:.1f} ms ({:.1f} ms of compilation across threads) with a {} pipeline cache.",
+		m_pipelineCount.load(), wallTime, m_compilationTimeUs.load() / 1000.0, m_warm ? "warm" : "cold");
+
+	m_compilationStarted = false;
+	m_pipelineCount = 0;
+	m_compilationTimeUs = 0;
+}
+
+void PipelineCache::save()
+{
+	size_t dataSize{ 0 };
+	EASSERT(vkGetPipelineCacheData(m_device, m_cacheHandle, &dataSize, nullptr) == VK_SUCCESS, "Vulkan", "Pipeline cache data retrieval failed.");
+	std::vector<char> cacheData(dataSize);
+	EASSERT(vkGetPipelineCacheData(m_device, m_cacheHandle, &dataSize, cacheData.data()) == VK_SUCCESS, "Vulkan", "Pipeline cache data retrieval failed.");
+
+	std::ofstream stream{ m_filepath, std::ios::binary | std::ios::trunc };
+	LOG_IF_WARNING(!stream.is_open(), "Could not write pipeline cache to \"{}\".", m_filepath.string());
+	if (!stream.is_open())
+		return;
+
+	FileHeader header{ m_header };
+	header.dataSize = dataSize;
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	stream.write(cacheData.data(), dataSize);
+}
+
+void PipelineCache::runCompilation(const std::function<VkPipeline(VkPipelineCache)>& compilation, const std::shared_ptr<std::promise<VkPipeline>>& result)
+{
+	//Pipelines can be created from any thread, only the first compilation records the start time
+	if (!m_compilationStarted.exchange(true))
+		m_firstCompilation = std::chrono::steady_clock::now();
+
+	m_compilationTasks.run([this, compilation, result]()
+		{
+			auto start{ std::chrono::steady_clock::now() };
+			VkPipeline pipeline{ compilation(m_cacheHandle) };
+			EASSERT(pipeline != VK_NULL_HANDLE, "Vulkan", "Pipeline creation failed.");
+			m_compilationTimeUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			++m_pipelineCount;
+			result->set_value(pipeline);
+		});
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Assembler state is copied since the pipeline may be created after the assembler has been changed or destroyed
+	struct GraphicsPipelineState
+	{
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		std::vector<VkDynamicState> dynamicStateValues{};
+		VkPipelineViewportStateCreateInfo viewportState{};
+		VkViewport viewport{};
+		VkRect2D scissor{};
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{};
+		VkPipelineTessellationStateCreateInfo tesselationState{};
+		VkPipelineMultisampleStateCreateInfo multisamplingState{};
+		VkPipelineRasterizationStateCreateInfo rasterizationState{};
+		VkPipelineDepthStencilStateCreateInfo depthStencilState{};
+		VkPipelineColorBlendStateCreateInfo colorBlendingState{};
+		std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments{};
+		VkPipelineRenderingCreateInfo pipelineRenderingState{};
+		std::vector<VkFormat> colorAttachmentFormats{};
+		std::vector<VkVertexInputBindingDescription> bindings{};
+		std::vector<VkVertexInputAttributeDescription> attributes{};
+		std::vector<ShaderStage> shaders{};
+
+		GraphicsPipelineState(const PipelineAssembler& assembler,
+			std::span<const ShaderStage> shaderStages,
+			std::span<const VkVertexInputBindingDescription> vertexBindings,
+			std::span<const VkVertexInputAttributeDescription> vertexAttributes)
+			: dynamicState{ assembler.getDynamicState() }, viewportState{ assembler.getViewportState() },
+			inputAssemblyState{ assembler.getInputAssemblyState() }, tesselationState{ assembler.getTesselationState() },
+			multisamplingState{ assembler.getMultisamplingState() }, rasterizationState{ assembler.getRasterizationState() },
+			depthStencilState{ assembler.getDepthStencilState() }, colorBlendingState{ assembler.getColorBlendState() },
+			pipelineRenderingState{ assembler.getPipelineRenderingState() },
+			bindings{ vertexBindings.begin(), vertexBindings.end() }, attributes{ vertexAttributes.begin(), vertexAttributes.end() },
+			shaders{ shaderStages.begin(), shaderStages.end() }
+		{
+			if (dynamicState.pDynamicStates != nullptr)
+			{
+				dynamicStateValues.assign(dynamicState.pDynamicStates, dynamicState.pDynamicStates + dynamicState.dynamicStateCount);
+				dynamicState.pDynamicStates = dynamicStateValues.data();
+			}
+			if (viewportState.pViewports != nullptr)
+			{
+				viewport = *viewportState.pViewports;
+				viewportState.pViewports = &viewport;
+			}
+			if (viewportState.pScissors != nullptr)
+			{
+				scissor = *viewportState.pScissors;
+				viewportState.pScissors = &scissor;
+			}
+			if (colorBlendingState.pAttachments != nullptr)
+			{
+				colorBlendAttachments.assign(colorBlendingState.pAttachments, colorBlendingState.pAttachments + colorBlendingState.attachmentCount);
+				colorBlendingState.pAttachments = colorBlendAttachments.data();
+			}
+			if (pipelineRenderingState.pColorAttachmentFormats != nullptr)
+			{
+				colorAttachmentFormats.assign(pipelineRenderingState.pColorAttachmentFormats, pipelineRenderingState.pColorAttachmentFormats + pipelineRenderingState.colorAttachmentCount);
+				pipelineRenderingState.pColorAttachmentFormats = colorAttachmentFormats.data();
+			}
+		}
+	};
+}
+
 Pipeline::Pipeline() : m_invalid{ true }
 {
 
@@ -395,6 +576,16 @@ Pipeline::Pipeline(Pipeline&& srcPipeline) noexcept
 	m_device = srcPipeline.m_device;
 
 	m_pipelineHandle = srcPipeline.m_pipelineHandle;
+	m_pendingPipeline = std::move(srcPipeline.m_pendingPipeline);
+	m_creation = std::move(srcPipeline.m_creation);
+	m_shaderFilepaths = std::move(srcPipeline.m_shaderFilepaths);
+	{
+		std::lock_guard<std::mutex> lock{ m_registryMutex };
+		m_id = srcPipeline.m_id;
+		srcPipeline.m_id = UINT64_MAX;
+		if (m_id != UINT64_MAX)
+			m_registry[m_id] = this;
+	}
 	m_pipelineLayoutHandle = srcPipeline.m_pipelineLayoutHandle;
 	m_bindPoint = srcPipeline.m_bindPoint;
 
@@ -407,16 +598,18 @@ Pipeline::Pipeline(Pipeline&& srcPipeline) noexcept
 
 Pipeline::~Pipeline()
 {
+	unregister();
 	if (!m_invalid)
 	{
-		vkDestroyPipeline(m_device, m_pipelineHandle, nullptr);
+		vkDestroyPipeline(m_device, getPipelineHandle(), nullptr);
 		vkDestroyPipelineLayout(m_device, m_pipelineLayoutHandle, nullptr);
 	}
 }
 
 VkPipeline Pipeline::getPipelineHandle() const
 {
-	return m_pipelineHandle;
+	//Blocks if the pipeline is still being compiled
+	return m_pendingPipeline.valid() ? m_pendingPipeline.get() : m_pipelineHandle;
 }
 
 VkPipelineLayout Pipeline::getPipelineLayoutHandle() const
@@ -441,7 +634,7 @@ void Pipeline::setResourceInUse(uint32_t resSetIndex, uint32_t value)
 
 void Pipeline::cmdBind(VkCommandBuffer cb)
 {
-	vkCmdBindPipeline(cb, m_bindPoint, m_pipelineHandle);
+	vkCmdBindPipeline(cb, m_bindPoint, getPipelineHandle());
 }
 
 void Pipeline::cmdBindResourceSets(VkCommandBuffer cb)
@@ -511,42 +704,6 @@ void Pipeline::initializeGraphics(const PipelineAssembler& assembler,
 	m_device = assembler.getDevice(); 
 	m_bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 
-	VkGraphicsPipelineCreateInfo pipelineCI{};
-	pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineCI.flags = VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
-	pipelineCI.pDynamicState = &assembler.getDynamicState();
-	pipelineCI.pViewportState = &assembler.getViewportState();
-	pipelineCI.stageCount = shaders.size();
-	pipelineCI.pInputAssemblyState = &assembler.getInputAssemblyState();
-	pipelineCI.pTessellationState = &assembler.getTesselationState();
-	pipelineCI.pMultisampleState = &assembler.getMultisamplingState();
-	pipelineCI.pRasterizationState = &assembler.getRasterizationState();
-	pipelineCI.pDepthStencilState = &assembler.getDepthStencilState();
-	pipelineCI.pColorBlendState = &assembler.getColorBlendState();
-	VkPipelineVertexInputStateCreateInfo vertInputState{};
-	vertInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertInputState.vertexBindingDescriptionCount = bindings.size();
-	vertInputState.pVertexBindingDescriptions = bindings.data();
-	vertInputState.vertexAttributeDescriptionCount = attributes.size();
-	vertInputState.pVertexAttributeDescriptions = attributes.data();
-	pipelineCI.pVertexInputState = &vertInputState;
-
-	pipelineCI.pNext = &assembler.getPipelineRenderingState();
-
-	VkPipelineShaderStageCreateInfo* shaderStages{ new VkPipelineShaderStageCreateInfo[shaders.size()] };
-	for (uint32_t i{ 0 }; i < shaders.size(); ++i)
-	{
-		shaderStages[i] = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.stage = shaders[i].stage,
-			.module = ShaderOperations::createModule(m_device, ShaderOperations::getShaderCode(shaders[i].filepath)),
-			.pName = "main"
-		};
-	}
-	pipelineCI.pStages = shaderStages;
-
-
-
 	VkPipelineLayoutCreateInfo pipelineLayoutCI{};
 	pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	std::vector<VkDescriptorSetLayout> setLayouts(resourceSets.size());
@@ -562,7 +719,6 @@ void Pipeline::initializeGraphics(const PipelineAssembler& assembler,
 		pipelineLayoutCI.pPushConstantRanges = pushConstantsRanges.data();
 	}
 	EASSERT(vkCreatePipelineLayout(m_device, &pipelineLayoutCI, nullptr, &m_pipelineLayoutHandle) == VK_SUCCESS, "Vulkan", "Pipeline layout creation failed.");
-	pipelineCI.layout = m_pipelineLayoutHandle;
 	m_resourceSets.reserve(resourceSets.size());
 	for (int i{ 0 }; i < resourceSets.size(); ++i)
 	{
@@ -570,20 +726,64 @@ void Pipeline::initializeGraphics(const PipelineAssembler& assembler,
 	}
 	m_setsInUse = std::vector<uint32_t>(m_resourceSets.size(), 0u);
 
-	EASSERT(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &m_pipelineHandle) == VK_SUCCESS, "Vulkan", "Pipeline creation failed.");
-
-
-
-	for (uint32_t i{ 0 }; i < shaders.size(); ++i)
-	{
-		vkDestroyShaderModule(m_device, (shaderStages + i)->module, nullptr);
-	}
-	delete[] shaderStages;
+	std::shared_ptr<GraphicsPipelineState> state{ std::make_shared<GraphicsPipelineState>(assembler, shaders, bindings, attributes) };
+	std::vector<fs::path> shaderFilepaths{};
+	for (auto& shader : shaders)
+		shaderFilepaths.push_back(shader.filepath);
+	createPipeline([device = m_device, layout = m_pipelineLayoutHandle, state](VkPipelineCache cache) -> VkPipeline
+		{
+			VkGraphicsPipelineCreateInfo pipelineCI{};
+			pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineCI.flags = VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+			pipelineCI.pDynamicState = &state->dynamicState;
+			pipelineCI.pViewportState = &state->viewportState;
+			pipelineCI.stageCount = state->shaders.size();
+			pipelineCI.pInputAssemblyState = &state->inputAssemblyState;
+			pipelineCI.pTessellationState = &state->tesselationState;
+			pipelineCI.pMultisampleState = &state->multisamplingState;
+			pipelineCI.pRasterizationState = &state->rasterizationState;
+			pipelineCI.pDepthStencilState = &state->depthStencilState;
+			pipelineCI.pColorBlendState = &state->colorBlendingState;
+			VkPipelineVertexInputStateCreateInfo vertInputState{};
+			vertInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+			vertInputState.vertexBindingDescriptionCount = state->bindings.size();
+			vertInputState.pVertexBindingDescriptions = state->bindings.data();
+			vertInputState.vertexAttributeDescriptionCount = state->attributes.size();
+			vertInputState.pVertexAttributeDescriptions = state->attributes.data();
+			pipelineCI.pVertexInputState = &vertInputState;
+
+			pipelineCI.pNext = &state->pipelineRenderingState;
+
+			std::vector<VkPipelineShaderStageCreateInfo> shaderStages(state->shaders.size());
+			for (uint32_t i{ 0 }; i < state->shaders.size(); ++i)
+			{
+				shaderStages[i] = {
+					.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+					.stage = state->shaders[i].stage,
+					.module = ShaderOperations::createModule(device, ShaderOperations::getShaderCode(state->shaders[i].filepath)),
+					.pName = "main"
+				};
+			}
+			pipelineCI.pStages = shaderStages.data();
+			pipelineCI.layout = layout;
+
+			//Failure is returned as a null handle so a shader reload can keep the previous pipeline
+			VkPipeline pipeline{ VK_NULL_HANDLE };
+			VkResult result{ vkCreateGraphicsPipelines(device, cache, 1, &pipelineCI, nullptr, &pipeline) };
+			LOG_IF_WARNING(result != VK_SUCCESS, "Graphics pipeline creation failed with VkResult {}.", static_cast<int>(result));
+
+			for (auto& shaderStage : shaderStages)
+			{
+				vkDestroyShaderModule(device, shaderStage.module, nullptr);
+			}
+
+			return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+		}, std::move(shaderFilepaths));
 
 	m_invalid = false;
 }
 
-void Pipeline::initializaCompute(VkDevice device, const fs::path& computeShaderFilepath, std::span<std::reference_wrapper<const ResourceSet>> resourceSets, std::span<const VkPushConstantRange> pushConstantsRanges)
+void Pipeline::initializaCompute(VkDevice device, const fs::path& computeShaderFilepath, std::span<std::reference_wrapper<const ResourceSet>> resourceSets, std::span<const VkPushConstantRange> pushConstantsRanges, std::span<const uint32_t> specializationConstants)
 {
 	m_device = device; 
 	m_bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
@@ -611,17 +811,108 @@ void Pipeline::initializaCompute(VkDevice device, const fs::path& computeShaderF
 	}
 	m_setsInUse = std::vector<uint32_t>(m_resourceSets.size(), 0u);
 
-	VkPipelineShaderStageCreateInfo shaderStage{ .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-	shaderStage.module = ShaderOperations::createModule(device, ShaderOperations::getShaderCode(computeShaderFilepath));
-	shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-	shaderStage.pName = "main";
+	//Constants are copied since the creation may run later on a compilation thread or again on shader reload
+	createPipeline([device, layout = m_pipelineLayoutHandle, computeShaderFilepath, constants = std::vector<uint32_t>(specializationConstants.begin(), specializationConstants.end())](VkPipelineCache cache) -> VkPipeline
+		{
+			VkPipelineShaderStageCreateInfo shaderStage{ .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+			shaderStage.module = ShaderOperations::createModule(device, ShaderOperations::getShaderCode(computeShaderFilepath));
+			shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			shaderStage.pName = "main";
+
+			std::vector<VkSpecializationMapEntry> mapEntries(constants.size());
+			for (uint32_t i{ 0 }; i < constants.size(); ++i)
+				mapEntries[i] = VkSpecializationMapEntry{ .constantID = i, .offset = static_cast<uint32_t>(i * sizeof(uint32_t)), .size = sizeof(uint32_t) };
+			VkSpecializationInfo specializationInfo{ .mapEntryCount = static_cast<uint32_t>(mapEntries.size()), .pMapEntries = mapEntries.data(), .dataSize = constants.size() * sizeof(uint32_t), .pData = constants.data() };
+			if (!constants.empty())
+				shaderStage.pSpecializationInfo = &specializationInfo;
+
+			VkComputePipelineCreateInfo compPipelineCI{ .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+			compPipelineCI.layout = layout;
+			compPipelineCI.stage = shaderStage;
+			compPipelineCI.flags = VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+
+			VkPipeline pipeline{ VK_NULL_HANDLE };
+			VkResult result{ vkCreateComputePipelines(device, cache, 1, &compPipelineCI, nullptr, &pipeline) };
+			LOG_IF_WARNING(result != VK_SUCCESS, "Compute pipeline creation failed with VkResult {}.", static_cast<int>(result));
+
+			vkDestroyShaderModule(device, shaderStage.module, nullptr);
+
+			return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+		}, { computeShaderFilepath });
+}
+
+void Pipeline::assignGlobalPipelineCache(PipelineCache& pipelineCache)
+{
+	m_pipelineCache = &pipelineCache;
+}
 
-	VkComputePipelineCreateInfo compPipelineCI{ .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
-	compPipelineCI.layout = m_pipelineLayoutHandle;
-	compPipelineCI.stage = shaderStage;
-	compPipelineCI.flags = VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+void Pipeline::createPipeline(std::function<VkPipeline(VkPipelineCache)> creation, std::vector<fs::path> shaderFilepaths)
+{
+	unregister();
+	m_creation = creation;
+	m_shaderFilepaths = std::move(shaderFilepaths);
+	{
+		std::lock_guard<std::mutex> lock{ m_registryMutex };
+		m_id = m_nextID++;
+		m_registry[m_id] = this;
+	}
+
+	if (m_pipelineCache == nullptr)
+	{
+		m_pipelineHandle = creation(VK_NULL_HANDLE);
+		EASSERT(m_pipelineHandle != VK_NULL_HANDLE, "Vulkan", "Pipeline creation failed.");
+		return;
+	}
+
+	std::shared_ptr<std::promise<VkPipeline>> result{ std::make_shared<std::promise<VkPipeline>>() };
+	m_pendingPipeline = result->get_future().share();
+	m_pipelineCache->runCompilation(creation, result);
+}
+
+void Pipeline::unregister()
+{
+	std::lock_guard<std::mutex> lock{ m_registryMutex };
+	if (m_id != UINT64_MAX)
+		m_registry.erase(m_id);
+	m_id = UINT64_MAX;
+}
+
+std::vector<std::pair<uint64_t, std::function<VkPipeline(VkPipelineCache)>>> Pipeline::getPipelinesUsingShader(const fs::path& shaderFilename)
+{
+	std::vector<std::pair<uint64_t, std::function<VkPipeline(VkPipelineCache)>>> pipelines{};
+
+	std::lock_guard<std::mutex> lock{ m_registryMutex };
+	for (auto& [id, pipeline] : m_registry)
+	{
+		for (auto& filepath : pipeline->m_shaderFilepaths)
+		{
+			if (filepath.filename() == shaderFilename)
+			{
+				pipelines.push_back({ id, pipeline->m_creation });
+				break;
+			}
+		}
+	}
+
+	return pipelines;
+}
+
+VkPipelineCache Pipeline::getGlobalPipelineCacheHandle()
+{
+	return m_pipelineCache != nullptr ? m_pipelineCache->getHandle() : VK_NULL_HANDLE;
+}
+
+bool Pipeline::replacePipeline(uint64_t id, VkPipeline pipeline)
+{
+	std::lock_guard<std::mutex> lock{ m_registryMutex };
+	auto iter{ m_registry.find(id) };
+	if (iter == m_registry.end() || pipeline == VK_NULL_HANDLE)
+		return false;
 
-	EASSERT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &compPipelineCI, nullptr, &m_pipelineHandle) == VK_SUCCESS, "Vulkan", "Compute pipeline creation failed.");
+	Pipeline& target{ *iter->second };
+	vkDestroyPipeline(target.m_device, target.getPipelineHandle(), nullptr);
+	target.m_pendingPipeline = {};
+	target.m_pipelineHandle = pipeline;
 
-	vkDestroyShaderModule(device, shaderStage.module, nullptr);
+	return true;
 }
\ No newline at end of file
@@ -5,8 +5,14 @@
 #include <filesystem>
 #include <functional>
 #include <span>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
 
 #include <vulkan/vulkan.h>
+#include <tbb/task_group.h>
 
 #include "src/rendering/renderer/descriptor_management.h"
 
@@ -103,12 +109,70 @@ private:
 
 
 
+//Pipelines are compiled through the cache in TBB tasks, the cache is stored on disk and reused if the device and driver match
+class PipelineCache
+{
+private:
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t headerSize;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t deviceUUID[VK_UUID_SIZE];
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+	};
+
+	VkDevice m_device{};
+	VkPipelineCache m_cacheHandle{};
+	fs::path m_filepath{};
+	FileHeader m_header{};
+	bool m_warm{ false };
+
+	oneapi::tbb::task_group m_compilationTasks{};
+	std::atomic<uint32_t> m_pipelineCount{ 0 };
+	std::atomic<uint64_t> m_compilationTimeUs{ 0 };
+	std::chrono::steady_clock::time_point m_firstCompilation{};
+	std::atomic<bool> m_compilationStarted{ false };
+
+public:
+	PipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const fs::path& filepath);
+	~PipelineCache();
+
+	VkPipelineCache getHandle() const { return m_cacheHandle; }
+	bool isWarm() const { return m_warm; }
+
+	void waitForCompilation();
+	void save();
+
+	PipelineCache(PipelineCache&) = delete;
+	void operator=(PipelineCache&) = delete;
+
+private:
+	void runCompilation(const std::function<VkPipeline(VkPipelineCache)>& compilation, const std::shared_ptr<std::promise<VkPipeline>>& result);
+
+	friend class Pipeline;
+};
+
 class Pipeline
 {
 private:
+	inline static PipelineCache* m_pipelineCache{ nullptr };
+
+	//Live pipelines by ID, used by the shader reloader to find and replace pipelines that use a recompiled shader
+	inline static std::mutex m_registryMutex{};
+	inline static std::unordered_map<uint64_t, Pipeline*> m_registry{};
+	inline static uint64_t m_nextID{ 0 };
+
 	VkDevice m_device{};
+	uint64_t m_id{ UINT64_MAX };
+	std::function<VkPipeline(VkPipelineCache)> m_creation{};
+	std::vector<fs::path> m_shaderFilepaths{};
 
 	VkPipeline m_pipelineHandle{};
+	std::shared_future<VkPipeline> m_pendingPipeline{};
 	VkPipelineLayout m_pipelineLayoutHandle{};
 	VkPipelineBindPoint m_bindPoint{};
 
@@ -151,9 +215,21 @@ public:
 		std::span<const VkVertexInputAttributeDescription> attributes = {},
 		std::span<const VkPushConstantRange> pushConstantsRanges = {});
 
-	void initializaCompute(VkDevice device, const fs::path& computeShaderFilepath, std::span<std::reference_wrapper<const ResourceSet>> resourceSets, std::span<const VkPushConstantRange> pushConstantsRanges = {});
+	//Specialization constants are 32 bit values assigned to constant IDs 0 to N - 1 in order
+	void initializaCompute(VkDevice device, const fs::path& computeShaderFilepath, std::span<std::reference_wrapper<const ResourceSet>> resourceSets, std::span<const VkPushConstantRange> pushConstantsRanges = {}, std::span<const uint32_t> specializationConstants = {});
+
+	static void assignGlobalPipelineCache(PipelineCache& pipelineCache);
 
 private:
+	void createPipeline(std::function<VkPipeline(VkPipelineCache)> creation, std::vector<fs::path> shaderFilepaths);
+	void unregister();
+
+	static std::vector<std::pair<uint64_t, std::function<VkPipeline(VkPipelineCache)>>> getPipelinesUsingShader(const fs::path& shaderFilename);
+	static VkPipelineCache getGlobalPipelineCacheHandle();
+	static bool replacePipeline(uint64_t id, VkPipeline pipeline);
+
+	friend class ShaderReloader;
+
 	Pipeline(Pipeline&) = delete;
 	void operator=(Pipeline&) = delete;
 };
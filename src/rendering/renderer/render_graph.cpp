@@ -0,0 +1,599 @@
+#include "src/rendering/renderer/render_graph.h"
+
+#include <algorithm>
+
+#include "src/tools/asserter.h"
+#include "src/tools/logging.h"
+
+namespace
+{
+	constexpr VkAccessFlags2 READ_ACCESS_MASK{
+		VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT |
+		VK_ACCESS_2_UNIFORM_READ_BIT | VK_ACCESS_2_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT |
+		VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT |
+		VK_ACCESS_2_HOST_READ_BIT | VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT };
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+void RenderGraph::PassBuilder::readImage(ResourceHandle image, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout)
+{
+	m_graph.addAccess(m_passIndex, image, ResourceState{ stages, access, layout }, false);
+}
+void RenderGraph::PassBuilder::writeImage(ResourceHandle image, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout)
+{
+	m_graph.addAccess(m_passIndex, image, ResourceState{ stages, access, layout }, true);
+}
+void RenderGraph::PassBuilder::readBuffer(ResourceHandle buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 access)
+{
+	m_graph.addAccess(m_passIndex, buffer, ResourceState{ stages, access, VK_IMAGE_LAYOUT_UNDEFINED }, false);
+}
+void RenderGraph::PassBuilder::writeBuffer(ResourceHandle buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 access)
+{
+	m_graph.addAccess(m_passIndex, buffer, ResourceState{ stages, access, VK_IMAGE_LAYOUT_UNDEFINED }, true);
+}
+void RenderGraph::PassBuilder::setSideEffects()
+{
+	m_graph.m_passes[m_passIndex].sideEffects = true;
+}
+
+RenderGraph::RenderGraph(VkDevice device, MemoryManager& memoryManager) : m_device{ device }, m_memoryManager{ memoryManager }
+{
+
+}
+RenderGraph::~RenderGraph()
+{
+	for (auto& resource : m_resources)
+	{
+		if (resource.transient && resource.image != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(m_device, resource.imageView, nullptr);
+			vkDestroyImage(m_device, resource.image, nullptr);
+		}
+	}
+	if (m_transientAllocation != VK_NULL_HANDLE)
+		vmaFreeMemory(m_memoryManager.getAllocator(), m_transientAllocation);
+}
+
+RenderGraph::ResourceHandle RenderGraph::importImage(const std::string& name, const std::function<ImportedImage()>& resolve, const ResourceState& initialState, const ResourceState& finalState, bool ownedMemory)
+{
+	EASSERT(!m_compiled, "App", "Resources can't be added to a compiled render graph.");
+
+	Resource& resource{ m_resources.emplace_back() };
+	resource.name = name;
+	resource.type = IMAGE_RESOURCE;
+	resource.resolveImage = resolve;
+	resource.initialState = initialState;
+	resource.finalState = finalState;
+	resource.ownedMemory = ownedMemory;
+
+	return m_resources.size() - 1;
+}
+RenderGraph::ResourceHandle RenderGraph::importBuffer(const std::string& name, const std::function<ImportedBuffer()>& resolve)
+{
+	EASSERT(!m_compiled, "App", "Resources can't be added to a compiled render graph.");
+
+	Resource& resource{ m_resources.emplace_back() };
+	resource.name = name;
+	resource.type = BUFFER_RESOURCE;
+	resource.resolveBuffer = resolve;
+
+	return m_resources.size() - 1;
+}
+RenderGraph::ResourceHandle RenderGraph::createTransientImage(const std::string& name, const TransientImageInfo& info)
+{
+	EASSERT(!m_compiled, "App", "Resources can't be added to a compiled render graph.");
+
+	Resource& resource{ m_resources.emplace_back() };
+	resource.name = name;
+	resource.type = IMAGE_RESOURCE;
+	resource.transient = true;
+	resource.transientInfo = info;
+	resource.subresourceRange = { .aspectMask = info.aspects, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1 };
+
+	return m_resources.size() - 1;
+}
+void RenderGraph::markOutput(ResourceHandle resource)
+{
+	EASSERT(resource < m_resources.size(), "App", "Invalid render graph resource handle.");
+	m_resources[resource].output = true;
+}
+
+void RenderGraph::addPass(const std::string& name, QueueType queue, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& record)
+{
+	EASSERT(!m_compiled, "App", "Passes can't be added to a compiled render graph.");
+
+	Pass& pass{ m_passes.emplace_back() };
+	pass.name = name;
+	pass.requestedQueue = queue;
+	pass.queue = queue;
+	pass.record = record;
+
+	PassBuilder builder{ *this, static_cast<uint32_t>(m_passes.size() - 1) };
+	setup(builder);
+}
+
+void RenderGraph::addAccess(uint32_t passIndex, ResourceHandle resource, const ResourceState& state, bool write)
+{
+	EASSERT(resource < m_resources.size(), "App", "Invalid render graph resource handle.");
+
+	Pass& pass{ m_passes[passIndex] };
+	for (auto& access : pass.accesses)
+	{
+		EASSERT(access.resource != resource, "App", "Pass \"" << pass.name << "\" declares resource \"" << m_resources[resource].name << "\" more than once. Combine the accesses.");
+	}
+	EASSERT(m_resources[resource].type == BUFFER_RESOURCE || state.layout != VK_IMAGE_LAYOUT_UNDEFINED, "App", "Image access in pass \"" << pass.name << "\" has undefined layout.");
+
+	pass.accesses.push_back(Access{ .resource = resource, .state = state, .write = write });
+}
+
+void RenderGraph::compile()
+{
+	EASSERT(!m_compiled, "App", "Render graph is already compiled.");
+
+	for (auto& resource : m_resources)
+	{
+		if (resource.transient || resource.type != IMAGE_RESOURCE)
+			continue;
+		ImportedImage imported{ resource.resolveImage() };
+		resource.image = imported.image;
+		resource.imageView = imported.imageView;
+		resource.subresourceRange = imported.subresourceRange;
+		if (resource.ownedMemory && resource.image != VK_NULL_HANDLE)
+		{
+			VkMemoryRequirements memReqs{};
+			vkGetImageMemoryRequirements(m_device, resource.image, &memReqs);
+			m_statistics.importedImageMemory += memReqs.size;
+		}
+	}
+	for (auto& resource : m_resources)
+	{
+		if (resource.type != BUFFER_RESOURCE)
+			continue;
+		ImportedBuffer imported{ resource.resolveBuffer() };
+		resource.buffer = imported.buffer;
+		resource.offset = imported.offset;
+		resource.size = imported.size;
+	}
+
+	cullPasses();
+	assignQueues();
+	computeLifetimes();
+	placeTransientImages();
+	generateBarriers();
+
+	m_compiled = true;
+}
+
+void RenderGraph::resolve()
+{
+	EASSERT(m_compiled, "App", "Render graph must be compiled before resolving.");
+
+	bool changed{ false };
+	for (auto& resource : m_resources)
+	{
+		if (resource.transient)
+			continue;
+		if (resource.type == IMAGE_RESOURCE)
+		{
+			ImportedImage imported{ resource.resolveImage() };
+			EASSERT(imported.subresourceRange.aspectMask == resource.subresourceRange.aspectMask, "App", "Image \"" << resource.name << "\" was resolved to an image with different aspects.");
+			changed = changed || imported.image != resource.image;
+			resource.image = imported.image;
+			resource.imageView = imported.imageView;
+			resource.subresourceRange = imported.subresourceRange;
+		}
+		else
+		{
+			ImportedBuffer imported{ resource.resolveBuffer() };
+			changed = changed || imported.buffer != resource.buffer || imported.offset != resource.offset || imported.size != resource.size;
+			resource.buffer = imported.buffer;
+			resource.offset = imported.offset;
+			resource.size = imported.size;
+		}
+	}
+	if (!changed)
+		return;
+
+	//Barrier layout and access stay the same, only the objects they refer to change
+	auto patchImageBarriers{ [this](std::vector<VkImageMemoryBarrier2>& barriers, const std::vector<ResourceHandle>& resources)
+		{
+			for (uint32_t i{ 0 }; i < barriers.size(); ++i)
+			{
+				barriers[i].image = m_resources[resources[i]].image;
+				barriers[i].subresourceRange = m_resources[resources[i]].subresourceRange;
+			}
+		} };
+	for (auto& pass : m_passes)
+	{
+		patchImageBarriers(pass.imageBarriers, pass.imageBarrierResources);
+		for (uint32_t i{ 0 }; i < pass.bufferBarriers.size(); ++i)
+		{
+			const Resource& resource{ m_resources[pass.bufferBarrierResources[i]] };
+			pass.bufferBarriers[i].buffer = resource.buffer;
+			pass.bufferBarriers[i].offset = resource.offset;
+			pass.bufferBarriers[i].size = resource.size;
+		}
+	}
+	for (uint32_t i{ 0 }; i < QUEUE_TYPE_COUNT; ++i)
+		patchImageBarriers(m_finalImageBarriers[i], m_finalImageBarrierResources[i]);
+}
+
+void RenderGraph::cullPasses()
+{
+	//Walk backwards keeping only passes whose results reach an output
+	std::vector<bool> needed(m_resources.size(), false);
+	for (uint32_t i{ 0 }; i < m_resources.size(); ++i)
+		needed[i] = m_resources[i].output;
+
+	for (int i{ static_cast<int>(m_passes.size()) - 1 }; i >= 0; --i)
+	{
+		Pass& pass{ m_passes[i] };
+
+		bool alive{ pass.sideEffects };
+		for (auto& access : pass.accesses)
+			if (access.write && needed[access.resource])
+				alive = true;
+
+		pass.culled = !alive;
+		if (pass.culled)
+			continue;
+
+		for (auto& access : pass.accesses)
+			if (access.write && !(access.state.access & READ_ACCESS_MASK))
+				needed[access.resource] = false;
+		for (auto& access : pass.accesses)
+			if (!access.write || (access.state.access & READ_ACCESS_MASK))
+				needed[access.resource] = true;
+	}
+
+	m_statistics.passCount = 0;
+	m_statistics.culledPassCount = 0;
+	for (auto& pass : m_passes)
+	{
+		if (pass.culled)
+			++m_statistics.culledPassCount;
+		else
+			++m_statistics.passCount;
+
+		LOG_IF_INFO(pass.culled, "Render graph pass \"{}\" was culled.", pass.name);
+	}
+}
+
+void RenderGraph::assignQueues()
+{
+	constexpr VkPipelineStageFlags2 computeQueueStages{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+		VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT };
+
+	//Passes which can run on the compute queue start there and are moved to graphics if they share a resource with a graphics pass,
+	//until no such pass is left. Dependencies between queues would need semaphores and ownership transfers, which the graph doesn't generate
+	std::vector<bool> usedOnGraphics(m_resources.size(), false);
+	for (auto& pass : m_passes)
+	{
+		if (pass.culled || pass.requestedQueue != ANY_QUEUE)
+			continue;
+		pass.queue = COMPUTE_QUEUE;
+		for (auto& access : pass.accesses)
+			if (access.state.stages & ~computeQueueStages)
+				pass.queue = GRAPHICS_QUEUE;
+	}
+	bool changed{ true };
+	while (changed)
+	{
+		changed = false;
+		for (auto& pass : m_passes)
+			if (!pass.culled && pass.queue == GRAPHICS_QUEUE)
+				for (auto& access : pass.accesses)
+					usedOnGraphics[access.resource] = true;
+		for (auto& pass : m_passes)
+		{
+			if (pass.culled || pass.requestedQueue != ANY_QUEUE || pass.queue != COMPUTE_QUEUE)
+				continue;
+			for (auto& access : pass.accesses)
+			{
+				if (usedOnGraphics[access.resource])
+				{
+					pass.queue = GRAPHICS_QUEUE;
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+
+	m_statistics.computeQueuePassCount = 0;
+	for (auto& pass : m_passes)
+	{
+		if (!pass.culled && pass.queue == COMPUTE_QUEUE)
+			++m_statistics.computeQueuePassCount;
+		LOG_IF_INFO(!pass.culled && pass.requestedQueue == ANY_QUEUE, "Render graph pass \"{}\" was assigned to the {} queue.", pass.name, pass.queue == COMPUTE_QUEUE ? "compute" : "graphics");
+	}
+}
+
+void RenderGraph::computeLifetimes()
+{
+	std::vector<int> resourceQueues(m_resources.size(), -1);
+
+	for (uint32_t i{ 0 }; i < m_passes.size(); ++i)
+	{
+		Pass& pass{ m_passes[i] };
+		if (pass.culled)
+			continue;
+
+		for (auto& access : pass.accesses)
+		{
+			Resource& resource{ m_resources[access.resource] };
+
+			//Queue ownership transfers and semaphores are not generated, such dependencies are synchronized by the caller
+			if (resourceQueues[access.resource] == -1)
+				resourceQueues[access.resource] = pass.queue;
+			EASSERT(resourceQueues[access.resource] == pass.queue, "App", "Resource \"" << resource.name << "\" is accessed from different queues. Cross-queue dependencies must be synchronized outside of the render graph.");
+
+			resource.firstPass = std::min(resource.firstPass, i);
+			resource.lastPass = i;
+			resource.lastStages = access.state.stages;
+			resource.lastAccess = access.state.access;
+		}
+	}
+}
+
+void RenderGraph::placeTransientImages()
+{
+	std::vector<uint32_t> transients{};
+	for (uint32_t i{ 0 }; i < m_resources.size(); ++i)
+	{
+		Resource& resource{ m_resources[i] };
+		if (!resource.transient || resource.firstPass == UINT32_MAX)
+			continue;
+
+		const TransientImageInfo& info{ resource.transientInfo };
+		VkImageCreateInfo imageCI{};
+		imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = info.format;
+		imageCI.extent = { .width = info.width, .height = info.height, .depth = 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = info.usage;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		EASSERT(vkCreateImage(m_device, &imageCI, nullptr, &resource.image) == VK_SUCCESS, "Vulkan", "Transient image creation failed.");
+		vkGetImageMemoryRequirements(m_device, resource.image, &resource.memoryRequirements);
+
+		transients.push_back(i);
+	}
+
+	m_statistics.transientImageCount = transients.size();
+	if (transients.empty())
+		return;
+
+	//Greedy placement, largest first. An image may share memory with every image whose lifetime doesn't overlap its own
+	std::sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) { return m_resources[a].memoryRequirements.size > m_resources[b].memoryRequirements.size; });
+
+	auto lifetimesOverlap{ [](const Resource& a, const Resource& b) { return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass; } };
+	auto memoryOverlaps{ [](const Resource& a, const Resource& b) { return a.memoryOffset < b.memoryOffset + b.memoryRequirements.size && b.memoryOffset < a.memoryOffset + a.memoryRequirements.size; } };
+
+	VkMemoryRequirements heapRequirements{ .size = 0, .alignment = 1, .memoryTypeBits = UINT32_MAX };
+	std::vector<uint32_t> placed{};
+	for (auto index : transients)
+	{
+		Resource& resource{ m_resources[index] };
+		const VkMemoryRequirements& reqs{ resource.memoryRequirements };
+
+		std::vector<VkDeviceSize> candidateOffsets{ 0 };
+		for (auto other : placed)
+			if (lifetimesOverlap(resource, m_resources[other]))
+				candidateOffsets.push_back(alignUp(m_resources[other].memoryOffset + m_resources[other].memoryRequirements.size, reqs.alignment));
+		std::sort(candidateOffsets.begin(), candidateOffsets.end());
+
+		for (auto offset : candidateOffsets)
+		{
+			resource.memoryOffset = offset;
+			bool fits{ true };
+			for (auto other : placed)
+				if (lifetimesOverlap(resource, m_resources[other]) && memoryOverlaps(resource, m_resources[other]))
+					fits = false;
+			if (fits)
+				break;
+		}
+		placed.push_back(index);
+
+		heapRequirements.size = std::max(heapRequirements.size, resource.memoryOffset + reqs.size);
+		heapRequirements.alignment = std::max(heapRequirements.alignment, reqs.alignment);
+		heapRequirements.memoryTypeBits &= reqs.memoryTypeBits;
+		m_statistics.transientMemoryUnaliased += reqs.size;
+	}
+	m_statistics.transientMemory = heapRequirements.size;
+
+	EASSERT(heapRequirements.memoryTypeBits != 0, "App", "Transient images have no common memory type.");
+
+	VmaAllocationCreateInfo allocCI{};
+	allocCI.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	EASSERT(vmaAllocateMemory(m_memoryManager.getAllocator(), &heapRequirements, &allocCI, &m_transientAllocation, nullptr) == VK_SUCCESS, "VMA", "Transient memory allocation failed.");
+
+	for (auto index : transients)
+	{
+		Resource& resource{ m_resources[index] };
+		EASSERT(vmaBindImageMemory2(m_memoryManager.getAllocator(), m_transientAllocation, resource.memoryOffset, resource.image, nullptr) == VK_SUCCESS, "VMA", "Transient image binding failed.");
+
+		VkImageViewCreateInfo imageViewCI{};
+		imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		imageViewCI.image = resource.image;
+		imageViewCI.format = resource.transientInfo.format;
+		imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCI.components = { .r = VK_COMPONENT_SWIZZLE_R, .g = VK_COMPONENT_SWIZZLE_G, .b = VK_COMPONENT_SWIZZLE_B, .a = VK_COMPONENT_SWIZZLE_A };
+		imageViewCI.subresourceRange = resource.subresourceRange;
+		EASSERT(vkCreateImageView(m_device, &imageViewCI, nullptr, &resource.imageView) == VK_SUCCESS, "Vulkan", "Transient image view creation failed.");
+	}
+}
+
+void RenderGraph::generateBarriers()
+{
+	std::vector<TrackedState> states(m_resources.size());
+	for (uint32_t i{ 0 }; i < m_resources.size(); ++i)
+	{
+		Resource& resource{ m_resources[i] };
+		TrackedState& state{ states[i] };
+
+		if (resource.transient)
+		{
+			//Previous users of the aliased memory must be done before the image is transitioned out of undefined layout
+			state = TrackedState{};
+			for (auto& other : m_resources)
+			{
+				if (&other == &resource || !other.transient || other.firstPass == UINT32_MAX || resource.firstPass == UINT32_MAX || other.lastPass >= resource.firstPass)
+					continue;
+				if (other.memoryOffset < resource.memoryOffset + resource.memoryRequirements.size && resource.memoryOffset < other.memoryOffset + other.memoryRequirements.size)
+				{
+					state.writeStages |= other.lastStages;
+					state.writeAccess |= other.lastAccess & ~READ_ACCESS_MASK;
+				}
+			}
+			state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+		else
+		{
+			const ResourceState& initial{ resource.initialState };
+			state.writeStages = (initial.access & ~READ_ACCESS_MASK) || initial.access == VK_ACCESS_2_NONE ? initial.stages : VK_PIPELINE_STAGE_2_NONE;
+			state.writeAccess = initial.access & ~READ_ACCESS_MASK;
+			state.readStages = initial.access & READ_ACCESS_MASK ? initial.stages : VK_PIPELINE_STAGE_2_NONE;
+			state.visibleStages = state.readStages;
+			state.layout = initial.layout;
+		}
+	}
+
+	auto emitBarrier{ [this](Pass& pass, ResourceHandle resourceHandle,
+		VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout)
+		{
+			const Resource& resource{ m_resources[resourceHandle] };
+			if (resource.type == IMAGE_RESOURCE)
+			{
+				pass.imageBarriers.push_back(SyncOperations::constructImageBarrier(srcStages, dstStages, srcAccess, dstAccess, oldLayout, newLayout, resource.image, resource.subresourceRange));
+				pass.imageBarrierResources.push_back(resourceHandle);
+			}
+			else
+			{
+				pass.bufferBarriers.push_back(SyncOperations::constructBufferBarrier(srcStages, dstStages, srcAccess, dstAccess, resource.buffer, resource.offset, resource.size));
+				pass.bufferBarrierResources.push_back(resourceHandle);
+			}
+		} };
+
+	m_statistics.barrierCount = 0;
+	m_statistics.barrierBatchCount = 0;
+
+	for (auto& pass : m_passes)
+	{
+		pass.imageBarriers.clear();
+		pass.bufferBarriers.clear();
+		pass.imageBarrierResources.clear();
+		pass.bufferBarrierResources.clear();
+		if (pass.culled)
+			continue;
+
+		for (auto& access : pass.accesses)
+		{
+			const Resource& resource{ m_resources[access.resource] };
+			TrackedState& state{ states[access.resource] };
+			const ResourceState& dst{ access.state };
+
+			bool layoutChange{ resource.type == IMAGE_RESOURCE && dst.layout != state.layout };
+			VkImageLayout newLayout{ resource.type == IMAGE_RESOURCE ? dst.layout : VK_IMAGE_LAYOUT_UNDEFINED };
+
+			if (access.write || layoutChange)
+			{
+				//WAR, WAW and layout transitions
+				if (layoutChange || state.writeStages != VK_PIPELINE_STAGE_2_NONE || state.readStages != VK_PIPELINE_STAGE_2_NONE)
+					emitBarrier(pass, access.resource,
+						state.writeStages | state.readStages, state.writeAccess, dst.stages, dst.access, state.layout, newLayout);
+
+				if (access.write)
+					state = TrackedState{ .writeStages = dst.stages, .writeAccess = dst.access & ~READ_ACCESS_MASK, .layout = newLayout };
+				else
+					state = TrackedState{ .writeStages = dst.stages, .readStages = dst.stages, .visibleStages = dst.stages, .layout = newLayout };
+			}
+			else
+			{
+				//RAW, only if the reading stages haven't seen the last write yet
+				if (state.writeStages != VK_PIPELINE_STAGE_2_NONE && (dst.stages & ~state.visibleStages))
+				{
+					emitBarrier(pass, access.resource,
+						state.writeStages, state.writeAccess, dst.stages, dst.access, state.layout, newLayout);
+					state.visibleStages |= dst.stages;
+				}
+				state.readStages |= dst.stages;
+			}
+		}
+
+		m_statistics.barrierCount += pass.imageBarriers.size() + pass.bufferBarriers.size();
+		if (!pass.imageBarriers.empty() || !pass.bufferBarriers.empty())
+			++m_statistics.barrierBatchCount;
+	}
+
+	//Return imported images to the layout the rest of the frame expects, on the queue of their last user. Memory dependencies with work outside of the graph are left to the caller
+	for (uint32_t i{ 0 }; i < QUEUE_TYPE_COUNT; ++i)
+	{
+		m_finalImageBarriers[i].clear();
+		m_finalImageBarrierResources[i].clear();
+	}
+	for (uint32_t i{ 0 }; i < m_resources.size(); ++i)
+	{
+		const Resource& resource{ m_resources[i] };
+		const TrackedState& state{ states[i] };
+		const ResourceState& finalState{ resource.finalState };
+		if (resource.transient || resource.type != IMAGE_RESOURCE || finalState.layout == VK_IMAGE_LAYOUT_UNDEFINED || finalState.layout == state.layout)
+			continue;
+
+		QueueType queue{ resource.firstPass == UINT32_MAX ? GRAPHICS_QUEUE : m_passes[resource.lastPass].queue };
+		m_finalImageBarriers[queue].push_back(SyncOperations::constructImageBarrier(state.writeStages | state.readStages, finalState.stages, state.writeAccess, finalState.access,
+			state.layout, finalState.layout, resource.image, resource.subresourceRange));
+		m_finalImageBarrierResources[queue].push_back(i);
+	}
+	for (uint32_t i{ 0 }; i < QUEUE_TYPE_COUNT; ++i)
+	{
+		m_statistics.barrierCount += m_finalImageBarriers[i].size();
+		if (!m_finalImageBarriers[i].empty())
+			++m_statistics.barrierBatchCount;
+	}
+}
+
+void RenderGraph::cmdExecute(VkCommandBuffer cb, QueueType queue)
+{
+	EASSERT(m_compiled, "App", "Render graph must be compiled before execution.");
+	EASSERT(queue < QUEUE_TYPE_COUNT, "App", "Render graph is executed on a specific queue.");
+
+	for (auto& pass : m_passes)
+	{
+		if (pass.culled || pass.queue != queue)
+			continue;
+
+		if (!pass.imageBarriers.empty() || !pass.bufferBarriers.empty())
+			SyncOperations::cmdExecuteBarrier(cb, {}, pass.bufferBarriers, pass.imageBarriers);
+
+		pass.record(cb);
+	}
+
+	if (!m_finalImageBarriers[queue].empty())
+		SyncOperations::cmdExecuteBarrier(cb, m_finalImageBarriers[queue]);
+}
+
+VkImage RenderGraph::getImageHandle(ResourceHandle image) const
+{
+	EASSERT(image < m_resources.size() && m_resources[image].type == IMAGE_RESOURCE, "App", "Invalid render graph image handle.");
+	return m_resources[image].image;
+}
+VkImageView RenderGraph::getImageView(ResourceHandle image) const
+{
+	EASSERT(image < m_resources.size() && m_resources[image].type == IMAGE_RESOURCE, "App", "Invalid render graph image handle.");
+	EASSERT(m_compiled || !m_resources[image].transient, "App", "Transient image views are available after the render graph is compiled.");
+	return m_resources[image].imageView;
+}
+VkImageSubresourceRange RenderGraph::getSubresourceRange(ResourceHandle image) const
+{
+	EASSERT(image < m_resources.size() && m_resources[image].type == IMAGE_RESOURCE, "App", "Invalid render graph image handle.");
+	return m_resources[image].subresourceRange;
+}
@@ -0,0 +1,217 @@
+#ifndef RENDER_GRAPH_HEADER
+#define RENDER_GRAPH_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <vulkan/vulkan.h>
+#include <vma/vk_mem_alloc.h>
+
+#include "src/rendering/data_management/memory_manager.h"
+#include "src/rendering/renderer/sync_operations.h"
+
+//Passes declare what they read and write, the graph culls passes that don't contribute to outputs, assigns passes to queues,
+//derives the barriers and layout transitions between them and places transient images with non-overlapping lifetimes in shared memory.
+//The graph is compiled once and replayed every frame, so resources are expected to be in their initial state when execution begins.
+//Imported resources are resolved through callbacks every frame, so images which are recreated, relocated or swapped keep getting correct barriers.
+class RenderGraph
+{
+public:
+	typedef uint32_t ResourceHandle;
+
+	enum QueueType
+	{
+		GRAPHICS_QUEUE,
+		COMPUTE_QUEUE,
+		QUEUE_TYPE_COUNT,
+		//Graph puts the pass on the async compute queue if it only uses compute and transfer stages and shares no resources with graphics passes
+		ANY_QUEUE = QUEUE_TYPE_COUNT
+	};
+
+	struct ResourceState
+	{
+		VkPipelineStageFlags2 stages{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 access{ VK_ACCESS_2_NONE };
+		VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	};
+
+	struct ImportedImage
+	{
+		VkImage image;
+		VkImageView imageView;
+		VkImageSubresourceRange subresourceRange;
+	};
+	struct ImportedBuffer
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	struct TransientImageInfo
+	{
+		VkFormat format;
+		uint32_t width;
+		uint32_t height;
+		VkImageUsageFlags usage;
+		VkImageAspectFlags aspects;
+	};
+
+	struct Statistics
+	{
+		uint32_t passCount{ 0 };
+		uint32_t culledPassCount{ 0 };
+		uint32_t computeQueuePassCount{ 0 };
+		uint32_t barrierCount{ 0 };
+		uint32_t barrierBatchCount{ 0 };
+		uint32_t transientImageCount{ 0 };
+		VkDeviceSize importedImageMemory{ 0 };
+		VkDeviceSize transientMemory{ 0 };
+		VkDeviceSize transientMemoryUnaliased{ 0 };
+	};
+
+	class PassBuilder
+	{
+	private:
+		RenderGraph& m_graph;
+		uint32_t m_passIndex;
+
+	public:
+		void readImage(ResourceHandle image, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout);
+		void writeImage(ResourceHandle image, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout);
+		void readBuffer(ResourceHandle buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 access);
+		void writeBuffer(ResourceHandle buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 access);
+		//Pass is never culled
+		void setSideEffects();
+
+	private:
+		PassBuilder(RenderGraph& graph, uint32_t passIndex) : m_graph{ graph }, m_passIndex{ passIndex } {}
+
+		friend class RenderGraph;
+	};
+
+private:
+	enum ResourceType
+	{
+		IMAGE_RESOURCE,
+		BUFFER_RESOURCE
+	};
+
+	struct Resource
+	{
+		std::string name{};
+		ResourceType type{};
+		bool transient{ false };
+		bool output{ false };
+		bool ownedMemory{ true };
+
+		std::function<ImportedImage()> resolveImage{};
+		std::function<ImportedBuffer()> resolveBuffer{};
+
+		VkImage image{};
+		VkImageView imageView{};
+		VkImageSubresourceRange subresourceRange{};
+		TransientImageInfo transientInfo{};
+
+		VkBuffer buffer{};
+		VkDeviceSize offset{};
+		VkDeviceSize size{};
+
+		ResourceState initialState{};
+		ResourceState finalState{};
+
+		//Transient placement
+		VkMemoryRequirements memoryRequirements{};
+		VkDeviceSize memoryOffset{};
+		uint32_t firstPass{ UINT32_MAX };
+		uint32_t lastPass{ 0 };
+		VkPipelineStageFlags2 lastStages{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 lastAccess{ VK_ACCESS_2_NONE };
+	};
+
+	struct Access
+	{
+		ResourceHandle resource;
+		ResourceState state;
+		bool write;
+	};
+
+	struct Pass
+	{
+		std::string name{};
+		QueueType requestedQueue{};
+		QueueType queue{};
+		bool sideEffects{ false };
+		bool culled{ false };
+		std::vector<Access> accesses{};
+		std::function<void(VkCommandBuffer)> record{};
+
+		std::vector<VkImageMemoryBarrier2> imageBarriers{};
+		std::vector<VkBufferMemoryBarrier2> bufferBarriers{};
+		//Resources the barriers refer to, handles are patched when imports resolve to different objects
+		std::vector<ResourceHandle> imageBarrierResources{};
+		std::vector<ResourceHandle> bufferBarrierResources{};
+	};
+
+	struct TrackedState
+	{
+		VkPipelineStageFlags2 writeStages;
+		VkAccessFlags2 writeAccess;
+		VkPipelineStageFlags2 readStages;
+		VkPipelineStageFlags2 visibleStages;
+		VkImageLayout layout;
+	};
+
+	VkDevice m_device{};
+	MemoryManager& m_memoryManager;
+
+	std::vector<Resource> m_resources{};
+	std::vector<Pass> m_passes{};
+
+	//Barriers after the last pass of each queue
+	std::vector<VkImageMemoryBarrier2> m_finalImageBarriers[QUEUE_TYPE_COUNT]{};
+	std::vector<ResourceHandle> m_finalImageBarrierResources[QUEUE_TYPE_COUNT]{};
+
+	VmaAllocation m_transientAllocation{};
+
+	Statistics m_statistics{};
+	bool m_compiled{ false };
+
+public:
+	RenderGraph(VkDevice device, MemoryManager& memoryManager);
+	~RenderGraph();
+
+	//ownedMemory is false for images whose memory isn't counted by this graph, such as swapchain images or images already imported into another graph
+	ResourceHandle importImage(const std::string& name, const std::function<ImportedImage()>& resolve, const ResourceState& initialState, const ResourceState& finalState, bool ownedMemory = true);
+	ResourceHandle importBuffer(const std::string& name, const std::function<ImportedBuffer()>& resolve);
+	ResourceHandle createTransientImage(const std::string& name, const TransientImageInfo& info);
+	void markOutput(ResourceHandle resource);
+
+	void addPass(const std::string& name, QueueType queue, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& record);
+
+	void compile();
+	//Re-resolves imported resources and patches the recorded barriers. Has to be called before the graph is executed in a frame and not concurrently with cmdExecute()
+	void resolve();
+	void cmdExecute(VkCommandBuffer cb, QueueType queue = GRAPHICS_QUEUE);
+
+	VkImage getImageHandle(ResourceHandle image) const;
+	VkImageView getImageView(ResourceHandle image) const;
+	VkImageSubresourceRange getSubresourceRange(ResourceHandle image) const;
+	const Statistics& getStatistics() const { return m_statistics; }
+
+	RenderGraph(RenderGraph&) = delete;
+	void operator=(RenderGraph&) = delete;
+
+private:
+	void addAccess(uint32_t passIndex, ResourceHandle resource, const ResourceState& state, bool write);
+
+	void cullPasses();
+	void assignQueues();
+	void computeLifetimes();
+	void placeTransientImages();
+	void generateBarriers();
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "src/rendering/renderer/transform_storage.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "src/tools/logging.h"
+
+namespace
+{
+	//Calls func once for every run of consecutive indices
+	template<typename Func>
+	void forEachRange(const std::vector<uint32_t>& sortedIndices, Func&& func)
+	{
+		for (size_t i{ 0 }; i < sortedIndices.size();)
+		{
+			size_t j{ i + 1 };
+			while (j < sortedIndices.size() && sortedIndices[j] == sortedIndices[j - 1] + 1)
+				++j;
+			func(sortedIndices[i], static_cast<uint32_t>(j - i));
+			i = j;
+		}
+	}
+}
+
+TransformStorage::TransformStorage(VkDevice device, uint32_t capacity, uint32_t drawCapacity, const BufferMapped& indirectDrawCmdData, RingAllocator& frameAllocator) :
+	m_capacity{ capacity },
+	m_drawCapacity{ drawCapacity },
+	m_base{ device, sizeof(glm::mat4) * 2 * capacity + sizeof(Bounds) * 2 * drawCapacity + 1024,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT },
+	m_frameAllocator{ &frameAllocator }
+{
+	EASSERT(capacity != 0 && capacity <= TRANSFORM_STORAGE_MAX_OBJECTS, "App", "Transform storage capacity is out of range.");
+
+	m_objects.reserve(capacity);
+	m_dirtyFlags.resize(capacity, 0);
+	m_localBounds.resize(drawCapacity);
+
+	m_transforms.initialize(m_base, sizeof(glm::mat4) * capacity);
+	m_prevTransforms.initialize(m_base, sizeof(glm::mat4) * capacity);
+	m_localBoundsBuffer.initialize(m_base, sizeof(Bounds) * drawCapacity);
+	m_worldBounds.initialize(m_base, sizeof(Bounds) * drawCapacity);
+
+	VkDescriptorSetLayoutBinding transformsBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT transformsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_transforms.getDeviceAddress(), .range = m_transforms.getSize() };
+	VkDescriptorSetLayoutBinding localBoundsBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT localBoundsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_localBoundsBuffer.getDeviceAddress(), .range = m_localBoundsBuffer.getSize() };
+	//Rewritten every frame to point at the draws uploaded through the frame allocator
+	VkDescriptorSetLayoutBinding dirtyDrawsBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT dirtyDrawsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = frameAllocator.getDeviceAddress(), .range = sizeof(glm::uvec2) * drawCapacity };
+	VkDescriptorSetLayoutBinding drawCommandsBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT drawCommandsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = indirectDrawCmdData.getDeviceAddress(), .range = indirectDrawCmdData.getSize() };
+	VkDescriptorSetLayoutBinding worldBoundsBinding{ .binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	VkDescriptorAddressInfoEXT worldBoundsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = m_worldBounds.getDeviceAddress(), .range = m_worldBounds.getSize() };
+	m_resSet.initializeSet(device, 1, VkDescriptorSetLayoutCreateFlagBits{},
+		std::array{ transformsBinding, localBoundsBinding, dirtyDrawsBinding, drawCommandsBinding, worldBoundsBinding },
+		std::array<VkDescriptorBindingFlags, 0>{},
+		std::vector<std::vector<VkDescriptorDataEXT>>{
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &transformsAddressInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &localBoundsAddressInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &dirtyDrawsAddressInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &drawCommandsAddressInfo} },
+			std::vector<VkDescriptorDataEXT>{ {.pStorageBuffer = &worldBoundsAddressInfo} } },
+		false);
+
+	std::array<std::reference_wrapper<const ResourceSet>, 1> resourceSets{ m_resSet };
+	m_boundsPass.initializaCompute(device, "shaders/cmpld/transform_bounds_comp.spv", resourceSets,
+		{ {VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(m_pcData) }} });
+}
+
+uint32_t TransformStorage::addObject(const glm::mat4& transform, uint32_t firstDraw, uint32_t drawCount)
+{
+	EASSERT(m_objects.size() < m_capacity, "App", "More objects added than space allocated.");
+	EASSERT(firstDraw + drawCount <= m_drawCapacity, "App", "Object draws are out of range.");
+
+	uint32_t objectIndex{ static_cast<uint32_t>(m_objects.size()) };
+	m_objects.push_back(Object{ .transform = transform, .firstDraw = firstDraw, .drawCount = drawCount });
+	markDirty(objectIndex);
+	return objectIndex;
+}
+void TransformStorage::setLocalBounds(const OBBs& localBoundingBoxes)
+{
+	float* axii[9]{};
+	float* centers[3]{};
+	float* extents[3]{};
+	uint32_t count{ localBoundingBoxes.getAxiiOBBs(
+		axii + 0, axii + 1, axii + 2,
+		axii + 3, axii + 4, axii + 5,
+		axii + 6, axii + 7, axii + 8,
+		centers + 0, centers + 1, centers + 2,
+		extents + 0, extents + 1, extents + 2) };
+	EASSERT(count <= m_drawCapacity, "App", "More bounding boxes than draws allocated.");
+
+	for (uint32_t i{ 0 }; i < count; ++i)
+	{
+		Bounds& bounds{ m_localBounds[i] };
+		bounds.center = glm::vec4{ centers[0][i], centers[1][i], centers[2][i], 1.0f };
+		for (int axis{ 0 }; axis < 3; ++axis)
+			bounds.halfAxes[axis] = glm::vec4{ axii[axis * 3 + 0][i], axii[axis * 3 + 1][i], axii[axis * 3 + 2][i], 0.0f } * extents[axis][i];
+	}
+	m_localBoundsPending = true;
+	//Spheres of every draw have to be recomputed from the new bounds
+	for (uint32_t i{ 0 }; i < m_objects.size(); ++i)
+		markDirty(i);
+}
+void TransformStorage::setTransform(uint32_t objectIndex, const glm::mat4& transform)
+{
+	EASSERT(objectIndex < m_objects.size(), "App", "Undefined object accessed.");
+	m_objects[objectIndex].transform = transform;
+	markDirty(objectIndex);
+}
+void TransformStorage::markDirty(uint32_t objectIndex)
+{
+	if (m_dirtyFlags[objectIndex])
+		return;
+	m_dirtyFlags[objectIndex] = 1;
+	m_dirtyObjects.push_back(objectIndex);
+}
+
+void TransformStorage::cmdUpload(VkCommandBuffer cb)
+{
+	m_uploadStats = {};
+	if (m_localBoundsPending)
+	{
+		RingAllocator::Allocation staging{ m_frameAllocator->push(std::span<const Bounds>{ m_localBounds }) };
+		if (staging.failed())
+		{
+			LOG_WARNING("Local bounds upload is postponed, the frame allocator is full.");
+			return;
+		}
+		VkBufferCopy copy{ .srcOffset = staging.offset, .dstOffset = m_localBoundsBuffer.getOffset(), .size = staging.size };
+		BufferTools::cmdBufferCopy(cb, staging.buffer, m_localBoundsBuffer.getBufferHandle(), 1, &copy);
+		m_localBoundsPending = false;
+		m_uploadStats.stagedBytes += staging.size;
+	}
+
+	if (m_dirtyObjects.empty() && m_prevDirtyObjects.empty())
+		return;
+
+	std::sort(m_dirtyObjects.begin(), m_dirtyObjects.end());
+
+	//Staging is reserved before anything is recorded, so a full frame allocator leaves the dirty state intact for the next frame
+	RingAllocator::Allocation staging{};
+	RingAllocator::Allocation dirtyDrawsAllocation{};
+	std::vector<glm::uvec2> dirtyDraws{};
+	if (!m_dirtyObjects.empty())
+	{
+		for (uint32_t objectIndex : m_dirtyObjects)
+		{
+			const Object& object{ m_objects[objectIndex] };
+			for (uint32_t draw{ object.firstDraw }; draw < object.firstDraw + object.drawCount; ++draw)
+				dirtyDraws.push_back(glm::uvec2{ draw, objectIndex });
+		}
+		staging = m_frameAllocator->allocate(sizeof(glm::mat4) * m_dirtyObjects.size());
+		if (!dirtyDraws.empty() && !staging.failed())
+			dirtyDrawsAllocation = m_frameAllocator->push(std::span<const glm::uvec2>{ dirtyDraws }, RING_ALLOCATOR_MAX_ALIGNMENT);
+		if (staging.failed() || (!dirtyDraws.empty() && dirtyDrawsAllocation.failed()))
+		{
+			LOG_WARNING("Transform upload of {} objects is postponed, the frame allocator is full.", m_dirtyObjects.size());
+			return;
+		}
+	}
+
+	//Previous transforms are refreshed before the current ones are overwritten. Objects changed only in the previous frame stop moving, so both become equal
+	std::vector<uint32_t> refreshedObjects{};
+	std::set_union(m_dirtyObjects.begin(), m_dirtyObjects.end(), m_prevDirtyObjects.begin(), m_prevDirtyObjects.end(), std::back_inserter(refreshedObjects));
+	std::vector<VkBufferCopy> regions{};
+	forEachRange(refreshedObjects, [&](uint32_t first, uint32_t count)
+		{
+			regions.push_back(VkBufferCopy{
+				.srcOffset = m_transforms.getOffset() + sizeof(glm::mat4) * first,
+				.dstOffset = m_prevTransforms.getOffset() + sizeof(glm::mat4) * first,
+				.size = sizeof(glm::mat4) * count });
+		});
+	BufferTools::cmdBufferCopy(cb, m_transforms.getBufferHandle(), m_prevTransforms.getBufferHandle(), regions.size(), regions.data());
+
+	if (!m_dirtyObjects.empty())
+	{
+		SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT)} });
+
+		//Only the matrices of changed objects are staged, one copy region per run of consecutive objects
+		glm::mat4* stagedTransforms{ reinterpret_cast<glm::mat4*>(staging.data) };
+		for (uint32_t i{ 0 }; i < m_dirtyObjects.size(); ++i)
+			stagedTransforms[i] = m_objects[m_dirtyObjects[i]].transform;
+		regions.clear();
+		VkDeviceSize stagingOffset{ staging.offset };
+		forEachRange(m_dirtyObjects, [&](uint32_t first, uint32_t count)
+			{
+				regions.push_back(VkBufferCopy{
+					.srcOffset = stagingOffset,
+					.dstOffset = m_transforms.getOffset() + sizeof(glm::mat4) * first,
+					.size = sizeof(glm::mat4) * count });
+				stagingOffset += sizeof(glm::mat4) * count;
+			});
+		BufferTools::cmdBufferCopy(cb, staging.buffer, m_transforms.getBufferHandle(), regions.size(), regions.data());
+		m_uploadStats.objectCount = static_cast<uint32_t>(m_dirtyObjects.size());
+		m_uploadStats.drawCount = static_cast<uint32_t>(dirtyDraws.size());
+		m_uploadStats.stagedBytes += sizeof(glm::mat4) * m_dirtyObjects.size() + sizeof(glm::uvec2) * dirtyDraws.size();
+
+		if (!dirtyDraws.empty())
+		{
+			VkDescriptorAddressInfoEXT dirtyDrawsAddressInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = dirtyDrawsAllocation.deviceAddress, .range = dirtyDrawsAllocation.size };
+			m_resSet.rewriteDescriptor(2, 0, 0, { .pStorageBuffer = &dirtyDrawsAddressInfo });
+
+			SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)} });
+
+			m_pcData.dirtyDrawCount = static_cast<uint32_t>(dirtyDraws.size());
+			m_boundsPass.cmdBindResourceSets(cb);
+			m_boundsPass.cmdBind(cb);
+			vkCmdPushConstants(cb, m_boundsPass.getPipelineLayoutHandle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_pcData), &m_pcData);
+			vkCmdDispatch(cb, DISPATCH_SIZE(m_pcData.dirtyDrawCount, TRANSFORM_BOUNDS_GROUP_SIZE), 1, 1);
+		}
+	}
+
+	SyncOperations::cmdExecuteBarrier(cb, { {SyncOperations::constructMemoryBarrier(
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT)} });
+
+	for (uint32_t objectIndex : m_dirtyObjects)
+		m_dirtyFlags[objectIndex] = 0;
+	m_prevDirtyObjects = std::move(m_dirtyObjects);
+	m_dirtyObjects.clear();
+}
+void TransformStorage::upload(CommandBufferSet& cmdBufferSet, VkQueue queue)
+{
+	VkCommandBuffer cb{ cmdBufferSet.beginTransientRecording() };
+	cmdUpload(cb);
+	cmdBufferSet.endRecording(cb);
+	VkSubmitInfo submitInfo{ .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .commandBufferCount = 1, .pCommandBuffers = &cb };
+	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(queue);
+	cmdBufferSet.resetAll();
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef TRANSFORM_STORAGE_HEADER
+#define TRANSFORM_STORAGE_HEADER
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "src/rendering/renderer/pipeline_management.h"
+#include "src/rendering/renderer/descriptor_management.h"
+#include "src/rendering/renderer/command_management.h"
+#include "src/rendering/renderer/sync_operations.h"
+#include "src/rendering/data_management/buffer_class.h"
+#include "src/rendering/data_management/ring_allocator.h"
+#include "src/rendering/data_abstraction/BB.h"
+#include "src/tools/asserter.h"
+#include "src/tools/comp_s.h"
+
+#define TRANSFORM_BOUNDS_GROUP_SIZE 64
+//Draw data holds 16 bit model indices
+#define TRANSFORM_STORAGE_MAX_OBJECTS 65536
+
+//Device resident model matrices with per object indices.
+//Only objects changed since the previous frame are uploaded, and the bounding spheres of their draws are recomputed by a compute pass.
+//Capacity is fixed at construction since the buffers are referenced by descriptors of other passes.
+class TransformStorage
+{
+private:
+	struct Object
+	{
+		glm::mat4 transform;
+		uint32_t firstDraw;
+		uint32_t drawCount;
+	};
+	//Center and half axes scaled by the extents
+	struct Bounds
+	{
+		glm::vec4 center;
+		glm::vec4 halfAxes[3];
+	};
+
+	uint32_t m_capacity{};
+	uint32_t m_drawCapacity{};
+	std::vector<Object> m_objects{};
+	std::vector<Bounds> m_localBounds{};
+	bool m_localBoundsPending{ false };
+
+	//Objects changed this frame and in the previous one. Previous transforms of both are refreshed from the current ones on the GPU
+	std::vector<uint8_t> m_dirtyFlags{};
+	std::vector<uint32_t> m_dirtyObjects{};
+	std::vector<uint32_t> m_prevDirtyObjects{};
+
+	BufferBaseHostInaccessible m_base;
+	Buffer m_transforms{};
+	Buffer m_prevTransforms{};
+	Buffer m_localBoundsBuffer{};
+	Buffer m_worldBounds{};
+
+	RingAllocator* const m_frameAllocator{ nullptr };
+
+	ResourceSet m_resSet{};
+	Pipeline m_boundsPass{};
+
+	struct
+	{
+		uint32_t dirtyDrawCount;
+	} m_pcData{};
+
+public:
+	//Data staged by the last cmdUpload
+	struct UploadStats
+	{
+		uint32_t objectCount;
+		uint32_t drawCount;
+		VkDeviceSize stagedBytes;
+	};
+private:
+	UploadStats m_uploadStats{};
+
+public:
+	TransformStorage(VkDevice device, uint32_t capacity, uint32_t drawCapacity, const BufferMapped& indirectDrawCmdData, RingAllocator& frameAllocator);
+	~TransformStorage() = default;
+
+	uint32_t addObject(const glm::mat4& transform, uint32_t firstDraw, uint32_t drawCount);
+	//Bounds have to be in model space, they are transformed by the matrix of the object owning the draw
+	void setLocalBounds(const OBBs& localBoundingBoxes);
+	void setTransform(uint32_t objectIndex, const glm::mat4& transform);
+
+	const glm::mat4& getTransform(uint32_t objectIndex) const
+	{
+		EASSERT(objectIndex < m_objects.size(), "App", "Undefined object accessed.");
+		return m_objects[objectIndex].transform;
+	}
+	//Draw range is fixed when the object is added
+	uint32_t getFirstDraw(uint32_t objectIndex) const
+	{
+		EASSERT(objectIndex < m_objects.size(), "App", "Undefined object accessed.");
+		return m_objects[objectIndex].firstDraw;
+	}
+	uint32_t getDrawCount(uint32_t objectIndex) const
+	{
+		EASSERT(objectIndex < m_objects.size(), "App", "Undefined object accessed.");
+		return m_objects[objectIndex].drawCount;
+	}
+	uint32_t getObjectCount() const { return static_cast<uint32_t>(m_objects.size()); }
+	uint32_t getDirtyObjectCount() const { return static_cast<uint32_t>(m_dirtyObjects.size()); }
+	const UploadStats& getUploadStats() const { return m_uploadStats; }
+	//Bytes staged per frame if every object was uploaded
+	VkDeviceSize getFullUploadSize() const { return sizeof(glm::mat4) * m_objects.size() + sizeof(glm::uvec2) * (m_objects.empty() ? 0 : m_objects.back().firstDraw + m_objects.back().drawCount); }
+	const Buffer& getTransforms() const { return m_transforms; }
+	const Buffer& getPrevTransforms() const { return m_prevTransforms; }
+	//World space OBBs of the draws as center and three half axes
+	const Buffer& getWorldBounds() const { return m_worldBounds; }
+
+	//Has to be recorded before anything reads transforms or bounding spheres of the frame
+	void cmdUpload(VkCommandBuffer cb);
+	void upload(CommandBufferSet& cmdBufferSet, VkQueue queue);
+
+	TransformStorage(TransformStorage&) = delete;
+	void operator=(TransformStorage&) = delete;
+
+private:
+	void markDirty(uint32_t objectIndex);
+};
+
+#endif
\ No newline at end of file
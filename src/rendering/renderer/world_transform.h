@@ -25,6 +25,8 @@ private:
 	ResourceSet m_resSet{};
 
 	uint32_t m_jitterIndex{ 0 };
+	//Jitter is kept in pixels and scaled by the current render extent
+	glm::dvec2 m_invScreenDimensions{ 1.0 };
 
 	glm::dvec2 m_HaltonSequenceJitter[16]
 	{
@@ -62,9 +64,9 @@ public:
 	VkBuffer getBufferHandle() const { return m_data.getBufferHandle(); }
 	VkDeviceSize getBufferOffset() const { return m_data.getOffset(); }
 	const ResourceSet& getResourceSet() const { return m_resSet; };
-	const glm::vec2& getCurrentJitter()
+	glm::vec2 getCurrentJitter() const
 	{
-		return m_HaltonSequenceJitter[m_jitterIndex];
+		return glm::vec2(m_HaltonSequenceJitter[m_jitterIndex] * m_invScreenDimensions);
 	}
 
 	const glm::mat4& getViewMatrix() const { return reinterpret_cast<CoordinateTransformationData*>(m_data.getData())->viewFromWorld; }
@@ -101,8 +103,9 @@ public:
 		CoordinateTransformationData* data{ reinterpret_cast<CoordinateTransformationData*>(m_data.getData()) };
 
 		m_jitterIndex = (m_jitterIndex + 1) % ARRAYSIZE(m_HaltonSequenceJitter);
-		data->ndcFromView[2][0] = static_cast<float>(m_HaltonSequenceJitter[m_jitterIndex].x);
-		data->ndcFromView[2][1] = static_cast<float>(m_HaltonSequenceJitter[m_jitterIndex].y);
+		glm::vec2 jitter{ getCurrentJitter() };
+		data->ndcFromView[2][0] = jitter.x;
+		data->ndcFromView[2][1] = jitter.y;
 		data->viewFromNdc = glm::inverse(data->ndcFromView);
 
 		data->ndcFromWorld = data->ndcFromView * data->viewFromWorld;
@@ -110,8 +113,7 @@ public:
 	}
 	void updateScreenDimensions(uint32_t width, uint32_t height)
 	{
-		for (auto& jit : m_HaltonSequenceJitter)
-			jit /= glm::vec2(float(width), float(height));
+		m_invScreenDimensions = glm::dvec2(1.0 / width, 1.0 / height);
 	}
 };
 
@@ -0,0 +1,365 @@
+#include "shader_reloader.h"
+
+#include <cstdlib>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <format>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+#include <tbb/parallel_for.h>
+
+#include "src/rendering/renderer/pipeline_management.h"
+#include "src/tools/asserter.h"
+#include "src/tools/logging.h"
+
+#define SHADER_RELOADER_POLL_INTERVAL_MS 250
+
+ShaderReloader::ShaderReloader(VkDevice device, const fs::path& sourceDirectory, const fs::path& outputDirectory)
+	: m_device{ device }, m_sourceDirectory{ sourceDirectory }, m_outputDirectory{ outputDirectory }
+{
+	const char* sdk{ std::getenv("VULKAN_SDK") };
+#ifdef _WIN32
+	m_compiler = sdk != nullptr ? (fs::path{ sdk } / "Bin" / "glslangValidator").string() : "glslangValidator";
+#else
+	m_compiler = sdk != nullptr ? (fs::path{ sdk } / "bin" / "glslangValidator").string() : "glslangValidator";
+#endif
+
+	m_watcher = std::thread{ &ShaderReloader::watch, this };
+}
+ShaderReloader::~ShaderReloader()
+{
+	stop();
+
+	for (auto& reloaded : m_reloadedPipelines)
+		vkDestroyPipeline(m_device, reloaded.pipeline, nullptr);
+}
+
+void ShaderReloader::stop()
+{
+	m_stop = true;
+	if (m_watcher.joinable())
+		m_watcher.join();
+}
+
+uint32_t ShaderReloader::applyReloadedPipelines()
+{
+	std::vector<ReloadedPipeline> reloadedPipelines{};
+	{
+		std::lock_guard<std::mutex> lock{ m_reloadedMutex };
+		reloadedPipelines.swap(m_reloadedPipelines);
+	}
+	if (reloadedPipelines.empty())
+		return 0;
+
+	//Old pipelines might still be referenced by the async compute submission
+	EASSERT(vkDeviceWaitIdle(m_device) == VK_SUCCESS, "Vulkan", "Device wait failed.");
+
+	uint32_t replacedCount{ 0 };
+	for (auto& reloaded : reloadedPipelines)
+	{
+		if (Pipeline::replacePipeline(reloaded.id, reloaded.pipeline))
+			++replacedCount;
+		else
+			vkDestroyPipeline(m_device, reloaded.pipeline, nullptr);
+	}
+	LOG_INFO("{} pipelines were replaced after shader reload.", replacedCount);
+
+	return replacedCount;
+}
+
+std::vector<std::string> ShaderReloader::getErrors()
+{
+	std::vector<std::string> errors{};
+
+	std::lock_guard<std::mutex> lock{ m_errorsMutex };
+	for (auto& [filename, log] : m_errors)
+		errors.push_back(std::format("{}:\n{}", filename, log));
+
+	return errors;
+}
+
+void ShaderReloader::watch()
+{
+#ifdef __linux__
+	int notifier{ inotify_init1(IN_NONBLOCK) };
+	EASSERT(notifier != -1, "App", "inotify initialization failed.");
+	int sourceWatch{ inotify_add_watch(notifier, m_sourceDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) };
+	int includeWatch{ inotify_add_watch(notifier, (m_sourceDirectory / "include").c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) };
+
+	alignas(inotify_event) char buffer[4096];
+	while (!m_stop)
+	{
+		pollfd descriptor{ .fd = notifier, .events = POLLIN };
+		if (poll(&descriptor, 1, SHADER_RELOADER_POLL_INTERVAL_MS) <= 0)
+			continue;
+
+		std::vector<fs::path> changedFiles{};
+		ssize_t length{};
+		while ((length = read(notifier, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* ptr{ buffer }; ptr < buffer + length; ptr += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(ptr)->len)
+			{
+				const inotify_event* event{ reinterpret_cast<inotify_event*>(ptr) };
+				if (event->len == 0)
+					continue;
+				changedFiles.push_back((event->wd == includeWatch ? m_sourceDirectory / "include" : m_sourceDirectory) / event->name);
+			}
+		}
+
+		processChanges(changedFiles);
+	}
+
+	inotify_rm_watch(notifier, includeWatch);
+	inotify_rm_watch(notifier, sourceWatch);
+	close(notifier);
+#else
+	//No inotify, compare write times instead
+	std::unordered_map<std::string, fs::file_time_type> writeTimes{};
+	auto collectChanges{ [this, &writeTimes](bool record)
+		{
+			std::vector<fs::path> changedFiles{};
+			std::error_code error{};
+			for (auto& entry : fs::recursive_directory_iterator{ m_sourceDirectory, error })
+			{
+				if (!entry.is_regular_file())
+					continue;
+				fs::file_time_type writeTime{ entry.last_write_time(error) };
+				auto iter{ writeTimes.find(entry.path().string()) };
+				if (iter == writeTimes.end())
+					writeTimes.insert({ entry.path().string(), writeTime });
+				else if (iter->second != writeTime)
+				{
+					iter->second = writeTime;
+					if (record)
+						changedFiles.push_back(entry.path());
+				}
+			}
+			return changedFiles;
+		} };
+	collectChanges(false);
+
+	while (!m_stop)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(SHADER_RELOADER_POLL_INTERVAL_MS));
+		processChanges(collectChanges(true));
+	}
+#endif
+}
+
+void ShaderReloader::processChanges(const std::vector<fs::path>& changedFiles)
+{
+	std::set<fs::path> sources{};
+	for (auto& file : changedFiles)
+	{
+		if (isShaderSource(file))
+		{
+			sources.insert(file);
+		}
+		else
+		{
+			//Recompile every source that includes the changed header, directly or through other headers
+			std::error_code error{};
+			fs::path header{ fs::weakly_canonical(file, error) };
+			for (auto& entry : fs::recursive_directory_iterator{ m_sourceDirectory, error })
+			{
+				if (!entry.is_regular_file() || !isShaderSource(entry.path()))
+					continue;
+				std::set<fs::path> visited{};
+				if (includes(entry.path(), header, visited))
+					sources.insert(entry.path());
+			}
+		}
+	}
+
+	for (auto& source : sources)
+	{
+		if (compile(source))
+			rebuildPipelines(source.stem().string() + ".spv");
+	}
+}
+
+bool ShaderReloader::isShaderSource(const fs::path& file)
+{
+	std::string extension{ file.extension().string() };
+	return extension == ".vert" || extension == ".frag" || extension == ".comp" || extension == ".geom" || extension == ".tesc" || extension == ".tese";
+}
+
+bool ShaderReloader::includes(const fs::path& file, const fs::path& header, std::set<fs::path>& visited)
+{
+	std::error_code error{};
+	if (!visited.insert(fs::weakly_canonical(file, error)).second)
+		return false;
+
+	std::ifstream stream{ file };
+	std::string line{};
+	while (std::getline(stream, line))
+	{
+		//Only #include "name" directives are followed, they are resolved like glslangValidator does: next to the including file first, then in the include directory
+		size_t directive{ line.find_first_not_of(" \t") };
+		if (directive == std::string::npos || line[directive] != '#')
+			continue;
+		directive = line.find_first_not_of(" \t", directive + 1);
+		if (directive == std::string::npos || line.compare(directive, 7, "include") != 0)
+			continue;
+		size_t nameStart{ line.find('"', directive + 7) };
+		size_t nameEnd{ nameStart == std::string::npos ? std::string::npos : line.find('"', nameStart + 1) };
+		if (nameEnd == std::string::npos)
+			continue;
+		std::string name{ line.substr(nameStart + 1, nameEnd - nameStart - 1) };
+
+		fs::path included{ file.parent_path() / name };
+		if (!fs::exists(included, error))
+			included = m_sourceDirectory / "include" / name;
+		if (!fs::exists(included, error))
+			continue;
+
+		if (fs::weakly_canonical(included, error) == header || includes(included, header, visited))
+			return true;
+	}
+	return false;
+}
+
+bool ShaderReloader::compile(const fs::path& source)
+{
+	fs::path output{ m_outputDirectory / (source.stem().string() + ".spv") };
+	fs::path temporary{ output };
+	temporary += ".tmp";
+	fs::path logPath{ m_outputDirectory / (source.stem().string() + ".log") };
+
+	//Arguments are passed to the compiler without a shell, so paths with spaces need no escaping
+	int result{ runCompiler({ "-V", "--target-env", "vulkan1.3", "-I" + (m_sourceDirectory / "include").string(), "-o", temporary.string(), source.string() }, logPath) };
+
+	std::string log{};
+	{
+		std::ifstream stream{ logPath };
+		std::stringstream text{};
+		text << stream.rdbuf();
+		log = text.str();
+	}
+	std::error_code error{};
+	fs::remove(logPath, error);
+
+	std::lock_guard<std::mutex> lock{ m_errorsMutex };
+	if (result != 0)
+	{
+		fs::remove(temporary, error);
+		m_errors[source.filename().string()] = log;
+		LOG_WARNING("Shader \"{}\" failed to compile.", source.filename().string());
+		return false;
+	}
+
+	fs::rename(temporary, output, error);
+	m_errors.erase(source.filename().string());
+	LOG_INFO("Shader \"{}\" was recompiled.", source.filename().string());
+	return true;
+}
+
+int ShaderReloader::runCompiler(const std::vector<std::string>& arguments, const fs::path& logPath)
+{
+#ifdef _WIN32
+	std::string commandLine{ std::format("\"{}\"", m_compiler) };
+	for (auto& argument : arguments)
+		commandLine += std::format(" \"{}\"", argument);
+
+	SECURITY_ATTRIBUTES inheritable{ .nLength = sizeof(SECURITY_ATTRIBUTES), .lpSecurityDescriptor = nullptr, .bInheritHandle = TRUE };
+	HANDLE log{ CreateFileW(logPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &inheritable, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+	if (log == INVALID_HANDLE_VALUE)
+		return -1;
+
+	STARTUPINFOA startupInfo{ .cb = sizeof(STARTUPINFOA) };
+	startupInfo.dwFlags = STARTF_USESTDHANDLES;
+	startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+	startupInfo.hStdOutput = log;
+	startupInfo.hStdError = log;
+	PROCESS_INFORMATION processInfo{};
+	BOOL created{ CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr, nullptr, &startupInfo, &processInfo) };
+	CloseHandle(log);
+	if (!created)
+	{
+		LOG_WARNING("Shader compiler \"{}\" could not be started.", m_compiler);
+		return -1;
+	}
+
+	WaitForSingleObject(processInfo.hProcess, INFINITE);
+	DWORD exitCode{};
+	if (!GetExitCodeProcess(processInfo.hProcess, &exitCode))
+		exitCode = static_cast<DWORD>(-1);
+	CloseHandle(processInfo.hThread);
+	CloseHandle(processInfo.hProcess);
+	return static_cast<int>(exitCode);
+#else
+	std::vector<char*> argv{};
+	argv.push_back(m_compiler.data());
+	for (auto& argument : arguments)
+		argv.push_back(const_cast<char*>(argument.c_str()));
+	argv.push_back(nullptr);
+
+	posix_spawn_file_actions_t actions{};
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+	pid_t process{};
+	int spawnResult{ posix_spawnp(&process, m_compiler.c_str(), &actions, nullptr, argv.data(), environ) };
+	posix_spawn_file_actions_destroy(&actions);
+	if (spawnResult != 0)
+	{
+		LOG_WARNING("Shader compiler \"{}\" could not be started.", m_compiler);
+		return -1;
+	}
+
+	int status{};
+	while (waitpid(process, &status, 0) == -1)
+	{
+		if (errno != EINTR)
+			return -1;
+	}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+void ShaderReloader::rebuildPipelines(const fs::path& shaderFilename)
+{
+	auto pipelines{ Pipeline::getPipelinesUsingShader(shaderFilename) };
+	VkPipelineCache cache{ Pipeline::getGlobalPipelineCacheHandle() };
+
+	std::vector<ReloadedPipeline> reloadedPipelines(pipelines.size());
+	oneapi::tbb::parallel_for(size_t{ 0 }, pipelines.size(), [&](size_t i)
+		{
+			reloadedPipelines[i] = { .id = pipelines[i].first, .pipeline = pipelines[i].second(cache) };
+		});
+
+	//Pipelines that failed to build keep their previous version
+	size_t failedCount{ std::erase_if(reloadedPipelines, [](const ReloadedPipeline& reloaded) { return reloaded.pipeline == VK_NULL_HANDLE; }) };
+	{
+		std::lock_guard<std::mutex> lock{ m_errorsMutex };
+		if (failedCount != 0)
+		{
+			m_errors[shaderFilename.string()] = std::format("{} of {} pipelines using the shader failed to build, previous versions are kept.", failedCount, pipelines.size());
+			LOG_WARNING("{} pipelines using \"{}\" failed to build.", failedCount, shaderFilename.string());
+		}
+		else
+		{
+			m_errors.erase(shaderFilename.string());
+		}
+	}
+
+	std::lock_guard<std::mutex> lock{ m_reloadedMutex };
+	m_reloadedPipelines.insert(m_reloadedPipelines.end(), reloadedPipelines.begin(), reloadedPipelines.end());
+}
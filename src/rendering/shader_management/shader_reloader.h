@@ -0,0 +1,69 @@
+#ifndef SHADER_RELOADER_HEADER
+#define SHADER_RELOADER_HEADER
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <set>
+
+#include <vulkan/vulkan.h>
+
+namespace fs = std::filesystem;
+
+//Watches shader sources, recompiles changed ones with glslangValidator on the watcher thread and rebuilds the pipelines that use them off-thread.
+//Rebuilt pipelines are swapped in by applyReloadedPipelines() which must be called between frames.
+//Compilation errors are kept until the shader compiles successfully.
+class ShaderReloader
+{
+private:
+	struct ReloadedPipeline
+	{
+		uint64_t id;
+		VkPipeline pipeline;
+	};
+
+	VkDevice m_device{};
+	fs::path m_sourceDirectory{};
+	fs::path m_outputDirectory{};
+	std::string m_compiler{};
+
+	std::thread m_watcher{};
+	std::atomic<bool> m_stop{ false };
+
+	std::mutex m_reloadedMutex{};
+	std::vector<ReloadedPipeline> m_reloadedPipelines{};
+
+	std::mutex m_errorsMutex{};
+	std::unordered_map<std::string, std::string> m_errors{};
+
+public:
+	ShaderReloader(VkDevice device, const fs::path& sourceDirectory, const fs::path& outputDirectory);
+	~ShaderReloader();
+
+	//Joins the watcher, has to be called before the pipeline layouts used by reloads are destroyed
+	void stop();
+
+	//Returns the number of pipelines replaced
+	uint32_t applyReloadedPipelines();
+	std::vector<std::string> getErrors();
+
+	ShaderReloader(ShaderReloader&) = delete;
+	void operator=(ShaderReloader&) = delete;
+
+private:
+	void watch();
+	void processChanges(const std::vector<fs::path>& changedFiles);
+	static bool isShaderSource(const fs::path& file);
+	//Follows #include directives of the file recursively, visited files are skipped so include cycles terminate
+	bool includes(const fs::path& file, const fs::path& header, std::set<fs::path>& visited);
+	bool compile(const fs::path& source);
+	//Runs the compiler as a child process with its output written to the log, returns the exit code or -1 if it couldn't be run
+	int runCompiler(const std::vector<std::string>& arguments, const fs::path& logPath);
+	void rebuildPipelines(const fs::path& shaderFilename);
+};
+
+#endif
@@ -225,7 +225,8 @@ private:
 	{ \
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME, \
 	VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME, \
-	VK_EXT_DEPTH_RANGE_UNRESTRICTED_EXTENSION_NAME \
+	VK_EXT_DEPTH_RANGE_UNRESTRICTED_EXTENSION_NAME, \
+	VK_EXT_MEMORY_BUDGET_EXTENSION_NAME \
 	}
 	void getRequiredDeviceExtensions(std::vector<const char*>& extensions)
 	{
@@ -6,9 +6,15 @@
 
 #include <iostream>
 #include <map>
+#include <cstring>
+#include <cstddef>
+#include <string>
+#include <algorithm>
 
 #include <tbb/task_group.h>
 #include <tbb/spin_mutex.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
@@ -28,10 +34,19 @@
 #include "src/rendering/data_abstraction/mesh.h"
 #include "src/rendering/data_abstraction/runit.h"
 #include "src/rendering/data_abstraction/BB.h"
+#include "src/rendering/data_abstraction/mesh_simplifier.h"
 
 #include "src/tools/logging.h"
 #include "src/tools/alignment.h"
 
+//Every LOD is simplified from the previous one and targets half of its indices
+#define LOD_INDEX_REDUCTION 0.5
+//Simplification error of the first LOD relative to the size of the primitive, doubled for every next LOD along with the projected size halving
+#define LOD_FIRST_MAX_ERROR 0.005f
+//LODs saving less than this are not worth their index data
+#define LOD_MIN_INDEX_REDUCTION 0.8
+#define LOD_MIN_TRIANGLE_COUNT 64
+
 namespace fs = std::filesystem;
 
 struct MaterialURIs
@@ -91,12 +106,17 @@ inline void formIndexChunk(cgltf_data* model,
 	uint64_t& stagingCurrentSize,
 	RUnit& renderUnit,
 	oneapi::tbb::task_group& taskGroup);
+inline void generateLODs(uint8_t* const stagingDataPtr,
+	uint64_t& stagingCurrentSize,
+	std::vector<RUnit>& renderUnits,
+	const fs::path& filepath);
 
 
 inline std::vector<StaticMesh> loadStaticMeshes(
 								Buffer& vertexBuffer,
 								Buffer& indexBuffer,
 								BufferMapped& indirectDataBuffer,
+								BufferMapped& drawLODDataBuffer,
 								uint32_t& drawCount,
 								OBBs& rUnitOBBs,
 								ImageListContainer& loadedTextures,
@@ -142,6 +162,9 @@ inline std::vector<StaticMesh> loadStaticMeshes(
 			assert(false);
 		}
 		taskGroup.wait();
+		//Simplification needs the vertex data written by the tasks
+		if (result2 == cgltf_result_success)
+			generateLODs(stagingDataPtr, stagingCurrentSize, meshes.back().getRUnits(), filepaths[i]);
 		cgltf_free(modelsData[i]);
 	}
 	delete[] modelsData;
@@ -157,7 +180,7 @@ inline std::vector<StaticMesh> loadStaticMeshes(
 		for (uint32_t i{ 0 }; i < renderUnits.size(); ++i)
 		{
 			verticesByteSize += renderUnits[i].getVertBufByteSize();
-			indicesByteSize += renderUnits[i].getIndexBufByteSize();
+			indicesByteSize += renderUnits[i].getIndexBufByteSize() + renderUnits[i].getLODIndicesByteSize();
 		}
 	}
 	verticesByteSize = ALIGNED_SIZE(verticesByteSize, vertexBuffer.getAlignment());
@@ -168,11 +191,15 @@ inline std::vector<StaticMesh> loadStaticMeshes(
 	{
 		drawCount += mesh.getRUnits().size();
 	};
+	//Draw buffers are sized to the loaded scene
+	indirectDataBuffer.initialize(sizeof(IndirectData) * drawCount);
+	drawLODDataBuffer.initialize(sizeof(DrawLODData) * drawCount);
 
 	std::vector<VkBufferCopy> copyRegionsVertexBuf{};
 	std::vector<VkBufferCopy> copyRegionsIndexBuf{};
 
 	IndirectData* indirectCmdData{ reinterpret_cast<IndirectData*>(indirectDataBuffer.getData()) };
+	DrawLODData* drawLODData{ reinterpret_cast<DrawLODData*>(drawLODDataBuffer.getData()) };
 
 	uint64_t offsetIntoVertexData{ vertexBuffer.getOffset() };
 	uint64_t offsetIntoIndexData{ indexBuffer.getOffset() };
@@ -188,6 +215,7 @@ inline std::vector<StaticMesh> loadStaticMeshes(
 		{
 			uint64_t vertBufSize{ renderUnits[j].getVertBufByteSize() };
 			uint64_t indexBufSize{ renderUnits[j].getIndexBufByteSize() };
+			uint64_t lodIndexBufSize{ renderUnits[j].getLODIndicesByteSize() };
 			uint32_t indexCount{ static_cast<uint32_t>(indexBufSize / renderUnits[j].getIndexSize()) };
 
 			(indirectCmdData++)->cmd = VkDrawIndexedIndirectCommand{
@@ -197,15 +225,28 @@ inline std::vector<StaticMesh> loadStaticMeshes(
 				.vertexOffset = firstVertex,
 				.firstInstance = 0 };
 
-			firstIndex += indexCount;
+			//Simplified index ranges follow the full detail ones
+			DrawLODData& lods{ *(drawLODData++) };
+			lods.lodCount = renderUnits[j].getLODCount();
+			for (uint32_t lod{ 0 }, lodFirstIndex{ firstIndex }; lod < lods.lodCount; ++lod)
+			{
+				lods.firstIndex[lod] = lodFirstIndex;
+				lods.indexCount[lod] = renderUnits[j].getLODIndexCount(lod);
+				lodFirstIndex += lods.indexCount[lod];
+			}
+
+			firstIndex += static_cast<uint32_t>((indexBufSize + lodIndexBufSize) / renderUnits[j].getIndexSize());
 			firstVertex += static_cast<int32_t>(vertBufSize / renderUnits[j].getVertexSize());
 			copyRegionsVertexBuf.push_back(VkBufferCopy{ .srcOffset = renderUnits[j].getOffsetVertex(), .dstOffset = offsetIntoVertexData, .size = vertBufSize });
 			copyRegionsIndexBuf.push_back(VkBufferCopy{ .srcOffset = renderUnits[j].getOffsetIndex(), .dstOffset = offsetIntoIndexData, .size = indexBufSize });
+			if (lodIndexBufSize != 0)
+				copyRegionsIndexBuf.push_back(VkBufferCopy{ .srcOffset = renderUnits[j].getOffsetLODIndices(), .dstOffset = offsetIntoIndexData + indexBufSize, .size = lodIndexBufSize });
 			renderUnits[j].setVertBufOffset(offsetIntoVertexData);
 			renderUnits[j].setIndexBufOffset(offsetIntoIndexData);
+			renderUnits[j].setLODIndexBufOffset(offsetIntoIndexData + indexBufSize);
 			renderUnits[j].setDrawCmdBufferOffset(offsetIntoCmdBuffer++);
 			offsetIntoVertexData += vertBufSize;
-			offsetIntoIndexData += indexBufSize;
+			offsetIntoIndexData += indexBufSize + lodIndexBufSize;
 		}
 	}
 	VkCommandBuffer CB{ commandBufferSet.beginRecording(CommandBufferSet::MAIN_CB) };
@@ -600,5 +641,68 @@ inline void formIndexChunk(cgltf_data* model,
 	}
 }
 
+inline void generateLODs(uint8_t* const stagingDataPtr,
+	uint64_t& stagingCurrentSize,
+	std::vector<RUnit>& renderUnits,
+	const fs::path& filepath)
+{
+	std::vector<std::vector<uint32_t>> lodIndices(renderUnits.size());
+	oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0, renderUnits.size()),
+		[stagingDataPtr, &renderUnits, &lodIndices](const oneapi::tbb::blocked_range<size_t>& range)
+		{
+			for (size_t i{ range.begin() }; i < range.end(); ++i)
+			{
+				RUnit& renderUnit{ renderUnits[i] };
+				const uint8_t* positions{ stagingDataPtr + renderUnit.getOffsetVertex() + offsetof(StaticVertex, position) };
+				uint32_t vertexCount{ static_cast<uint32_t>(renderUnit.getVertBufByteSize() / renderUnit.getVertexSize()) };
+
+				std::vector<uint32_t> source{};
+				const uint32_t* sourceIndices{ reinterpret_cast<const uint32_t*>(stagingDataPtr + renderUnit.getOffsetIndex()) };
+				uint32_t sourceIndexCount{ renderUnit.getLODIndexCount(0) };
+				float maxError{ LOD_FIRST_MAX_ERROR };
+				while (renderUnit.getLODCount() < LOD_MAX_COUNT && sourceIndexCount / 3 >= LOD_MIN_TRIANGLE_COUNT)
+				{
+					std::vector<uint32_t> simplified{ MeshSimplifier::simplify(positions, renderUnit.getVertexSize(), vertexCount,
+						sourceIndices, sourceIndexCount, static_cast<uint32_t>(sourceIndexCount * LOD_INDEX_REDUCTION), maxError) };
+					if (simplified.size() > sourceIndexCount * LOD_MIN_INDEX_REDUCTION)
+						break;
+
+					renderUnit.addLOD(static_cast<uint32_t>(simplified.size()));
+					lodIndices[i].insert(lodIndices[i].end(), simplified.begin(), simplified.end());
+					source = std::move(simplified);
+					sourceIndices = source.data();
+					sourceIndexCount = static_cast<uint32_t>(source.size());
+					maxError *= 2.0f;
+				}
+			}
+		});
+
+	for (size_t i{ 0 }; i < renderUnits.size(); ++i)
+	{
+		if (lodIndices[i].empty())
+			continue;
+		uint64_t chunkSize{ sizeof(uint32_t) * lodIndices[i].size() };
+		std::memcpy(stagingDataPtr + stagingCurrentSize, lodIndices[i].data(), chunkSize);
+		renderUnits[i].setLODIndexBufOffset(stagingCurrentSize);
+		stagingCurrentSize += chunkSize;
+	}
+
+	//Draws without a level fall back to their coarsest one, so every level sums the whole scene
+	std::string lodReport{};
+	for (uint32_t lod{ 0 }; lod < LOD_MAX_COUNT; ++lod)
+	{
+		uint64_t triangleCount{ 0 };
+		uint32_t simplifiedDrawCount{ 0 };
+		for (auto& renderUnit : renderUnits)
+		{
+			uint32_t availableLOD{ std::min(lod, renderUnit.getLODCount() - 1) };
+			triangleCount += renderUnit.getLODIndexCount(availableLOD) / 3;
+			simplifiedDrawCount += availableLOD == lod ? 1 : 0;
+		}
+		lodReport += std::format("{}LOD{} - {} triangles ({} of {} draws)", lod == 0 ? "" : ", ", lod, triangleCount, simplifiedDrawCount, renderUnits.size());
+	}
+	LOG_INFO("LOD triangle counts of {}: {}", filepath.filename().generic_string(), lodReport);
+}
+
 
 #endif
\ No newline at end of file
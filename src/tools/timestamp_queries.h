@@ -75,6 +75,15 @@ public:
 		vkGetQueryPoolResults(m_device, m_pool, 0, QueryNum * 2, QueryNum * sizeof(Query), &m_queries.getData(), sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
 	}
 
+	//Negative if the query results haven't been available
+	double getQueryTimeMS(uint32_t queryIndex)
+	{
+		const Query& query{ reinterpret_cast<const Query*>(m_queries.getData())[queryIndex] };
+		if (query.availabilityStart == 0 || query.availabilityEnd == 0)
+			return -1.0;
+		return (query.endTime - query.startTime) * m_timeScaleMS;
+	}
+
 	void uploadQueryDataToProfilerTasks(legit::ProfilerTask* tasks, uint32_t count, uint32_t queryOffset = 0)
 	{
 		Query* queries{ reinterpret_cast<Query*>(m_queries.getData()) };